@@ -0,0 +1,226 @@
+#include "async_reader.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+// There is no liburing on all systems we build on, so the ring is set up with the raw system calls
+int io_uring_setup(const uint32_t entries, io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(const int ring_fd, const uint32_t to_submit, const uint32_t min_complete, const uint32_t flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+void* map_ring(const int ring_fd, const uint64_t size, const uint64_t offset) {
+  auto* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+  return region == MAP_FAILED ? nullptr : region;
+}
+
+template <typename T>
+T* ring_field(void* ring, const uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+}  // namespace
+
+namespace keva {
+
+AsyncReader::AsyncReader(const int fd, const uint32_t queue_depth, const bool use_io_uring)
+    : _fd(fd), _queue_depth(queue_depth) {
+  Assert(queue_depth > 0, "Queue depth must be at least one.");
+  if (use_io_uring && !_setup_ring()) _release_ring();
+}
+
+AsyncReader::~AsyncReader() { _release_ring(); }
+
+void AsyncReader::read(const std::vector<ReadRequest>& requests) {
+  if (requests.size() > 1) {
+    std::unique_lock<std::mutex> lock(_ring_mutex, std::try_to_lock);
+    if (lock.owns_lock() && _ring_fd >= 0) {
+      _read_with_io_uring(requests);
+      return;
+    }
+  }
+
+  for (const auto& request : requests) _pread(request, 0);
+}
+
+bool AsyncReader::uses_io_uring() const {
+  std::lock_guard<std::mutex> lock(_ring_mutex);
+  return _ring_fd >= 0;
+}
+
+bool AsyncReader::_setup_ring() {
+  io_uring_params params{};
+  _ring_fd = io_uring_setup(_queue_depth, &params);
+  if (_ring_fd < 0) return false;
+
+  // Older kernels map the submission and completion rings separately
+  _ring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  _ring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    _ring.sq_ring_size = std::max(_ring.sq_ring_size, _ring.cq_ring_size);
+    _ring.cq_ring_size = 0;
+  }
+
+  _ring.sq_ring = map_ring(_ring_fd, _ring.sq_ring_size, IORING_OFF_SQ_RING);
+  if (_ring.sq_ring == nullptr) return false;
+  _ring.cq_ring = _ring.sq_ring;
+  if (_ring.cq_ring_size > 0) {
+    _ring.cq_ring = map_ring(_ring_fd, _ring.cq_ring_size, IORING_OFF_CQ_RING);
+    if (_ring.cq_ring == nullptr) return false;
+  }
+  _ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  _ring.sqes = map_ring(_ring_fd, _ring.sqes_size, IORING_OFF_SQES);
+  if (_ring.sqes == nullptr) return false;
+
+  _ring.sq_head = ring_field<uint32_t>(_ring.sq_ring, params.sq_off.head);
+  _ring.sq_tail = ring_field<uint32_t>(_ring.sq_ring, params.sq_off.tail);
+  _ring.sq_mask = *ring_field<uint32_t>(_ring.sq_ring, params.sq_off.ring_mask);
+  _ring.sq_array = ring_field<uint32_t>(_ring.sq_ring, params.sq_off.array);
+  _ring.cq_head = ring_field<uint32_t>(_ring.cq_ring, params.cq_off.head);
+  _ring.cq_tail = ring_field<uint32_t>(_ring.cq_ring, params.cq_off.tail);
+  _ring.cq_mask = *ring_field<uint32_t>(_ring.cq_ring, params.cq_off.ring_mask);
+  _ring.cqes = ring_field<void>(_ring.cq_ring, params.cq_off.cqes);
+  return true;
+}
+
+void AsyncReader::_release_ring() {
+  if (_ring.sqes != nullptr) munmap(_ring.sqes, _ring.sqes_size);
+  if (_ring.cq_ring != nullptr && _ring.cq_ring != _ring.sq_ring) munmap(_ring.cq_ring, _ring.cq_ring_size);
+  if (_ring.sq_ring != nullptr) munmap(_ring.sq_ring, _ring.sq_ring_size);
+  if (_ring_fd >= 0) close(_ring_fd);
+  _ring = Ring{};
+  _ring_fd = -1;
+}
+
+void AsyncReader::_read_with_io_uring(const std::vector<ReadRequest>& requests) {
+  auto* sqes = static_cast<io_uring_sqe*>(_ring.sqes);
+  const auto* cqes = static_cast<const io_uring_cqe*>(_ring.cqes);
+
+  // Reads in flight write into the buffers of the requests, so all of them are completed before an error is reported
+  // or the ring is released
+  std::string error;
+  auto next_request = size_t{0};
+  auto num_in_flight = uint32_t{0};
+  auto has_failed_submit = false;
+  while (num_in_flight > 0 || (next_request < requests.size() && !has_failed_submit)) {
+    // Fill the submission queue up to the queue depth. Only we write its tail.
+    auto sq_tail = *_ring.sq_tail;
+    while (!has_failed_submit && next_request < requests.size() && num_in_flight < _queue_depth &&
+           sq_tail - __atomic_load_n(_ring.sq_head, __ATOMIC_ACQUIRE) <= _ring.sq_mask) {
+      const auto& request = requests[next_request];
+      const auto index = sq_tail & _ring.sq_mask;
+      auto& sqe = sqes[index];
+      std::memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = IORING_OP_READ;
+      sqe.fd = _fd;
+      sqe.off = request.offset;
+      sqe.addr = reinterpret_cast<uint64_t>(request.data);
+      sqe.len = request.num_bytes;
+      sqe.user_data = next_request;
+      _ring.sq_array[index] = index;
+
+      ++sq_tail;
+      ++next_request;
+      ++num_in_flight;
+    }
+    __atomic_store_n(_ring.sq_tail, sq_tail, __ATOMIC_RELEASE);
+
+    // Submit all reads that the kernel did not take yet and wait until at least one read is complete. A submit may be
+    // interrupted or take only some of the reads, in which case it does not wait.
+    while (!has_failed_submit) {
+      const auto sq_head = __atomic_load_n(_ring.sq_head, __ATOMIC_ACQUIRE);
+      const auto num_unsubmitted = sq_tail - sq_head;
+      if (num_unsubmitted == 0) break;
+
+      const auto result = _enter(num_unsubmitted, 1, IORING_ENTER_GETEVENTS);
+      if (result > 0 || (result < 0 && errno == EINTR)) continue;
+      if (result == 0 || errno == EAGAIN || errno == EBUSY) {
+        // The kernel is short of resources until some reads complete
+        if (num_in_flight > num_unsubmitted) break;
+        std::this_thread::yield();
+        continue;
+      }
+
+      // The kernel never saw the remaining reads, so they are taken back and read with pread once the ring is idle
+      __atomic_store_n(_ring.sq_tail, sq_head, __ATOMIC_RELEASE);
+      next_request -= num_unsubmitted;
+      num_in_flight -= num_unsubmitted;
+      has_failed_submit = true;
+    }
+    if (num_in_flight == 0) continue;
+
+    _wait_for_completion();
+    auto cq_head = *_ring.cq_head;
+    const auto cq_tail = __atomic_load_n(_ring.cq_tail, __ATOMIC_ACQUIRE);
+    for (; cq_head != cq_tail; ++cq_head) {
+      const auto& cqe = cqes[cq_head & _ring.cq_mask];
+      const auto& request = requests[cqe.user_data];
+
+      // Kernels without IORING_OP_READ reject it, short reads are finished synchronously. Both are rare.
+      try {
+        if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+          _pread(request, 0);
+        } else {
+          Assert(cqe.res >= 0, std::string{"Failed to read from database file: "} + std::strerror(-cqe.res));
+          if (static_cast<uint32_t>(cqe.res) < request.num_bytes) _pread(request, static_cast<uint32_t>(cqe.res));
+        }
+      } catch (const std::logic_error& read_error) {
+        if (error.empty()) error = read_error.what();
+      }
+
+      --num_in_flight;
+    }
+    __atomic_store_n(_ring.cq_head, cq_head, __ATOMIC_RELEASE);
+  }
+
+  if (has_failed_submit) {
+    // Nothing is in flight anymore. The state of the ring is unknown, so all further reads use pread.
+    _release_ring();
+    for (; next_request < requests.size(); ++next_request) {
+      try {
+        _pread(requests[next_request], 0);
+      } catch (const std::logic_error& read_error) {
+        if (error.empty()) error = read_error.what();
+      }
+    }
+  }
+
+  Assert(error.empty(), error);
+}
+
+void AsyncReader::_wait_for_completion() {
+  // Completions are posted even if waiting for them fails, so the reads in flight are never abandoned
+  while (__atomic_load_n(_ring.cq_tail, __ATOMIC_ACQUIRE) == *_ring.cq_head) {
+    if (_enter(0, 1, IORING_ENTER_GETEVENTS) < 0) std::this_thread::yield();
+  }
+}
+
+int AsyncReader::_enter(const uint32_t to_submit, const uint32_t min_complete, const uint32_t flags) {
+  return io_uring_enter(_ring_fd, to_submit, min_complete, flags);
+}
+
+void AsyncReader::_pread(const ReadRequest& request, uint32_t num_bytes_done) const {
+  while (num_bytes_done < request.num_bytes) {
+    const auto result = pread(_fd, request.data + num_bytes_done, request.num_bytes - num_bytes_done,
+                              static_cast<off_t>(request.offset + num_bytes_done));
+    if (result < 0 && errno == EINTR) continue;
+    Assert(result > 0, "Failed to read from database file.");
+    num_bytes_done += static_cast<uint32_t>(result);
+  }
+}
+
+}  // namespace keva
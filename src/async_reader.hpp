@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+struct ReadRequest {
+  FileOffset offset;
+  uint32_t num_bytes;
+  char* data;
+};
+
+// Reads many ranges of a file at once. With io_uring, up to queue_depth reads are in flight at the same time, so the
+// device can work on them in parallel. If the kernel does not support io_uring (or it is disabled, e.g., by a seccomp
+// filter), the ranges are read one after another with pread.
+class AsyncReader : public Noncopyable {
+ public:
+  AsyncReader(int fd, uint32_t queue_depth, bool use_io_uring = true);
+  virtual ~AsyncReader();
+
+  // Returns once all requests are complete. Reading beyond the end of the file is an error. May be called from many
+  // threads at once: the ring serves one of them at a time, the others read with pread meanwhile instead of waiting.
+  void read(const std::vector<ReadRequest>& requests);
+
+  bool uses_io_uring() const;
+
+ protected:
+  // Mapped rings of io_uring. The kernel writes the completion tail and the submission head, we write the others.
+  struct Ring {
+    void* sq_ring = nullptr;
+    uint64_t sq_ring_size = 0;
+    void* cq_ring = nullptr;
+    uint64_t cq_ring_size = 0;
+    void* sqes = nullptr;
+    uint64_t sqes_size = 0;
+
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t sq_mask;
+    uint32_t* sq_array;
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t cq_mask;
+    void* cqes;
+  };
+
+  bool _setup_ring();
+  void _release_ring();
+  void _read_with_io_uring(const std::vector<ReadRequest>& requests);
+  void _wait_for_completion();
+  void _pread(const ReadRequest& request, uint32_t num_bytes_done) const;
+
+  // io_uring_enter on the ring. Returns the number of submitted reads, or -1 and sets errno. Tests inject failures.
+  virtual int _enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+
+  const int _fd;
+  const uint32_t _queue_depth;
+  mutable std::mutex _ring_mutex;
+  int _ring_fd = -1;
+  Ring _ring{};
+};
+
+}  // namespace keva
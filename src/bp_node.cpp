@@ -2,6 +2,8 @@
 
 #include <algorithm>
 
+#include "key_search.hpp"
+
 namespace keva {
 
 const BPNodeHeader& BPNode::header() const { return _header; }
@@ -116,6 +118,32 @@ std::pair<BPNode, FileKey> BPNode::split_parent(FileKey split_key, NodeID new_ch
   return {std::move(new_node), median_key};
 }
 
+std::pair<BPNode, FileKey> BPNode::split_internal() {
+  DebugAssert(!_header.is_leaf, "Cannot call split_internal on leaf node");
+  DebugAssert(_keys.size() >= 3, "Node has too few keys to be split");
+
+  // The left node keeps the keys before the median, the new node gets the keys behind it
+  const auto num_keys_stay = _keys.size() / 2;
+  const auto median_key = _keys[num_keys_stay];
+
+  std::vector<FileKey> new_keys(_keys.begin() + num_keys_stay + 1, _keys.end());
+  std::vector<NodeID> new_children(_children.begin() + num_keys_stay + 1, _children.end());
+  _keys.resize(num_keys_stay);
+  _children.resize(num_keys_stay + 1);
+  _header.num_keys = static_cast<uint16_t>(num_keys_stay);
+
+  BPNodeHeader new_node_header{};
+  new_node_header.node_id = InvalidNodeID;  // use dummy value, external caller has to update this
+  new_node_header.is_leaf = false;
+  new_node_header.parent_id = _header.parent_id;
+  new_node_header.next_leaf = InvalidNodeID;
+  new_node_header.previous_leaf = InvalidNodeID;
+  new_node_header.num_keys = static_cast<uint16_t>(new_keys.size());
+
+  BPNode new_node{new_node_header, std::move(new_keys), std::move(new_children)};
+  return {std::move(new_node), median_key};
+}
+
 void BPNode::insert(const FileKey key, const NodeID child) {
   uint16_t insert_pos;
 
@@ -132,6 +160,31 @@ void BPNode::insert(const FileKey key, const NodeID child) {
   _header.num_keys++;
 }
 
+void BPNode::set_child(const uint16_t position, const NodeID child) {
+  DebugAssert(position < _children.size(), "Child position out of range");
+  _children[position] = child;
+}
+
+void BPNode::set_key(const uint16_t position, const FileKey key) {
+  DebugAssert(position < _keys.size(), "Key position out of range");
+  _keys[position] = key;
+}
+
+void BPNode::erase(const uint16_t position) {
+  DebugAssert(position < _keys.size(), "Key position out of range");
+  _keys.erase(_keys.begin() + position);
+  _children.erase(_children.begin() + position + (_header.is_leaf ? 0 : 1));
+  _header.num_keys--;
+}
+
+void BPNode::erase_child(const uint16_t position) {
+  DebugAssert(!_header.is_leaf, "Cannot call erase_child on leaf node");
+  DebugAssert(position < _children.size(), "Child position out of range");
+  _children.erase(_children.begin() + position);
+  if (!_keys.empty()) _keys.erase(_keys.begin() + (position > 0 ? position - 1 : 0));
+  _header.num_keys = static_cast<uint16_t>(_keys.size());
+}
+
 NodeID BPNode::find_child(const FileKey key) const {
   DebugAssert(!_header.is_leaf, "Cannot call find_child on leaf node");
   return _children.at(find_child_insert_position(key));
@@ -149,18 +202,12 @@ NodeID BPNode::find_value(const FileKey key) const {
 
 uint16_t BPNode::find_child_insert_position(const FileKey key) const {
   DebugAssert(!_header.is_leaf, "Cannot call find_child_insert_position on leaf node");
-  const auto key_end = _keys.cbegin() + _header.num_keys;
-  const auto key_iter = std::upper_bound(_keys.begin(), key_end, key);
-
-  return static_cast<uint16_t>(std::distance(_keys.cbegin(), key_iter));
+  return keys_upper_bound(_keys.data(), _header.num_keys, key);
 }
 
 uint16_t BPNode::find_value_insert_position(const FileKey key) const {
   DebugAssert(_header.is_leaf, "Cannot call find_value_insert_position on non-leaf node");
-  const auto key_end = _keys.cbegin() + _header.num_keys;
-  const auto key_iter = std::lower_bound(_keys.begin(), key_end, key);
-
-  return static_cast<uint16_t>(std::distance(_keys.begin(), key_iter));
+  return keys_lower_bound(_keys.data(), _header.num_keys, key);
 }
 
 }  // namespace keva
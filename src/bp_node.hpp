@@ -29,10 +29,22 @@ class BPNode : public Noncopyable {
   BPNodeHeader& mutable_header();
 
   void insert(FileKey key, NodeID child);
+  void set_child(uint16_t position, NodeID child);
+  void set_key(uint16_t position, FileKey key);
+
+  // Removes the key at position and its child. In internal nodes, this is the child right of the key.
+  void erase(uint16_t position);
+
+  // Removes the child at position of an internal node with the key on its left, or on its right for the first child
+  void erase_child(uint16_t position);
 
   BPNode split_leaf(FileKey split_key);
   std::pair<BPNode, FileKey> split_parent(FileKey split_key, NodeID new_child_id);
 
+  // Moves the upper half of an internal node to a new node without inserting anything. Returns the new node and the key
+  // that separates both nodes, which is in neither of them.
+  std::pair<BPNode, FileKey> split_internal();
+
   // Finds the ID of the next child to look at. Only callable on internal nodes
   NodeID find_child(FileKey key) const;
   uint16_t find_child_insert_position(FileKey key) const;
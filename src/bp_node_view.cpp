@@ -0,0 +1,85 @@
+#include "bp_node_view.hpp"
+
+#include "key_search.hpp"
+
+namespace keva {
+
+void encode_node_header(const BPNodeHeader& header, char* page) {
+  write_to_page(page, NODE_ID_OFFSET, header.node_id);
+  write_to_page(page, IS_LEAF_OFFSET, static_cast<uint8_t>(header.is_leaf));
+  write_to_page(page, PARENT_ID_OFFSET, header.parent_id);
+  write_to_page(page, NEXT_LEAF_OFFSET, header.next_leaf);
+  write_to_page(page, PREVIOUS_LEAF_OFFSET, header.previous_leaf);
+  write_to_page(page, NUM_KEYS_OFFSET, header.num_keys);
+}
+
+BPNodeView::BPNodeView(const char* page, const NodeLayout layout) : _page(page), _layout(layout) {}
+
+BPNodeHeader BPNodeView::header() const {
+  BPNodeHeader node_header{};
+  node_header.node_id = read_from_page<NodeID>(_page, NODE_ID_OFFSET);
+  node_header.is_leaf = is_leaf();
+  node_header.parent_id = read_from_page<NodeID>(_page, PARENT_ID_OFFSET);
+  node_header.next_leaf = read_from_page<NodeID>(_page, NEXT_LEAF_OFFSET);
+  node_header.previous_leaf = read_from_page<NodeID>(_page, PREVIOUS_LEAF_OFFSET);
+  node_header.num_keys = num_keys();
+  return node_header;
+}
+
+bool BPNodeView::is_leaf() const { return read_from_page<uint8_t>(_page, IS_LEAF_OFFSET) != 0; }
+
+uint16_t BPNodeView::num_keys() const { return read_from_page<uint16_t>(_page, NUM_KEYS_OFFSET); }
+
+KeySpan BPNodeView::keys() const { return {_page + BP_NODE_HEADER_SIZE, num_keys(), _layout.key_size}; }
+
+UnalignedSpan<NodeID> BPNodeView::children() const {
+  const auto children_offset = BP_NODE_HEADER_SIZE + _layout.max_keys_per_node * _layout.key_size;
+  const auto num_children = static_cast<uint16_t>(num_keys() + (is_leaf() ? 0 : 1));
+  return {_page + children_offset, num_children};
+}
+
+BPNode BPNodeView::to_node() const {
+  const auto keys_view = keys();
+  const auto children_view = children();
+
+  // Only copy the used slots, the rest of the page is null
+  std::vector<FileKey> node_keys(keys_view.size());
+  for (auto position = uint16_t{0}; position < node_keys.size(); ++position) node_keys[position] = keys_view[position];
+
+  std::vector<NodeID> node_children(children_view.size());
+  if (!node_children.empty()) {
+    std::memcpy(node_children.data(), children_view.data(), node_children.size() * sizeof(NodeID));
+  }
+
+  return BPNode(header(), std::move(node_keys), std::move(node_children));
+}
+
+NodeID BPNodeView::find_child(const FileKey key) const {
+  DebugAssert(!is_leaf(), "Cannot call find_child on leaf node");
+  return children()[find_child_insert_position(key)];
+}
+
+uint16_t BPNodeView::find_child_insert_position(const FileKey key) const {
+  DebugAssert(!is_leaf(), "Cannot call find_child_insert_position on leaf node");
+  if (_layout.key_size == sizeof(uint32_t)) return keys32_upper_bound(_page + BP_NODE_HEADER_SIZE, num_keys(), key);
+  return keys_upper_bound(_page + BP_NODE_HEADER_SIZE, num_keys(), key);
+}
+
+NodeID BPNodeView::find_value(const FileKey key) const {
+  DebugAssert(is_leaf(), "Cannot call find_value on non-leaf node");
+  const auto value_pos = find_value_insert_position(key);
+  const auto node_keys = keys();
+  if (value_pos < node_keys.size() && node_keys[value_pos] == key) {
+    return children()[value_pos];
+  } else {
+    return InvalidNodeID;
+  }
+}
+
+uint16_t BPNodeView::find_value_insert_position(const FileKey key) const {
+  DebugAssert(is_leaf(), "Cannot call find_value_insert_position on non-leaf node");
+  if (_layout.key_size == sizeof(uint32_t)) return keys32_lower_bound(_page + BP_NODE_HEADER_SIZE, num_keys(), key);
+  return keys_lower_bound(_page + BP_NODE_HEADER_SIZE, num_keys(), key);
+}
+
+}  // namespace keva
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <memory>
+
+#include "bp_node.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+// Byte offsets of the node header fields within a page
+static const uint16_t NODE_ID_OFFSET = 0;
+static const uint16_t IS_LEAF_OFFSET = 8;
+static const uint16_t PARENT_ID_OFFSET = 9;
+static const uint16_t NEXT_LEAF_OFFSET = 17;
+static const uint16_t PREVIOUS_LEAF_OFFSET = 25;
+static const uint16_t NUM_KEYS_OFFSET = 33;
+
+// Buffer for a page that is neither cached nor mapped. Pages of up to DEFAULT_PAGE_SIZE bytes are stored inline, so
+// the many buffers on the stack stay small. Larger pages are allocated on the heap when the buffer is first filled.
+class NodePage {
+ public:
+  // At least page_size bytes. Their contents are lost if the buffer has to grow.
+  char* data(const uint32_t page_size) {
+    if (page_size > _inline_page.size() && page_size > _heap_page_size) {
+      _heap_page.reset(new char[page_size]);
+      _heap_page_size = page_size;
+    }
+    return data();
+  }
+
+  char* data() { return _heap_page ? _heap_page.get() : _inline_page.data(); }
+  const char* data() const { return _heap_page ? _heap_page.get() : _inline_page.data(); }
+
+ protected:
+  std::array<char, DEFAULT_PAGE_SIZE> _inline_page;
+  std::unique_ptr<char[]> _heap_page;
+  uint32_t _heap_page_size = 0;
+};
+
+template <typename T>
+T read_from_page(const char* page, const uint64_t offset) {
+  T value;
+  std::memcpy(&value, page + offset, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void write_to_page(char* page, const uint64_t offset, const T& value) {
+  std::memcpy(page + offset, &value, sizeof(T));
+}
+
+// Writes the header fields to their offsets. Used for all node formats, as they share the header.
+void encode_node_header(const BPNodeHeader& header, char* page);
+
+// Read-only array of T that starts at an arbitrary byte in a page. Children are not 8-byte aligned in a page, so
+// elements are copied out instead of being accessed through a T*.
+template <typename T>
+class UnalignedSpan {
+ public:
+  UnalignedSpan(const char* data, const uint16_t size) : _data(data), _size(size) {}
+
+  T operator[](const uint16_t index) const { return read_from_page<T>(_data, index * sizeof(T)); }
+  T front() const { return (*this)[0]; }
+  T back() const { return (*this)[_size - 1]; }
+
+  uint16_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  const char* data() const { return _data; }
+
+ protected:
+  const char* _data;
+  uint16_t _size;
+};
+
+// Read-only array of the keys of a page, which are 4 or 8 bytes wide (see NodeLayout). Keys are returned as FileKeys.
+class KeySpan {
+ public:
+  KeySpan(const char* data, const uint16_t size, const uint16_t key_size)
+      : _data(data), _size(size), _key_size(key_size) {}
+
+  FileKey operator[](const uint16_t index) const {
+    if (_key_size == sizeof(uint32_t)) return read_from_page<uint32_t>(_data, index * sizeof(uint32_t));
+    return read_from_page<FileKey>(_data, index * sizeof(FileKey));
+  }
+  FileKey front() const { return (*this)[0]; }
+  FileKey back() const { return (*this)[_size - 1]; }
+
+  uint16_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+ protected:
+  const char* _data;
+  uint16_t _size;
+  uint16_t _key_size;
+};
+
+// Read-only view of a node that interprets the page in place instead of copying it into a BPNode. The view is only
+// valid as long as the page memory is, i.e., until the next call into the FileManager that it came from.
+class BPNodeView {
+ public:
+  BPNodeView(const char* page, NodeLayout layout);
+
+  BPNodeHeader header() const;
+  bool is_leaf() const;
+  uint16_t num_keys() const;
+
+  KeySpan keys() const;
+  UnalignedSpan<NodeID> children() const;
+
+  // Copies the used key and child slots into a BPNode
+  BPNode to_node() const;
+
+  // Same semantics as the BPNode functions of the same name
+  NodeID find_child(FileKey key) const;
+  uint16_t find_child_insert_position(FileKey key) const;
+  NodeID find_value(FileKey key) const;
+  uint16_t find_value_insert_position(FileKey key) const;
+
+ protected:
+  const char* _page;
+  NodeLayout _layout;
+};
+
+}  // namespace keva
@@ -0,0 +1,120 @@
+#include "buffer_pool.hpp"
+
+#include <algorithm>
+
+namespace keva {
+
+BufferPool::BufferPool(const uint64_t capacity_bytes, const uint32_t page_size, PageReader page_reader,
+                       PageWriter page_writer)
+    : _page_size(page_size), _page_reader(std::move(page_reader)), _page_writer(std::move(page_writer)) {
+  const auto num_frames = capacity_bytes / page_size;
+  Assert(num_frames > 0, "Buffer pool must be able to hold at least one page.");
+
+  _page_data.resize(num_frames * page_size);
+  _frames.resize(num_frames, BufferFrame{InvalidNodeID, false, false, false});
+  _page_table.reserve(num_frames);
+}
+
+const char* BufferPool::read_page(const FileOffset offset) { return _frame_data(_get_frame(offset, true)); }
+
+char* BufferPool::write_page(const FileOffset offset, const bool load_from_file, const bool pin) {
+  const auto frame_id = _get_frame(offset, load_from_file);
+  auto& frame = _frames[frame_id];
+  frame.is_dirty = true;
+
+  if (pin && !frame.is_pinned) {
+    frame.is_pinned = true;
+    _pinned_frames.push_back(frame_id);
+  }
+
+  return _frame_data(frame_id);
+}
+
+void BufferPool::unpin_all() {
+  for (const auto frame_id : _pinned_frames) _frames[frame_id].is_pinned = false;
+  _pinned_frames.clear();
+}
+
+void BufferPool::flush() {
+  // Write back in file order so that the writes are as sequential as possible. Pinned pages must stay in memory.
+  std::vector<uint32_t> dirty_frames;
+  for (auto frame_id = 0u; frame_id < _num_used_frames; ++frame_id) {
+    if (_frames[frame_id].is_dirty && !_frames[frame_id].is_pinned) dirty_frames.push_back(frame_id);
+  }
+
+  std::sort(dirty_frames.begin(), dirty_frames.end(),
+            [&](const uint32_t lhs, const uint32_t rhs) { return _frames[lhs].offset < _frames[rhs].offset; });
+
+  for (const auto frame_id : dirty_frames) {
+    _page_writer(_frames[frame_id].offset, _frame_data(frame_id));
+    _frames[frame_id].is_dirty = false;
+    _stats.write_backs++;
+  }
+}
+
+bool BufferPool::contains(const FileOffset offset) const { return _page_table.count(offset) > 0; }
+
+uint32_t BufferPool::num_frames() const { return static_cast<uint32_t>(_frames.size()); }
+
+const BufferPoolStats& BufferPool::stats() const { return _stats; }
+
+uint32_t BufferPool::_get_frame(const FileOffset offset, const bool load_from_file) {
+  DebugAssert(offset != InvalidNodeID, "Trying to access page at invalid offset");
+
+  const auto page_it = _page_table.find(offset);
+  if (page_it != _page_table.end()) {
+    _stats.hits++;
+    _frames[page_it->second].is_referenced = true;
+    return page_it->second;
+  }
+
+  _stats.misses++;
+  const auto frame_id = _find_victim_frame();
+  auto& frame = _frames[frame_id];
+
+  frame.offset = offset;
+  frame.is_dirty = false;
+  frame.is_referenced = true;
+  frame.is_pinned = false;
+  _page_table.emplace(offset, frame_id);
+
+  if (load_from_file) _page_reader(offset, _frame_data(frame_id));
+  return frame_id;
+}
+
+uint32_t BufferPool::_find_victim_frame() {
+  // Fill the pool before evicting anything
+  if (_num_used_frames < _frames.size()) return _num_used_frames++;
+
+  // After two full rotations all reference bits are cleared, so only pinned pages are left
+  for (auto step = 0ull; step < 2 * _frames.size(); ++step) {
+    auto& frame = _frames[_clock_hand];
+    const auto frame_id = _clock_hand;
+    _clock_hand = (_clock_hand + 1) % _frames.size();
+
+    if (frame.is_pinned) continue;
+
+    if (frame.is_referenced) {
+      // Second chance
+      frame.is_referenced = false;
+      continue;
+    }
+
+    if (frame.is_dirty) {
+      _page_writer(frame.offset, _frame_data(frame_id));
+      _stats.write_backs++;
+    }
+
+    _page_table.erase(frame.offset);
+    _stats.evictions++;
+    return frame_id;
+  }
+
+  throw std::runtime_error("All pages in the buffer pool are pinned. Increase the buffer pool size.");
+}
+
+char* BufferPool::_frame_data(const uint32_t frame_id) {
+  return _page_data.data() + static_cast<uint64_t>(frame_id) * _page_size;
+}
+
+}  // namespace keva
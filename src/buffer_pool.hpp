@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+struct BufferPoolStats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t write_backs;
+};
+
+// Fixed-size cache of raw node pages. Pages are evicted with the CLOCK (second chance) algorithm and dirty pages are
+// only written back to the file on eviction or flush.
+class BufferPool : public Noncopyable {
+ public:
+  using PageReader = std::function<void(FileOffset, char*)>;
+  using PageWriter = std::function<void(FileOffset, const char*)>;
+
+  BufferPool(uint64_t capacity_bytes, uint32_t page_size, PageReader page_reader, PageWriter page_writer);
+
+  // Returned pointers are valid until the next call into the pool
+  const char* read_page(FileOffset offset);
+
+  // Pinned pages are not evicted (and thus not written to the file) until unpin_all is called
+  char* write_page(FileOffset offset, bool load_from_file, bool pin = false);
+  void unpin_all();
+
+  // Write all dirty pages that are not pinned back to the file
+  void flush();
+
+  bool contains(FileOffset offset) const;
+  uint32_t num_frames() const;
+  const BufferPoolStats& stats() const;
+
+ protected:
+  struct BufferFrame {
+    FileOffset offset;
+    bool is_dirty;
+    bool is_referenced;
+    bool is_pinned;
+  };
+
+  uint32_t _get_frame(FileOffset offset, bool load_from_file);
+  uint32_t _find_victim_frame();
+  char* _frame_data(uint32_t frame_id);
+
+  const uint32_t _page_size;
+  const PageReader _page_reader;
+  const PageWriter _page_writer;
+
+  std::vector<char> _page_data;
+  std::vector<BufferFrame> _frames;
+  std::unordered_map<FileOffset, uint32_t> _page_table;
+  std::vector<uint32_t> _pinned_frames;
+
+  uint32_t _clock_hand = 0;
+  uint32_t _num_used_frames = 0;
+  BufferPoolStats _stats{};
+};
+
+}  // namespace keva
@@ -0,0 +1,176 @@
+#include "bulk_loader.hpp"
+
+#include <algorithm>
+
+namespace {
+
+using namespace keva;
+
+// First item of node_index if num_items are distributed evenly over num_nodes
+uint64_t first_item_of_node(const uint64_t node_index, const uint64_t num_items, const uint64_t num_nodes) {
+  return node_index * num_items / num_nodes;
+}
+
+uint64_t num_items_of_node(const uint64_t node_index, const uint64_t num_items, const uint64_t num_nodes) {
+  return first_item_of_node(node_index + 1, num_items, num_nodes) - first_item_of_node(node_index, num_items, num_nodes);
+}
+
+uint64_t num_nodes_for_items(const uint64_t num_items, const uint64_t node_capacity, const uint64_t min_fill) {
+  auto num_nodes = (num_items + node_capacity - 1) / node_capacity;
+  // Only the root may be less than half full
+  while (num_nodes > 1 && num_items / num_nodes < min_fill) num_nodes--;
+  return num_nodes;
+}
+
+}  // namespace
+
+namespace keva {
+
+BulkLoader::BulkLoader(FileManager& file_manager, const uint16_t max_keys_per_node, const double fill_factor)
+    : _file_manager(file_manager), _max_keys_per_node(max_keys_per_node), _fill_factor(fill_factor) {
+  Assert(fill_factor > 0 && fill_factor <= 1, "Fill factor must be in (0, 1].");
+}
+
+NodeID BulkLoader::load(const uint64_t num_entries, const BulkLoadEntryGenerator& next_entry) {
+  Assert(num_entries > 0, "Cannot bulk load without entries.");
+
+  const uint64_t min_fill = (_max_keys_per_node + 1) / 2;
+  const auto max_children = static_cast<uint64_t>(_max_keys_per_node + 1);
+  const auto leaf_capacity =
+      std::clamp(static_cast<uint64_t>(_max_keys_per_node * _fill_factor), min_fill, max_children - 1);
+  const auto internal_capacity =
+      std::clamp(static_cast<uint64_t>(max_children * _fill_factor), std::max<uint64_t>(min_fill, 2), max_children);
+
+  _level_sizes = {num_nodes_for_items(num_entries, leaf_capacity, min_fill)};
+  while (_level_sizes.back() > 1) {
+    _level_sizes.push_back(num_nodes_for_items(_level_sizes.back(), internal_capacity, min_fill));
+  }
+
+  // Reserve all internal nodes in front of the leaves, starting with the root
+  _internal_levels.resize(_level_sizes.size());
+  for (auto level = _level_sizes.size() - 1; level > 0; --level) {
+    auto& internal_level = _internal_levels[level];
+    for (auto node = 0ull; node < _level_sizes[level]; ++node) {
+      internal_level.node_ids.push_back(_file_manager.get_next_node_position());
+    }
+  }
+
+  const auto num_leaves = _level_sizes[0];
+  FileKey previous_key = 0;
+
+  for (auto leaf_index = 0ull; leaf_index < num_leaves; ++leaf_index) {
+    const auto num_leaf_entries = num_items_of_node(leaf_index, num_entries, num_leaves);
+    std::vector<FileKey> keys;
+    std::vector<FileValue> values;
+    keys.reserve(num_leaf_entries);
+    values.reserve(num_leaf_entries);
+
+    for (auto i = 0ull; i < num_leaf_entries; ++i) {
+      auto entry = next_entry();
+      if (!(leaf_index == 0 && i == 0) && entry.first <= previous_key) {
+        throw std::runtime_error("Bulk load keys must be unique and sorted.");
+      }
+      if (entry.first > _file_manager.max_key()) {
+        throw std::runtime_error("Bulk load key does not fit into the key size of the database.");
+      }
+
+      previous_key = entry.first;
+      keys.push_back(entry.first);
+      values.push_back(std::move(entry.second));
+    }
+
+    _write_leaf(leaf_index, std::move(keys), values);
+  }
+
+  for (auto level = 1u; level < _internal_levels.size(); ++level) {
+    Assert(_internal_levels[level].current_node == _level_sizes[level], "Bulk load did not write all internal nodes.");
+  }
+
+  return _level_sizes.size() == 1 ? _previous_leaf : _internal_levels.back().node_ids.front();
+}
+
+void BulkLoader::_write_leaf(const uint64_t leaf_index, std::vector<FileKey> keys, const std::vector<FileValue>& values) {
+  const auto leaf_id = _file_manager.get_next_node_position();
+  const auto is_last_leaf = leaf_index + 1 == _level_sizes[0];
+
+  // Values are placed directly behind the leaf, so we know their positions before writing it. Inline values are
+  // stored in the leaf itself and the next leaf follows directly, just like with a value log.
+  const auto values_follow_leaf = !_file_manager.has_inline_values() && _file_manager.value_log() == nullptr;
+  std::vector<NodeID> children;
+  children.reserve(values.size());
+  auto value_position = leaf_id + _file_manager.page_size();
+  for (auto i = 0u; i < values.size(); ++i) {
+    const auto& value = values[i];
+    if (!values_follow_leaf) {
+      children.push_back(_file_manager.insert_value(value, keys[i]));
+      continue;
+    }
+
+    children.push_back(value_position);
+    value_position += value.size();
+  }
+
+  BPNodeHeader header{};
+  header.node_id = leaf_id;
+  header.is_leaf = true;
+  header.parent_id = _parent_id(0, leaf_index);
+  header.next_leaf = is_last_leaf ? InvalidNodeID : _file_manager.page_aligned(value_position);
+  header.previous_leaf = _previous_leaf;
+  header.num_keys = static_cast<uint16_t>(keys.size());
+
+  const auto min_key = keys.front();
+  _file_manager.write_node(BPNode{header, std::move(keys), std::move(children)});
+
+  auto expected_position = leaf_id + _file_manager.page_size();
+  for (auto i = 0u; i < values.size() && values_follow_leaf; ++i) {
+    const auto position = _file_manager.insert_value(values[i]);
+    Assert(position == expected_position, "Bulk load values are not stored next to their leaf.");
+    expected_position += values[i].size();
+  }
+
+  _previous_leaf = leaf_id;
+  if (_level_sizes.size() > 1) _add_child(1, leaf_id, min_key);
+}
+
+void BulkLoader::_add_child(const uint32_t level, const NodeID child_id, const FileKey min_key) {
+  auto& internal_level = _internal_levels[level];
+
+  // The smallest key of each child except the first one separates it from its left neighbour
+  if (internal_level.children.empty()) {
+    internal_level.min_key = min_key;
+  } else {
+    internal_level.keys.push_back(min_key);
+  }
+  internal_level.children.push_back(child_id);
+
+  const auto node_index = internal_level.current_node;
+  const auto num_children = num_items_of_node(node_index, _level_sizes[level - 1], _level_sizes[level]);
+  if (internal_level.children.size() < num_children) return;
+
+  BPNodeHeader header{};
+  header.node_id = internal_level.node_ids[node_index];
+  header.is_leaf = false;
+  header.parent_id = _parent_id(level, node_index);
+  header.next_leaf = InvalidNodeID;
+  header.previous_leaf = InvalidNodeID;
+  header.num_keys = static_cast<uint16_t>(internal_level.keys.size());
+
+  _file_manager.write_node(BPNode{header, std::move(internal_level.keys), std::move(internal_level.children)});
+  internal_level.keys = {};
+  internal_level.children = {};
+  internal_level.current_node++;
+
+  if (level + 1u < _level_sizes.size()) _add_child(level + 1, header.node_id, internal_level.min_key);
+}
+
+NodeID BulkLoader::_parent_id(const uint32_t child_level, const uint64_t child_index) const {
+  if (child_level + 1u >= _level_sizes.size()) return InvalidNodeID;
+
+  // Inverse of first_item_of_node: the last parent whose first child is not after child_index
+  const auto num_children = _level_sizes[child_level];
+  const auto num_parents = _level_sizes[child_level + 1];
+  const auto parent_index = ((child_index + 1) * num_parents + num_children - 1) / num_children - 1;
+  return _internal_levels[child_level + 1].node_ids[parent_index];
+}
+
+}  // namespace keva
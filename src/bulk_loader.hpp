@@ -0,0 +1,48 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "file_manager.hpp"
+#include "types.hpp"
+
+namespace keva {
+
+using BulkLoadEntry = std::pair<FileKey, FileValue>;
+using BulkLoadEntryGenerator = std::function<BulkLoadEntry()>;
+
+// Builds a B+-tree bottom-up from sorted entries. All internal nodes are reserved in front of the leaves and each leaf
+// is directly followed by its values (unless they are stored inline or in a value log), so the file is written
+// sequentially and values are stored next to their leaf. The next leaf starts at the following page boundary.
+class BulkLoader : public Noncopyable {
+ public:
+  BulkLoader(FileManager& file_manager, uint16_t max_keys_per_node, double fill_factor);
+
+  // Pulls num_entries entries with strictly increasing keys from next_entry and returns the root of the new tree
+  NodeID load(uint64_t num_entries, const BulkLoadEntryGenerator& next_entry);
+
+ protected:
+  struct InternalLevel {
+    std::vector<NodeID> node_ids;
+    uint64_t current_node = 0;
+    FileKey min_key = 0;
+    std::vector<FileKey> keys;
+    std::vector<NodeID> children;
+  };
+
+  void _write_leaf(uint64_t leaf_index, std::vector<FileKey> keys, const std::vector<FileValue>& values);
+  void _add_child(uint32_t level, NodeID child_id, FileKey min_key);
+  NodeID _parent_id(uint32_t child_level, uint64_t child_index) const;
+
+  FileManager& _file_manager;
+  const uint16_t _max_keys_per_node;
+  const double _fill_factor;
+
+  // Index 0 is the leaf level
+  std::vector<uint64_t> _level_sizes;
+  std::vector<InternalLevel> _internal_levels;
+  NodeID _previous_leaf = InvalidNodeID;
+};
+
+}  // namespace keva
@@ -0,0 +1,184 @@
+#include "cursor.hpp"
+
+#include <algorithm>
+
+#include "db_manager.hpp"
+
+namespace keva {
+
+Cursor::Cursor(const DBManager& db_manager, const uint32_t value_batch_size, const FileKey upper_bound,
+               std::shared_ptr<const ReaderPin> pin)
+    : _db_manager(db_manager),
+      _file_manager(db_manager.get_file_manager()),
+      _value_batch_size(value_batch_size),
+      _upper_bound(upper_bound),
+      _pin(pin ? std::move(pin) : db_manager.pin_root()) {
+  Assert(value_batch_size > 0, "Cursor must read at least one value at a time.");
+}
+
+bool Cursor::seek(const FileKey key) {
+  _descend(key);
+  _position = _leaf.find_value_insert_position(key);
+  return _settle_forward();
+}
+
+bool Cursor::seek_to_first() {
+  _descend(0);
+  _position = 0;
+  return _settle_forward();
+}
+
+bool Cursor::seek_to_last() {
+  // Start behind the last entry of the leaf that would contain the upper bound and move back from there
+  _descend(_upper_bound);
+  _position = _leaf.header().num_keys;
+  return _settle_backward();
+}
+
+bool Cursor::next() {
+  DebugAssert(_is_valid, "Cannot move invalid cursor");
+  ++_position;
+  return _settle_forward();
+}
+
+bool Cursor::prev() {
+  DebugAssert(_is_valid, "Cannot move invalid cursor");
+  return _settle_backward();
+}
+
+bool Cursor::is_valid() const { return _is_valid; }
+
+FileKey Cursor::key() const {
+  DebugAssert(_is_valid, "Cannot read key of invalid cursor");
+  return _leaf.keys()[_position];
+}
+
+const FileValue& Cursor::value() {
+  DebugAssert(_is_valid, "Cannot read value of invalid cursor");
+
+  const auto batch_end = _batch_begin + _batch_values.size();
+  if (_position < _batch_begin || _position >= batch_end) _load_value_batch(_position >= batch_end);
+  return _batch_values[_position - _batch_begin];
+}
+
+void Cursor::_descend(const FileKey key) {
+  // The cached root of a copy-on-write tree belongs to the writer, the pinned root is read from the file
+  NodeID node_id;
+  if (_pin) {
+    node_id = _pin->root_id();
+    _lower_fence.reset();
+    _upper_fence.reset();
+  } else {
+    const auto& root = _db_manager.get_root();
+    if (root.header().is_leaf) {
+      _load_leaf(root.header().node_id);
+      return;
+    }
+    node_id = root.find_child(key);
+  }
+
+  // Only the leaf is copied, the internal nodes are searched in place. Separators further down bound the leaf tighter.
+  NodePage page_buffer;
+  while (true) {
+    const auto node = _file_manager.view_node(node_id, page_buffer);
+    if (node.is_leaf()) break;
+
+    const auto child_position = node.find_child_insert_position(key);
+    if (child_position > 0) _lower_fence = node.keys()[child_position - 1];
+    if (child_position < node.num_keys()) _upper_fence = node.keys()[child_position];
+    node_id = node.children()[child_position];
+  }
+
+  _load_leaf(node_id);
+}
+
+void Cursor::_load_leaf(const NodeID leaf_id) {
+  _leaf = _file_manager.load_node(leaf_id);
+  _batch_begin = 0;
+  _batch_values.clear();
+}
+
+bool Cursor::_settle_forward() {
+  while (_position >= _leaf.header().num_keys) {
+    if (!_load_next_leaf()) {
+      _is_valid = false;
+      return false;
+    }
+    _position = 0;
+  }
+
+  _is_valid = _leaf.keys()[_position] <= _upper_bound;
+  return _is_valid;
+}
+
+bool Cursor::_settle_backward() {
+  // Entries above the upper bound are skipped, which can only happen when coming from seek_to_last
+  do {
+    while (_position == 0) {
+      if (!_load_previous_leaf()) {
+        _is_valid = false;
+        return false;
+      }
+      _position = _leaf.header().num_keys;
+    }
+
+    --_position;
+  } while (_leaf.keys()[_position] > _upper_bound);
+
+  _is_valid = true;
+  return true;
+}
+
+bool Cursor::_load_next_leaf() {
+  // The next leaf of a copy-on-write tree starts at the upper fence
+  if (_pin) {
+    if (!_upper_fence) return false;
+    _descend(*_upper_fence);
+    return true;
+  }
+
+  const auto next_leaf = _leaf.header().next_leaf;
+  if (next_leaf == InvalidNodeID) return false;
+  _load_leaf(next_leaf);
+  return true;
+}
+
+bool Cursor::_load_previous_leaf() {
+  // The previous leaf of a copy-on-write tree ends right before the lower fence. There are no keys below 0.
+  if (_pin) {
+    if (!_lower_fence || *_lower_fence == 0) return false;
+    _descend(*_lower_fence - 1);
+    return true;
+  }
+
+  const auto previous_leaf = _leaf.header().previous_leaf;
+  if (previous_leaf == InvalidNodeID) return false;
+  _load_leaf(previous_leaf);
+  return true;
+}
+
+void Cursor::_load_value_batch(const bool forward) {
+  const auto num_keys = _leaf.header().num_keys;
+  const auto& keys = _leaf.keys();
+
+  uint32_t batch_begin;
+  uint32_t batch_end;
+  if (forward) {
+    batch_begin = _position;
+    batch_end = std::min<uint32_t>(_position + _value_batch_size, num_keys);
+
+    // Do not read values that are out of bounds
+    batch_end = static_cast<uint32_t>(std::upper_bound(keys.begin() + batch_begin, keys.begin() + batch_end,
+                                                       _upper_bound) - keys.begin());
+  } else {
+    batch_end = _position + 1;
+    batch_begin = batch_end > _value_batch_size ? batch_end - _value_batch_size : 0;
+  }
+
+  const auto& children = _leaf.children();
+  const std::vector<FileOffset> value_positions(children.begin() + batch_begin, children.begin() + batch_end);
+  _batch_values = _file_manager.get_values(value_positions);
+  _batch_begin = batch_begin;
+}
+
+}  // namespace keva
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "bp_node.hpp"
+#include "reader_table.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+class DBManager;
+class FileManager;
+
+using ScanCallback = std::function<void(FileKey, const FileValue&)>;
+
+// Iterates over the entries of a tree in key order by walking the leaf chain. The tree is only descended on seek.
+// Values are read lazily in batches of neighbouring entries of the current leaf. A cursor is invalidated by any write
+// to the database, except on a copy-on-write tree (see DBOptions::copy_on_write). There it reads the tree of its pin,
+// whose leaves are not chained, so it descends again to find the next or previous leaf.
+class Cursor : public Noncopyable {
+ public:
+  // Keys greater than upper_bound are treated as if they did not exist, so no values are read ahead past them. On a
+  // copy-on-write tree, the cursor reads the tree below pin, or pins the current tree if pin is nullptr.
+  explicit Cursor(const DBManager& db_manager, uint32_t value_batch_size = DEFAULT_SCAN_BATCH_SIZE,
+                  FileKey upper_bound = std::numeric_limits<FileKey>::max(),
+                  std::shared_ptr<const ReaderPin> pin = nullptr);
+
+  // Positions the cursor at the first entry with a key >= key
+  bool seek(FileKey key);
+  bool seek_to_first();
+  bool seek_to_last();
+
+  // Move to the next or previous entry. Once the cursor is moved out of the tree, it is invalid until the next seek.
+  bool next();
+  bool prev();
+
+  bool is_valid() const;
+
+  // Only callable on a valid cursor
+  FileKey key() const;
+  const FileValue& value();
+
+ protected:
+  // Descends to the leaf that may contain key
+  void _descend(FileKey key);
+  void _load_leaf(NodeID leaf_id);
+
+  // Return false at the end of the tree
+  bool _load_next_leaf();
+  bool _load_previous_leaf();
+
+  // Skip over (possibly empty) leaves until the position is valid or the chain ends
+  bool _settle_forward();
+  bool _settle_backward();
+
+  void _load_value_batch(bool forward);
+
+  const DBManager& _db_manager;
+  const FileManager& _file_manager;
+  const uint32_t _value_batch_size;
+  const FileKey _upper_bound;
+
+  // Root of a copy-on-write tree that the cursor reads, shared with the snapshot it came from. The separators around
+  // the path to the current leaf bound its keys, the neighbouring leaves are found by descending to them.
+  std::shared_ptr<const ReaderPin> _pin;
+  std::optional<FileKey> _lower_fence;
+  std::optional<FileKey> _upper_fence;
+
+  BPNode _leaf{{}, {}, {}};
+  bool _is_valid = false;
+  uint32_t _position = 0;
+
+  // Values of the entries [_batch_begin, _batch_begin + _batch_values.size()) of the current leaf
+  uint32_t _batch_begin = 0;
+  std::vector<FileValue> _batch_values;
+};
+
+}  // namespace keva
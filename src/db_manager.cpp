@@ -1,41 +1,342 @@
 #include "db_manager.hpp"
 
+#include <algorithm>
 #include <memory>
+#include <numeric>
+#include <thread>
 
 namespace keva {
 
 DBManager::DBManager(uint16_t value_size, uint16_t max_keys_per_node)
-    : _file_manager(value_size, max_keys_per_node), _max_keys_per_node(max_keys_per_node), _value_size(value_size) {
+    : DBManager(value_size, NodeLayout{max_keys_per_node}) {}
+
+DBManager::DBManager(uint16_t value_size, NodeLayout node_layout)
+    : _file_manager(value_size, node_layout),
+      _max_keys_per_node(node_layout.max_keys_per_node),
+      _value_size(value_size),
+      _options() {
   _root = std::make_unique<BPNode>(_init_root());
+  _root_id = _root->header().node_id;
+  _file_manager.commit();
 }
 
-DBManager::DBManager(std::string db_file_name, uint16_t value_size, uint16_t max_keys_per_node)
-    : _file_manager(std::move(db_file_name), value_size, max_keys_per_node),
-      _max_keys_per_node(max_keys_per_node),
-      _value_size(value_size) {
+DBManager::DBManager(std::string db_file_name, uint16_t value_size, NodeLayout node_layout, DBOptions options)
+    : _file_manager(std::move(db_file_name), value_size, node_layout, options),
+      _max_keys_per_node(node_layout.max_keys_per_node),
+      _value_size(value_size),
+      _options(options) {
+  Assert(_options.merge_min_fill > 0 && _options.merge_min_fill <= 0.5, "Merge min fill must be in (0, 0.5].");
+  if (_options.concurrent) {
+    Assert(_options.storage_mode == StorageMode::Stream && !_options.enable_wal && _options.buffer_pool_size == 0 &&
+               !_options.enable_value_log,
+           "Concurrent trees require StorageMode::Stream without write-ahead log, buffer pool and value log.");
+    _node_latches = std::make_unique<NodeLatches>();
+  }
+  if (_options.copy_on_write) {
+    Assert(_options.storage_mode == StorageMode::Stream && !_options.enable_wal && _options.buffer_pool_size == 0 &&
+               !_options.enable_value_log && !_options.concurrent,
+           "Copy-on-write trees require StorageMode::Stream without write-ahead log, buffer pool, value log and "
+           "concurrent writers.");
+  }
+
   _root = std::make_unique<BPNode>(_init_root());
+  _root_id = _root->header().node_id;
+  if (_options.copy_on_write) {
+    _reader_table = std::make_unique<ReaderTable>(_root->header().node_id, _options.max_readers);
+  }
+  _file_manager.commit();
+}
+
+DBManager::~DBManager() {
+  // No reader outlives the tree, so all replaced space is free once it is closed
+  if (!_reader_table) return;
+  for (const auto& retired_space : _retired_space) {
+    for (const auto node_id : retired_space.node_ids) _file_manager.free_node(node_id);
+    for (const auto value_pos : retired_space.value_positions) _file_manager.free_value(value_pos);
+  }
+  _file_manager.commit();
 }
 
 FileValue DBManager::get(FileKey key) const {
-  auto* node = _root.get();
-  BPNode child{{}, {}, {}};
+  if (_node_latches) return _get_concurrent(key);
+  if (!_reader_table) return _get(key, InvalidNodeID);
+
+  const auto pin = _reader_table->pin();
+  return _get(key, pin.root_id());
+}
+
+FileValue DBManager::_get(const FileKey key, const NodeID root_id) const {
+  // Inline values may have a null slot, so the key itself has to be checked
+  const auto get_leaf_value = [&](const auto& leaf) {
+    const auto entry_position = leaf.find_value_insert_position(key);
+    if (entry_position == leaf.keys().size() || leaf.keys()[entry_position] != key) return FileValue();
+    return _file_manager.get_value(leaf.children()[entry_position]);
+  };
 
-  // Iterate through children until leaf is found
+  // Copy-on-write trees are read from the pinned root on, as the cached root belongs to the writer. Their pages are
+  // always read into the buffer, so the view shows whichever node was read last.
+  if (root_id != InvalidNodeID) {
+    NodePage page_buffer;
+    const BPNodeView node{_file_manager.view_page(root_id, page_buffer), _file_manager.node_layout()};
+    while (!node.is_leaf()) _file_manager.view_page(node.find_child(key), page_buffer);
+    return get_leaf_value(node);
+  }
+
+  if (_root->header().is_leaf) return get_leaf_value(*_root);
+
+  // Descend over views of the pages, so no node is copied to the heap. Only the ID of the next child is kept from each
+  // view, as the page buffer is reused for the next level.
+  NodePage page_buffer;
+  auto node_id = _root->find_child(key);
   while (true) {
-    if (node->header().is_leaf) {
-      const auto value_pos = node->find_value(key);
-      return _file_manager.get_value(value_pos);
-    } else {
-      const auto child_pos = node->find_child(key);
-      child = _file_manager.load_node(child_pos);
-      node = &child;
+    const auto node = _file_manager.view_node(node_id, page_buffer);
+    if (node.is_leaf()) return get_leaf_value(node);
+    node_id = node.find_child(key);
+  }
+}
+
+std::vector<FileValue> DBManager::multi_get(const std::vector<FileKey>& keys) const {
+  // The batched descent reads whole levels without latches, concurrent trees look up one key after another
+  if (_node_latches) {
+    std::vector<FileValue> values;
+    values.reserve(keys.size());
+    for (const auto key : keys) values.push_back(_get_concurrent(key));
+    return values;
+  }
+
+  if (!_reader_table) return _multi_get(keys, InvalidNodeID);
+
+  // The pin keeps the values of a copy-on-write tree in place until they are read
+  const auto pin = _reader_table->pin();
+  return _multi_get(keys, pin.root_id());
+}
+
+std::vector<FileValue> DBManager::_multi_get(const std::vector<FileKey>& keys, const NodeID root_id) const {
+  const auto value_positions = _find_value_positions(keys, root_id);
+
+  std::vector<uint32_t> found_keys;
+  std::vector<FileOffset> found_positions;
+  for (auto i = 0u; i < keys.size(); ++i) {
+    if (!value_positions[i]) continue;
+    found_keys.push_back(i);
+    found_positions.push_back(*value_positions[i]);
+  }
+
+  _file_manager.prefetch_values(found_positions);
+  auto found_values = _file_manager.get_values(found_positions);
+  std::vector<FileValue> values(keys.size());
+  for (auto i = 0u; i < found_keys.size(); ++i) values[found_keys[i]] = std::move(found_values[i]);
+  return values;
+}
+
+std::vector<std::optional<FileOffset>> DBManager::_find_value_positions(const std::vector<FileKey>& keys,
+                                                                       const NodeID root_id) const {
+  if (keys.empty()) return {};
+
+  // Sorting the keys makes all keys that go to the same subtree neighbours
+  std::vector<uint32_t> key_order(keys.size());
+  std::iota(key_order.begin(), key_order.end(), 0);
+  std::sort(key_order.begin(), key_order.end(), [&](const uint32_t lhs, const uint32_t rhs) { return keys[lhs] < keys[rhs]; });
+
+  // Keys in key_order[begin, end) are looked up in node_id
+  struct NodeLookup {
+    NodeID node_id;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  std::vector<std::optional<FileOffset>> value_positions(keys.size());
+  std::vector<NodeLookup> level;
+  std::vector<NodeLookup> next_level;
+
+  // Splits the keys of a lookup among the children of an internal node
+  const auto add_child_lookups = [&](const auto& node, const NodeLookup& lookup) {
+    auto child_begin = lookup.begin;
+    auto child_position = node.find_child_insert_position(keys[key_order[child_begin]]);
+    for (auto i = lookup.begin + 1; i < lookup.end; ++i) {
+      const auto position = node.find_child_insert_position(keys[key_order[i]]);
+      if (position == child_position) continue;
+
+      next_level.push_back({node.children()[child_position], child_begin, i});
+      child_begin = i;
+      child_position = position;
+    }
+    next_level.push_back({node.children()[child_position], child_begin, lookup.end});
+  };
+
+  const auto find_values = [&](const auto& leaf, const NodeLookup& lookup) {
+    for (auto i = lookup.begin; i < lookup.end; ++i) {
+      const auto key = keys[key_order[i]];
+      const auto entry_position = leaf.find_value_insert_position(key);
+      if (entry_position < leaf.keys().size() && leaf.keys()[entry_position] == key) {
+        value_positions[key_order[i]] = leaf.children()[entry_position];
+      }
+    }
+  };
+
+  // A pinned root is read like the nodes of the other levels, the cached root is searched in memory
+  const auto num_keys = static_cast<uint32_t>(keys.size());
+  if (root_id != InvalidNodeID) {
+    next_level.push_back({root_id, 0, num_keys});
+  } else if (_root->header().is_leaf) {
+    find_values(*_root, {_root->header().node_id, 0, num_keys});
+  } else {
+    add_child_lookups(*_root, {_root->header().node_id, 0, num_keys});
+  }
+
+  // All nodes of a level are read together, so the device can work on the reads in parallel
+  std::vector<char> level_pages;
+  std::vector<FileOffset> node_ids;
+  while (!next_level.empty()) {
+    std::swap(level, next_level);
+    next_level.clear();
+
+    node_ids.clear();
+    for (const auto& lookup : level) node_ids.push_back(lookup.node_id);
+    const auto nodes = _file_manager.view_nodes(node_ids, level_pages);
+
+    for (auto i = size_t{0}; i < level.size(); ++i) {
+      if (nodes[i].is_leaf()) {
+        find_values(nodes[i], level[i]);
+      } else {
+        add_child_lookups(nodes[i], level[i]);
+      }
     }
   }
+
+  return value_positions;
+}
+
+void DBManager::scan(const FileKey lower, const FileKey upper, const ScanCallback& callback,
+                     const uint32_t value_batch_size) const {
+  if (lower > upper) return;
+
+  // The upper bound keeps the cursor from reading values past the end of the range
+  auto range_cursor = cursor(value_batch_size, upper);
+  for (auto is_valid = range_cursor.seek(lower); is_valid; is_valid = range_cursor.next()) {
+    callback(range_cursor.key(), range_cursor.value());
+  }
+}
+
+Cursor DBManager::cursor(const uint32_t value_batch_size, const FileKey upper_bound) const {
+  return Cursor{*this, value_batch_size, upper_bound};
 }
 
 void DBManager::put(const FileKey key, const FileValue& value) {
+  if (_node_latches) {
+    _check_key_size(key);
+    if (_write_concurrent(key, &value, KeyWrite::Put)) {
+      throw std::runtime_error("Key '" + std::to_string(key) + "' already exists.");
+    }
+    return;
+  }
+
+  if (_reader_table) {
+    _check_key_size(key);
+    std::lock_guard<std::mutex> lock(_writer_mutex);
+    if (_write_copy_on_write(key, &value, KeyWrite::Put)) {
+      throw std::runtime_error("Key '" + std::to_string(key) + "' already exists.");
+    }
+    _commit_copy_on_write();
+    return;
+  }
+
+  _put(key, value);
+  _collect_value_log_garbage_if_due();
+  _file_manager.commit();
+}
+
+void DBManager::update(const FileKey key, const FileValue& value) {
+  if (_node_latches) {
+    if (!_write_concurrent(key, &value, KeyWrite::Update)) {
+      throw std::runtime_error("Key '" + std::to_string(key) + "' does not exist.");
+    }
+    return;
+  }
+
+  if (_reader_table) {
+    std::lock_guard<std::mutex> lock(_writer_mutex);
+    if (!_write_copy_on_write(key, &value, KeyWrite::Update)) {
+      throw std::runtime_error("Key '" + std::to_string(key) + "' does not exist.");
+    }
+    _commit_copy_on_write();
+    return;
+  }
+
+  if (!_update(key, value)) throw std::runtime_error("Key '" + std::to_string(key) + "' does not exist.");
+  _collect_value_log_garbage_if_due();
+  _file_manager.commit();
+}
+
+void DBManager::upsert(const FileKey key, const FileValue& value) {
+  if (_node_latches) {
+    _check_key_size(key);
+    _write_concurrent(key, &value, KeyWrite::Upsert);
+    return;
+  }
+
+  if (_reader_table) {
+    _check_key_size(key);
+    std::lock_guard<std::mutex> lock(_writer_mutex);
+    _write_copy_on_write(key, &value, KeyWrite::Upsert);
+    _commit_copy_on_write();
+    return;
+  }
+
+  if (!_update(key, value)) _put(key, value);
+  _collect_value_log_garbage_if_due();
+  _file_manager.commit();
+}
+
+bool DBManager::_update(const FileKey key, const FileValue& value) {
   DebugAssert(value.size() == _value_size || _value_size == 0,
               "Cannot insert value with different size than specified!");
+
+  auto leaf_id = _root->header().node_id;
+  uint16_t entry_position;
+  FileOffset value_pos;
+
+  if (_root->header().is_leaf) {
+    entry_position = _root->find_value_insert_position(key);
+    if (entry_position == _root->keys().size() || _root->keys()[entry_position] != key) return false;
+    value_pos = _root->children()[entry_position];
+  } else {
+    NodePage page_buffer;
+    leaf_id = _root->find_child(key);
+    while (true) {
+      const auto node = _file_manager.view_node(leaf_id, page_buffer);
+      if (!node.is_leaf()) {
+        leaf_id = node.find_child(key);
+        continue;
+      }
+
+      entry_position = node.find_value_insert_position(key);
+      if (entry_position == node.num_keys() || node.keys()[entry_position] != key) return false;
+      value_pos = node.children()[entry_position];
+      break;
+    }
+  }
+
+  const auto new_value_pos = _file_manager.update_value(value_pos, value, key);
+  if (new_value_pos == value_pos) return true;
+
+  // The value did not fit into its old space and was moved
+  if (leaf_id == _root->header().node_id) {
+    _root->set_child(entry_position, new_value_pos);
+    _file_manager.write_node(*_root);
+  } else {
+    auto leaf = _file_manager.load_node(leaf_id);
+    leaf.set_child(entry_position, new_value_pos);
+    _file_manager.write_node(leaf);
+  }
+
+  return true;
+}
+
+void DBManager::_put(const FileKey key, const FileValue& value) {
+  DebugAssert(value.size() == _value_size || _value_size == 0,
+              "Cannot insert value with different size than specified!");
+  _check_key_size(key);
   std::vector<BPNode> children;
   children.reserve(10);
 
@@ -69,8 +370,9 @@ void DBManager::put(const FileKey key, const FileValue& value) {
           _file_manager.write_node_header(next_leaf_header);
         }
 
-        // Key belongs in new new node
-        if (key >= node->keys().back()) {
+        // split_leaf leaves the room for the key in the smaller half, so both halves end up equally full. Comparing the
+        // key with the last key of the old node would put keys that belong before the split point into the new node.
+        if (node->keys().size() >= new_node->keys().size()) {
           _file_manager.write_node(*node);  // Update old node now, we don't need it any more
           node = new_node.get();
         }
@@ -79,7 +381,7 @@ void DBManager::put(const FileKey key, const FileValue& value) {
         _file_manager.write_node(*new_node);
       }
 
-      const auto value_pos = _file_manager.insert_value(value);
+      const auto value_pos = _file_manager.insert_value(value, key);
       node->insert(key, value_pos);
 
       // Write the node that we didn't write earlier
@@ -101,21 +403,14 @@ void DBManager::put(const FileKey key, const FileValue& value) {
     children.pop_back();
   }
 
-  auto parent_it = children.rbegin();
+  // The parents are taken from the descent path, as parent IDs of nodes are not updated when their parent is split or
+  // merged. -1 is the root that was not in the children list.
+  auto parent_index = static_cast<int64_t>(children.size()) - 1;
   auto split_key = new_node->keys().front();
 
   // New nodes through splitting need to be added to parents
-  while (new_node && split_leaf) {
-    BPNode* parent;
-    if (new_node->header().parent_id == _root->header().node_id) {
-      // Update root node that was not in children list
-      parent = _root.get();
-    } else if (parent_it < children.rend()) {
-      parent = &(*parent_it);
-    } else {
-      // Need to create new root
-      break;
-    }
+  while (new_node && split_leaf && parent_index >= -1) {
+    auto* parent = parent_index >= 0 ? &children[parent_index] : _root.get();
 
     // Parent is full and needs to be split
     if (parent->header().num_keys == _max_keys_per_node) {
@@ -134,7 +429,7 @@ void DBManager::put(const FileKey key, const FileValue& value) {
       return;
     }
 
-    ++parent_it;
+    --parent_index;
   }
 
   // The old root had to be split, so we need a new root
@@ -158,16 +453,687 @@ void DBManager::put(const FileKey key, const FileValue& value) {
     std::vector<NodeID> new_root_children = {_root->header().node_id, new_node->header().node_id};
     _root = std::make_unique<BPNode>(node_header, std::move(new_root_keys), std::move(new_root_children));
 
-    _file_manager.update_root_offset(node_header.node_id);
+    _update_root_offset(node_header.node_id);
+    _file_manager.write_node(*_root);
+  }
+}
+
+void DBManager::remove(const FileKey key) {
+  if (_node_latches) {
+    _write_concurrent(key, nullptr, KeyWrite::Remove);
+    return;
+  }
+
+  if (_reader_table) {
+    std::lock_guard<std::mutex> lock(_writer_mutex);
+    if (_write_copy_on_write(key, nullptr, KeyWrite::Remove)) _commit_copy_on_write();
+    return;
+  }
+
+  if (!_remove(key)) return;
+  _merge_pending_nodes_if_due();
+  _collect_value_log_garbage_if_due();
+  _file_manager.commit();
+}
+
+bool DBManager::_remove(const FileKey key) {
+  if (_root->header().is_leaf) {
+    const auto entry_position = _root->find_value_insert_position(key);
+    if (entry_position == _root->keys().size() || _root->keys()[entry_position] != key) return false;
+
+    // The root may be underfull
+    _file_manager.free_value(_root->children()[entry_position]);
+    _root->erase(entry_position);
     _file_manager.write_node(*_root);
+    return true;
+  }
+
+  // The leaf is only loaded if the key exists
+  NodePage page_buffer;
+  auto leaf_id = _root->find_child(key);
+  uint16_t entry_position;
+  while (true) {
+    const auto node = _file_manager.view_node(leaf_id, page_buffer);
+    if (!node.is_leaf()) {
+      leaf_id = node.find_child(key);
+      continue;
+    }
+
+    entry_position = node.find_value_insert_position(key);
+    if (entry_position == node.num_keys() || node.keys()[entry_position] != key) return false;
+    break;
+  }
+
+  // The leaf is not rebalanced now, as the next puts might fill it again anyway
+  auto leaf = _file_manager.load_node(leaf_id);
+  _file_manager.free_value(leaf.children()[entry_position]);
+  leaf.erase(entry_position);
+  _file_manager.write_node(leaf);
+
+  if (leaf.header().num_keys < _min_num_children(true)) _pending_merge_keys.push_back(key);
+  return true;
+}
+
+void DBManager::merge_underfull_nodes() {
+  _merge_pending_nodes();
+  _file_manager.commit();
+}
+
+uint64_t DBManager::num_pending_merges() const { return _pending_merge_keys.size(); }
+
+uint16_t DBManager::_min_num_children(const bool is_leaf) const {
+  const auto min_num_children = static_cast<uint16_t>(_options.merge_min_fill * (_max_keys_per_node + 1));
+  return std::max<uint16_t>(min_num_children, is_leaf ? 1 : 2);
+}
+
+void DBManager::_merge_pending_nodes_if_due() {
+  if (_options.merge_batch_size > 0 && _pending_merge_keys.size() >= _options.merge_batch_size) {
+    _merge_pending_nodes();
+  }
+}
+
+void DBManager::_merge_pending_nodes() {
+  if (_pending_merge_keys.empty()) return;
+
+  std::sort(_pending_merge_keys.begin(), _pending_merge_keys.end());
+  _pending_merge_keys.erase(std::unique(_pending_merge_keys.begin(), _pending_merge_keys.end()),
+                            _pending_merge_keys.end());
+
+  // Merging internal nodes gives underfull nodes below them new neighbours, so the pass is repeated until only leaves
+  // were merged. Merges can leave the root with a single child, which then becomes the new root.
+  const auto old_root_id = _root->header().node_id;
+  auto merged_internal_nodes = true;
+  while (merged_internal_nodes && !_root->header().is_leaf) {
+    merged_internal_nodes = _merge_underfull_children(*_root, _pending_merge_keys.data(),
+                                                      _pending_merge_keys.data() + _pending_merge_keys.size());
+    while (!_root->header().is_leaf && _root->children().size() == 1) {
+      _file_manager.free_node(_root->header().node_id);
+      _root = std::make_unique<BPNode>(_file_manager.load_node(_root->children().front()));
+    }
   }
+  _pending_merge_keys.clear();
+
+  if (_root->header().node_id == old_root_id) return;
+
+  _root->mutable_header().parent_id = InvalidNodeID;
+  _file_manager.write_node_header(_root->header());
+  _update_root_offset(_root->header().node_id);
+}
+
+bool DBManager::_merge_underfull_children(BPNode& node, const FileKey* begin, const FileKey* end) {
+  // Fix the subtrees first, so that merges further up see the final number of children
+  auto merged_internal_nodes = false;
+  std::vector<uint16_t> child_positions;
+  auto group_begin = begin;
+  while (group_begin != end) {
+    const auto child_position = node.find_child_insert_position(*group_begin);
+    auto group_end = group_begin + 1;
+    if (child_position < node.keys().size()) {
+      while (group_end != end && *group_end < node.keys()[child_position]) ++group_end;
+    } else {
+      group_end = end;
+    }
+
+    child_positions.push_back(child_position);
+    auto child = _file_manager.load_node(node.children()[child_position]);
+    if (!child.header().is_leaf) merged_internal_nodes |= _merge_underfull_children(child, group_begin, group_end);
+    group_begin = group_end;
+  }
+
+  // Going from right to left, a merge does not move the children that are checked next
+  auto is_modified = false;
+  for (auto position_it = child_positions.rbegin(); position_it != child_positions.rend(); ++position_it) {
+    auto position = *position_it;
+    while (node.children().size() > 1 && position < node.children().size()) {
+      const auto child_header = _file_manager.load_node_header(node.children()[position]);
+      const auto num_children = child_header.num_keys + (child_header.is_leaf ? 0u : 1u);
+      if (num_children >= _min_num_children(child_header.is_leaf)) break;
+
+      // The merged node is checked again, a refilled one is at least half full
+      position = position == 0 ? 0 : position - 1;
+      _merge_siblings(node, position);
+      is_modified = true;
+      merged_internal_nodes |= !child_header.is_leaf;
+    }
+  }
+
+  if (is_modified) _file_manager.write_node(node);
+  return merged_internal_nodes;
+}
+
+void DBManager::_merge_siblings(BPNode& parent, const uint16_t left_position) {
+  const auto left = _file_manager.load_node(parent.children()[left_position]);
+  const auto right = _file_manager.load_node(parent.children()[left_position + 1]);
+  const auto is_leaf = left.header().is_leaf;
+
+  // In internal nodes, the separator from the parent moves down between the entries of both nodes
+  std::vector<FileKey> keys = left.keys();
+  std::vector<NodeID> children = left.children();
+  if (!is_leaf) keys.push_back(parent.keys()[left_position]);
+  keys.insert(keys.end(), right.keys().begin(), right.keys().end());
+  children.insert(children.end(), right.children().begin(), right.children().end());
+
+  const auto num_children = static_cast<uint32_t>(children.size());
+  const auto max_children = _max_keys_per_node + (is_leaf ? 0u : 1u);
+
+  if (num_children <= max_children) {
+    // The right node is dropped
+    auto header = left.header();
+    header.num_keys = static_cast<uint16_t>(keys.size());
+    if (is_leaf) {
+      header.next_leaf = right.header().next_leaf;
+      if (header.next_leaf != InvalidNodeID) {
+        auto next_leaf_header = _file_manager.load_node_header(header.next_leaf);
+        next_leaf_header.previous_leaf = header.node_id;
+        _file_manager.write_node_header(next_leaf_header);
+      }
+    }
+
+    _file_manager.write_node(BPNode{header, std::move(keys), std::move(children)});
+    _file_manager.free_node(right.header().node_id);
+    parent.erase(left_position);
+    return;
+  }
+
+  // Both nodes keep half of the entries. In internal nodes, the key between them moves up into the parent.
+  // For leaves, the separator is the first key of the right node.
+  const auto num_left_children = num_children / 2;
+  const auto num_left_keys = is_leaf ? num_left_children : num_left_children - 1;
+  const auto separator = keys[num_left_keys];
+
+  auto left_header = left.header();
+  left_header.num_keys = static_cast<uint16_t>(num_left_keys);
+  auto right_header = right.header();
+  right_header.num_keys = static_cast<uint16_t>(keys.size() - num_left_children);
+
+  _file_manager.write_node(BPNode{left_header,
+                                  {keys.begin(), keys.begin() + num_left_keys},
+                                  {children.begin(), children.begin() + num_left_children}});
+  _file_manager.write_node(BPNode{right_header,
+                                  {keys.begin() + num_left_children, keys.end()},
+                                  {children.begin() + num_left_children, children.end()}});
+  parent.set_key(left_position, separator);
+}
+
+bool DBManager::collect_value_log_garbage(const double min_dead_ratio) {
+  auto* value_log = _file_manager.value_log();
+  if (value_log == nullptr) return false;
+
+  const auto segment_id = value_log->find_garbage_segment(min_dead_ratio);
+  if (segment_id == 0) return false;
+
+  _collect_value_log_segment(segment_id);
+  _file_manager.commit();
+  return true;
+}
+
+void DBManager::_collect_value_log_garbage_if_due() {
+  auto* value_log = _file_manager.value_log();
+  if (value_log == nullptr || _options.value_log_gc_ratio <= 0) return;
+
+  // A large write can leave more than one segment with enough garbage
+  for (auto segment_id = value_log->find_garbage_segment(_options.value_log_gc_ratio); segment_id != 0;
+       segment_id = value_log->find_garbage_segment(_options.value_log_gc_ratio)) {
+    _collect_value_log_segment(segment_id);
+  }
+}
+
+void DBManager::_collect_value_log_segment(const uint32_t segment_id) {
+  auto& value_log = *_file_manager.value_log();
+  const auto records = value_log.read_segment(segment_id);
+
+  // A record is live if the entry of its key still points to it. Older records of the same key are dead.
+  std::vector<FileKey> keys;
+  keys.reserve(records.size());
+  for (const auto& record : records) keys.push_back(record.key);
+  const auto value_positions = _find_value_positions(keys);
+
+  std::vector<std::pair<FileKey, FileOffset>> value_slots;
+  for (auto i = 0u; i < records.size(); ++i) {
+    if (value_positions[i] != records[i].pointer) continue;
+
+    const auto& value = records[i].value;
+    value_slots.emplace_back(records[i].key,
+                             value_log.append(records[i].key, value.data(), static_cast<uint32_t>(value.size())));
+  }
+
+  std::sort(value_slots.begin(), value_slots.end());
+  _set_value_slots(value_slots);
+  value_log.drop_segment(segment_id);
+}
+
+void DBManager::_set_value_slots(const std::vector<std::pair<FileKey, FileOffset>>& value_slots) {
+  auto slot_it = value_slots.begin();
+  while (slot_it != value_slots.end()) {
+    auto leaf_id = _root->header().node_id;
+    if (!_root->header().is_leaf) {
+      NodePage page_buffer;
+      leaf_id = _root->find_child(slot_it->first);
+      while (true) {
+        const auto node = _file_manager.view_node(leaf_id, page_buffer);
+        if (node.is_leaf()) break;
+        leaf_id = node.find_child(slot_it->first);
+      }
+    }
+
+    // All following keys in the same leaf are set with a single write
+    std::optional<BPNode> loaded_leaf;
+    auto& leaf = leaf_id == _root->header().node_id ? *_root : loaded_leaf.emplace(_file_manager.load_node(leaf_id));
+    const auto leaf_begin = slot_it;
+    for (; slot_it != value_slots.end(); ++slot_it) {
+      const auto entry_position = leaf.find_value_insert_position(slot_it->first);
+      if (entry_position == leaf.keys().size() || leaf.keys()[entry_position] != slot_it->first) break;
+      leaf.set_child(entry_position, slot_it->second);
+    }
+
+    Assert(slot_it != leaf_begin, "Key '" + std::to_string(slot_it->first) + "' does not exist.");
+    _file_manager.write_node(leaf);
+  }
+}
+
+void DBManager::write(const WriteBatch& batch) {
+  std::unique_lock<std::mutex> writer_lock(_writer_mutex, std::defer_lock);
+  if (_reader_table) writer_lock.lock();
+
+  const auto& operations = batch.operations();
+
+  // Operations on the same key keep their batch order
+  std::vector<uint32_t> operation_order(operations.size());
+  std::iota(operation_order.begin(), operation_order.end(), 0);
+  std::stable_sort(operation_order.begin(), operation_order.end(), [&](const uint32_t lhs, const uint32_t rhs) {
+    return operations[lhs].key < operations[rhs].key;
+  });
+
+  std::vector<FileKey> keys;
+  for (const auto index : operation_order) {
+    if (keys.empty() || keys.back() != operations[index].key) keys.push_back(operations[index].key);
+  }
+  const auto value_positions = _find_value_positions(keys);
+
+  // Combine all operations on a key into one change. Nothing is written before the whole batch is validated.
+  std::vector<BatchChange> changes;
+  auto order_index = 0u;
+  for (auto key_index = 0u; key_index < keys.size(); ++key_index) {
+    const auto key = keys[key_index];
+    const auto existed = value_positions[key_index].has_value();
+    auto exists = existed;
+    const FileValue* value = nullptr;
+
+    for (; order_index < operation_order.size() && operations[operation_order[order_index]].key == key; ++order_index) {
+      const auto& operation = operations[operation_order[order_index]];
+      if (operation.type == WriteType::Remove) {
+        exists = false;
+        value = nullptr;
+        continue;
+      }
+
+      if (exists) throw std::runtime_error("Key '" + std::to_string(key) + "' already exists.");
+      _check_key_size(key);
+      DebugAssert(operation.value.size() == _value_size || _value_size == 0,
+                  "Cannot insert value with different size than specified!");
+      exists = true;
+      value = &operation.value;
+    }
+
+    if (exists || existed) changes.push_back({key, value});
+  }
+
+  if (changes.empty()) return;
+
+  // Each change copies the path to its leaf. Nodes that an earlier change of the batch copied are changed in place.
+  if (_reader_table) {
+    for (const auto& change : changes) {
+      _write_copy_on_write(change.key, change.value, change.value ? KeyWrite::Upsert : KeyWrite::Remove);
+    }
+    _commit_copy_on_write();
+    return;
+  }
+
+  const auto old_root_id = _root->header().node_id;
+  auto new_siblings =
+      _apply_changes(*_root, _root->header().parent_id, changes.data(), changes.data() + changes.size());
+
+  // The root was split, so the tree grows by one level. Many splits can even need more than one new level.
+  while (!new_siblings.empty()) {
+    std::vector<FileKey> root_keys;
+    std::vector<NodeID> root_children = {_root->header().node_id};
+    for (const auto& [separator, sibling_id] : new_siblings) {
+      root_keys.push_back(separator);
+      root_children.push_back(sibling_id);
+    }
+
+    BPNodeHeader root_header{};
+    root_header.node_id = _file_manager.get_next_node_position();
+    root_header.is_leaf = false;
+    root_header.parent_id = InvalidNodeID;
+    root_header.next_leaf = InvalidNodeID;
+    root_header.previous_leaf = InvalidNodeID;
+    root_header.num_keys = static_cast<uint16_t>(root_keys.size());
+
+    _root = std::make_unique<BPNode>(root_header, std::move(root_keys), std::move(root_children));
+    new_siblings = _write_split_internal_node(*_root);
+  }
+
+  if (_root->header().node_id != old_root_id) _update_root_offset(_root->header().node_id);
+
+  _merge_pending_nodes_if_due();
+  _collect_value_log_garbage_if_due();
+  _file_manager.commit();
+}
+
+DBManager::NewSiblings DBManager::_apply_changes(BPNode& node, const NodeID parent_id, const BatchChange* begin,
+                                                 const BatchChange* end) {
+  if (node.header().is_leaf) return _apply_leaf_changes(node, parent_id, begin, end);
+
+  const auto& keys = node.keys();
+  const auto& children = node.children();
+  std::vector<FileKey> new_keys;
+  std::vector<NodeID> new_children;
+
+  // Children are copied in order, each with the separator on its left
+  auto next_child = 0u;
+  const auto append_child = [&](const FileKey separator, const NodeID child_id) {
+    if (!new_children.empty()) new_keys.push_back(separator);
+    new_children.push_back(child_id);
+  };
+  const auto append_old_children = [&](const uint32_t until) {
+    for (; next_child < until; ++next_child) append_child(next_child > 0 ? keys[next_child - 1] : 0, children[next_child]);
+  };
+
+  auto is_modified = false;
+  auto group_begin = begin;
+  while (group_begin != end) {
+    // All changes below the separator right of the child go into the same child
+    const auto child_position = node.find_child_insert_position(group_begin->key);
+    auto group_end = group_begin + 1;
+    if (child_position < keys.size()) {
+      while (group_end != end && group_end->key < keys[child_position]) ++group_end;
+    } else {
+      group_end = end;
+    }
+
+    auto child = _file_manager.load_node(children[child_position]);
+    const auto child_siblings = _apply_changes(child, node.header().node_id, group_begin, group_end);
+
+    append_old_children(child_position + 1);
+    for (const auto& [separator, sibling_id] : child_siblings) append_child(separator, sibling_id);
+    is_modified |= !child_siblings.empty();
+    group_begin = group_end;
+  }
+
+  if (!is_modified) return {};
+
+  append_old_children(static_cast<uint32_t>(children.size()));
+  auto header = node.header();
+  header.num_keys = static_cast<uint16_t>(new_keys.size());
+  node = BPNode{header, std::move(new_keys), std::move(new_children)};
+  return _write_split_internal_node(node);
+}
+
+DBManager::NewSiblings DBManager::_apply_leaf_changes(BPNode& leaf, const NodeID parent_id, const BatchChange* begin,
+                                                      const BatchChange* end) {
+  const auto& keys = leaf.keys();
+  const auto& children = leaf.children();
+  std::vector<FileKey> new_keys;
+  std::vector<NodeID> new_children;
+  new_keys.reserve(keys.size() + (end - begin));
+  new_children.reserve(keys.size() + (end - begin));
+
+  // Merge the sorted changes into the sorted entries
+  auto entry = 0u;
+  for (auto change = begin; change != end; ++change) {
+    for (; entry < keys.size() && keys[entry] < change->key; ++entry) {
+      new_keys.push_back(keys[entry]);
+      new_children.push_back(children[entry]);
+    }
+
+    const auto exists = entry < keys.size() && keys[entry] == change->key;
+    if (change->value == nullptr) {
+      // Skip removed entry
+      if (exists) _file_manager.free_value(children[entry++]);
+      continue;
+    }
+
+    // Existing values are overwritten in place if possible
+    new_keys.push_back(change->key);
+    new_children.push_back(exists ? _file_manager.update_value(children[entry++], *change->value, change->key)
+                                  : _file_manager.insert_value(*change->value, change->key));
+  }
+  new_keys.insert(new_keys.end(), keys.begin() + entry, keys.end());
+  new_children.insert(new_children.end(), children.begin() + entry, children.end());
+
+  // Only values were overwritten in place
+  if (new_keys == keys && new_children == children) return {};
+
+  auto header = leaf.header();
+  header.parent_id = parent_id;
+
+  const auto num_entries = static_cast<uint32_t>(new_keys.size());
+  if (num_entries < _min_num_children(true) && header.node_id != _root->header().node_id) {
+    _pending_merge_keys.push_back(begin->key);
+  }
+
+  if (num_entries <= _max_keys_per_node) {
+    header.num_keys = static_cast<uint16_t>(num_entries);
+    leaf = BPNode{header, std::move(new_keys), std::move(new_children)};
+    _file_manager.write_node(leaf);
+    return {};
+  }
+
+  // Distribute the entries evenly, so that all leaves are at least half full
+  const auto num_leaves = (num_entries + _max_keys_per_node - 1) / _max_keys_per_node;
+  std::vector<NodeID> leaf_ids = {header.node_id};
+  for (auto i = 1u; i < num_leaves; ++i) leaf_ids.push_back(_file_manager.get_next_node_position());
+
+  if (header.next_leaf != InvalidNodeID) {
+    auto next_leaf_header = _file_manager.load_node_header(header.next_leaf);
+    next_leaf_header.previous_leaf = leaf_ids.back();
+    _file_manager.write_node_header(next_leaf_header);
+  }
+
+  NewSiblings new_siblings;
+  for (auto i = 0u; i < num_leaves; ++i) {
+    const auto entries_begin = static_cast<uint64_t>(i) * num_entries / num_leaves;
+    const auto entries_end = static_cast<uint64_t>(i + 1) * num_entries / num_leaves;
+
+    auto piece_header = header;
+    piece_header.node_id = leaf_ids[i];
+    piece_header.previous_leaf = i == 0 ? header.previous_leaf : leaf_ids[i - 1];
+    piece_header.next_leaf = i + 1 == num_leaves ? header.next_leaf : leaf_ids[i + 1];
+    piece_header.num_keys = static_cast<uint16_t>(entries_end - entries_begin);
+
+    BPNode piece{piece_header,
+                 {new_keys.begin() + entries_begin, new_keys.begin() + entries_end},
+                 {new_children.begin() + entries_begin, new_children.begin() + entries_end}};
+    _file_manager.write_node(piece);
+
+    if (i == 0) {
+      leaf = std::move(piece);
+    } else {
+      new_siblings.emplace_back(new_keys[entries_begin], piece_header.node_id);
+    }
+  }
+
+  return new_siblings;
+}
+
+DBManager::NewSiblings DBManager::_write_split_internal_node(BPNode& node) {
+  const auto max_children = _max_keys_per_node + 1u;
+  const auto num_children = static_cast<uint32_t>(node.children().size());
+  if (num_children <= max_children) {
+    _file_manager.write_node(node);
+    return {};
+  }
+
+  // Distribute the children evenly. The key between two nodes moves up into the parent.
+  const auto num_nodes = (num_children + max_children - 1) / max_children;
+  const auto keys = node.keys();
+  const auto children = node.children();
+
+  NewSiblings new_siblings;
+  for (auto i = 0u; i < num_nodes; ++i) {
+    const auto children_begin = static_cast<uint64_t>(i) * num_children / num_nodes;
+    const auto children_end = static_cast<uint64_t>(i + 1) * num_children / num_nodes;
+
+    auto header = node.header();
+    header.node_id = i == 0 ? header.node_id : _file_manager.get_next_node_position();
+    header.num_keys = static_cast<uint16_t>(children_end - children_begin - 1);
+
+    BPNode piece{header,
+                 {keys.begin() + children_begin, keys.begin() + children_end - 1},
+                 {children.begin() + children_begin, children.begin() + children_end}};
+    _file_manager.write_node(piece);
+
+    if (i == 0) {
+      node = std::move(piece);
+    } else {
+      new_siblings.emplace_back(keys[children_begin - 1], header.node_id);
+    }
+  }
+
+  return new_siblings;
+}
+
+void DBManager::bulk_load(const uint64_t num_entries, const BulkLoadEntryGenerator& next_entry,
+                          const double fill_factor) {
+  std::unique_lock<std::mutex> writer_lock(_writer_mutex, std::defer_lock);
+  if (_reader_table) writer_lock.lock();
+
+  Assert(_root->header().is_leaf && _root->header().num_keys == 0, "Can only bulk load into an empty database.");
+  if (num_entries == 0) return;
+
+  BulkLoader bulk_loader{_file_manager, _max_keys_per_node, fill_factor};
+
+  // The new tree is not reachable until the root offset is updated, so it does not need to go through the log
+  _file_manager.begin_unlogged_writes();
+  NodeID root_id;
+  try {
+    root_id = bulk_loader.load(num_entries, next_entry);
+  } catch (...) {
+    _file_manager.end_unlogged_writes();
+    throw;
+  }
+  _file_manager.end_unlogged_writes();
+
+  // The new tree was appended to the file, only the empty root is replaced
+  if (_reader_table) {
+    _retiring_space.node_ids.push_back(_root->header().node_id);
+    _root = std::make_unique<BPNode>(_file_manager.load_node(root_id));
+    _commit_copy_on_write();
+    return;
+  }
+
+  _root = std::make_unique<BPNode>(_file_manager.load_node(root_id));
+  _update_root_offset(root_id);
+  _file_manager.commit();
+}
+
+void DBManager::compact(const std::string& dest_file_name, const double fill_factor) const {
+  if (std::ifstream{dest_file_name}.good()) {
+    throw std::runtime_error("Compaction target '" + dest_file_name + "' already exists.");
+  }
+
+  // The copy needs a value log if the source has one, as it has to be opened with the same options
+  DBOptions compacted_options;
+  compacted_options.enable_value_log = _options.enable_value_log;
+  compacted_options.value_log_segment_size = _options.value_log_segment_size;
+  compacted_options.copy_on_write = _options.copy_on_write;
+  // Files of old format versions are converted to the page-aligned format
+  compacted_options.page_size = std::max(_file_manager.page_size(), MIN_PAGE_SIZE);
+
+  const auto num_source_entries = num_entries();
+  if (num_source_entries == 0) {
+    DBManager empty_db{dest_file_name, _value_size, _file_manager.node_layout(), compacted_options};
+    return;
+  }
+
+  // The new tree is written directly behind the header page. A DBManager would first write an empty root there.
+  FileManager compacted_file{dest_file_name, _value_size, _file_manager.node_layout(), compacted_options};
+  BulkLoader bulk_loader{compacted_file, _max_keys_per_node, fill_factor};
+
+  // The values of a whole leaf are read at once
+  auto source = cursor(_max_keys_per_node);
+  source.seek_to_first();
+  const auto root_id = bulk_loader.load(num_source_entries, [&]() {
+    BulkLoadEntry entry{source.key(), source.value()};
+
+    // Values are read without their size, which is stored as part of variable sized values
+    if (_value_size == 0) {
+      const auto num_bytes = static_cast<uint32_t>(entry.second.size());
+      const auto* num_bytes_raw = reinterpret_cast<const char*>(&num_bytes);
+      entry.second.insert(entry.second.begin(), num_bytes_raw, num_bytes_raw + sizeof(num_bytes));
+    }
+
+    source.next();
+    return entry;
+  });
+  compacted_file.update_root_offset(root_id);
+}
+
+uint64_t DBManager::num_entries() const {
+  // Leaves of copy-on-write trees are not chained, so the whole pinned tree is visited
+  if (_reader_table) {
+    const auto pin = _reader_table->pin();
+    NodePage page_buffer;
+    uint64_t num_entries = 0;
+    std::vector<NodeID> node_ids = {pin.root_id()};
+    while (!node_ids.empty()) {
+      const auto node = _file_manager.view_node(node_ids.back(), page_buffer);
+      node_ids.pop_back();
+      if (node.is_leaf()) {
+        num_entries += node.num_keys();
+        continue;
+      }
+      for (auto i = 0u; i < node.children().size(); ++i) node_ids.push_back(node.children()[i]);
+    }
+    return num_entries;
+  }
+
+  if (_root->header().is_leaf) return _root->header().num_keys;
+
+  NodePage page_buffer;
+  auto leaf_id = _root->children().front();
+  while (true) {
+    const auto node = _file_manager.view_node(leaf_id, page_buffer);
+    if (node.is_leaf()) break;
+    leaf_id = node.children().front();
+  }
+
+  uint64_t num_entries = 0;
+  while (leaf_id != InvalidNodeID) {
+    const auto leaf_header = _file_manager.load_node_header(leaf_id);
+    num_entries += leaf_header.num_keys;
+    leaf_id = leaf_header.next_leaf;
+  }
+  return num_entries;
 }
 
 const BPNode& DBManager::get_root() const { return *_root; }
 
 const FileManager& DBManager::get_file_manager() const { return _file_manager; }
 
+std::shared_ptr<const ReaderPin> DBManager::pin_root() const {
+  if (!_reader_table) return nullptr;
+  return std::make_shared<const ReaderPin>(_reader_table->pin());
+}
+
+Snapshot DBManager::snapshot() const {
+  Assert(_reader_table, "Snapshots require a copy-on-write tree (see DBOptions::copy_on_write).");
+  return Snapshot{*this, pin_root()};
+}
+
+void DBManager::_check_key_size(const FileKey key) const {
+  if (key > _file_manager.max_key()) {
+    throw std::runtime_error("Key '" + std::to_string(key) + "' does not fit into the key size of the database.");
+  }
+}
+
 BPNode DBManager::_init_root() {
+  // Existing database, continue with the stored tree
+  if (!_file_manager.is_new_db()) {
+    return _file_manager.load_node(_file_manager.db_header().root_offset);
+  }
+
   BPNodeHeader node_header{};
   node_header.node_id = _file_manager.get_next_node_position();
   node_header.is_leaf = true;
@@ -183,4 +1149,405 @@ BPNode DBManager::_init_root() {
   return root;
 }
 
+void DBManager::_update_root_offset(const NodeID root_id) {
+  _file_manager.update_root_offset(root_id);
+  _root_id.store(root_id, std::memory_order_release);
+}
+
+FileValue DBManager::_get_concurrent(const FileKey key) const {
+  NodePage page_buffer;
+  while (true) {
+    auto value = _try_get_concurrent(key, page_buffer);
+    if (value) return std::move(*value);
+    std::this_thread::yield();
+  }
+}
+
+std::optional<FileValue> DBManager::_try_get_concurrent(const FileKey key, NodePage& page_buffer) const {
+  // A root that was replaced after it was read only covers part of the keys
+  auto node_id = _root_id.load(std::memory_order_acquire);
+  auto version = _read_node_concurrent(node_id, page_buffer);
+  if (!version || node_id != _root_id.load(std::memory_order_acquire)) return std::nullopt;
+
+  // The view shows whichever node was read into the buffer last
+  const BPNodeView node{page_buffer.data(), _file_manager.node_layout()};
+  while (!node.is_leaf()) {
+    // Lock coupling: if the parent is unchanged after the child was read, the child still covers the key
+    const auto child_id = node.find_child(key);
+    const auto child_version = _read_node_concurrent(child_id, page_buffer);
+    if (!child_version || !(*_node_latches)[node_id].validate(*version)) return std::nullopt;
+    node_id = child_id;
+    version = child_version;
+  }
+
+  const auto entry_position = node.find_value_insert_position(key);
+  if (entry_position == node.num_keys() || node.keys()[entry_position] != key) return FileValue();
+
+  // Writers hold the latch of the leaf while they overwrite or free its values, so a value that was read while its slot
+  // changed is detected by the version. Reading a reused slot may also fail, e.g., if it starts inside another value.
+  const auto& leaf_latch = (*_node_latches)[node_id];
+  FileValue value;
+  try {
+    value = _file_manager.get_value(node.children()[entry_position]);
+  } catch (const std::exception&) {
+    if (!leaf_latch.validate(*version)) return std::nullopt;
+    throw;
+  }
+  if (!leaf_latch.validate(*version)) return std::nullopt;
+  return value;
+}
+
+bool DBManager::_write_concurrent(const FileKey key, const FileValue* value, const KeyWrite write) {
+  while (true) {
+    const auto existed = _try_write_concurrent(key, value, write);
+    if (!existed) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lock(_file_mutex);
+    _file_manager.commit();
+    return *existed;
+  }
+}
+
+std::optional<bool> DBManager::_try_write_concurrent(const FileKey key, const FileValue* value,
+                                                     const KeyWrite write) {
+  NodePage page_buffer;
+  auto node_id = _root_id.load(std::memory_order_acquire);
+  auto version = _read_node_concurrent(node_id, page_buffer);
+  if (!version || node_id != _root_id.load(std::memory_order_acquire)) return std::nullopt;
+
+  auto node = BPNodeView{page_buffer.data(), _file_manager.node_layout()}.to_node();
+  std::optional<BPNode> parent;
+  uint64_t parent_version = 0;
+
+  // Full nodes are split on the way down, so a split never has to go further up than to the parent. Only writes that
+  // may add the key split nodes.
+  const auto may_insert = write == KeyWrite::Put || write == KeyWrite::Upsert;
+  while (true) {
+    if (may_insert && node.header().num_keys == _max_keys_per_node) {
+      LatchSet latches;
+      if (parent && !latches.try_upgrade((*_node_latches)[parent->header().node_id], parent_version)) {
+        return std::nullopt;
+      }
+      if (!latches.try_upgrade((*_node_latches)[node_id], *version)) return std::nullopt;
+
+      // The key goes into one of the halves, which is found by starting over
+      _split_concurrent(node, parent ? &*parent : nullptr, key, latches);
+      return std::nullopt;
+    }
+    if (node.header().is_leaf) break;
+
+    const auto child_id = node.find_child(key);
+    const auto child_version = _read_node_concurrent(child_id, page_buffer);
+    if (!child_version || !(*_node_latches)[node_id].validate(*version)) return std::nullopt;
+
+    parent = std::move(node);
+    parent_version = *version;
+    node = BPNodeView{page_buffer.data(), _file_manager.node_layout()}.to_node();
+    node_id = child_id;
+    version = child_version;
+  }
+
+  // Only the leaf is latched, the nodes above are not changed
+  LatchSet latches;
+  if (!latches.try_upgrade((*_node_latches)[node_id], *version)) return std::nullopt;
+
+  const auto entry_position = node.find_value_insert_position(key);
+  const auto exists = entry_position < node.keys().size() && node.keys()[entry_position] == key;
+  if (write == KeyWrite::Remove) {
+    if (!exists) return false;
+
+    {
+      std::lock_guard<std::mutex> lock(_file_mutex);
+      _file_manager.free_value(node.children()[entry_position]);
+      if (parent && node.header().num_keys - 1u < _min_num_children(true)) _pending_merge_keys.push_back(key);
+    }
+    node.erase(entry_position);
+    _write_node_concurrent(node);
+    return true;
+  }
+
+  if (exists) {
+    if (write == KeyWrite::Put) return true;
+
+    const auto value_pos = node.children()[entry_position];
+    FileOffset new_value_pos;
+    {
+      std::lock_guard<std::mutex> lock(_file_mutex);
+      new_value_pos = _file_manager.update_value(value_pos, *value, key);
+    }
+
+    // The value did not fit into its old space and was moved
+    if (new_value_pos != value_pos) {
+      node.set_child(entry_position, new_value_pos);
+      _write_node_concurrent(node);
+    }
+    return true;
+  }
+
+  if (write == KeyWrite::Update) return false;
+
+  FileOffset value_pos;
+  {
+    std::lock_guard<std::mutex> lock(_file_mutex);
+    value_pos = _file_manager.insert_value(*value, key);
+  }
+  node.insert(key, value_pos);
+  _write_node_concurrent(node);
+  return false;
+}
+
+std::optional<uint64_t> DBManager::_read_node_concurrent(const NodeID node_id, NodePage& page_buffer) const {
+  const auto& latch = (*_node_latches)[node_id];
+  const auto version = latch.read_version();
+  if (!version) return std::nullopt;
+
+  _file_manager.view_page(node_id, page_buffer);
+  if (!latch.validate(*version)) return std::nullopt;
+  return version;
+}
+
+void DBManager::_split_concurrent(BPNode& node, BPNode* parent, const FileKey key, LatchSet& latches) {
+  // The next leaf links back to the new leaf, so it is latched as well before anything is written
+  const auto is_leaf = node.header().is_leaf;
+  const auto next_leaf = node.header().next_leaf;
+  if (is_leaf && next_leaf != InvalidNodeID && !latches.try_lock((*_node_latches)[next_leaf])) return;
+
+  auto split = is_leaf ? std::make_pair(node.split_leaf(key), FileKey{0}) : node.split_internal();
+  auto& new_node = split.first;
+  if (is_leaf) {
+    // split_leaf leaves the room for the key in the smaller half. That may be the new leaf even if the key is smaller
+    // than all of its keys, then the key becomes the separator.
+    split.second = new_node.keys().front();
+    if (key > node.keys().back()) split.second = std::min(split.second, key);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_file_mutex);
+    new_node.mutable_header().node_id = _file_manager.get_next_node_position();
+  }
+  const auto new_node_id = new_node.header().node_id;
+
+  if (is_leaf) {
+    new_node.mutable_header().next_leaf = next_leaf;
+    node.mutable_header().next_leaf = new_node_id;
+    if (next_leaf != InvalidNodeID) {
+      auto next_leaf_header = _file_manager.load_node_header(next_leaf);
+      next_leaf_header.previous_leaf = new_node_id;
+      _file_manager.write_node_header(next_leaf_header);
+    }
+  }
+
+  if (parent) {
+    // Readers only reach the new node through the parent, which is latched until all three nodes are written
+    _file_manager.write_node(new_node);
+    _write_node_concurrent(node);
+    parent->insert(split.second, new_node_id);
+    _write_node_concurrent(*parent);
+    return;
+  }
+
+  // The root was split, the new root is published once both halves are written
+  BPNodeHeader root_header{};
+  {
+    std::lock_guard<std::mutex> lock(_file_mutex);
+    root_header.node_id = _file_manager.get_next_node_position();
+  }
+  root_header.is_leaf = false;
+  root_header.parent_id = InvalidNodeID;
+  root_header.next_leaf = InvalidNodeID;
+  root_header.previous_leaf = InvalidNodeID;
+  root_header.num_keys = 1;
+
+  node.mutable_header().parent_id = root_header.node_id;
+  new_node.mutable_header().parent_id = root_header.node_id;
+  _file_manager.write_node(new_node);
+  _file_manager.write_node(node);
+
+  BPNode root{root_header, {split.second}, {node.header().node_id, new_node_id}};
+  _file_manager.write_node(root);
+  _root = std::make_unique<BPNode>(std::move(root));
+
+  std::lock_guard<std::mutex> lock(_file_mutex);
+  _update_root_offset(root_header.node_id);
+}
+
+void DBManager::_write_node_concurrent(const BPNode& node) {
+  _file_manager.write_node(node);
+
+  // Only the writer that holds the latch of the root changes the cached root
+  if (node.header().node_id == _root_id.load(std::memory_order_acquire)) {
+    _root = std::make_unique<BPNode>(node.header(), node.keys(), node.children());
+  }
+}
+
+bool DBManager::_write_copy_on_write(const FileKey key, const FileValue* value, const KeyWrite write) {
+  // All nodes on the path from the root to the leaf of the key are replaced
+  std::vector<BPNode> path;
+  std::vector<uint16_t> child_positions;
+  path.emplace_back(_root->header(), _root->keys(), _root->children());
+  while (!path.back().header().is_leaf) {
+    child_positions.push_back(path.back().find_child_insert_position(key));
+    auto child = _file_manager.load_node(path.back().children()[child_positions.back()]);
+    path.push_back(std::move(child));
+  }
+
+  auto& leaf = path.back();
+  const auto entry_position = leaf.find_value_insert_position(key);
+  const auto exists = entry_position < leaf.keys().size() && leaf.keys()[entry_position] == key;
+  if (!exists && (write == KeyWrite::Update || write == KeyWrite::Remove)) return false;
+  if (exists && write == KeyWrite::Put) return true;
+
+  // Readers of older trees may still read the old value, so it is never overwritten
+  if (exists) _retiring_space.value_positions.push_back(leaf.children()[entry_position]);
+
+  // Node split off from the node of the current level and its separator key
+  std::optional<BPNode> sibling;
+  FileKey separator = 0;
+  if (write == KeyWrite::Remove) {
+    leaf.erase(entry_position);
+  } else if (exists) {
+    leaf.set_child(entry_position, _file_manager.insert_value(*value, key));
+  } else if (leaf.header().num_keys < _max_keys_per_node) {
+    leaf.insert(key, _file_manager.insert_value(*value, key));
+  } else {
+    // split_leaf leaves the room for the key in the smaller half
+    sibling.emplace(leaf.split_leaf(key));
+    auto& target_leaf = leaf.keys().size() >= sibling->keys().size() ? *sibling : leaf;
+    target_leaf.insert(key, _file_manager.insert_value(*value, key));
+    separator = sibling->keys().front();
+  }
+
+  // Pages of dropped nodes that were written in this transaction were never visible to readers
+  const auto drop_node = [&](const NodeID node_id) {
+    if (_written_node_ids.erase(node_id) > 0) {
+      _file_manager.free_node(node_id);
+    } else {
+      _retiring_space.node_ids.push_back(node_id);
+    }
+  };
+
+  // Bottom-up, each node of the path moves to a new page and its parent is pointed to the copy. Split-off siblings are
+  // added to the parent, empty nodes are dropped from it.
+  std::optional<std::pair<FileKey, NodeID>> new_child;
+  auto is_dropped = false;
+  for (auto level = path.size(); level-- > 0;) {
+    auto& node = path[level];
+    if (level + 1 < path.size()) {
+      const auto child_position = child_positions[level];
+      if (is_dropped) {
+        node.erase_child(child_position);
+      } else {
+        node.set_child(child_position, path[level + 1].header().node_id);
+      }
+
+      if (new_child && node.header().num_keys == _max_keys_per_node) {
+        auto [new_node, median_key] = node.split_parent(new_child->first, new_child->second);
+        sibling.emplace(std::move(new_node));
+        separator = median_key;
+      } else if (new_child) {
+        node.insert(new_child->first, new_child->second);
+      }
+      new_child.reset();
+    }
+
+    is_dropped = level > 0 && node.children().empty();
+    if (is_dropped) {
+      drop_node(node.header().node_id);
+      continue;
+    }
+
+    _copy_node_on_write(node);
+    _file_manager.write_node(node);
+    if (sibling) {
+      _copy_node_on_write(*sibling);
+      _file_manager.write_node(*sibling);
+      new_child.emplace(separator, sibling->header().node_id);
+      sibling.reset();
+    }
+  }
+
+  // A split root gets a new root above it. A root with a single child is replaced by the child, one without children
+  // (all of its keys were removed) by an empty leaf.
+  if (new_child) {
+    BPNodeHeader root_header{};
+    root_header.node_id = _file_manager.get_next_node_position();
+    root_header.is_leaf = false;
+    root_header.parent_id = InvalidNodeID;
+    root_header.next_leaf = InvalidNodeID;
+    root_header.previous_leaf = InvalidNodeID;
+    root_header.num_keys = 1;
+    _written_node_ids.insert(root_header.node_id);
+
+    _root = std::make_unique<BPNode>(root_header, std::vector<FileKey>{new_child->first},
+                                     std::vector<NodeID>{path.front().header().node_id, new_child->second});
+    _file_manager.write_node(*_root);
+    return exists;
+  }
+
+  auto root = std::move(path.front());
+  if (!root.header().is_leaf && root.children().empty()) {
+    drop_node(root.header().node_id);
+    BPNodeHeader root_header{};
+    root_header.node_id = _file_manager.get_next_node_position();
+    root_header.is_leaf = true;
+    root_header.parent_id = InvalidNodeID;
+    root_header.next_leaf = InvalidNodeID;
+    root_header.previous_leaf = InvalidNodeID;
+    root_header.num_keys = 0;
+    _written_node_ids.insert(root_header.node_id);
+
+    root = BPNode{root_header, {}, {}};
+    _file_manager.write_node(root);
+  }
+  while (!root.header().is_leaf && root.children().size() == 1) {
+    drop_node(root.header().node_id);
+    root = _file_manager.load_node(root.children().front());
+  }
+  _root = std::make_unique<BPNode>(std::move(root));
+  return exists;
+}
+
+void DBManager::_copy_node_on_write(BPNode& node) {
+  auto& header = node.mutable_header();
+
+  // Neighbours are not copied along, so leaves do not link to them
+  header.next_leaf = InvalidNodeID;
+  header.previous_leaf = InvalidNodeID;
+  if (_written_node_ids.count(header.node_id) > 0) return;
+
+  // New nodes (e.g., split-off siblings) have no page yet
+  if (header.node_id != InvalidNodeID) _retiring_space.node_ids.push_back(header.node_id);
+  header.node_id = _file_manager.get_next_node_position();
+  _written_node_ids.insert(header.node_id);
+}
+
+void DBManager::_commit_copy_on_write() {
+  // The root offset may only point to the new pages once they are durable, and the replaced pages may only be reused
+  // once the root offset is durable. The file therefore always contains a complete tree.
+  _file_manager.sync();
+  _update_root_offset(_root->header().node_id);
+  _file_manager.sync();
+
+  _retiring_space.version = _reader_table->publish(_root->header().node_id);
+  _retired_space.push_back(std::move(_retiring_space));
+  _retiring_space = {};
+  _written_node_ids.clear();
+
+  _free_unpinned_space();
+  _file_manager.commit();
+}
+
+void DBManager::_free_unpinned_space() {
+  // Readers with an older version may still read the space, readers with this or a later one started behind its commit
+  const auto oldest_pinned_version = _reader_table->oldest_pinned_version();
+  while (!_retired_space.empty() && _retired_space.front().version <= oldest_pinned_version) {
+    for (const auto node_id : _retired_space.front().node_ids) _file_manager.free_node(node_id);
+    for (const auto value_pos : _retired_space.front().value_positions) _file_manager.free_value(value_pos);
+    _retired_space.pop_front();
+  }
+}
+
 }  // namespace keva
@@ -1,36 +1,227 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "bp_node.hpp"
+#include "bulk_loader.hpp"
+#include "cursor.hpp"
 #include "file_manager.hpp"
+#include "reader_table.hpp"
+#include "snapshot.hpp"
 #include "types.hpp"
+#include "version_latch.hpp"
+#include "write_batch.hpp"
 
 namespace keva {
 
 class DBManager : public Noncopyable {
  public:
   explicit DBManager(uint16_t value_size, uint16_t max_keys_per_node = KEYS_PER_NODE);
-  DBManager(std::string db_file_name, uint16_t value_size, uint16_t max_keys_per_node = KEYS_PER_NODE);
+  DBManager(uint16_t value_size, NodeLayout node_layout);
+  DBManager(std::string db_file_name, uint16_t value_size, NodeLayout node_layout = KEYS_PER_NODE,
+            DBOptions options = {});
+  ~DBManager();
 
   FileValue get(FileKey key) const;
 
+  // Looks up all keys with a single descent in key order and returns the values in the order of keys. Values of keys
+  // that do not exist are empty. Nodes and values are prefetched level by level before they are read.
+  std::vector<FileValue> multi_get(const std::vector<FileKey>& keys) const;
+
+  // Calls callback for all entries with lower <= key <= upper in ascending key order
+  void scan(FileKey lower, FileKey upper, const ScanCallback& callback,
+            uint32_t value_batch_size = DEFAULT_SCAN_BATCH_SIZE) const;
+
+  // The returned cursor is unpositioned and must not outlive this DBManager
+  Cursor cursor(uint32_t value_batch_size = DEFAULT_SCAN_BATCH_SIZE,
+                FileKey upper_bound = std::numeric_limits<FileKey>::max()) const;
+
   void put(FileKey key, const FileValue& value);
 
+  // Replace the value of an existing key. update throws if the key does not exist, upsert inserts it. Values are
+  // overwritten in place if the new value fits into the old one's space.
+  void update(FileKey key, const FileValue& value);
+  void upsert(FileKey key, const FileValue& value);
+
+  // Removing a key that does not exist has no effect. Only the leaf of the key is rewritten. If it becomes underfull,
+  // it is merged later together with other underfull nodes (see DBOptions::merge_batch_size).
   void remove(FileKey key);
 
+  // Merges all pending underfull nodes with a neighbour or moves entries over from it, bottom-up in a single descent.
+  // Pending merges are only kept in memory, so nodes can stay underfull if the database is closed before.
+  void merge_underfull_nodes();
+  uint64_t num_pending_merges() const;
+
+  // Moves the live values of the value log segment with the largest share of dead bytes to the head of the log and
+  // deletes the segment in a single commit. Returns false if there is no value log or no segment with at least
+  // min_dead_ratio dead bytes. Also happens after writes, see DBOptions::value_log_gc_ratio.
+  bool collect_value_log_garbage(double min_dead_ratio = 0.0);
+
+  // Applies all operations of the batch in a single commit. The batch is validated before anything is written, so a
+  // put of an existing key leaves the database unchanged. Each affected node is read and written once.
+  void write(const WriteBatch& batch);
+
+  // Builds the tree bottom-up from num_entries entries with strictly increasing keys. Only possible on an empty
+  // database. fill_factor is the share of each node's capacity that is used.
+  void bulk_load(uint64_t num_entries, const BulkLoadEntryGenerator& next_entry, double fill_factor = 1.0);
+
+  // Writes all entries to a new database file in which the leaves are stored in key order, each followed by its values,
+  // behind all internal nodes. The file contains no free space. The entries are read leaf by leaf along the leaf chain.
+  // With a value log, the copy gets a new log that only contains the live values in key order.
+  void compact(const std::string& dest_file_name, double fill_factor = 1.0) const;
+
+  // Number of entries in the tree. Only the headers of the leaves are read.
+  uint64_t num_entries() const;
+
   const FileManager& get_file_manager() const;
   const BPNode& get_root() const;
 
+  // Pins the current root of a copy-on-write tree (see DBOptions::copy_on_write), which can then be read while writers
+  // replace it. nullptr for other trees.
+  std::shared_ptr<const ReaderPin> pin_root() const;
+
+  // Read-only view of the current tree that is not changed by later writes. Only for copy-on-write trees. Taking a
+  // snapshot only takes a slot in the reader table, the replaced pages are kept until its last copy is destroyed.
+  Snapshot snapshot() const;
+
  protected:
+  friend class Snapshot;
+
+  // Change of a single key by a write batch. A null value removes the key.
+  struct BatchChange {
+    FileKey key;
+    const FileValue* value;
+  };
+
+  // Nodes that were split off during a write batch and need to be added to the parent, with their separator keys
+  using NewSiblings = std::vector<std::pair<FileKey, NodeID>>;
+
+  // Single-key writes of a concurrent or copy-on-write tree
+  enum class KeyWrite : uint8_t { Put, Update, Upsert, Remove };
+
   BPNode _init_root();
 
+  // Lookups below root_id, which is a pinned root of a copy-on-write tree, or below the cached root if it is invalid
+  FileValue _get(FileKey key, NodeID root_id) const;
+  std::vector<FileValue> _multi_get(const std::vector<FileKey>& keys, NodeID root_id) const;
+
+  // Writes the root offset to the file and publishes the root to concurrent operations
+  void _update_root_offset(NodeID root_id);
+
+  // Throws if the key is too large for a database with 4-byte keys
+  void _check_key_size(FileKey key) const;
+
+  void _put(FileKey key, const FileValue& value);
+
+  // Returns false if the key does not exist
+  bool _update(FileKey key, const FileValue& value);
+
+  // Returns false if the key does not exist
+  bool _remove(FileKey key);
+
+  // Value positions (or inline values) of keys in the same order, nullopt for keys that do not exist. root_id as above.
+  std::vector<std::optional<FileOffset>> _find_value_positions(const std::vector<FileKey>& keys,
+                                                               NodeID root_id = InvalidNodeID) const;
+
+  NewSiblings _apply_changes(BPNode& node, NodeID parent_id, const BatchChange* begin, const BatchChange* end);
+  NewSiblings _apply_leaf_changes(BPNode& leaf, NodeID parent_id, const BatchChange* begin, const BatchChange* end);
+  NewSiblings _write_split_internal_node(BPNode& node);
+
+  // Nodes with fewer children (entries in leaves) are merged
+  uint16_t _min_num_children(bool is_leaf) const;
+  void _merge_pending_nodes_if_due();
+  void _merge_pending_nodes();
+
+  // Fixes the underfull children on the paths to the sorted keys in [begin, end). Returns true if internal nodes were
+  // merged or refilled, which can leave underfull nodes that had no neighbour before.
+  bool _merge_underfull_children(BPNode& node, const FileKey* begin, const FileKey* end);
+
+  // Merges the children at left_position and left_position + 1 of parent or distributes their entries evenly
+  void _merge_siblings(BPNode& parent, uint16_t left_position);
+
+  void _collect_value_log_garbage_if_due();
+  void _collect_value_log_segment(uint32_t segment_id);
+
+  // Sets the child slots of the sorted keys, which must exist. Each leaf is written once.
+  void _set_value_slots(const std::vector<std::pair<FileKey, FileOffset>>& value_slots);
+
+  // Operations of a concurrent tree. An attempt returns nullopt if a node changed while it was read or a latch could
+  // not be taken, the operation then starts over at the root.
+  FileValue _get_concurrent(FileKey key) const;
+  std::optional<FileValue> _try_get_concurrent(FileKey key, NodePage& page_buffer) const;
+
+  // value is nullptr for removes. Returns true if the key existed. A put of an existing key changes nothing.
+  bool _write_concurrent(FileKey key, const FileValue* value, KeyWrite write);
+  std::optional<bool> _try_write_concurrent(FileKey key, const FileValue* value, KeyWrite write);
+
+  // Reads the node into page_buffer and returns the version of its latch, or nullopt if a writer held or took the latch
+  // meanwhile. Concurrent trees have neither a buffer pool nor a mapping, so the page is always copied.
+  std::optional<uint64_t> _read_node_concurrent(NodeID node_id, NodePage& page_buffer) const;
+
+  // Splits node, whose latch is held in latches together with the latch of its parent (nullptr for the root). For
+  // leaves, key decides which half gets the room. Does nothing if the latch of the next leaf cannot be taken.
+  void _split_concurrent(BPNode& node, BPNode* parent, FileKey key, LatchSet& latches);
+
+  // Writes the node, which is latched, and keeps the cached root up to date
+  void _write_node_concurrent(const BPNode& node);
+
+  // Changes a key of a copy-on-write tree in the current transaction. value is nullptr for removes. Returns true if the
+  // key existed. A put of an existing key changes nothing.
+  bool _write_copy_on_write(FileKey key, const FileValue* value, KeyWrite write);
+
+  // Moves a node of the committed tree to a new page, as readers may still read the old one. Nodes that were written in
+  // the current transaction are not visible to readers and keep their page.
+  void _copy_node_on_write(BPNode& node);
+
+  // Syncs the pages of the transaction, replaces the root and syncs the root offset. Then reuses the pages and value
+  // slots that no reader can reach any more.
+  void _commit_copy_on_write();
+  void _free_unpinned_space();
+
   FileManager _file_manager;
   std::unique_ptr<BPNode> _root;
   uint16_t _max_keys_per_node;
   uint16_t _value_size;
+  const DBOptions _options;
+
+  // A key in each leaf that became underfull since the last merge pass
+  std::vector<FileKey> _pending_merge_keys;
+
+  // nullptr unless the tree is concurrent. Concurrent operations start at _root_id, as the cached root is only used by
+  // the other functions.
+  std::unique_ptr<NodeLatches> _node_latches;
+  std::atomic<NodeID> _root_id{InvalidNodeID};
+
+  // Serializes the changes of concurrent writers to the file manager (allocations, value writes, commits) and to the
+  // pending merges
+  std::mutex _file_mutex;
+
+  // Space of a copy-on-write tree that is no longer part of the tree since the commit of version
+  struct RetiredSpace {
+    uint64_t version;
+    std::vector<NodeID> node_ids;
+    std::vector<FileOffset> value_positions;
+  };
+
+  // nullptr unless the tree is copy-on-write. Readers pin their root in the table, the writer publishes new roots.
+  std::unique_ptr<ReaderTable> _reader_table;
+  std::mutex _writer_mutex;
+
+  // Pages written by the current transaction and the space it replaced
+  std::unordered_set<NodeID> _written_node_ids;
+  RetiredSpace _retiring_space;
+
+  // Replaced space of earlier commits in commit order, which is freed once no reader has an older version pinned
+  std::deque<RetiredSpace> _retired_space;
 };
 
 }  // namespace keva
\ No newline at end of file
@@ -1,176 +1,678 @@
 #include "file_manager.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
-#include <iostream>
+#include <limits>
 #include <memory>
-#include <sstream>
+
+namespace {
+
+using namespace keva;
+
+// Position of DBHeader::root_offset in the file
+const FileOffset ROOT_OFFSET_POSITION = 6;
+
+// Version 2 stores fixed-size values of up to MAX_INLINE_VALUE_SIZE bytes in the child slots of the leaves, version 3
+// adds the key size to the header, version 4 the page size, version 5 the flags. Since version 4, the header fills the
+// first page and nodes are aligned to the page size.
+const uint16_t DB_FORMAT_VERSION = 5;
+const uint16_t INLINE_VALUES_VERSION = 2;
+const uint16_t KEY_SIZE_VERSION = 3;
+const uint16_t PAGE_SIZE_VERSION = 4;
+const uint16_t FLAGS_VERSION = 5;
+const uint16_t MAX_INLINE_VALUE_SIZE = sizeof(NodeID);
+
+// Granularity of read-ahead hints. Ranges that are closer than this are merged into one hint.
+const FileOffset PREFETCH_PAGE_SIZE = 4096;
+
+// get_values reads over gaps of up to this many bytes between values instead of issuing another read
+const FileOffset MAX_VALUE_READ_GAP = 2048;
+
+// The free-space map is stored at the end of the file, followed by its offset and this marker
+const uint64_t FREE_SPACE_MAP_MAGIC = 0x70616d6565726621;
+const FileOffset FREE_SPACE_TRAILER_SIZE = sizeof(FileOffset) + sizeof(uint64_t);
+
+// A variable sized value needs at least its size and one byte
+uint32_t min_value_slot_size(const uint16_t value_size) {
+  return value_size == 0 ? sizeof(uint32_t) + 1 : value_size;
+}
+
+void check_page_size(const uint32_t page_size) {
+  Assert(page_size >= MIN_PAGE_SIZE && page_size <= MAX_PAGE_SIZE && (page_size & (page_size - 1)) == 0,
+         "Page size must be a power of two between 4 KiB and 64 KiB.");
+}
+
+void check_node_layout(const NodeLayout& node_layout, const uint32_t page_size) {
+  Assert(node_layout.key_size == sizeof(uint32_t) || node_layout.key_size == sizeof(FileKey),
+         "Keys must be 4 or 8 bytes wide.");
+  Assert(BP_NODE_HEADER_SIZE + node_layout.max_keys_per_node * node_layout.key_size +
+                 (node_layout.max_keys_per_node + 1) * sizeof(NodeID) <=
+             page_size,
+         "Keys per node do not fit into a node.");
+}
+
+}  // namespace
 
 namespace keva {
 
-FileManager::FileManager(uint16_t value_size, uint16_t max_keys_per_node)
-    : _value_size(value_size), _max_keys_per_node(max_keys_per_node) {
-  _db = std::make_unique<std::stringstream>(_file_flags);
+FileManager::FileManager(uint16_t value_size, NodeLayout node_layout)
+    : _value_size(value_size),
+      _node_layout(node_layout),
+      _free_space_map(min_value_slot_size(value_size)) {
+  _fd = memfd_create("keva-lite", MFD_CLOEXEC);
+  Assert(_fd >= 0, "Failed to create in-memory database file.");
   _db_header = init_db();
   _next_position = _get_file_size();
+  _has_inline_values = _stores_values_inline(_db_header);
 }
 
-FileManager::FileManager(std::string db_file_name, uint16_t value_size, uint16_t max_keys_per_node)
-    : _db_file_name(std::move(db_file_name)), _value_size(value_size), _max_keys_per_node(max_keys_per_node) {
+FileManager::FileManager(std::string db_file_name, uint16_t value_size, NodeLayout node_layout, DBOptions options)
+    : _db_file_name(std::move(db_file_name)),
+      _options(options),
+      _value_size(value_size),
+      _node_layout(node_layout),
+      _free_space_map(min_value_slot_size(value_size)) {
   std::ifstream exist_check(_db_file_name);
-  const auto is_new_db = !exist_check.good();
+  _is_new_db = !exist_check.good();
 
-  if (is_new_db) {
-    _db = std::make_unique<std::fstream>(_db_file_name, _file_flags | std::ios::trunc);
-    _db_header = init_db();
+  const auto open_flags = O_RDWR | O_CREAT | (_is_new_db ? O_TRUNC : 0);
+  _fd = open(_db_file_name.c_str(), open_flags, 0644);
+  Assert(_fd >= 0, "Failed to open database file '" + _db_file_name + "'.");
+
+  if (_options.storage_mode == StorageMode::MemoryMapped) {
+    _open_mapped_file();
   } else {
-    _db = std::make_unique<std::fstream>(_db_file_name, _file_flags);
-    _db_header = load_db();
+    _reader = std::make_unique<AsyncReader>(_fd, _options.io_queue_depth);
   }
 
+  // Recovery has to happen before the header is read, as the log may contain a new root offset
+  if (_options.enable_wal) _open_write_ahead_log();
+
+  _db_header = _is_new_db ? init_db() : load_db();
+  _has_inline_values = _stores_values_inline(_db_header);
+
+  // Inline values never go to the value log
+  const auto value_log_name = _db_file_name + "-vlog";
+  const auto has_value_log = _options.enable_value_log && !_has_inline_values;
+  Assert(_is_new_db || ValueLog::exists(value_log_name) == has_value_log,
+         "Database file was created with a different value log setting than specified.");
+  if (has_value_log) {
+    _value_log = std::make_unique<ValueLog>(value_log_name, _options.value_log_segment_size, _is_new_db);
+  }
   _next_position = _get_file_size();
+  if (!_is_new_db) _load_free_space_map();
+
+  // Without a synced header, log replay could not make sense of a crashed new database
+  if (_wal && _is_new_db) _sync_data_file();
+
+  const auto buffer_pool_size =
+      (_options.buffer_pool_size == 0 && _wal) ? DEFAULT_BUFFER_POOL_SIZE : _options.buffer_pool_size;
+  if (buffer_pool_size > 0) {
+    auto page_reader = [this](const FileOffset offset, char* page) { _read_at(offset, page, _db_header.page_size); };
+    auto page_writer = [this](const FileOffset offset, const char* page) {
+      _write_at(offset, page, _db_header.page_size);
+    };
+    _buffer_pool = std::make_unique<BufferPool>(buffer_pool_size, _db_header.page_size, page_reader, page_writer);
+  }
+}
+
+FileManager::~FileManager() {
+  try {
+    // Uncommitted changes are not written back. The database file stays at the last committed state.
+    if (_wal && _txn_log.empty()) {
+      checkpoint();
+    } else {
+      flush();
+    }
+
+    if (_txn_log.empty()) _store_free_space_map();
+  } catch (const std::exception&) {
+    // Nothing we can do about this in a destructor. With a write-ahead log, the changes are replayed on the next open.
+  }
+
+  if (_mapped_region != nullptr) {
+    munmap(_mapped_region, _mapped_size);
+    // Cut off the unused rest of the last chunk so the file only contains actual data
+    const auto truncate_result = ftruncate(_fd, _mapped_data_end);
+    static_cast<void>(truncate_result);
+  }
+
+  if (_fd >= 0) close(_fd);
 }
 
 DBHeader FileManager::init_db() {
-  _db->seekp(0);
-  DebugAssert(!_db->fail(), "Failed to set position in output stream.");
+  check_page_size(_options.page_size);
+  check_node_layout(_node_layout, _options.page_size);
 
   DBHeader db_header{};
-  db_header.version = 1;
+  db_header.version = DB_FORMAT_VERSION;
   db_header.value_size = _value_size;
-  db_header.keys_per_node = _max_keys_per_node;
-  db_header.root_offset = DB_HEADER_SIZE;
-
-  write_value(db_header.version);
-  write_value(db_header.value_size);
-  write_value(db_header.keys_per_node);
-  write_value(db_header.root_offset);
+  db_header.keys_per_node = _node_layout.max_keys_per_node;
+  db_header.root_offset = _options.page_size;
+  db_header.key_size = _node_layout.key_size;
+  db_header.page_size = _options.page_size;
+  db_header.flags = _options.copy_on_write ? COPY_ON_WRITE_FLAG : 0;
+
+  auto offset = FileOffset{0};
+  write_value(offset, db_header.version);
+  write_value(offset, db_header.value_size);
+  write_value(offset, db_header.keys_per_node);
+  write_value(offset, db_header.root_offset);
+  write_value(offset, db_header.key_size);
+  write_value(offset, db_header.page_size);
+  write_value(offset, db_header.flags);
+
+  // The root starts on the second page
+  write_values(offset, std::vector<char>(db_header.page_size - DB_HEADER_SIZE, 0));
 
   return db_header;
 }
 
 DBHeader FileManager::load_db() const {
-  _db->seekg(0);
-  DebugAssert(!_db->fail(), "Failed to set position in input stream.");
-
   DBHeader db_header{};
-  db_header.version = read_value<uint16_t>();
-  db_header.value_size = read_value<uint16_t>();
-  db_header.keys_per_node = read_value<uint16_t>();
-  db_header.root_offset = read_value<FileOffset>();
-
+  auto offset = FileOffset{0};
+  db_header.version = read_value<uint16_t>(offset);
+  db_header.value_size = read_value<uint16_t>(offset);
+  db_header.keys_per_node = read_value<uint16_t>(offset);
+  db_header.root_offset = read_value<FileOffset>(offset);
+  db_header.key_size = db_header.version >= KEY_SIZE_VERSION ? read_value<uint16_t>(offset) : uint16_t{sizeof(FileKey)};
+  db_header.page_size = db_header.version >= PAGE_SIZE_VERSION ? read_value<uint32_t>(offset) : LEGACY_PAGE_SIZE;
+  db_header.flags = db_header.version >= FLAGS_VERSION ? read_value<uint16_t>(offset) : uint16_t{0};
+
+  Assert(db_header.version <= DB_FORMAT_VERSION, "Database file has a newer format than this version supports.");
+  if (db_header.version >= PAGE_SIZE_VERSION) check_page_size(db_header.page_size);
   Assert(db_header.value_size == _value_size, "Database file contains different value type than specified.");
-  Assert(db_header.keys_per_node == _max_keys_per_node,
+  Assert(db_header.keys_per_node == _node_layout.max_keys_per_node,
          "Database file contains different number of keys per node than specified.");
+  Assert(db_header.key_size == _node_layout.key_size, "Database file contains different key size than specified.");
+  check_node_layout(_node_layout, db_header.page_size);
+  // Files of older versions do not record the mode
+  Assert(db_header.version < FLAGS_VERSION ||
+             ((db_header.flags & COPY_ON_WRITE_FLAG) != 0) == _options.copy_on_write,
+         "Database file was created with a different copy-on-write setting than specified.");
+
+  return db_header;
+}
+
+DBHeader FileManager::read_db_header(const std::string& db_file_name) {
+  std::ifstream db_file{db_file_name, std::ios::binary};
+  if (!db_file.good()) throw std::runtime_error("Failed to open database file '" + db_file_name + "'.");
+
+  DBHeader db_header{};
+  db_file.read(reinterpret_cast<char*>(&db_header.version), sizeof(db_header.version));
+  db_file.read(reinterpret_cast<char*>(&db_header.value_size), sizeof(db_header.value_size));
+  db_file.read(reinterpret_cast<char*>(&db_header.keys_per_node), sizeof(db_header.keys_per_node));
+  db_file.read(reinterpret_cast<char*>(&db_header.root_offset), sizeof(db_header.root_offset));
+  db_header.key_size = sizeof(FileKey);
+  if (db_header.version >= KEY_SIZE_VERSION) {
+    db_file.read(reinterpret_cast<char*>(&db_header.key_size), sizeof(db_header.key_size));
+  }
+  db_header.page_size = LEGACY_PAGE_SIZE;
+  if (db_header.version >= PAGE_SIZE_VERSION) {
+    db_file.read(reinterpret_cast<char*>(&db_header.page_size), sizeof(db_header.page_size));
+  }
+  db_header.flags = 0;
+  if (db_header.version >= FLAGS_VERSION) {
+    db_file.read(reinterpret_cast<char*>(&db_header.flags), sizeof(db_header.flags));
+  }
+  if (!db_file.good()) throw std::runtime_error("'" + db_file_name + "' is not a database file.");
 
   return db_header;
 }
 
 void FileManager::update_root_offset(const FileOffset offset) {
-  _db->seekp(6);
-  DebugAssert(!_db->fail(), "Failed to set position in output stream.");
-  write_value(offset);
+  _db_header.root_offset = offset;
+
+  if (_wal) {
+    // The header is not a cached page, so it is only written to the database file on the next checkpoint
+    _log_write(ROOT_OFFSET_POSITION, reinterpret_cast<const char*>(&offset), sizeof(offset));
+    _is_root_offset_dirty = true;
+    return;
+  }
+
+  _write_root_offset();
 }
 
-BPNodeHeader FileManager::load_node_header(const FileOffset offset) const {
-  DebugAssert(offset != InvalidNodeID, "Trying to read from invalid offset");
-  _db->seekg(offset);
-  DebugAssert(!_db->fail(), "Failed to set position in input stream.");
+const DBHeader& FileManager::db_header() const { return _db_header; }
 
-  BPNodeHeader node_header{};
-  node_header.node_id = read_value<NodeID>();
-  node_header.is_leaf = read_value<bool>();
-  node_header.parent_id = read_value<NodeID>();
-  node_header.next_leaf = read_value<NodeID>();
-  node_header.previous_leaf = read_value<NodeID>();
-  node_header.num_keys = read_value<uint16_t>();
+bool FileManager::is_new_db() const { return _is_new_db; }
 
-  return node_header;
+BPNodeHeader FileManager::load_node_header(const FileOffset offset) const {
+  DebugAssert(offset != InvalidNodeID, "Trying to read from invalid offset");
+  std::array<char, BP_NODE_HEADER_SIZE> buffer;
+  return BPNodeView{_read_page(offset, buffer.data(), BP_NODE_HEADER_SIZE), _node_layout}.header();
 }
 
 BPNode FileManager::load_node(const FileOffset offset) const {
-  DebugAssert(offset != InvalidNodeID, "Trying to read from invalid offset");
-  const auto node_header = load_node_header(offset);
+  NodePage buffer;
+  return view_node(offset, buffer).to_node();
+}
 
-  const auto extra_child = node_header.is_leaf ? 0 : 1u;
+BPNodeView FileManager::view_node(const FileOffset offset, NodePage& buffer) const {
+  DebugAssert(offset != InvalidNodeID, "Trying to read from invalid offset");
+  return BPNodeView{_read_page(offset, buffer.data(_db_header.page_size), _db_header.page_size), _node_layout};
+}
 
-  // Node has loaded all keys but some are null. Resize here to not grow above max nodes per key limit.
-  auto keys = read_values<FileKey>(_max_keys_per_node);
-  keys.resize(node_header.num_keys);
+std::vector<BPNodeView> FileManager::view_nodes(const std::vector<FileOffset>& offsets,
+                                                std::vector<char>& buffer) const {
+  std::vector<BPNodeView> views;
+  views.reserve(offsets.size());
+  if (_mapped_region != nullptr && !_buffer_pool) {
+    for (const auto offset : offsets) views.emplace_back(_mapped_region + offset, _node_layout);
+    return views;
+  }
 
-  auto children = read_values<NodeID>(_max_keys_per_node + extra_child);
-  children.resize(node_header.num_keys + extra_child);
+  // Cached pages are copied, as the pool may evict them while it loads the next one
+  const auto page_size = _db_header.page_size;
+  buffer.resize(offsets.size() * page_size);
+  std::vector<ReadRequest> requests;
+  for (auto i = size_t{0}; i < offsets.size(); ++i) {
+    DebugAssert(offsets[i] != InvalidNodeID, "Trying to read from invalid offset");
+    auto* page = buffer.data() + i * page_size;
+    if (_buffer_pool && _buffer_pool->contains(offsets[i])) {
+      std::memcpy(page, _buffer_pool->read_page(offsets[i]), page_size);
+    } else {
+      requests.push_back({offsets[i], page_size, page});
+    }
+  }
+  _read_ranges(requests);
 
-  return BPNode(node_header, std::move(keys), std::move(children));
+  for (auto i = size_t{0}; i < offsets.size(); ++i) views.emplace_back(buffer.data() + i * page_size, _node_layout);
+  return views;
 }
 
 void FileManager::write_node_header(const BPNodeHeader& header) {
   Assert(header.node_id != InvalidNodeID, "Trying to write to invalid offset");
 
-  _db->seekp(header.node_id);
-  Assert(!_db->fail(), "Failed to set position in output stream.");
-  write_value(header.node_id);
-  write_value(header.is_leaf);
-  write_value(header.parent_id);
-  write_value(header.next_leaf);
-  write_value(header.previous_leaf);
-  write_value(header.num_keys);
+  if (_buffer_pool) {
+    auto* page = _buffer_pool->write_page(header.node_id, true, _is_logging());
+    encode_node_header(header, page);
+    _log_write(header.node_id, page, BP_NODE_HEADER_SIZE);
+    return;
+  }
+
+  std::array<char, BP_NODE_HEADER_SIZE> buffer;
+  encode_node_header(header, buffer.data());
+  _write_at(header.node_id, buffer.data(), buffer.size());
 }
 
 void FileManager::write_node(const BPNode& node) {
-  write_node_header(node.header());
+  Assert(node.header().node_id != InvalidNodeID, "Trying to write to invalid offset");
+
+  if (_buffer_pool) {
+    // Pages of uncommitted transactions must not be written to the database file before the log is synced
+    auto* page = _buffer_pool->write_page(node.header().node_id, false, _is_logging());
+    _encode_node(node, page);
+    _log_write(node.header().node_id, page, _db_header.page_size);
+    return;
+  }
 
-  auto bytes_written = BP_NODE_HEADER_SIZE;
+  NodePage page;
+  _encode_node(node, page.data(_db_header.page_size));
+  _write_at(node.header().node_id, page.data(), _db_header.page_size);
+}
+
+const char* FileManager::view_page(const FileOffset offset, NodePage& buffer) const {
+  DebugAssert(offset != InvalidNodeID, "Trying to read from invalid offset");
+  return _read_page(offset, buffer.data(_db_header.page_size), _db_header.page_size);
+}
+
+void FileManager::write_page(const FileOffset offset, const char* page) {
+  Assert(offset != InvalidNodeID, "Trying to write to invalid offset");
+
+  if (_buffer_pool) {
+    auto* cached_page = _buffer_pool->write_page(offset, false, _is_logging());
+    std::memcpy(cached_page, page, _db_header.page_size);
+    _log_write(offset, page, _db_header.page_size);
+    return;
+  }
+
+  _write_at(offset, page, _db_header.page_size);
+}
+
+void FileManager::flush() {
+  if (_buffer_pool) _buffer_pool->flush();
+  if (_value_log) _value_log->flush();
+  if (_is_root_offset_dirty) _write_root_offset();
+}
+
+void FileManager::sync() {
+  flush();
+  _sync_data_file();
+}
 
-  // Number of values to fill up empty space with
-  const auto dummy_values_size = _max_keys_per_node - node.keys().size();
-  const auto dummy_children_size = (node.header().is_leaf) ? dummy_values_size + 1 : dummy_values_size;
-  const std::vector<FileKey> dummy_keys(dummy_values_size);
-  const std::vector<NodeID> dummy_children(dummy_children_size);
+void FileManager::commit() {
+  // Values must be durable before the nodes that reference them
+  if (_value_log && _wal) _value_log->sync();
 
-  bytes_written += write_values(node.keys());
-  bytes_written += write_values(dummy_keys);  // Fill rest of space with dummy keys
+  if (_wal && !_txn_log.empty()) {
+    _wal->commit(_txn_log);
+    _txn_log.clear();
 
-  bytes_written += write_values(node.children());
-  bytes_written += write_values(dummy_children);  // Fill rest of space with dummy children
+    for (const auto& [offset, data] : _deferred_writes) _write_at(offset, data.data(), data.size());
+    _deferred_writes.clear();
+    _buffer_pool->unpin_all();
 
-  const auto num_padding_bytes = BP_NODE_SIZE - bytes_written;
-  const std::vector<char> padding_vector(num_padding_bytes);
-  write_values(padding_vector);
-  _db->flush();
+    if (_wal->size() >= _options.wal_checkpoint_size) checkpoint();
+  }
+
+  // The committed tree does not reference the space freed by the transaction anymore
+  _free_space_map.release_freed_space();
+  if (_value_log) _value_log->release_dropped_segments();
+}
+
+void FileManager::begin_unlogged_writes() { _is_unlogged = true; }
+
+void FileManager::end_unlogged_writes() {
+  _is_unlogged = false;
+  if (!_wal) return;
+
+  flush();
+  _sync_data_file();
+  if (_value_log) _value_log->sync();
+}
+
+void FileManager::checkpoint() {
+  Assert(_txn_log.empty(), "Cannot checkpoint with uncommitted changes.");
+  flush();
+
+  if (!_wal) return;
+  _sync_data_file();
+  _wal->truncate();
 }
 
 FileValue FileManager::get_value(const FileOffset value_pos) const {
+  if (_has_inline_values) return _decode_inline_value(value_pos);
+
   // No value to be read
   if (value_pos == InvalidNodeID) return FileValue();
+  if (_value_log) return _value_log->read(value_pos);
 
-  _db->seekg(value_pos);
-  DebugAssert(!_db->fail(), "Failed to set position in input stream.");
+  auto offset = value_pos;
   auto value_size = _db_header.value_size;
 
   // Variable size (e.g. string or raw data type). Read size of upcoming data block
-  const auto num_bytes = (value_size == 0) ? read_value<uint32_t>() : value_size;
+  const auto num_bytes = (value_size == 0) ? read_value<uint32_t>(offset) : value_size;
 
   FileValue value(num_bytes);
-  _db->read(value.data(), num_bytes);
+  _read_at(offset, value.data(), num_bytes);
   return value;
 }
 
-FileOffset FileManager::insert_value(const FileValue& value) {
+std::vector<FileValue> FileManager::get_values(const std::vector<FileOffset>& value_positions) const {
+  std::vector<FileValue> values(value_positions.size());
+  if (_has_inline_values) {
+    for (auto i = 0u; i < value_positions.size(); ++i) values[i] = _decode_inline_value(value_positions[i]);
+    return values;
+  }
+
+  if (_value_log) {
+    for (auto i = 0u; i < value_positions.size(); ++i) values[i] = get_value(value_positions[i]);
+    return values;
+  }
+
+  // Read the values in file order. Invalid positions stay empty.
+  std::vector<uint32_t> order;
+  order.reserve(value_positions.size());
+  for (auto i = 0u; i < value_positions.size(); ++i) {
+    if (value_positions[i] != InvalidNodeID) order.push_back(i);
+  }
+  std::sort(order.begin(), order.end(),
+            [&](const uint32_t lhs, const uint32_t rhs) { return value_positions[lhs] < value_positions[rhs]; });
+
+  // Equal positions are read once and copied afterwards
+  std::vector<std::pair<uint32_t, uint32_t>> duplicates;
+  auto num_unique = 0u;
+  for (const auto index : order) {
+    if (num_unique > 0 && value_positions[index] == value_positions[order[num_unique - 1]]) {
+      duplicates.emplace_back(index, order[num_unique - 1]);
+    } else {
+      order[num_unique++] = index;
+    }
+  }
+  order.resize(num_unique);
+
+  // Values that are close to each other form a run that is read at once. The size of the last variable sized value of
+  // a run is only known after the run is read, so its data is read in a second batch.
+  const auto value_size = _db_header.value_size;
+  const auto last_value_bytes = value_size == 0 ? uint32_t{sizeof(uint32_t)} : uint32_t{value_size};
+  std::vector<std::pair<uint32_t, uint32_t>> runs;
+  std::vector<std::vector<char>> run_buffers;
+  std::vector<ReadRequest> requests;
+  auto run_begin = 0u;
+  while (run_begin < order.size()) {
+    auto run_end = run_begin + 1;
+    while (run_end < order.size() &&
+           value_positions[order[run_end]] - value_positions[order[run_end - 1]] <= MAX_VALUE_READ_GAP) {
+      ++run_end;
+    }
+
+    const auto first_position = value_positions[order[run_begin]];
+    const auto last_position = value_positions[order[run_end - 1]];
+    runs.emplace_back(run_begin, run_end);
+    run_buffers.emplace_back(last_position - first_position + last_value_bytes);
+    requests.push_back({first_position, static_cast<uint32_t>(run_buffers.back().size()), run_buffers.back().data()});
+    run_begin = run_end;
+  }
+  _read_ranges(requests);
+
+  requests.clear();
+  for (auto run = size_t{0}; run < runs.size(); ++run) {
+    const auto& buffer = run_buffers[run];
+    const auto first_position = value_positions[order[runs[run].first]];
+    for (auto i = runs[run].first; i < runs[run].second; ++i) {
+      const auto value_position = value_positions[order[i]];
+      const auto* value_data = buffer.data() + (value_position - first_position);
+      auto num_bytes = static_cast<uint32_t>(value_size);
+      if (value_size == 0) {
+        std::memcpy(&num_bytes, value_data, sizeof(num_bytes));
+        value_data += sizeof(num_bytes);
+      }
+
+      auto& value = values[order[i]];
+      if (value_size == 0 && i + 1 == runs[run].second) {
+        value.resize(num_bytes);
+        requests.push_back({value_position + sizeof(uint32_t), num_bytes, value.data()});
+        continue;
+      }
+
+      DebugAssert(value_data + num_bytes <= buffer.data() + buffer.size(), "Values overlap in the file");
+      value.assign(value_data, value_data + num_bytes);
+    }
+  }
+  _read_ranges(requests);
+
+  for (const auto& [duplicate, original] : duplicates) values[duplicate] = values[original];
+  return values;
+}
+
+FileOffset FileManager::update_value(const FileOffset value_pos, const FileValue& value, const FileKey key) {
+  if (_has_inline_values) return _encode_inline_value(value);
+
+  if (_value_log) {
+    _value_log->free(value_pos);
+    return insert_value(value, key);
+  }
+
+  DebugAssert(value_pos != InvalidNodeID, "Trying to update value at invalid offset");
+  DebugAssert(!value.empty(), "Trying to insert an empty value");
+
+  if (_db_header.value_size == 0) {
+    // Variable sized values start with their size. The slot is reused if the new value is not larger.
+    auto offset = value_pos;
+    const auto old_num_bytes = static_cast<uint32_t>(sizeof(uint32_t) + read_value<uint32_t>(offset));
+    if (value.size() > old_num_bytes) {
+      const auto new_value_pos = insert_value(value);
+      _free_space_map.free_value_slot(value_pos, old_num_bytes);
+      return new_value_pos;
+    }
+
+    // The rest of the old slot is not used anymore
+    _free_space_map.free_value_slot(value_pos + value.size(), old_num_bytes - static_cast<uint32_t>(value.size()));
+  }
+
+  _log_write(value_pos, value.data(), static_cast<uint32_t>(value.size()));
+  if (_is_logging()) {
+    // Without the log record on disk, a crash could leave the old value partially overwritten
+    _deferred_writes.emplace_back(value_pos, value);
+  } else {
+    _write_at(value_pos, value.data(), value.size());
+  }
+
+  return value_pos;
+}
+
+void FileManager::prefetch(std::vector<FileOffset> offsets, const uint32_t num_bytes) const {
+  // In-memory databases have nothing to read ahead
+  if (_db_file_name.empty()) return;
+
+  // Cached pages are already in memory
+  if (_buffer_pool) {
+    offsets.erase(std::remove_if(offsets.begin(), offsets.end(),
+                                 [&](const FileOffset offset) { return _buffer_pool->contains(offset); }),
+                  offsets.end());
+  }
+  std::sort(offsets.begin(), offsets.end());
+
+  const auto give_hint = [&](const FileOffset begin, const FileOffset end) {
+    if (_mapped_region != nullptr) {
+      if (begin >= _mapped_size) return;
+      const auto length = std::min(end, _mapped_size) - begin;
+      madvise(_mapped_region + begin, length, MADV_WILLNEED);
+    } else {
+      posix_fadvise(_fd, static_cast<off_t>(begin), static_cast<off_t>(end - begin), POSIX_FADV_WILLNEED);
+    }
+  };
+
+  // Merge neighbouring ranges to save system calls. madvise needs page-aligned addresses.
+  auto range_begin = InvalidNodeID;
+  auto range_end = InvalidNodeID;
+  for (const auto offset : offsets) {
+    if (offset == InvalidNodeID) continue;
+
+    const auto begin = offset / PREFETCH_PAGE_SIZE * PREFETCH_PAGE_SIZE;
+    const auto end = offset + num_bytes;
+    if (range_end != InvalidNodeID && begin <= range_end) {
+      range_end = std::max(range_end, end);
+      continue;
+    }
+
+    if (range_end != InvalidNodeID) give_hint(range_begin, range_end);
+    range_begin = begin;
+    range_end = end;
+  }
+
+  if (range_end != InvalidNodeID) give_hint(range_begin, range_end);
+}
+
+void FileManager::prefetch_values(const std::vector<FileOffset>& value_positions) const {
+  if (_has_inline_values) return;
+
+  if (_value_log) {
+    _value_log->prefetch(value_positions);
+    return;
+  }
+
+  // The size of variable sized values is unknown, so at least the beginning of each value is prefetched
+  prefetch(value_positions, _db_header.value_size == 0 ? _db_header.page_size : _db_header.value_size);
+}
+
+FileOffset FileManager::insert_value(const FileValue& value, const FileKey key) {
   DebugAssert(!value.empty(), "Trying to insert an empty value");
+  if (_has_inline_values) return _encode_inline_value(value);
+
+  if (_value_log) {
+    // The log stores the size of every value, so variable sized values are appended without theirs
+    const auto size_prefix = _db_header.value_size == 0 ? sizeof(uint32_t) : 0;
+    return _value_log->append(key, value.data() + size_prefix, static_cast<uint32_t>(value.size() - size_prefix));
+  }
+
   const auto insert_pos = get_next_value_position(value);
 
-  _db->seekp(insert_pos);
-  DebugAssert(!_db->fail(), "Failed to set position in output stream");
+  // New values never overwrite committed data, so they can be written before the commit
+  _write_at(insert_pos, value.data(), value.size());
+  _log_write(insert_pos, value.data(), static_cast<uint32_t>(value.size()));
 
-  write_values(value);
   return insert_pos;
 }
 
-uint16_t FileManager::max_keys_per_node() const { return _max_keys_per_node; }
+uint16_t FileManager::max_keys_per_node() const { return _node_layout.max_keys_per_node; }
+
+const NodeLayout& FileManager::node_layout() const { return _node_layout; }
+
+uint32_t FileManager::page_size() const { return _db_header.page_size; }
+
+FileOffset FileManager::page_aligned(const FileOffset offset) const {
+  if (_db_header.version < PAGE_SIZE_VERSION) return offset;
+  return (offset + _db_header.page_size - 1) / _db_header.page_size * _db_header.page_size;
+}
+
+FileKey FileManager::max_key() const {
+  return _node_layout.key_size == sizeof(uint32_t) ? std::numeric_limits<uint32_t>::max()
+                                                   : std::numeric_limits<FileKey>::max();
+}
+
+const BufferPool* FileManager::buffer_pool() const { return _buffer_pool.get(); }
+
+const WriteAheadLog* FileManager::write_ahead_log() const { return _wal.get(); }
+
+ValueLog* FileManager::value_log() { return _value_log.get(); }
+
+const ValueLog* FileManager::value_log() const { return _value_log.get(); }
+
+FileOffset FileManager::get_next_node_position() {
+  if (!_is_unlogged) {
+    const auto free_page = _free_space_map.allocate_page();
+    if (free_page != InvalidNodeID) return free_page;
+  }
+
+  // Values in the file may end anywhere, the space up to the next page is left to later values
+  const auto node_position = page_aligned(_next_position);
+  const auto gap = static_cast<uint32_t>(node_position - _next_position);
+  if (gap >= min_value_slot_size(_value_size)) _free_space_map.free_value_slot(_next_position, gap);
+
+  _next_position = node_position;
+  return _get_next_position(_db_header.page_size);
+}
+
+FileOffset FileManager::get_next_value_position(const FileValue& value) {
+  if (!_is_unlogged) {
+    const auto free_slot = _free_space_map.allocate_value_slot(static_cast<uint32_t>(value.size()));
+    if (free_slot != InvalidNodeID) return free_slot;
+  }
+
+  return _get_next_position(value.size());
+}
 
-FileOffset FileManager::get_next_node_position() { return _get_next_position(BP_NODE_SIZE); }
+void FileManager::free_node(const NodeID node_id) { _free_space_map.free_page(node_id); }
 
-FileOffset FileManager::get_next_value_position(const FileValue& value) { return _get_next_position(value.size()); }
+void FileManager::free_value(const FileOffset value_pos) {
+  if (_has_inline_values || value_pos == InvalidNodeID) return;
+
+  if (_value_log) {
+    _value_log->free(value_pos);
+    return;
+  }
+
+  auto num_bytes = static_cast<uint32_t>(_db_header.value_size);
+  if (num_bytes == 0) {
+    auto offset = value_pos;
+    num_bytes = sizeof(uint32_t) + read_value<uint32_t>(offset);
+  }
+  _free_space_map.free_value_slot(value_pos, num_bytes);
+}
+
+const FreeSpaceMap& FileManager::free_space_map() const { return _free_space_map; }
+
+bool FileManager::has_inline_values() const { return _has_inline_values; }
 
 FileOffset FileManager::_get_next_position(const FileOffset move_forward) {
   const auto next_position = _next_position;
@@ -179,10 +681,215 @@ FileOffset FileManager::_get_next_position(const FileOffset move_forward) {
 }
 
 FileOffset FileManager::_get_file_size() {
-  _db->seekg(0, std::ios_base::beg);
-  const auto begin_pos = _db->tellg();
-  _db->seekg(0, std::ios_base::end);
-  return static_cast<FileOffset>(_db->tellg() - begin_pos);
+  if (_mapped_region != nullptr) return _mapped_data_end;
+
+  struct stat file_stat {};
+  Assert(fstat(_fd, &file_stat) == 0, "Failed to read size of database file.");
+  return static_cast<FileOffset>(file_stat.st_size);
+}
+
+void FileManager::_read_at(const FileOffset offset, char* data, const uint64_t num_bytes) const {
+  if (_mapped_region != nullptr) {
+    DebugAssert(offset + num_bytes <= _mapped_data_end, "Trying to read beyond the end of the file");
+    std::memcpy(data, _mapped_region + offset, num_bytes);
+    return;
+  }
+
+  auto num_bytes_read = uint64_t{0};
+  while (num_bytes_read < num_bytes) {
+    const auto result =
+        pread(_fd, data + num_bytes_read, num_bytes - num_bytes_read, static_cast<off_t>(offset + num_bytes_read));
+    if (result < 0 && errno == EINTR) continue;
+    Assert(result > 0, "Failed to read from database file.");
+    num_bytes_read += static_cast<uint64_t>(result);
+  }
+}
+
+void FileManager::_write_at(const FileOffset offset, const char* data, const uint64_t num_bytes) {
+  if (_mapped_region != nullptr) {
+    const auto write_end = offset + num_bytes;
+    if (write_end > _mapped_size) _grow_mapped_region(write_end);
+
+    std::memcpy(_mapped_region + offset, data, num_bytes);
+    _mapped_data_end = std::max(_mapped_data_end, write_end);
+    return;
+  }
+
+  // Writing behind the end of the file (e.g., for nodes reserved by the bulk loader) fills the gap with zeros
+  auto num_bytes_written = uint64_t{0};
+  while (num_bytes_written < num_bytes) {
+    const auto result = pwrite(_fd, data + num_bytes_written, num_bytes - num_bytes_written,
+                               static_cast<off_t>(offset + num_bytes_written));
+    if (result < 0 && errno == EINTR) continue;
+    Assert(result > 0, "Failed to write to database file.");
+    num_bytes_written += static_cast<uint64_t>(result);
+  }
+}
+
+const char* FileManager::_read_page(const FileOffset offset, char* buffer, const uint32_t num_bytes) const {
+  if (_buffer_pool) return _buffer_pool->read_page(offset);
+
+  if (_mapped_region != nullptr) {
+    DebugAssert(offset + num_bytes <= _mapped_data_end, "Trying to read beyond the end of the file");
+    return _mapped_region + offset;
+  }
+
+  _read_at(offset, buffer, num_bytes);
+  return buffer;
+}
+
+void FileManager::_read_ranges(const std::vector<ReadRequest>& requests) const {
+  if (requests.empty()) return;
+
+  if (_reader) {
+    _reader->read(requests);
+    return;
+  }
+
+  for (const auto& request : requests) _read_at(request.offset, request.data, request.num_bytes);
+}
+
+void FileManager::_encode_node(const BPNode& node, char* page) const {
+  // Unused key and child slots as well as the padding are null
+  std::memset(page, 0, _db_header.page_size);
+  encode_node_header(node.header(), page);
+
+  const auto keys_offset = BP_NODE_HEADER_SIZE;
+  const auto children_offset = keys_offset + _node_layout.max_keys_per_node * _node_layout.key_size;
+  if (_node_layout.key_size == sizeof(uint32_t)) {
+    for (auto position = 0u; position < node.keys().size(); ++position) {
+      DebugAssert(node.keys()[position] <= max_key(), "Key does not fit into the key size");
+      write_to_page(page, keys_offset + position * sizeof(uint32_t), static_cast<uint32_t>(node.keys()[position]));
+    }
+  } else if (!node.keys().empty()) {
+    std::memcpy(page + keys_offset, node.keys().data(), node.keys().size() * sizeof(FileKey));
+  }
+  if (!node.children().empty()) {
+    std::memcpy(page + children_offset, node.children().data(), node.children().size() * sizeof(NodeID));
+  }
+}
+
+void FileManager::_open_mapped_file() {
+  Assert(!_db_file_name.empty(), "Memory-mapped storage requires a database file.");
+
+  _mapped_data_end = _get_file_size();
+  _grow_mapped_region(std::max(_mapped_data_end, static_cast<FileOffset>(1)));
+}
+
+void FileManager::_grow_mapped_region(const FileOffset min_size) {
+  const auto new_size = ((min_size + MMAP_CHUNK_SIZE - 1) / MMAP_CHUNK_SIZE) * MMAP_CHUNK_SIZE;
+  Assert(ftruncate(_fd, new_size) == 0, "Failed to grow database file.");
+
+  if (_mapped_region != nullptr) munmap(_mapped_region, _mapped_size);
+
+  auto* region = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  Assert(region != MAP_FAILED, "Failed to map database file into memory.");
+
+  _mapped_region = static_cast<char*>(region);
+  _mapped_size = new_size;
+}
+
+void FileManager::_open_write_ahead_log() {
+  Assert(!_db_file_name.empty(), "The write-ahead log requires a database file.");
+  _wal = std::make_unique<WriteAheadLog>(_db_file_name + "-wal");
+
+  // A log next to a new database file belongs to a database that does not exist anymore
+  if (!_is_new_db) {
+    const auto num_recovered_txns = _wal->recover(
+        [&](const FileOffset offset, const char* data, const uint32_t num_bytes) { _write_at(offset, data, num_bytes); });
+    if (num_recovered_txns > 0) _sync_data_file();
+  }
+
+  _wal->truncate();
+}
+
+bool FileManager::_is_logging() const { return _wal && !_is_unlogged; }
+
+void FileManager::_log_write(const FileOffset offset, const char* data, const uint32_t num_bytes) {
+  if (!_is_logging()) return;
+  WriteAheadLog::append_write(_txn_log, offset, data, num_bytes);
+}
+
+void FileManager::_write_root_offset() {
+  auto offset = ROOT_OFFSET_POSITION;
+  write_value(offset, _db_header.root_offset);
+  _is_root_offset_dirty = false;
+}
+
+void FileManager::_load_free_space_map() {
+  const auto file_size = _next_position;
+  if (file_size < DB_HEADER_SIZE + FREE_SPACE_TRAILER_SIZE) return;
+
+  const auto trailer_position = file_size - FREE_SPACE_TRAILER_SIZE;
+  auto offset = trailer_position;
+  const auto map_offset = read_value<FileOffset>(offset);
+  const auto magic = read_value<uint64_t>(offset);
+  if (magic != FREE_SPACE_MAP_MAGIC || map_offset < DB_HEADER_SIZE || map_offset > trailer_position) return;
+
+  std::vector<char> buffer(trailer_position - map_offset);
+  _read_at(map_offset, buffer.data(), buffer.size());
+  if (!_free_space_map.deserialize(buffer.data(), buffer.size())) return;
+
+  // New data overwrites the map, so it must not be found again after a crash
+  offset = trailer_position + sizeof(FileOffset);
+  write_value(offset, uint64_t{0});
+  if (_wal) _sync_data_file();
+
+  _next_position = map_offset;
+}
+
+void FileManager::_store_free_space_map() {
+  if (_db_file_name.empty()) return;
+
+  // Everything behind the data is unused, e.g., the map that was read when the file was opened
+  auto file_end = _next_position;
+  if (!_free_space_map.empty()) {
+    std::vector<char> buffer;
+    _free_space_map.serialize(buffer);
+    buffer.resize(buffer.size() + FREE_SPACE_TRAILER_SIZE);
+    std::memcpy(buffer.data() + buffer.size() - FREE_SPACE_TRAILER_SIZE, &_next_position, sizeof(FileOffset));
+    std::memcpy(buffer.data() + buffer.size() - sizeof(uint64_t), &FREE_SPACE_MAP_MAGIC, sizeof(uint64_t));
+
+    _write_at(_next_position, buffer.data(), buffer.size());
+    file_end += buffer.size();
+  }
+
+  if (_mapped_region != nullptr) {
+    // The file is cut off at the end of the data when it is unmapped
+    _mapped_data_end = file_end;
+  } else {
+    Assert(ftruncate(_fd, static_cast<off_t>(file_end)) == 0, "Failed to truncate database file.");
+  }
+
+  if (_wal) _sync_data_file();
+}
+
+bool FileManager::_stores_values_inline(const DBHeader& db_header) {
+  return db_header.version >= INLINE_VALUES_VERSION && db_header.value_size > 0 &&
+         db_header.value_size <= MAX_INLINE_VALUE_SIZE;
+}
+
+FileOffset FileManager::_encode_inline_value(const FileValue& value) const {
+  DebugAssert(value.size() == _db_header.value_size, "Cannot store value with different size than specified.");
+
+  // Unused bytes of the slot are null, so equal values have equal slots
+  FileOffset slot = 0;
+  std::memcpy(&slot, value.data(), value.size());
+  return slot;
+}
+
+FileValue FileManager::_decode_inline_value(const FileOffset slot) const {
+  FileValue value(_db_header.value_size);
+  std::memcpy(value.data(), &slot, value.size());
+  return value;
+}
+
+void FileManager::_sync_data_file() {
+  if (_mapped_region != nullptr) {
+    Assert(msync(_mapped_region, _mapped_size, MS_SYNC) == 0, "Failed to sync database file.");
+  }
+
+  Assert(fsync(_fd) == 0, "Failed to sync database file.");
 }
 
 }  // namespace keva
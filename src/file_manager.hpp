@@ -1,11 +1,16 @@
 #pragma once
 
-#include <istream>
 #include <memory>
 #include <string>
 
+#include "async_reader.hpp"
 #include "bp_node.hpp"
+#include "bp_node_view.hpp"
+#include "buffer_pool.hpp"
+#include "free_space_map.hpp"
 #include "types.hpp"
+#include "value_log.hpp"
+#include "write_ahead_log.hpp"
 
 namespace keva {
 
@@ -14,101 +19,262 @@ struct DBHeader {
   uint16_t value_size;
   uint16_t keys_per_node;
   FileOffset root_offset;
+  uint16_t key_size;
+  uint32_t page_size;
+  uint16_t flags;
 };
 
+// DBHeader::flags. Trees written in copy-on-write mode have stale leaf links, so they must not be read in other modes.
+static const uint16_t COPY_ON_WRITE_FLAG = 1;
+
+// All reads and writes are positional (pread/pwrite on the file descriptor or memcpy on the mapping), there is no
+// shared file position. Const member functions therefore may be called from many threads at once, as long as no thread
+// writes at the same time and the buffer pool is disabled (it changes its page table on every read, and it is always
+// enabled with the write-ahead log).
 class FileManager : public Noncopyable {
  public:
-  explicit FileManager(uint16_t value_size, uint16_t max_keys_per_node);
-  explicit FileManager(std::string db_file_name, uint16_t value_size, uint16_t max_keys_per_node);
+  explicit FileManager(uint16_t value_size, NodeLayout node_layout);
+  explicit FileManager(std::string db_file_name, uint16_t value_size, NodeLayout node_layout, DBOptions options = {});
+  ~FileManager();
 
   DBHeader init_db();
   DBHeader load_db() const;
 
+  // Reads the header of a database file without opening the database, e.g., to find its value size
+  static DBHeader read_db_header(const std::string& db_file_name);
+
   void update_root_offset(FileOffset offset);
+  const DBHeader& db_header() const;
+  bool is_new_db() const;
 
   BPNodeHeader load_node_header(FileOffset offset) const;
   BPNode load_node(FileOffset offset) const;
 
+  // Returns a view of the node without copying it. buffer is only used if the page is neither cached nor mapped. The
+  // view is invalidated by the next call into the FileManager.
+  BPNodeView view_node(FileOffset offset, NodePage& buffer) const;
+
+  // Views of the nodes at offsets, in their order. Pages that are neither cached nor mapped are read into buffer with
+  // one batch of reads (see AsyncReader) without being added to the buffer pool. The views are invalidated by the next
+  // call into the FileManager.
+  std::vector<BPNodeView> view_nodes(const std::vector<FileOffset>& offsets, std::vector<char>& buffer) const;
+
   void write_node_header(const BPNodeHeader& header);
   void write_node(const BPNode& node);
 
+  // Raw access to the page of a node for node formats other than BPNode (see StringNode). Pages go through the same
+  // buffer pool and log as nodes. The returned page is invalidated by the next call into the FileManager.
+  const char* view_page(FileOffset offset, NodePage& buffer) const;
+  void write_page(FileOffset offset, const char* page);
+
+  // Write all cached dirty pages back to the file
+  void flush();
+
+  // Flushes and syncs the database file, also without write-ahead log. Copy-on-write trees use it to order writes.
+  void sync();
+
+  // Make all writes since the last commit durable. Only has an effect if the write-ahead log is enabled.
+  void commit();
+
+  // Write all committed changes to the database file, sync it and empty the write-ahead log
+  void checkpoint();
+
+  // Writes to space that is not reachable from the committed tree (e.g., during a bulk load) do not need to be logged.
+  // They are made durable by end_unlogged_writes, after which they can be linked into the tree in a normal commit.
+  void begin_unlogged_writes();
+  void end_unlogged_writes();
+
+  // Fixed-size values of up to 8 bytes are stored in the child slot of their leaf instead of a position (see
+  // has_inline_values). The value functions below then only convert between values and slots and never touch the file.
+  // With a value log, positions are pointers into the log.
   FileValue get_value(FileOffset value_pos) const;
-  FileOffset insert_value(const FileValue& value);
+
+  // Returns the values in the order of value_positions. Values that are close to each other in the file are read with
+  // a single read, all reads are issued at once.
+  std::vector<FileValue> get_values(const std::vector<FileOffset>& value_positions) const;
+
+  // The key is stored next to the value in the value log, so its garbage collection can find the entry of the value
+  FileOffset insert_value(const FileValue& value, FileKey key = 0);
+
+  // Overwrites the value at value_pos if the new value fits into its slot, otherwise the value is inserted at a new
+  // position. Returns the position of the value. Fixed-size values always fit, variable sized ones if they do not grow.
+  // Values in the value log are never overwritten.
+  FileOffset update_value(FileOffset value_pos, const FileValue& value, FileKey key = 0);
+
+  // Tells the OS that the num_bytes at each offset will be read soon, so it can start reading them in the background.
+  // Offsets of cached pages are skipped.
+  void prefetch(std::vector<FileOffset> offsets, uint32_t num_bytes) const;
+
+  // Prefetches values wherever they are stored
+  void prefetch_values(const std::vector<FileOffset>& value_positions) const;
 
   uint16_t max_keys_per_node() const;
+  const NodeLayout& node_layout() const;
+
+  // Size of the node pages as stored in the header. NodePages are filled with this many bytes.
+  uint32_t page_size() const;
+
+  // First position at or behind offset at which a node may start
+  FileOffset page_aligned(FileOffset offset) const;
+
+  // Largest key that fits into the keys of a node page
+  FileKey max_key() const;
+
+  // nullptr if the buffer pool is disabled
+  const BufferPool* buffer_pool() const;
 
+  // nullptr if the write-ahead log is disabled
+  const WriteAheadLog* write_ahead_log() const;
+
+  // nullptr if values are not stored in a value log. Records appended to the log are synced before each commit and
+  // dropped segments are deleted after it.
+  ValueLog* value_log();
+  const ValueLog* value_log() const;
+
+  // Space freed by committed transactions is reused before the file is extended. Writes that are not logged (e.g.,
+  // bulk loads) always append to the file.
   FileOffset get_next_value_position(const FileValue& value);
   FileOffset get_next_node_position();
 
+  // Mark a node page or the slot of a value as unused. The space is reused once the current transaction is committed.
+  void free_node(NodeID node_id);
+  void free_value(FileOffset value_pos);
+
+  // The map is stored behind the data when the database is closed and read again on the next open. After a crash, the
+  // space that was free before is lost.
+  const FreeSpaceMap& free_space_map() const;
+
+  // True if the leaves hold the values themselves. A null slot is a valid value then, so the existence of a key must be
+  // checked on the keys of its leaf.
+  bool has_inline_values() const;
+
+  // Read or write a value at offset and move offset behind it
   template <typename T>
-  T read_value() const;
+  T read_value(FileOffset& offset) const;
 
   template <typename T>
-  std::vector<T> read_values(uint32_t count) const;
+  std::vector<T> read_values(FileOffset& offset, uint32_t count) const;
 
   template <typename T>
-  uint32_t write_value(const T& value);
+  uint32_t write_value(FileOffset& offset, const T& value);
 
   template <typename T>
-  uint32_t write_values(const std::vector<T>& values);
+  uint32_t write_values(FileOffset& offset, const std::vector<T>& values);
 
  protected:
   FileOffset _get_file_size();
   FileOffset _get_next_position(FileOffset move_forward);
 
+  // All reads and writes go through these so that the file and the mmap backend share the (de)serialization code
+  void _read_at(FileOffset offset, char* data, uint64_t num_bytes) const;
+  void _write_at(FileOffset offset, const char* data, uint64_t num_bytes);
+
+  // Returns the page at offset. Only copies into buffer if the page is neither cached nor mapped.
+  const char* _read_page(FileOffset offset, char* buffer, uint32_t num_bytes) const;
+
+  // Reads all ranges with the AsyncReader of the file. Other backends read them one after another.
+  void _read_ranges(const std::vector<ReadRequest>& requests) const;
+  void _encode_node(const BPNode& node, char* page) const;
+
+  void _open_mapped_file();
+  void _grow_mapped_region(FileOffset min_size);
+
+  void _open_write_ahead_log();
+  bool _is_logging() const;
+  void _log_write(FileOffset offset, const char* data, uint32_t num_bytes);
+  void _write_root_offset();
+  void _sync_data_file();
+
+  void _load_free_space_map();
+  void _store_free_space_map();
+
+  static bool _stores_values_inline(const DBHeader& db_header);
+  FileOffset _encode_inline_value(const FileValue& value) const;
+  FileValue _decode_inline_value(FileOffset slot) const;
+
   const std::string _db_file_name;
-  mutable std::unique_ptr<std::iostream> _db;
+  const DBOptions _options;
+
+  // The database file. In-memory databases live in an anonymous file (see memfd_create) that is gone once it is closed.
+  int _fd = -1;
+  char* _mapped_region = nullptr;
+  FileOffset _mapped_size = 0;
+  FileOffset _mapped_data_end = 0;
+
+  // Reads batches with io_uring (or pread) from _fd. Only used for StorageMode::Stream, mapped files are read directly.
+  std::unique_ptr<AsyncReader> _reader;
+
+  std::unique_ptr<BufferPool> _buffer_pool;
+
+  std::unique_ptr<WriteAheadLog> _wal;
+  std::vector<char> _txn_log;
+
+  std::unique_ptr<ValueLog> _value_log;
+
+  // In-place writes to committed data. They are only written to the database file once their transaction is durable,
+  // so the old value is read until the commit.
+  std::vector<std::pair<FileOffset, FileValue>> _deferred_writes;
+  bool _is_root_offset_dirty = false;
+  bool _is_unlogged = false;
 
   DBHeader _db_header;
+  bool _is_new_db = true;
+  bool _has_inline_values = false;
   FileOffset _next_position = 0;
 
   const uint16_t _value_size;
-  uint16_t _max_keys_per_node;
+  const NodeLayout _node_layout;
 
-  const std::ios::openmode _file_flags = std::ios::binary | std::ios::in | std::ios::out;
+  FreeSpaceMap _free_space_map;
 };
 
 template <typename T>
-T FileManager::read_value() const {
+T FileManager::read_value(FileOffset& offset) const {
   T value;
-  _db->read(reinterpret_cast<char*>(&value), sizeof(T));
+  _read_at(offset, reinterpret_cast<char*>(&value), sizeof(T));
+  offset += sizeof(T);
   return value;
 }
 
 // Specialized for bool
 template <>
-inline bool FileManager::read_value() const {
+inline bool FileManager::read_value(FileOffset& offset) const {
   uint8_t value;
-  _db->read(reinterpret_cast<char*>(&value), sizeof(uint8_t));
+  _read_at(offset, reinterpret_cast<char*>(&value), sizeof(uint8_t));
+  offset += sizeof(uint8_t);
   return static_cast<bool>(value);
 }
 
 template <typename T>
-std::vector<T> FileManager::read_values(uint32_t count) const {
+std::vector<T> FileManager::read_values(FileOffset& offset, uint32_t count) const {
   std::vector<T> values(count);
-  _db->read(reinterpret_cast<char*>(values.data()), sizeof(T) * count);
+  _read_at(offset, reinterpret_cast<char*>(values.data()), sizeof(T) * count);
+  offset += sizeof(T) * count;
   return values;
 }
 
 template <typename T>
-uint32_t FileManager::write_value(const T& value) {
+uint32_t FileManager::write_value(FileOffset& offset, const T& value) {
   const auto num_bytes = sizeof(T);
-  _db->write(reinterpret_cast<const char*>(&value), num_bytes);
+  _write_at(offset, reinterpret_cast<const char*>(&value), num_bytes);
+  offset += num_bytes;
   return num_bytes;
 }
 
 // Specialized for bool
 template <>
-inline uint32_t FileManager::write_value(const bool& value) {
+inline uint32_t FileManager::write_value(FileOffset& offset, const bool& value) {
   const auto cast_value = static_cast<uint8_t>(value);
-  _db->write(reinterpret_cast<const char*>(&cast_value), sizeof(uint8_t));
+  _write_at(offset, reinterpret_cast<const char*>(&cast_value), sizeof(uint8_t));
+  offset += sizeof(uint8_t);
   return sizeof(uint8_t);
 }
 
 template <typename T>
-uint32_t FileManager::write_values(const std::vector<T>& values) {
+uint32_t FileManager::write_values(FileOffset& offset, const std::vector<T>& values) {
   const auto num_bytes = sizeof(T) * values.size();
-  _db->write(reinterpret_cast<const char*>(values.data()), num_bytes);
+  _write_at(offset, reinterpret_cast<const char*>(values.data()), num_bytes);
+  offset += num_bytes;
   return num_bytes;
 }
 
@@ -0,0 +1,151 @@
+#include "free_space_map.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+using namespace keva;
+
+// Allocations only check this many slots of their own size class for one that is large enough
+const uint32_t MAX_SIZE_CLASS_SCAN = 8;
+
+template <typename T>
+void append_to_buffer(std::vector<char>& buffer, const T& value) {
+  const auto* bytes = reinterpret_cast<const char*>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool read_from_buffer(const char*& data, const char* end, T& value) {
+  if (static_cast<uint64_t>(end - data) < sizeof(T)) return false;
+  std::memcpy(&value, data, sizeof(T));
+  data += sizeof(T);
+  return true;
+}
+
+}  // namespace
+
+namespace keva {
+
+FreeSpaceMap::FreeSpaceMap(const uint32_t min_value_slot_size) : _min_value_slot_size(min_value_slot_size) {
+  Assert(min_value_slot_size > 0, "Value slots must hold at least one byte.");
+}
+
+void FreeSpaceMap::free_page(const FileOffset offset) {
+  DebugAssert(offset != InvalidNodeID, "Trying to free page at invalid offset");
+  _freed_pages.push_back(offset);
+}
+
+void FreeSpaceMap::free_value_slot(const FileOffset offset, const uint32_t num_bytes) {
+  DebugAssert(offset != InvalidNodeID, "Trying to free value at invalid offset");
+  if (num_bytes < _min_value_slot_size) return;
+  _freed_value_slots.push_back({offset, num_bytes});
+}
+
+void FreeSpaceMap::release_freed_space() {
+  _free_pages.insert(_free_pages.end(), _freed_pages.begin(), _freed_pages.end());
+  _freed_pages.clear();
+
+  for (const auto& slot : _freed_value_slots) _add_value_slot(slot);
+  _freed_value_slots.clear();
+}
+
+FileOffset FreeSpaceMap::allocate_page() {
+  if (_free_pages.empty()) return InvalidNodeID;
+
+  const auto offset = _free_pages.back();
+  _free_pages.pop_back();
+  return offset;
+}
+
+FileOffset FreeSpaceMap::allocate_value_slot(const uint32_t num_bytes) {
+  const auto size_class = _size_class(num_bytes);
+  auto& class_slots = _free_value_slots[size_class];
+
+  ValueSlot slot{InvalidNodeID, 0};
+  const auto num_scanned = std::min<uint64_t>(class_slots.size(), MAX_SIZE_CLASS_SCAN);
+  for (auto i = 0u; i < num_scanned; ++i) {
+    const auto slot_it = class_slots.end() - 1 - i;
+    if (slot_it->num_bytes < num_bytes) continue;
+
+    slot = *slot_it;
+    class_slots.erase(slot_it);
+    break;
+  }
+
+  // All slots of larger classes are large enough
+  for (auto larger_class = size_class + 1; slot.offset == InvalidNodeID && larger_class < NUM_SIZE_CLASSES;
+       ++larger_class) {
+    if (_free_value_slots[larger_class].empty()) continue;
+    slot = _free_value_slots[larger_class].back();
+    _free_value_slots[larger_class].pop_back();
+  }
+
+  if (slot.offset == InvalidNodeID) return InvalidNodeID;
+
+  _num_free_value_bytes -= slot.num_bytes;
+  if (slot.num_bytes - num_bytes >= _min_value_slot_size) {
+    _add_value_slot({slot.offset + num_bytes, slot.num_bytes - num_bytes});
+  }
+  return slot.offset;
+}
+
+bool FreeSpaceMap::empty() const { return _free_pages.empty() && _num_free_value_bytes == 0; }
+
+uint64_t FreeSpaceMap::num_free_pages() const { return _free_pages.size(); }
+
+uint64_t FreeSpaceMap::num_free_value_bytes() const { return _num_free_value_bytes; }
+
+void FreeSpaceMap::serialize(std::vector<char>& buffer) const {
+  append_to_buffer(buffer, static_cast<uint64_t>(_free_pages.size()));
+  for (const auto offset : _free_pages) append_to_buffer(buffer, offset);
+
+  auto num_value_slots = uint64_t{0};
+  for (const auto& class_slots : _free_value_slots) num_value_slots += class_slots.size();
+  append_to_buffer(buffer, num_value_slots);
+  for (const auto& class_slots : _free_value_slots) {
+    for (const auto& slot : class_slots) {
+      append_to_buffer(buffer, slot.offset);
+      append_to_buffer(buffer, slot.num_bytes);
+    }
+  }
+}
+
+bool FreeSpaceMap::deserialize(const char* data, const uint64_t num_bytes) {
+  const auto* end = data + num_bytes;
+  std::vector<FileOffset> pages;
+  std::vector<ValueSlot> value_slots;
+
+  uint64_t num_pages;
+  if (!read_from_buffer(data, end, num_pages) || num_pages > num_bytes / sizeof(FileOffset)) return false;
+  pages.resize(num_pages);
+  for (auto& offset : pages) {
+    if (!read_from_buffer(data, end, offset) || offset == InvalidNodeID) return false;
+  }
+
+  uint64_t num_value_slots;
+  if (!read_from_buffer(data, end, num_value_slots) || num_value_slots > num_bytes / sizeof(ValueSlot)) return false;
+  value_slots.resize(num_value_slots);
+  for (auto& slot : value_slots) {
+    if (!read_from_buffer(data, end, slot.offset) || !read_from_buffer(data, end, slot.num_bytes)) return false;
+    if (slot.offset == InvalidNodeID || slot.num_bytes == 0) return false;
+  }
+  if (data != end) return false;
+
+  _free_pages.insert(_free_pages.end(), pages.begin(), pages.end());
+  for (const auto& slot : value_slots) _add_value_slot(slot);
+  return true;
+}
+
+uint32_t FreeSpaceMap::_size_class(const uint32_t num_bytes) {
+  if (num_bytes <= 1) return 0;
+  return 32 - static_cast<uint32_t>(__builtin_clz(num_bytes - 1));
+}
+
+void FreeSpaceMap::_add_value_slot(const ValueSlot slot) {
+  _free_value_slots[_size_class(slot.num_bytes)].push_back(slot);
+  _num_free_value_bytes += slot.num_bytes;
+}
+
+}  // namespace keva
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+// Free node pages and value slots of a database file. Value slots are kept in lists by size class (powers of two), so an
+// allocation only looks at slots of about the right size. Freed space is only handed out again after
+// release_freed_space, as the committed tree may reference it until the transaction that freed it is committed.
+class FreeSpaceMap : public Noncopyable {
+ public:
+  // Remainders of reused value slots that are smaller than min_value_slot_size are dropped
+  explicit FreeSpaceMap(uint32_t min_value_slot_size);
+
+  void free_page(FileOffset offset);
+  void free_value_slot(FileOffset offset, uint32_t num_bytes);
+
+  // Makes all space that was freed since the last call available for allocation
+  void release_freed_space();
+
+  // Return InvalidNodeID if there is no free space of the size
+  FileOffset allocate_page();
+  FileOffset allocate_value_slot(uint32_t num_bytes);
+
+  bool empty() const;
+  uint64_t num_free_pages() const;
+  uint64_t num_free_value_bytes() const;
+
+  // Only released space is serialized. deserialize returns false if data is not a serialized map.
+  void serialize(std::vector<char>& buffer) const;
+  bool deserialize(const char* data, uint64_t num_bytes);
+
+ protected:
+  struct ValueSlot {
+    FileOffset offset;
+    uint32_t num_bytes;
+  };
+
+  // Slots of class c hold (2^(c-1), 2^c] bytes
+  static constexpr uint32_t NUM_SIZE_CLASSES = 33;
+  static uint32_t _size_class(uint32_t num_bytes);
+
+  void _add_value_slot(ValueSlot slot);
+
+  const uint32_t _min_value_slot_size;
+
+  std::vector<FileOffset> _free_pages;
+  std::array<std::vector<ValueSlot>, NUM_SIZE_CLASSES> _free_value_slots;
+  uint64_t _num_free_value_bytes = 0;
+
+  std::vector<FileOffset> _freed_pages;
+  std::vector<ValueSlot> _freed_value_slots;
+};
+
+}  // namespace keva
@@ -1,54 +1,341 @@
 #pragma once
 
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "db_manager.hpp"
+#include "key_codec.hpp"
+#include "string_db_manager.hpp"
 #include "utils.hpp"
 
 namespace keva {
 
+// Composite keys like std::pair cannot be written to a stream, so errors show their file key instead
+template <typename K, typename = void>
+constexpr bool IS_PRINTABLE_KEY = false;
+
+template <typename K>
+constexpr bool IS_PRINTABLE_KEY<K, std::void_t<decltype(std::declval<std::ostream&>() << std::declval<const K&>())>> =
+    true;
+
+// String keys are stored as they are in a StringDBManager, so they keep their order. All other keys are converted to
+// FileKeys by their KeyCodec, which keeps their order as well.
 template <typename K, typename V>
 class KevaLite : public Noncopyable {
+  static constexpr bool HAS_STRING_KEYS = std::is_same_v<K, std::string>;
+  using Backend = std::conditional_t<HAS_STRING_KEYS, StringDBManager, DBManager>;
+  using FileBatch = std::conditional_t<HAS_STRING_KEYS, StringWriteBatch, keva::WriteBatch>;
+
  public:
   KevaLite();
 
-  explicit KevaLite(std::string db_file_name);
+  explicit KevaLite(std::string db_file_name, DBOptions options = {});
+
+  // Typed version of keva::WriteBatch
+  class WriteBatch {
+   public:
+    void put(const K& key, const V& value) { _batch.put(_to_db_key(key), convert_to_file_value(value)); }
+    void remove(const K& key) { _batch.remove(_to_db_key(key)); }
+    void clear() { _batch.clear(); }
+
+    uint64_t size() const { return _batch.size(); }
+    const FileBatch& file_batch() const { return _batch; }
+
+   protected:
+    FileBatch _batch;
+  };
+
+  // Typed version of keva::Snapshot. Reads see the database as it was when the snapshot was taken.
+  class Snapshot {
+   public:
+    V get(const K& key) const { return _get(_snapshot, key); }
+    std::vector<std::optional<V>> multi_get(const std::vector<K>& keys) const { return _multi_get(_snapshot, keys); }
+
+    template <typename Callback>
+    void scan(const K& lower, const K& upper, Callback callback) const {
+      _scan(_snapshot, lower, upper, callback);
+    }
+
+   protected:
+    friend class KevaLite;
+
+    explicit Snapshot(keva::Snapshot snapshot) : _snapshot(std::move(snapshot)) {}
+
+    keva::Snapshot _snapshot;
+  };
 
   V get(const K& key);
+
+  // Returns the values of all keys in the same order. Keys that do not exist have no value. Much faster than a get per
+  // key for large batches, as the keys share the descent through the tree and all reads are prefetched.
+  std::vector<std::optional<V>> multi_get(const std::vector<K>& keys);
+
   void put(const K& key, const V& value);
+
+  // Nodes that become underfull are merged later in batches, see DBOptions::merge_batch_size. Trees with string keys
+  // never merge nodes.
   void remove(const K& key);
+  void merge_underfull_nodes();
+
+  // Only has an effect with DBOptions::enable_value_log, which string keys do not support. Returns false if no segment
+  // had at least min_dead_ratio dead bytes.
+  bool collect_value_log_garbage(double min_dead_ratio = 0.0);
+
+  // update throws if the key does not exist, upsert inserts it
+  void update(const K& key, const V& value);
+  void upsert(const K& key, const V& value);
+
+  // Applies all puts and removes of the batch atomically
+  void write(const WriteBatch& batch);
+
+  // Consistent view for long reads while writes go on. Cheap enough to be taken for every read. Only for databases
+  // opened with DBOptions::copy_on_write and not for string keys.
+  Snapshot snapshot() const;
+
+  // Calls callback(key, value) for all entries with lower <= key <= upper in ascending order. Strings are compared
+  // bytewise, tuples lexicographically.
+  template <typename Callback>
+  void scan(const K& lower, const K& upper, Callback callback);
+
+  // Calls callback(key, value) for all entries whose key starts with prefix in ascending order. Only for string keys.
+  template <typename Callback>
+  void scan_prefix(const K& prefix, Callback callback);
+
+  // Fills an empty database with the std::pair<K, V> entries in [begin, end). Entries that are not sorted are sorted
+  // first. fill_factor is the share of each node's capacity that is used.
+  template <typename Iterator>
+  void bulk_load(Iterator begin, Iterator end, double fill_factor = 1.0);
+
+  // Writes a copy of the database to dest_file_name in which leaves and their values are stored in key order, so scans
+  // and lookups on the copy read mostly sequentially. The copy contains no free space.
+  void compact(const std::string& dest_file_name, double fill_factor = 1.0) const;
 
  protected:
-  DBManager _db_manager;
+  // Keys of up to 32 bits use 4-byte keys in the nodes of the DBManager
+  static Backend _create_db();
+  static Backend _open_db(std::string db_file_name, DBOptions options);
+
+  // Key as it is passed to the backend
+  static decltype(auto) _to_db_key(const K& key);
+
+  // Typed reads from the backend or a snapshot of it
+  template <typename Reader>
+  static V _get(const Reader& reader, const K& key);
+
+  template <typename Reader>
+  static std::vector<std::optional<V>> _multi_get(const Reader& reader, const std::vector<K>& keys);
+
+  template <typename Reader, typename Callback>
+  static void _scan(const Reader& reader, const K& lower, const K& upper, Callback& callback);
+
+  Backend _db_manager;
 };
 
 template <typename K, typename V>
-KevaLite<K, V>::KevaLite() : _db_manager(get_type_size<V>()) {}
+KevaLite<K, V>::KevaLite() : _db_manager(_create_db()) {}
+
+template <typename K, typename V>
+KevaLite<K, V>::KevaLite(std::string db_file_name, DBOptions options)
+    : _db_manager(_open_db(std::move(db_file_name), options)) {}
+
+template <typename K, typename V>
+typename KevaLite<K, V>::Backend KevaLite<K, V>::_create_db() {
+  if constexpr (HAS_STRING_KEYS) {
+    return StringDBManager{get_type_size<V>()};
+  } else {
+    return DBManager{get_type_size<V>(), NodeLayout::for_key_size(file_key_size<K>())};
+  }
+}
+
+template <typename K, typename V>
+typename KevaLite<K, V>::Backend KevaLite<K, V>::_open_db(std::string db_file_name, DBOptions options) {
+  if constexpr (HAS_STRING_KEYS) {
+    return StringDBManager{std::move(db_file_name), get_type_size<V>(), options};
+  } else {
+    // Nodes fill their page, so an existing database determines the number of keys per node with its page size
+    const auto page_size =
+        std::ifstream{db_file_name}.good() ? FileManager::read_db_header(db_file_name).page_size : options.page_size;
+    const auto node_layout = NodeLayout::for_key_size(file_key_size<K>(), page_size);
+    return DBManager{std::move(db_file_name), get_type_size<V>(), node_layout, options};
+  }
+}
 
 template <typename K, typename V>
-KevaLite<K, V>::KevaLite(std::string db_file_name) : _db_manager(std::move(db_file_name), get_type_size<V>()) {}
+decltype(auto) KevaLite<K, V>::_to_db_key(const K& key) {
+  if constexpr (HAS_STRING_KEYS) {
+    return key;
+  } else {
+    return convert_to_file_key(key);
+  }
+}
 
 template <typename K, typename V>
 V KevaLite<K, V>::get(const K& key) {
-  const auto file_key = convert_to_file_key(key);
-  auto result = _db_manager.get(file_key);
+  return _get(_db_manager, key);
+}
+
+template <typename K, typename V>
+template <typename Reader>
+V KevaLite<K, V>::_get(const Reader& reader, const K& key) {
+  auto result = reader.get(_to_db_key(key));
   if (result.empty()) {
     std::stringstream msg;
-    msg << "Key '" << key << "' not found.";
+    if constexpr (IS_PRINTABLE_KEY<K>) {
+      msg << "Key '" << key << "' not found.";
+    } else {
+      msg << "Key with file key " << _to_db_key(key) << " not found.";
+    }
     throw std::runtime_error(msg.str());
   }
   return convert_from_file_value<V>(result);
 }
+
+template <typename K, typename V>
+std::vector<std::optional<V>> KevaLite<K, V>::multi_get(const std::vector<K>& keys) {
+  return _multi_get(_db_manager, keys);
+}
+
+template <typename K, typename V>
+template <typename Reader>
+std::vector<std::optional<V>> KevaLite<K, V>::_multi_get(const Reader& reader, const std::vector<K>& keys) {
+  std::vector<FileValue> file_values;
+  if constexpr (HAS_STRING_KEYS) {
+    file_values = reader.multi_get(keys);
+  } else {
+    std::vector<FileKey> file_keys;
+    file_keys.reserve(keys.size());
+    for (const auto& key : keys) file_keys.push_back(convert_to_file_key(key));
+    file_values = reader.multi_get(file_keys);
+  }
+
+  std::vector<std::optional<V>> values;
+  values.reserve(file_values.size());
+  for (const auto& file_value : file_values) {
+    if (file_value.empty()) {
+      values.emplace_back(std::nullopt);
+    } else {
+      values.emplace_back(convert_from_file_value<V>(file_value));
+    }
+  }
+  return values;
+}
+
 template <typename K, typename V>
 void KevaLite<K, V>::put(const K& key, const V& value) {
-  const auto file_key = convert_to_file_key(key);
-  _db_manager.put(file_key, convert_to_file_value(value));
+  _db_manager.put(_to_db_key(key), convert_to_file_value(value));
 }
 template <typename K, typename V>
 void KevaLite<K, V>::remove(const K& key) {
-  const auto file_key = convert_to_file_key(key);
-  _db_manager.remove(file_key);
+  _db_manager.remove(_to_db_key(key));
+}
+
+template <typename K, typename V>
+void KevaLite<K, V>::merge_underfull_nodes() {
+  static_assert(!HAS_STRING_KEYS, "Trees with string keys do not merge nodes.");
+  _db_manager.merge_underfull_nodes();
+}
+
+template <typename K, typename V>
+bool KevaLite<K, V>::collect_value_log_garbage(double min_dead_ratio) {
+  static_assert(!HAS_STRING_KEYS, "Value logs are not supported for string keys.");
+  return _db_manager.collect_value_log_garbage(min_dead_ratio);
+}
+
+template <typename K, typename V>
+void KevaLite<K, V>::update(const K& key, const V& value) {
+  _db_manager.update(_to_db_key(key), convert_to_file_value(value));
+}
+
+template <typename K, typename V>
+void KevaLite<K, V>::upsert(const K& key, const V& value) {
+  _db_manager.upsert(_to_db_key(key), convert_to_file_value(value));
+}
+
+template <typename K, typename V>
+void KevaLite<K, V>::write(const WriteBatch& batch) {
+  _db_manager.write(batch.file_batch());
+}
+
+template <typename K, typename V>
+typename KevaLite<K, V>::Snapshot KevaLite<K, V>::snapshot() const {
+  static_assert(!HAS_STRING_KEYS, "Snapshots are not supported for string keys.");
+  return Snapshot{_db_manager.snapshot()};
+}
+
+template <typename K, typename V>
+template <typename Callback>
+void KevaLite<K, V>::scan(const K& lower, const K& upper, Callback callback) {
+  _scan(_db_manager, lower, upper, callback);
+}
+
+template <typename K, typename V>
+template <typename Reader, typename Callback>
+void KevaLite<K, V>::_scan(const Reader& reader, const K& lower, const K& upper, Callback& callback) {
+  if constexpr (HAS_STRING_KEYS) {
+    reader.scan(lower, upper, [&](const std::string& key, const FileValue& file_value) {
+      callback(key, convert_from_file_value<V>(file_value));
+    });
+  } else {
+    reader.scan(convert_to_file_key(lower), convert_to_file_key(upper),
+                [&](const FileKey file_key, const FileValue& file_value) {
+                  callback(convert_from_file_key<K>(file_key), convert_from_file_value<V>(file_value));
+                });
+  }
+}
+
+template <typename K, typename V>
+template <typename Callback>
+void KevaLite<K, V>::scan_prefix(const K& prefix, Callback callback) {
+  static_assert(HAS_STRING_KEYS, "Only string keys can be scanned by prefix.");
+  _db_manager.scan_prefix(prefix, [&](const std::string& key, const FileValue& file_value) {
+    callback(key, convert_from_file_value<V>(file_value));
+  });
+}
+
+template <typename K, typename V>
+template <typename Iterator>
+void KevaLite<K, V>::bulk_load(Iterator begin, Iterator end, double fill_factor) {
+  using Entry = std::conditional_t<HAS_STRING_KEYS, StringBulkLoadEntry, BulkLoadEntry>;
+  const auto num_entries = static_cast<uint64_t>(std::distance(begin, end));
+  const auto by_db_key = [](const auto& lhs, const auto& rhs) { return _to_db_key(lhs.first) < _to_db_key(rhs.first); };
+
+  if (std::is_sorted(begin, end, by_db_key)) {
+    auto entry_it = begin;
+    _db_manager.bulk_load(num_entries,
+                          [&]() {
+                            const auto& entry = *entry_it++;
+                            return Entry{_to_db_key(entry.first), convert_to_file_value(entry.second)};
+                          },
+                          fill_factor);
+    return;
+  }
+
+  // Sort references to the entries instead of copying all values
+  std::vector<Iterator> sorted_entries;
+  sorted_entries.reserve(num_entries);
+  for (auto entry_it = begin; entry_it != end; ++entry_it) sorted_entries.push_back(entry_it);
+  std::sort(sorted_entries.begin(), sorted_entries.end(),
+            [&](const Iterator lhs, const Iterator rhs) { return by_db_key(*lhs, *rhs); });
+
+  auto sorted_it = sorted_entries.cbegin();
+  _db_manager.bulk_load(num_entries,
+                        [&]() {
+                          const auto& entry = **sorted_it++;
+                          return Entry{_to_db_key(entry.first), convert_to_file_value(entry.second)};
+                        },
+                        fill_factor);
+}
+
+template <typename K, typename V>
+void KevaLite<K, V>::compact(const std::string& dest_file_name, double fill_factor) const {
+  _db_manager.compact(dest_file_name, fill_factor);
 }
 
 }  // namespace keva
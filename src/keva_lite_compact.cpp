@@ -0,0 +1,60 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "db_manager.hpp"
+#include "string_db_manager.hpp"
+
+using namespace keva;
+
+namespace {
+
+uint64_t file_size(const std::string& file_name) {
+  std::ifstream file{file_name, std::ios::binary | std::ios::ate};
+  return static_cast<uint64_t>(file.tellg());
+}
+
+}  // namespace
+
+// Rewrites a database into a new file with all leaves and values in key order and without free space
+int main(int argc, char* argv[]) {
+  if (argc < 3 || argc > 4) {
+    std::cerr << "Usage: " << argv[0] << " <source file> <destination file> [fill factor]" << std::endl;
+    return 1;
+  }
+
+  const std::string source_file_name = argv[1];
+  const std::string dest_file_name = argv[2];
+
+  try {
+    const auto fill_factor = argc == 4 ? std::stod(argv[3]) : 1.0;
+    const auto db_header = FileManager::read_db_header(source_file_name);
+
+    // Transactions that are only committed to the log have to be recovered before the tree is read
+    DBOptions options;
+    options.enable_wal = std::ifstream{source_file_name + "-wal"}.good();
+    options.enable_value_log = ValueLog::exists(source_file_name + "-vlog");
+    options.copy_on_write = (db_header.flags & COPY_ON_WRITE_FLAG) != 0;
+
+    // Trees with string keys have no fixed number of keys per node
+    uint64_t num_entries;
+    if (db_header.keys_per_node == 0) {
+      StringDBManager db_manager{source_file_name, db_header.value_size, options};
+      num_entries = db_manager.num_entries();
+      db_manager.compact(dest_file_name, fill_factor);
+    } else {
+      const NodeLayout node_layout{db_header.keys_per_node, db_header.key_size};
+      DBManager db_manager{source_file_name, db_header.value_size, node_layout, options};
+      num_entries = db_manager.num_entries();
+      db_manager.compact(dest_file_name, fill_factor);
+    }
+
+    std::cout << "Compacted " << num_entries << " entries from " << file_size(source_file_name) << " to "
+              << file_size(dest_file_name) << " bytes." << std::endl;
+  } catch (const std::exception& exception) {
+    std::cerr << "Compaction failed: " << exception.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "types.hpp"
+
+namespace keva {
+
+// Encodes keys as FileKeys so that the FileKeys are ordered like the keys: lhs < rhs if and only if
+// encode(lhs) < encode(rhs). Scans and bulk loads therefore follow the natural order of the key type. Each codec
+// only uses the lowest BITS bits of the FileKey, so codecs can be packed into a composite key.
+//
+// - Unsigned integers are stored as they are.
+// - Signed integers have their sign bit flipped, so negative keys come before all non-negative keys.
+// - Floating-point keys have their sign bit flipped if they are non-negative and all bits flipped if they are negative,
+//   so the IEEE 754 bits order like the numbers. -0.0 comes right before 0.0, NaNs come before (negative sign) or after
+//   (positive sign) all other keys.
+// - std::pair and std::tuple keys are packed with their first element in the highest bits, so they are ordered
+//   lexicographically like std::tuple. All elements together must fit into 64 bits, e.g. (uint32_t, int32_t).
+template <typename T, typename = void>
+struct KeyCodec {
+  static_assert(std::is_integral_v<T>, "There is no order-preserving key codec for this key type.");
+};
+
+template <typename T>
+struct KeyCodec<T, std::enable_if_t<std::is_integral_v<T>>> {
+  using Unsigned = std::make_unsigned_t<T>;
+  static constexpr uint32_t BITS = sizeof(T) * 8;
+  static constexpr Unsigned SIGN_FLIP = std::is_signed_v<T> ? Unsigned{1} << (BITS - 1) : Unsigned{0};
+
+  static FileKey encode(const T key) { return static_cast<Unsigned>(static_cast<Unsigned>(key) ^ SIGN_FLIP); }
+  static T decode(const FileKey file_key) { return static_cast<T>(static_cast<Unsigned>(file_key) ^ SIGN_FLIP); }
+};
+
+template <typename T>
+struct KeyCodec<T, std::enable_if_t<std::is_enum_v<T>>> {
+  using Underlying = std::underlying_type_t<T>;
+  static constexpr uint32_t BITS = KeyCodec<Underlying>::BITS;
+
+  static FileKey encode(const T key) { return KeyCodec<Underlying>::encode(static_cast<Underlying>(key)); }
+  static T decode(const FileKey file_key) { return static_cast<T>(KeyCodec<Underlying>::decode(file_key)); }
+};
+
+template <typename T>
+struct KeyCodec<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+  static_assert(std::numeric_limits<T>::is_iec559 && (sizeof(T) == 4 || sizeof(T) == 8),
+                "Only IEEE 754 float and double keys are supported.");
+  using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+  static constexpr uint32_t BITS = sizeof(T) * 8;
+  static constexpr Bits SIGN_BIT = Bits{1} << (BITS - 1);
+
+  static FileKey encode(const T key) {
+    Bits bits;
+    std::memcpy(&bits, &key, sizeof(bits));
+    return (bits & SIGN_BIT) ? static_cast<Bits>(~bits) : static_cast<Bits>(bits | SIGN_BIT);
+  }
+
+  static T decode(const FileKey file_key) {
+    const auto encoded = static_cast<Bits>(file_key);
+    const auto bits = (encoded & SIGN_BIT) ? static_cast<Bits>(encoded & ~SIGN_BIT) : static_cast<Bits>(~encoded);
+    T key;
+    std::memcpy(&key, &bits, sizeof(key));
+    return key;
+  }
+};
+
+template <typename... Ts>
+struct KeyCodec<std::tuple<Ts...>> {
+  static constexpr uint32_t BITS = (KeyCodec<Ts>::BITS + ...);
+  static_assert(BITS <= 64, "Composite keys must fit into 64 bits.");
+
+  static FileKey encode(const std::tuple<Ts...>& key) { return _encode(key, std::index_sequence_for<Ts...>{}); }
+  static std::tuple<Ts...> decode(const FileKey file_key) {
+    return _decode(file_key, std::index_sequence_for<Ts...>{});
+  }
+
+ protected:
+  // Shifting a FileKey by 64 bits is undefined, which happens for a tuple with a single 64-bit element
+  static constexpr FileKey _shift_left(const FileKey file_key, const uint32_t bits) {
+    return bits >= 64 ? 0 : file_key << bits;
+  }
+
+  static constexpr FileKey _shift_right(const FileKey file_key, const uint32_t bits) {
+    return bits >= 64 ? 0 : file_key >> bits;
+  }
+
+  static constexpr FileKey _low_bits(const FileKey file_key, const uint32_t bits) {
+    return file_key & ~_shift_left(~FileKey{0}, bits);
+  }
+
+  template <size_t... Is>
+  static FileKey _encode(const std::tuple<Ts...>& key, std::index_sequence<Is...>) {
+    auto file_key = FileKey{0};
+    ((file_key = _shift_left(file_key, KeyCodec<Ts>::BITS) |
+                 _low_bits(KeyCodec<Ts>::encode(std::get<Is>(key)), KeyCodec<Ts>::BITS)),
+     ...);
+    return file_key;
+  }
+
+  template <size_t... Is>
+  static std::tuple<Ts...> _decode(const FileKey file_key, std::index_sequence<Is...>) {
+    // Element i is stored behind (i.e. above) the bits of all later elements
+    constexpr uint32_t element_bits[] = {KeyCodec<Ts>::BITS...};
+    const auto shift = [&](const size_t index) {
+      auto bits = uint32_t{0};
+      for (auto i = index + 1; i < sizeof...(Ts); ++i) bits += element_bits[i];
+      return bits;
+    };
+    return std::tuple<Ts...>{
+        KeyCodec<Ts>::decode(_low_bits(_shift_right(file_key, shift(Is)), KeyCodec<Ts>::BITS))...};
+  }
+};
+
+template <typename First, typename Second>
+struct KeyCodec<std::pair<First, Second>> {
+  static constexpr uint32_t BITS = KeyCodec<std::tuple<First, Second>>::BITS;
+
+  static FileKey encode(const std::pair<First, Second>& key) {
+    return KeyCodec<std::tuple<First, Second>>::encode(std::tuple<First, Second>{key.first, key.second});
+  }
+
+  static std::pair<First, Second> decode(const FileKey file_key) {
+    const auto [first, second] = KeyCodec<std::tuple<First, Second>>::decode(file_key);
+    return {first, second};
+  }
+};
+
+// Keys of up to 32 bits are stored with 4 bytes in the node pages, so more of them fit into a node (see NodeLayout)
+template <typename KeyType>
+constexpr uint16_t file_key_size() {
+  return KeyCodec<KeyType>::BITS <= 32 ? sizeof(uint32_t) : sizeof(FileKey);
+}
+
+template <typename KeyType>
+inline FileKey convert_to_file_key(const KeyType& key) {
+  return KeyCodec<KeyType>::encode(key);
+}
+
+template <typename KeyType>
+inline KeyType convert_from_file_key(const FileKey file_key) {
+  return KeyCodec<KeyType>::decode(file_key);
+}
+
+}  // namespace keva
@@ -0,0 +1,225 @@
+#include "key_search.hpp"
+
+#include <cstring>
+#include <limits>
+
+#include "utils.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define KEVA_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define KEVA_X86_KERNELS 0
+#endif
+
+namespace {
+
+using namespace keva;
+
+template <typename Key>
+using CountLessFunction = uint16_t (*)(const char*, uint16_t, Key);
+
+template <typename Key>
+Key load_key(const char* keys, const uint16_t index) {
+  Key key;
+  std::memcpy(&key, keys + index * sizeof(Key), sizeof(Key));
+  return key;
+}
+
+// Halves the search range until at most max_window keys are left. The comparison result selects the next range
+// without a branch, so there are no mispredictions. Returns the first key of the remaining range and updates num_keys.
+template <typename Key>
+const char* narrow_search_range(const char* keys, uint16_t& num_keys, const Key key, const uint16_t max_window) {
+  while (num_keys > max_window) {
+    const auto half = static_cast<uint16_t>(num_keys / 2);
+    keys = load_key<Key>(keys, half - 1) < key ? keys + half * sizeof(Key) : keys;
+    num_keys = static_cast<uint16_t>(num_keys - half);
+  }
+  return keys;
+}
+
+template <typename Key>
+uint16_t count_less_scalar(const char* keys, uint16_t num_keys, const Key key) {
+  const auto* window = narrow_search_range(keys, num_keys, key, 1);
+  const auto window_begin = (window - keys) / sizeof(Key);
+  return static_cast<uint16_t>(window_begin + (num_keys == 1 && load_key<Key>(window, 0) < key));
+}
+
+#if KEVA_X86_KERNELS
+
+// AVX2 only has signed comparisons, so both sides are shifted into the signed range by flipping the sign bit
+__attribute__((target("avx2,popcnt"))) uint16_t count_less_avx2(const char* node_keys, uint16_t num_keys,
+                                                                  const uint64_t key) {
+  const auto* keys = narrow_search_range(node_keys, num_keys, key, 16);
+  const auto sign_bit = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+  const auto search_key = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(key)), sign_bit);
+
+  uint32_t count = 0;
+  uint16_t i = 0;
+  for (; i + 4 <= num_keys; i += 4) {
+    const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i * sizeof(uint64_t)));
+    const auto is_less = _mm256_cmpgt_epi64(search_key, _mm256_xor_si256(block, sign_bit));
+    count += _mm_popcnt_u32(static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(is_less))));
+  }
+
+  for (; i < num_keys; ++i) count += load_key<uint64_t>(keys, i) < key;
+  return static_cast<uint16_t>((keys - node_keys) / sizeof(uint64_t) + count);
+}
+
+__attribute__((target("avx2,popcnt"))) uint16_t count_less_avx2(const char* node_keys, uint16_t num_keys,
+                                                                  const uint32_t key) {
+  const auto* keys = narrow_search_range(node_keys, num_keys, key, 32);
+  const auto sign_bit = _mm256_set1_epi32(std::numeric_limits<int32_t>::min());
+  const auto search_key = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(key)), sign_bit);
+
+  uint32_t count = 0;
+  uint16_t i = 0;
+  for (; i + 8 <= num_keys; i += 8) {
+    const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i * sizeof(uint32_t)));
+    const auto is_less = _mm256_cmpgt_epi32(search_key, _mm256_xor_si256(block, sign_bit));
+    count += _mm_popcnt_u32(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(is_less))));
+  }
+
+  for (; i < num_keys; ++i) count += load_key<uint32_t>(keys, i) < key;
+  return static_cast<uint16_t>((keys - node_keys) / sizeof(uint32_t) + count);
+}
+
+__attribute__((target("avx512f,popcnt"))) uint16_t count_less_avx512(const char* node_keys, uint16_t num_keys,
+                                                                      const uint64_t key) {
+  const auto* keys = narrow_search_range(node_keys, num_keys, key, 32);
+  const auto search_key = _mm512_set1_epi64(static_cast<int64_t>(key));
+
+  uint32_t count = 0;
+  for (uint16_t i = 0; i < num_keys; i += 8) {
+    // The last block is loaded with a mask, so no key behind the array is read
+    const auto remaining = static_cast<uint32_t>(num_keys - i);
+    const auto load_mask = static_cast<__mmask8>(remaining >= 8 ? 0xFF : (1u << remaining) - 1);
+    const auto block = _mm512_maskz_loadu_epi64(load_mask, keys + i * sizeof(uint64_t));
+    count += _mm_popcnt_u32(_mm512_mask_cmplt_epu64_mask(load_mask, block, search_key));
+  }
+
+  return static_cast<uint16_t>((keys - node_keys) / sizeof(uint64_t) + count);
+}
+
+__attribute__((target("avx512f,popcnt"))) uint16_t count_less_avx512(const char* node_keys, uint16_t num_keys,
+                                                                      const uint32_t key) {
+  const auto* keys = narrow_search_range(node_keys, num_keys, key, 64);
+  const auto search_key = _mm512_set1_epi32(static_cast<int32_t>(key));
+
+  uint32_t count = 0;
+  for (uint16_t i = 0; i < num_keys; i += 16) {
+    const auto remaining = static_cast<uint32_t>(num_keys - i);
+    const auto load_mask = static_cast<__mmask16>(remaining >= 16 ? 0xFFFF : (1u << remaining) - 1);
+    const auto block = _mm512_maskz_loadu_epi32(load_mask, keys + i * sizeof(uint32_t));
+    count += _mm_popcnt_u32(_mm512_mask_cmplt_epu32_mask(load_mask, block, search_key));
+  }
+
+  return static_cast<uint16_t>((keys - node_keys) / sizeof(uint32_t) + count);
+}
+
+#endif
+
+template <typename Key>
+CountLessFunction<Key> count_less_function(const KeySearchKernel kernel) {
+  switch (kernel) {
+#if KEVA_X86_KERNELS
+    case KeySearchKernel::AVX512:
+      return count_less_avx512;
+    case KeySearchKernel::AVX2:
+      return count_less_avx2;
+#endif
+    default:
+      return count_less_scalar<Key>;
+  }
+}
+
+KeySearchKernel detect_key_search_kernel() {
+  if (key_search_kernel_is_supported(KeySearchKernel::AVX512)) return KeySearchKernel::AVX512;
+  if (key_search_kernel_is_supported(KeySearchKernel::AVX2)) return KeySearchKernel::AVX2;
+  return KeySearchKernel::Scalar;
+}
+
+const KeySearchKernel ACTIVE_KERNEL = detect_key_search_kernel();
+const CountLessFunction<uint64_t> ACTIVE_COUNT_LESS = count_less_function<uint64_t>(ACTIVE_KERNEL);
+const CountLessFunction<uint32_t> ACTIVE_COUNT_LESS_32 = count_less_function<uint32_t>(ACTIVE_KERNEL);
+
+// A search key that is wider than the keys is greater than all of them
+template <typename Key>
+uint16_t lower_bound_with(const CountLessFunction<Key> count_less, const char* keys, const uint16_t num_keys,
+                          const FileKey key) {
+  if constexpr (sizeof(Key) < sizeof(FileKey)) {
+    if (key > std::numeric_limits<Key>::max()) return num_keys;
+  }
+  return count_less(keys, num_keys, static_cast<Key>(key));
+}
+
+template <typename Key>
+uint16_t upper_bound_with(const CountLessFunction<Key> count_less, const char* keys, const uint16_t num_keys,
+                          const FileKey key) {
+  // keys <= key are exactly the keys < key + 1
+  if (key >= std::numeric_limits<Key>::max()) return num_keys;
+  return count_less(keys, num_keys, static_cast<Key>(key + 1));
+}
+
+}  // namespace
+
+namespace keva {
+
+KeySearchKernel active_key_search_kernel() { return ACTIVE_KERNEL; }
+
+bool key_search_kernel_is_supported(const KeySearchKernel kernel) {
+  switch (kernel) {
+#if KEVA_X86_KERNELS
+    case KeySearchKernel::AVX512:
+      return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt");
+    case KeySearchKernel::AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+    case KeySearchKernel::Scalar:
+      return true;
+    default:
+      return false;
+  }
+}
+
+uint16_t keys_lower_bound(const void* keys, const uint16_t num_keys, const FileKey key) {
+  return lower_bound_with(ACTIVE_COUNT_LESS, static_cast<const char*>(keys), num_keys, key);
+}
+
+uint16_t keys_upper_bound(const void* keys, const uint16_t num_keys, const FileKey key) {
+  return upper_bound_with(ACTIVE_COUNT_LESS, static_cast<const char*>(keys), num_keys, key);
+}
+
+uint16_t keys_lower_bound(const void* keys, const uint16_t num_keys, const FileKey key,
+                          const KeySearchKernel kernel) {
+  Assert(key_search_kernel_is_supported(kernel), "Key search kernel is not supported by this CPU.");
+  return lower_bound_with(count_less_function<uint64_t>(kernel), static_cast<const char*>(keys), num_keys, key);
+}
+
+uint16_t keys_upper_bound(const void* keys, const uint16_t num_keys, const FileKey key,
+                          const KeySearchKernel kernel) {
+  Assert(key_search_kernel_is_supported(kernel), "Key search kernel is not supported by this CPU.");
+  return upper_bound_with(count_less_function<uint64_t>(kernel), static_cast<const char*>(keys), num_keys, key);
+}
+
+uint16_t keys32_lower_bound(const void* keys, const uint16_t num_keys, const FileKey key) {
+  return lower_bound_with(ACTIVE_COUNT_LESS_32, static_cast<const char*>(keys), num_keys, key);
+}
+
+uint16_t keys32_upper_bound(const void* keys, const uint16_t num_keys, const FileKey key) {
+  return upper_bound_with(ACTIVE_COUNT_LESS_32, static_cast<const char*>(keys), num_keys, key);
+}
+
+uint16_t keys32_lower_bound(const void* keys, const uint16_t num_keys, const FileKey key,
+                            const KeySearchKernel kernel) {
+  Assert(key_search_kernel_is_supported(kernel), "Key search kernel is not supported by this CPU.");
+  return lower_bound_with(count_less_function<uint32_t>(kernel), static_cast<const char*>(keys), num_keys, key);
+}
+
+uint16_t keys32_upper_bound(const void* keys, const uint16_t num_keys, const FileKey key,
+                            const KeySearchKernel kernel) {
+  Assert(key_search_kernel_is_supported(kernel), "Key search kernel is not supported by this CPU.");
+  return upper_bound_with(count_less_function<uint32_t>(kernel), static_cast<const char*>(keys), num_keys, key);
+}
+
+}  // namespace keva
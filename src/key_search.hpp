@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include "types.hpp"
+
+namespace keva {
+
+enum class KeySearchKernel : uint8_t { Scalar, AVX2, AVX512 };
+
+// The fastest kernel that the CPU supports. It is detected once and used by all searches without an explicit kernel.
+KeySearchKernel active_key_search_kernel();
+bool key_search_kernel_is_supported(KeySearchKernel kernel);
+
+// Index of the first key that is >= key (resp. > key) in the sorted keys, like std::lower_bound and std::upper_bound.
+// The SIMD kernels compare key against all keys and count the matches, which avoids the unpredictable branches of a
+// binary search for the small key arrays in a node. keys does not need to be aligned, so it can point into a page.
+uint16_t keys_lower_bound(const void* keys, uint16_t num_keys, FileKey key);
+uint16_t keys_upper_bound(const void* keys, uint16_t num_keys, FileKey key);
+
+uint16_t keys_lower_bound(const void* keys, uint16_t num_keys, FileKey key, KeySearchKernel kernel);
+uint16_t keys_upper_bound(const void* keys, uint16_t num_keys, FileKey key, KeySearchKernel kernel);
+
+// Same for arrays of 32-bit keys, which nodes of databases with 4-byte keys use (see DBOptions::key_size). A key that
+// does not fit into 32 bits is greater than all keys.
+uint16_t keys32_lower_bound(const void* keys, uint16_t num_keys, FileKey key);
+uint16_t keys32_upper_bound(const void* keys, uint16_t num_keys, FileKey key);
+
+uint16_t keys32_lower_bound(const void* keys, uint16_t num_keys, FileKey key, KeySearchKernel kernel);
+uint16_t keys32_upper_bound(const void* keys, uint16_t num_keys, FileKey key, KeySearchKernel kernel);
+
+}  // namespace keva
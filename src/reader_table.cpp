@@ -0,0 +1,62 @@
+#include "reader_table.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace keva {
+
+ReaderPin::ReaderPin(ReaderTable& table, const uint32_t slot, const NodeID root_id)
+    : _table(&table), _slot(slot), _root_id(root_id) {}
+
+ReaderPin::ReaderPin(ReaderPin&& other) noexcept
+    : Noncopyable(), _table(other._table), _slot(other._slot), _root_id(other._root_id) {
+  other._table = nullptr;
+}
+
+ReaderPin::~ReaderPin() {
+  if (_table != nullptr) _table->_unpin(_slot);
+}
+
+NodeID ReaderPin::root_id() const { return _root_id; }
+
+ReaderTable::ReaderTable(const NodeID root_id, const uint32_t num_slots)
+    : _root_id(root_id), _slots(std::make_unique<std::atomic<uint64_t>[]>(num_slots)), _num_slots(num_slots) {
+  Assert(num_slots > 0, "Reader table needs at least one slot.");
+  for (auto slot = 0u; slot < num_slots; ++slot) _slots[slot].store(FREE_SLOT, std::memory_order_relaxed);
+}
+
+uint64_t ReaderTable::publish(const NodeID root_id) {
+  // Readers that see the new version must also see the new root
+  _root_id.store(root_id);
+  const auto version = _version.load(std::memory_order_relaxed) + 1;
+  _version.store(version);
+  return version;
+}
+
+ReaderPin ReaderTable::pin() {
+  // Threads start looking for a free slot at different places, so that they rarely compete for one
+  const auto first_slot = std::hash<std::thread::id>{}(std::this_thread::get_id());
+  while (true) {
+    for (auto i = 0u; i < _num_slots; ++i) {
+      const auto slot = static_cast<uint32_t>((first_slot + i) % _num_slots);
+      auto free_slot = FREE_SLOT;
+      if (_slots[slot].load(std::memory_order_relaxed) != FREE_SLOT) continue;
+      if (!_slots[slot].compare_exchange_strong(free_slot, _version.load())) continue;
+
+      // A writer that has not seen the pin yet has already published the root that is read here
+      return ReaderPin{*this, slot, _root_id.load()};
+    }
+    std::this_thread::yield();
+  }
+}
+
+uint64_t ReaderTable::oldest_pinned_version() const {
+  auto oldest_version = FREE_SLOT;
+  for (auto slot = 0u; slot < _num_slots; ++slot) oldest_version = std::min(oldest_version, _slots[slot].load());
+  return oldest_version;
+}
+
+void ReaderTable::_unpin(const uint32_t slot) { _slots[slot].store(FREE_SLOT, std::memory_order_release); }
+
+}  // namespace keva
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+class ReaderTable;
+
+// A reader's pin on a version of a copy-on-write tree. The pages of its root and everything below stay unchanged until
+// the pin is destroyed.
+class ReaderPin : public Noncopyable {
+ public:
+  ReaderPin(ReaderTable& table, uint32_t slot, NodeID root_id);
+  ReaderPin(ReaderPin&& other) noexcept;
+  ReaderPin& operator=(ReaderPin&& other) = delete;
+  ~ReaderPin();
+
+  NodeID root_id() const;
+
+ protected:
+  ReaderTable* _table;
+  uint32_t _slot;
+  NodeID _root_id;
+};
+
+// Roots of a copy-on-write tree that readers are using, similar to the reader table of LMDB. The writer publishes each
+// new root with the next version. A reader stores the current version in a free slot and only then reads the current
+// root, which is therefore at least as new as the version in the slot. Pages that a commit replaced may be reused once
+// all slots hold that commit's version or a later one.
+class ReaderTable : public Noncopyable {
+ public:
+  explicit ReaderTable(NodeID root_id, uint32_t num_slots = DEFAULT_NUM_READER_SLOTS);
+
+  // Only called by the writer. Returns the version of the new root.
+  uint64_t publish(NodeID root_id);
+
+  // Waits for a free slot if all of them are taken
+  ReaderPin pin();
+
+  // Smallest version that a reader pinned, the maximum value if there is no reader
+  uint64_t oldest_pinned_version() const;
+
+ protected:
+  friend class ReaderPin;
+
+  static const uint64_t FREE_SLOT = std::numeric_limits<uint64_t>::max();
+
+  void _unpin(uint32_t slot);
+
+  std::atomic<NodeID> _root_id;
+  std::atomic<uint64_t> _version{0};
+  std::unique_ptr<std::atomic<uint64_t>[]> _slots;
+  const uint32_t _num_slots;
+};
+
+}  // namespace keva
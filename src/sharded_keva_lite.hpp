@@ -0,0 +1,349 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "keva_lite.hpp"
+
+namespace keva {
+
+// Splits the keys of a database across num_shards independent KevaLite files <db_file_name>-shard<i> by the hash of
+// their key. Each shard has its own thread that runs all operations on it in the order they were queued, so writes to
+// different shards run in parallel and callers on many threads never write a shard at the same time. Batches,
+// multi_gets, scans and bulk loads are split by shard, run on all shard threads at once and their results are gathered.
+// A write batch is atomic per shard, but not across shards. If the shards are opened with DBOptions::concurrent or
+// copy_on_write, which allow readers next to the writer, gets run on the calling thread instead of waiting in the
+// queue. The number of shards must be the same every time the database is opened.
+template <typename K, typename V>
+class ShardedKevaLite : public Noncopyable {
+  static constexpr bool HAS_STRING_KEYS = std::is_same_v<K, std::string>;
+
+ public:
+  ShardedKevaLite(const std::string& db_file_name, uint32_t num_shards, DBOptions options = {});
+
+  // Puts and removes that are split by shard once the batch is written
+  class WriteBatch {
+   public:
+    void put(const K& key, const V& value) { _changes.emplace_back(key, value); }
+    void remove(const K& key) { _changes.emplace_back(key, std::nullopt); }
+    void clear() { _changes.clear(); }
+
+    uint64_t size() const { return _changes.size(); }
+
+   protected:
+    friend class ShardedKevaLite;
+
+    // Removed keys have no value
+    std::vector<std::pair<K, std::optional<V>>> _changes;
+  };
+
+  V get(const K& key);
+
+  // Returns the values of all keys in the same order. Keys that do not exist have no value. The keys of each shard are
+  // looked up with one multi_get on its thread.
+  std::vector<std::optional<V>> multi_get(const std::vector<K>& keys);
+
+  void put(const K& key, const V& value);
+  void remove(const K& key);
+
+  // update throws if the key does not exist, upsert inserts it
+  void update(const K& key, const V& value);
+  void upsert(const K& key, const V& value);
+
+  // Applies the changes of each shard atomically, all shards in parallel
+  void write(const WriteBatch& batch);
+
+  // Not for string keys, see KevaLite::merge_underfull_nodes
+  void merge_underfull_nodes();
+
+  // Calls callback(key, value) for all entries with lower <= key <= upper in ascending order, like KevaLite::scan. All
+  // shards are scanned at once and their entries are merged on the calling thread.
+  template <typename Callback>
+  void scan(const K& lower, const K& upper, Callback callback);
+
+  // Fills an empty database with the std::pair<K, V> entries in [begin, end), see KevaLite::bulk_load
+  template <typename Iterator>
+  void bulk_load(Iterator begin, Iterator end, double fill_factor = 1.0);
+
+  uint32_t num_shards() const;
+
+  static std::string shard_file_name(const std::string& db_file_name, uint32_t shard_id);
+
+  // Shard that stores key. Only depends on the key's bytes, so the same with every compiler and standard library.
+  static uint32_t shard_of(const K& key, uint32_t num_shards);
+
+ protected:
+  // The database of a shard and the thread that runs all tasks on it
+  class Shard : public Noncopyable {
+   public:
+    Shard(std::string db_file_name, DBOptions options)
+        : _db(std::move(db_file_name), options), _thread([this]() { _run(); }) {}
+
+    // Runs the tasks that are still queued before it returns
+    ~Shard() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _is_stopping = true;
+      }
+      _has_tasks.notify_one();
+      _thread.join();
+    }
+
+    // The future throws what the task threw
+    std::future<void> submit(std::function<void(KevaLite<K, V>&)> task) {
+      std::packaged_task<void()> queued_task{[this, task = std::move(task)]() { task(_db); }};
+      auto result = queued_task.get_future();
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(queued_task));
+      }
+      _has_tasks.notify_one();
+      return result;
+    }
+
+    // Only for reads that may run concurrently with the shard's writes
+    KevaLite<K, V>& db() { return _db; }
+
+   protected:
+    void _run() {
+      while (true) {
+        std::deque<std::packaged_task<void()>> tasks;
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _has_tasks.wait(lock, [&]() { return !_tasks.empty() || _is_stopping; });
+          if (_tasks.empty()) return;
+          tasks.swap(_tasks);
+        }
+        for (auto& task : tasks) task();
+      }
+    }
+
+    KevaLite<K, V> _db;
+
+    std::mutex _mutex;
+    std::condition_variable _has_tasks;
+    std::deque<std::packaged_task<void()>> _tasks;
+    bool _is_stopping = false;
+
+    // Started last, once everything it uses exists
+    std::thread _thread;
+  };
+
+  // Runs task(db) on the shard's thread and waits for it
+  void _run_on_shard(uint32_t shard_id, const std::function<void(KevaLite<K, V>&)>& task);
+
+  // Runs task(shard_id, db) on all shard threads at once and waits until all are done. Rethrows the first error.
+  void _run_on_all_shards(const std::function<void(uint32_t, KevaLite<K, V>&)>& task);
+
+  // Order of the keys in the shards
+  static bool _is_less(const K& lhs, const K& rhs);
+
+  std::vector<std::unique_ptr<Shard>> _shards;
+  bool _reads_bypass_writers;
+};
+
+template <typename K, typename V>
+ShardedKevaLite<K, V>::ShardedKevaLite(const std::string& db_file_name, const uint32_t num_shards,
+                                       const DBOptions options)
+    : _reads_bypass_writers(options.concurrent || options.copy_on_write) {
+  Assert(num_shards > 0, "A sharded database needs at least one shard.");
+
+  // Keys would be looked up in the wrong shard if their number changed
+  const auto exists = [&](const uint32_t shard_id) {
+    return std::ifstream{shard_file_name(db_file_name, shard_id)}.good();
+  };
+  if (exists(0) && (!exists(num_shards - 1) || exists(num_shards))) {
+    throw std::runtime_error("Database '" + db_file_name + "' was created with a different number of shards.");
+  }
+
+  _shards.reserve(num_shards);
+  for (auto shard_id = 0u; shard_id < num_shards; ++shard_id) {
+    _shards.push_back(std::make_unique<Shard>(shard_file_name(db_file_name, shard_id), options));
+  }
+}
+
+template <typename K, typename V>
+std::string ShardedKevaLite<K, V>::shard_file_name(const std::string& db_file_name, const uint32_t shard_id) {
+  return db_file_name + "-shard" + std::to_string(shard_id);
+}
+
+template <typename K, typename V>
+uint32_t ShardedKevaLite<K, V>::num_shards() const {
+  return static_cast<uint32_t>(_shards.size());
+}
+
+template <typename K, typename V>
+uint32_t ShardedKevaLite<K, V>::shard_of(const K& key, const uint32_t num_shards) {
+  uint64_t hash;
+  if constexpr (HAS_STRING_KEYS) {
+    hash = fnv1a_hash(key.data(), key.size());
+  } else {
+    // File keys of neighbouring keys only differ in their low bits, multiplying spreads them across all bits
+    hash = (convert_to_file_key(key) * 0x9e3779b97f4a7c15) >> 32;
+  }
+  return static_cast<uint32_t>(hash % num_shards);
+}
+
+template <typename K, typename V>
+bool ShardedKevaLite<K, V>::_is_less(const K& lhs, const K& rhs) {
+  if constexpr (HAS_STRING_KEYS) {
+    return lhs < rhs;
+  } else {
+    return convert_to_file_key(lhs) < convert_to_file_key(rhs);
+  }
+}
+
+template <typename K, typename V>
+void ShardedKevaLite<K, V>::_run_on_shard(const uint32_t shard_id,
+                                          const std::function<void(KevaLite<K, V>&)>& task) {
+  _shards[shard_id]->submit(task).get();
+}
+
+template <typename K, typename V>
+void ShardedKevaLite<K, V>::_run_on_all_shards(const std::function<void(uint32_t, KevaLite<K, V>&)>& task) {
+  std::vector<std::future<void>> results;
+  results.reserve(_shards.size());
+  for (auto shard_id = 0u; shard_id < _shards.size(); ++shard_id) {
+    results.push_back(_shards[shard_id]->submit([&task, shard_id](KevaLite<K, V>& db) { task(shard_id, db); }));
+  }
+
+  // The tasks use the caller's data, so all of them must be done before an error is passed on
+  std::exception_ptr error;
+  for (auto& result : results) {
+    try {
+      result.get();
+    } catch (...) {
+      if (!error) error = std::current_exception();
+    }
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+template <typename K, typename V>
+V ShardedKevaLite<K, V>::get(const K& key) {
+  const auto shard_id = shard_of(key, num_shards());
+  if (_reads_bypass_writers) return _shards[shard_id]->db().get(key);
+
+  std::optional<V> value;
+  _run_on_shard(shard_id, [&](KevaLite<K, V>& db) { value = db.get(key); });
+  return std::move(*value);
+}
+
+template <typename K, typename V>
+std::vector<std::optional<V>> ShardedKevaLite<K, V>::multi_get(const std::vector<K>& keys) {
+  std::vector<std::vector<K>> shard_keys(_shards.size());
+  std::vector<std::vector<uint64_t>> shard_positions(_shards.size());
+  for (auto position = uint64_t{0}; position < keys.size(); ++position) {
+    const auto shard_id = shard_of(keys[position], num_shards());
+    shard_keys[shard_id].push_back(keys[position]);
+    shard_positions[shard_id].push_back(position);
+  }
+
+  // Each shard only writes the positions of its own keys
+  std::vector<std::optional<V>> values(keys.size());
+  _run_on_all_shards([&](const uint32_t shard_id, KevaLite<K, V>& db) {
+    if (shard_keys[shard_id].empty()) return;
+    auto shard_values = db.multi_get(shard_keys[shard_id]);
+    for (auto i = 0u; i < shard_values.size(); ++i) {
+      values[shard_positions[shard_id][i]] = std::move(shard_values[i]);
+    }
+  });
+  return values;
+}
+
+template <typename K, typename V>
+void ShardedKevaLite<K, V>::put(const K& key, const V& value) {
+  _run_on_shard(shard_of(key, num_shards()), [&](KevaLite<K, V>& db) { db.put(key, value); });
+}
+
+template <typename K, typename V>
+void ShardedKevaLite<K, V>::remove(const K& key) {
+  _run_on_shard(shard_of(key, num_shards()), [&](KevaLite<K, V>& db) { db.remove(key); });
+}
+
+template <typename K, typename V>
+void ShardedKevaLite<K, V>::update(const K& key, const V& value) {
+  _run_on_shard(shard_of(key, num_shards()), [&](KevaLite<K, V>& db) { db.update(key, value); });
+}
+
+template <typename K, typename V>
+void ShardedKevaLite<K, V>::upsert(const K& key, const V& value) {
+  _run_on_shard(shard_of(key, num_shards()), [&](KevaLite<K, V>& db) { db.upsert(key, value); });
+}
+
+template <typename K, typename V>
+void ShardedKevaLite<K, V>::write(const WriteBatch& batch) {
+  std::vector<typename KevaLite<K, V>::WriteBatch> shard_batches(_shards.size());
+  for (const auto& [key, value] : batch._changes) {
+    auto& shard_batch = shard_batches[shard_of(key, num_shards())];
+    if (value) {
+      shard_batch.put(key, *value);
+    } else {
+      shard_batch.remove(key);
+    }
+  }
+
+  _run_on_all_shards([&](const uint32_t shard_id, KevaLite<K, V>& db) {
+    if (shard_batches[shard_id].size() > 0) db.write(shard_batches[shard_id]);
+  });
+}
+
+template <typename K, typename V>
+void ShardedKevaLite<K, V>::merge_underfull_nodes() {
+  static_assert(!HAS_STRING_KEYS, "Trees with string keys do not merge nodes.");
+  _run_on_all_shards([](uint32_t, KevaLite<K, V>& db) { db.merge_underfull_nodes(); });
+}
+
+template <typename K, typename V>
+template <typename Callback>
+void ShardedKevaLite<K, V>::scan(const K& lower, const K& upper, Callback callback) {
+  std::vector<std::vector<std::pair<K, V>>> shard_entries(_shards.size());
+  _run_on_all_shards([&](const uint32_t shard_id, KevaLite<K, V>& db) {
+    db.scan(lower, upper, [&](const K& key, const V& value) { shard_entries[shard_id].emplace_back(key, value); });
+  });
+
+  // Each shard's entries are sorted, the heap holds the position of the next entry of each shard
+  using Position = std::pair<uint32_t, uint64_t>;
+  const auto is_later = [&](const Position& lhs, const Position& rhs) {
+    return _is_less(shard_entries[rhs.first][rhs.second].first, shard_entries[lhs.first][lhs.second].first);
+  };
+  std::priority_queue<Position, std::vector<Position>, decltype(is_later)> next_entries{is_later};
+  for (auto shard_id = 0u; shard_id < shard_entries.size(); ++shard_id) {
+    if (!shard_entries[shard_id].empty()) next_entries.emplace(shard_id, 0);
+  }
+
+  while (!next_entries.empty()) {
+    const auto [shard_id, index] = next_entries.top();
+    next_entries.pop();
+    const auto& [key, value] = shard_entries[shard_id][index];
+    callback(key, value);
+    if (index + 1 < shard_entries[shard_id].size()) next_entries.emplace(shard_id, index + 1);
+  }
+}
+
+template <typename K, typename V>
+template <typename Iterator>
+void ShardedKevaLite<K, V>::bulk_load(Iterator begin, Iterator end, const double fill_factor) {
+  std::vector<std::vector<std::pair<K, V>>> shard_entries(_shards.size());
+  for (auto entry_it = begin; entry_it != end; ++entry_it) {
+    shard_entries[shard_of(entry_it->first, num_shards())].emplace_back(entry_it->first, entry_it->second);
+  }
+
+  _run_on_all_shards([&](const uint32_t shard_id, KevaLite<K, V>& db) {
+    db.bulk_load(shard_entries[shard_id].begin(), shard_entries[shard_id].end(), fill_factor);
+  });
+}
+
+}  // namespace keva
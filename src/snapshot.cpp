@@ -0,0 +1,32 @@
+#include "snapshot.hpp"
+
+#include "db_manager.hpp"
+
+namespace keva {
+
+Snapshot::Snapshot(const DBManager& db_manager, std::shared_ptr<const ReaderPin> pin)
+    : _db_manager(&db_manager), _pin(std::move(pin)) {
+  Assert(_pin, "Snapshot needs a pinned root.");
+}
+
+FileValue Snapshot::get(const FileKey key) const { return _db_manager->_get(key, _pin->root_id()); }
+
+std::vector<FileValue> Snapshot::multi_get(const std::vector<FileKey>& keys) const {
+  return _db_manager->_multi_get(keys, _pin->root_id());
+}
+
+void Snapshot::scan(const FileKey lower, const FileKey upper, const ScanCallback& callback,
+                    const uint32_t value_batch_size) const {
+  if (lower > upper) return;
+
+  auto range_cursor = cursor(value_batch_size, upper);
+  for (auto is_valid = range_cursor.seek(lower); is_valid; is_valid = range_cursor.next()) {
+    callback(range_cursor.key(), range_cursor.value());
+  }
+}
+
+Cursor Snapshot::cursor(const uint32_t value_batch_size, const FileKey upper_bound) const {
+  return Cursor{*_db_manager, value_batch_size, upper_bound, _pin};
+}
+
+}  // namespace keva
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "cursor.hpp"
+#include "reader_table.hpp"
+#include "types.hpp"
+
+namespace keva {
+
+class DBManager;
+
+// Read-only view of a copy-on-write tree as it was when the snapshot was taken (see DBManager::snapshot). Writes after
+// that are not visible. Copies of a snapshot and the cursors it creates share its pin, so the pages of its tree are
+// kept until the last of them is destroyed. Snapshots may be used from many threads, but must not outlive the
+// DBManager.
+class Snapshot {
+ public:
+  Snapshot(const DBManager& db_manager, std::shared_ptr<const ReaderPin> pin);
+
+  // Same semantics as the DBManager functions of the same name
+  FileValue get(FileKey key) const;
+  std::vector<FileValue> multi_get(const std::vector<FileKey>& keys) const;
+  void scan(FileKey lower, FileKey upper, const ScanCallback& callback,
+            uint32_t value_batch_size = DEFAULT_SCAN_BATCH_SIZE) const;
+  Cursor cursor(uint32_t value_batch_size = DEFAULT_SCAN_BATCH_SIZE,
+                FileKey upper_bound = std::numeric_limits<FileKey>::max()) const;
+
+ protected:
+  const DBManager* _db_manager;
+  std::shared_ptr<const ReaderPin> _pin;
+};
+
+}  // namespace keva
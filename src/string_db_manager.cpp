@@ -0,0 +1,537 @@
+#include "string_db_manager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+namespace {
+
+using namespace keva;
+
+const DBOptions& check_options(const DBOptions& options) {
+  // Garbage collection of the value log finds the leaf entries of values by fixed-size keys
+  Assert(!options.enable_value_log, "The value log is not supported for string keys.");
+  Assert(!options.concurrent, "Concurrent trees are not supported for string keys.");
+  Assert(!options.copy_on_write, "Copy-on-write trees are not supported for string keys.");
+  return options;
+}
+
+void check_key_size(const std::string_view key) {
+  if (key.size() > MAX_STRING_KEY_SIZE) {
+    throw std::runtime_error("Key is longer than " + std::to_string(MAX_STRING_KEY_SIZE) + " bytes.");
+  }
+}
+
+}  // namespace
+
+namespace keva {
+
+StringDBManager::StringDBManager(const uint16_t value_size)
+    : _file_manager(value_size, 0), _value_size(value_size) {
+  BPNodeHeader root_header{};
+  root_header.node_id = _file_manager.get_next_node_position();
+  root_header.is_leaf = true;
+  _set_root(StringNode{root_header, {}, {}});
+  _file_manager.commit();
+}
+
+StringDBManager::StringDBManager(std::string db_file_name, const uint16_t value_size, DBOptions options)
+    : _file_manager(std::move(db_file_name), value_size, 0, check_options(options)), _value_size(value_size) {
+  // Existing database, continue with the stored tree
+  if (!_file_manager.is_new_db()) {
+    _root_id = _file_manager.db_header().root_offset;
+    NodePage page_buffer;
+    const auto page_size = _file_manager.page_size();
+    std::memcpy(_root_page.data(page_size), _file_manager.view_page(_root_id, page_buffer), page_size);
+    return;
+  }
+
+  BPNodeHeader root_header{};
+  root_header.node_id = _file_manager.get_next_node_position();
+  root_header.is_leaf = true;
+  _set_root(StringNode{root_header, {}, {}});
+  _file_manager.commit();
+}
+
+FileValue StringDBManager::get(const std::string_view key) const {
+  const auto value_slot = _find_value_slot(key);
+  return value_slot ? _file_manager.get_value(*value_slot) : FileValue();
+}
+
+std::vector<FileValue> StringDBManager::multi_get(const std::vector<std::string>& keys) const {
+  std::vector<uint32_t> found_keys;
+  std::vector<FileOffset> found_slots;
+  for (auto i = 0u; i < keys.size(); ++i) {
+    const auto value_slot = _find_value_slot(keys[i]);
+    if (!value_slot) continue;
+    found_keys.push_back(i);
+    found_slots.push_back(*value_slot);
+  }
+
+  _file_manager.prefetch_values(found_slots);
+  auto found_values = _file_manager.get_values(found_slots);
+  std::vector<FileValue> values(keys.size());
+  for (auto i = 0u; i < found_keys.size(); ++i) values[found_keys[i]] = std::move(found_values[i]);
+  return values;
+}
+
+void StringDBManager::scan(const std::string_view lower, const std::string_view upper,
+                           const StringScanCallback& callback, const uint32_t value_batch_size) const {
+  if (lower > upper) return;
+  _scan(lower, [&](const std::string_view key) { return key <= upper; }, callback, value_batch_size);
+}
+
+void StringDBManager::scan_prefix(const std::string_view prefix, const StringScanCallback& callback,
+                                  const uint32_t value_batch_size) const {
+  _scan(prefix, [&](const std::string_view key) { return key.substr(0, prefix.size()) == prefix; }, callback,
+        value_batch_size);
+}
+
+void StringDBManager::_scan(const std::string_view lower, const std::function<bool(std::string_view)>& is_in_range,
+                            const StringScanCallback& callback, const uint32_t value_batch_size) const {
+  std::vector<std::string> keys;
+  std::vector<FileOffset> value_slots;
+  const auto read_batch = [&]() {
+    _file_manager.prefetch_values(value_slots);
+    const auto values = _file_manager.get_values(value_slots);
+    for (auto i = 0u; i < keys.size(); ++i) callback(keys[i], values[i]);
+    keys.clear();
+    value_slots.clear();
+  };
+
+  NodePage page_buffer;
+  auto leaf_id = _find_leaf(lower);
+  auto is_first_leaf = true;
+  while (leaf_id != InvalidNodeID) {
+    const StringNodeView leaf{_view_node(leaf_id, page_buffer)};
+    auto position = is_first_leaf ? leaf.lower_bound(lower) : uint16_t{0};
+    auto is_range_end = false;
+    for (; position < leaf.num_keys(); ++position) {
+      auto key = leaf.key(position);
+      if (!is_in_range(key)) {
+        is_range_end = true;
+        break;
+      }
+      keys.push_back(std::move(key));
+      value_slots.push_back(leaf.value_slot(position));
+    }
+
+    leaf_id = is_range_end ? InvalidNodeID : leaf.next_leaf();
+    is_first_leaf = false;
+
+    // The values are only read after the leaf, as reading them can invalidate its page
+    if (keys.size() >= value_batch_size || leaf_id == InvalidNodeID) read_batch();
+  }
+}
+
+void StringDBManager::put(const std::string_view key, const FileValue& value) {
+  _put(key, value);
+  _file_manager.commit();
+}
+
+void StringDBManager::update(const std::string_view key, const FileValue& value) {
+  if (!_update(key, value)) throw std::runtime_error("Key '" + std::string(key) + "' does not exist.");
+  _file_manager.commit();
+}
+
+void StringDBManager::upsert(const std::string_view key, const FileValue& value) {
+  if (!_update(key, value)) _put(key, value);
+  _file_manager.commit();
+}
+
+void StringDBManager::remove(const std::string_view key) {
+  if (!_remove(key)) return;
+  _file_manager.commit();
+}
+
+void StringDBManager::_put(const std::string_view key, const FileValue& value) {
+  DebugAssert(value.size() == _value_size || _value_size == 0,
+              "Cannot insert value with different size than specified!");
+  check_key_size(key);
+
+  Path path;
+  auto leaf = _load_leaf(key, path);
+  const auto position = leaf.lower_bound(key);
+  if (position < leaf.keys().size() && leaf.keys()[position] == key) {
+    throw std::runtime_error("Key '" + std::string(key) + "' already exists.");
+  }
+
+  leaf.insert(position, std::string(key), _file_manager.insert_value(value));
+  const auto is_append = leaf.header().next_leaf == InvalidNodeID && position + 1u == leaf.keys().size();
+  _write_node_with_splits(std::move(leaf), path, is_append);
+}
+
+bool StringDBManager::_update(const std::string_view key, const FileValue& value) {
+  DebugAssert(value.size() == _value_size || _value_size == 0,
+              "Cannot insert value with different size than specified!");
+
+  NodePage page_buffer;
+  const auto leaf_id = _find_leaf(key);
+  const StringNodeView leaf{_view_node(leaf_id, page_buffer)};
+  const auto value_slot = leaf.find_value(key);
+  if (!value_slot) return false;
+
+  const auto position = leaf.lower_bound(key);
+  const auto new_value_slot = _file_manager.update_value(*value_slot, value);
+  if (new_value_slot == *value_slot) return true;
+
+  // The value did not fit into its old space and was moved
+  auto changed_leaf = StringNode::decode(_view_node(leaf_id, page_buffer));
+  changed_leaf.set_child(position, new_value_slot);
+  _write_node(changed_leaf);
+  return true;
+}
+
+bool StringDBManager::_remove(const std::string_view key) {
+  NodePage page_buffer;
+  const auto leaf_id = _find_leaf(key);
+  if (!StringNodeView{_view_node(leaf_id, page_buffer)}.find_value(key)) return false;
+
+  auto leaf = StringNode::decode(_view_node(leaf_id, page_buffer));
+  const auto position = leaf.lower_bound(key);
+  _file_manager.free_value(leaf.children()[position]);
+  leaf.erase(position);
+  _write_node(leaf);
+  return true;
+}
+
+void StringDBManager::write(const StringWriteBatch& batch) {
+  const auto& operations = batch.operations();
+
+  // Operations on the same key keep their batch order
+  std::vector<uint32_t> operation_order(operations.size());
+  std::iota(operation_order.begin(), operation_order.end(), 0);
+  std::stable_sort(operation_order.begin(), operation_order.end(), [&](const uint32_t lhs, const uint32_t rhs) {
+    return operations[lhs].key < operations[rhs].key;
+  });
+
+  // Combine all operations on a key into one change. A null value removes the key. Nothing is written before the whole
+  // batch is validated.
+  struct BatchChange {
+    std::string_view key;
+    bool existed;
+    const FileValue* value;
+  };
+  std::vector<BatchChange> changes;
+
+  auto order_index = 0u;
+  while (order_index < operation_order.size()) {
+    const std::string_view key = operations[operation_order[order_index]].key;
+    const auto existed = _find_value_slot(key).has_value();
+    auto exists = existed;
+    const FileValue* value = nullptr;
+
+    for (; order_index < operation_order.size() && operations[operation_order[order_index]].key == key; ++order_index) {
+      const auto& operation = operations[operation_order[order_index]];
+      if (operation.type == WriteType::Remove) {
+        exists = false;
+        value = nullptr;
+        continue;
+      }
+
+      if (exists) throw std::runtime_error("Key '" + std::string(key) + "' already exists.");
+      check_key_size(key);
+      DebugAssert(operation.value.size() == _value_size || _value_size == 0,
+                  "Cannot insert value with different size than specified!");
+      exists = true;
+      value = &operation.value;
+    }
+
+    if (exists || existed) changes.push_back({key, existed, value});
+  }
+
+  if (changes.empty()) return;
+
+  for (const auto& change : changes) {
+    if (!change.value) {
+      _remove(change.key);
+    } else if (change.existed) {
+      _update(change.key, *change.value);
+    } else {
+      _put(change.key, *change.value);
+    }
+  }
+
+  _file_manager.commit();
+}
+
+void StringDBManager::bulk_load(const uint64_t num_entries, const StringBulkLoadEntryGenerator& next_entry,
+                                const double fill_factor) {
+  const StringNodeView root{_root_page.data()};
+  Assert(root.is_leaf() && root.num_keys() == 0, "Can only bulk load into an empty database.");
+  Assert(fill_factor > 0 && fill_factor <= 1, "Fill factor must be in (0, 1].");
+  if (num_entries == 0) return;
+
+  const auto max_node_size = static_cast<uint32_t>(fill_factor * _file_manager.page_size());
+
+  // The new tree is not reachable until the root offset is updated, so it does not need to go through the log
+  _file_manager.begin_unlogged_writes();
+  NodeID root_id;
+  try {
+    root_id = _build_tree(num_entries, next_entry, max_node_size);
+  } catch (...) {
+    _file_manager.end_unlogged_writes();
+    throw;
+  }
+  _file_manager.end_unlogged_writes();
+
+  // The empty root is not needed anymore
+  _file_manager.free_node(_root_id);
+
+  NodePage page_buffer;
+  const auto page_size = _file_manager.page_size();
+  std::memcpy(_root_page.data(page_size), _file_manager.view_page(root_id, page_buffer), page_size);
+  _root_id = root_id;
+  _file_manager.update_root_offset(root_id);
+  _file_manager.commit();
+}
+
+NodeID StringDBManager::_build_tree(const uint64_t num_entries, const StringBulkLoadEntryGenerator& next_entry,
+                                    const uint32_t max_node_size) {
+  // Separator to the previous node and ID of each node of the level that was built last
+  std::vector<std::pair<std::string, NodeID>> level;
+
+  // A leaf is written once the next one is started, so that it can link to it. Each leaf is followed by its values.
+  BPNodeHeader leaf_header{};
+  leaf_header.node_id = _file_manager.get_next_node_position();
+  leaf_header.is_leaf = true;
+  StringNode leaf{leaf_header, {}, {}};
+  std::string leaf_separator;
+  std::string previous_key;
+
+  for (auto entry_index = uint64_t{0}; entry_index < num_entries; ++entry_index) {
+    auto [key, value] = next_entry();
+    check_key_size(key);
+    if (entry_index > 0 && key <= previous_key) throw std::runtime_error("Bulk load keys must be unique and sorted.");
+
+    leaf.insert(static_cast<uint16_t>(leaf.keys().size()), key, InvalidNodeID);
+    if (leaf.keys().size() > 1 && leaf.encoded_size() > max_node_size) {
+      leaf.erase(static_cast<uint16_t>(leaf.keys().size() - 1));
+
+      BPNodeHeader next_header{};
+      next_header.node_id = _file_manager.get_next_node_position();
+      next_header.is_leaf = true;
+      next_header.previous_leaf = leaf.header().node_id;
+      leaf.mutable_header().next_leaf = next_header.node_id;
+
+      _write_node(leaf);
+      level.emplace_back(std::move(leaf_separator), leaf.header().node_id);
+      leaf_separator = shortest_separator(previous_key, key);
+      leaf = StringNode{next_header, {key}, {InvalidNodeID}};
+    }
+
+    leaf.set_child(static_cast<uint16_t>(leaf.keys().size() - 1), _file_manager.insert_value(value));
+    previous_key = std::move(key);
+  }
+
+  _write_node(leaf);
+  level.emplace_back(std::move(leaf_separator), leaf.header().node_id);
+
+  BPNodeHeader internal_header{};
+  internal_header.is_leaf = false;
+  while (level.size() > 1) {
+    std::vector<std::pair<std::string, NodeID>> next_level;
+
+    // The separator of the first child of a node becomes the separator of the node in the next level
+    auto node_separator = std::move(level.front().first);
+    StringNode node{internal_header, {}, {level.front().second}};
+    for (auto child_index = size_t{1}; child_index < level.size(); ++child_index) {
+      auto& [separator, child_id] = level[child_index];
+      node.insert(static_cast<uint16_t>(node.keys().size()), separator, child_id);
+      if (node.keys().size() == 1 || node.encoded_size() <= max_node_size) continue;
+
+      node.erase(static_cast<uint16_t>(node.keys().size() - 1));
+      node.mutable_header().node_id = _file_manager.get_next_node_position();
+      _write_node(node);
+      next_level.emplace_back(std::move(node_separator), node.header().node_id);
+
+      node_separator = std::move(separator);
+      node = StringNode{internal_header, {}, {child_id}};
+    }
+
+    node.mutable_header().node_id = _file_manager.get_next_node_position();
+    _write_node(node);
+    next_level.emplace_back(std::move(node_separator), node.header().node_id);
+    level = std::move(next_level);
+  }
+
+  return level.front().second;
+}
+
+void StringDBManager::compact(const std::string& dest_file_name, const double fill_factor) const {
+  if (std::ifstream{dest_file_name}.good()) {
+    throw std::runtime_error("Compaction target '" + dest_file_name + "' already exists.");
+  }
+
+  // Files of old format versions are converted to the page-aligned format
+  DBOptions compacted_options;
+  compacted_options.page_size = std::max(_file_manager.page_size(), MIN_PAGE_SIZE);
+  StringDBManager compacted_db{dest_file_name, _value_size, compacted_options};
+
+  // The entries are read leaf by leaf, with all values of a leaf at once
+  NodePage page_buffer;
+  auto leaf_id = _find_leaf({});
+  std::vector<std::string> keys;
+  std::vector<FileValue> values;
+  auto entry_index = size_t{0};
+
+  compacted_db.bulk_load(
+      num_entries(),
+      [&]() {
+        while (entry_index == keys.size()) {
+          const StringNodeView leaf{_view_node(leaf_id, page_buffer)};
+          keys.clear();
+          std::vector<FileOffset> value_slots;
+          for (auto position = uint16_t{0}; position < leaf.num_keys(); ++position) {
+            keys.push_back(leaf.key(position));
+            value_slots.push_back(leaf.value_slot(position));
+          }
+          leaf_id = leaf.next_leaf();
+          values = _file_manager.get_values(value_slots);
+          entry_index = 0;
+        }
+
+        StringBulkLoadEntry entry{std::move(keys[entry_index]), std::move(values[entry_index])};
+        ++entry_index;
+
+        // Values are read without their size, which is stored as part of variable sized values
+        if (_value_size == 0) {
+          const auto num_bytes = static_cast<uint32_t>(entry.second.size());
+          const auto* num_bytes_raw = reinterpret_cast<const char*>(&num_bytes);
+          entry.second.insert(entry.second.begin(), num_bytes_raw, num_bytes_raw + sizeof(num_bytes));
+        }
+        return entry;
+      },
+      fill_factor);
+}
+
+uint64_t StringDBManager::num_entries() const {
+  uint64_t num_entries = 0;
+  auto leaf_id = _find_leaf({});
+  while (leaf_id != InvalidNodeID) {
+    const auto leaf_header = _file_manager.load_node_header(leaf_id);
+    num_entries += leaf_header.num_keys;
+    leaf_id = leaf_header.next_leaf;
+  }
+  return num_entries;
+}
+
+uint32_t StringDBManager::height() const {
+  NodePage page_buffer;
+  auto height = uint32_t{1};
+  for (StringNodeView node{_root_page.data()}; !node.is_leaf(); ++height) {
+    node = StringNodeView{_view_node(node.child(0), page_buffer)};
+  }
+  return height;
+}
+
+const FileManager& StringDBManager::get_file_manager() const { return _file_manager; }
+
+const char* StringDBManager::_view_node(const NodeID node_id, NodePage& buffer) const {
+  return node_id == _root_id ? _root_page.data() : _file_manager.view_page(node_id, buffer);
+}
+
+NodeID StringDBManager::_find_leaf(const std::string_view key) const {
+  // Only the ID of the next child is kept from each view, as the page buffer is reused for the next level
+  NodePage page_buffer;
+  auto node_id = _root_id;
+  while (true) {
+    const StringNodeView node{_view_node(node_id, page_buffer)};
+    if (node.is_leaf()) return node_id;
+    node_id = node.find_child(key);
+  }
+}
+
+std::optional<FileOffset> StringDBManager::_find_value_slot(const std::string_view key) const {
+  NodePage page_buffer;
+  StringNodeView node{_root_page.data()};
+  while (!node.is_leaf()) node = StringNodeView{_file_manager.view_page(node.find_child(key), page_buffer)};
+  return node.find_value(key);
+}
+
+StringNode StringDBManager::_load_leaf(const std::string_view key, Path& path) const {
+  // Internal nodes are only decoded if a split reaches them
+  NodePage page_buffer;
+  auto node_id = _root_id;
+  while (true) {
+    const auto* page = _view_node(node_id, page_buffer);
+    const StringNodeView node{page};
+    if (node.is_leaf()) return StringNode::decode(page);
+
+    const auto child_position = node.upper_bound(key);
+    path.emplace_back(node_id, child_position);
+    node_id = node.child(child_position);
+  }
+}
+
+void StringDBManager::_write_node_with_splits(StringNode node, Path& path, bool split_at_end) {
+  while (!node.fits(_file_manager.page_size())) {
+    auto [separator, sibling_id] = _split_node(node, split_at_end);
+
+    // The old root had to be split, so we need a new root
+    if (path.empty()) {
+      BPNodeHeader root_header{};
+      root_header.node_id = _file_manager.get_next_node_position();
+      root_header.is_leaf = false;
+      _set_root(StringNode{root_header, {std::move(separator)}, {node.header().node_id, sibling_id}});
+      return;
+    }
+
+    NodePage page_buffer;
+    const auto [parent_id, child_position] = path.back();
+    auto parent = StringNode::decode(_view_node(parent_id, page_buffer));
+    path.pop_back();
+
+    split_at_end = split_at_end && child_position == parent.keys().size();
+    parent.insert(child_position, std::move(separator), sibling_id);
+    node = std::move(parent);
+  }
+
+  _write_node(node);
+}
+
+std::pair<std::string, NodeID> StringDBManager::_split_node(StringNode& node, const bool split_at_end) {
+  auto [sibling, separator] = node.split(node.split_position(split_at_end, _file_manager.page_size()));
+
+  auto& sibling_header = sibling.mutable_header();
+  sibling_header.node_id = _file_manager.get_next_node_position();
+  if (sibling_header.is_leaf) {
+    auto& node_header = node.mutable_header();
+    sibling_header.previous_leaf = node_header.node_id;
+    sibling_header.next_leaf = node_header.next_leaf;
+    node_header.next_leaf = sibling_header.node_id;
+
+    // Update next leaf's previous pointer. Node formats share the header, so it can be written on its own.
+    if (sibling_header.next_leaf != InvalidNodeID) {
+      auto next_leaf_header = _file_manager.load_node_header(sibling_header.next_leaf);
+      next_leaf_header.previous_leaf = sibling_header.node_id;
+      _file_manager.write_node_header(next_leaf_header);
+    }
+  }
+
+  _write_node(node);
+  _write_node(sibling);
+  return {std::move(separator), sibling_header.node_id};
+}
+
+void StringDBManager::_write_node(const StringNode& node) {
+  if (node.header().node_id == _root_id) {
+    node.encode(_root_page.data(_file_manager.page_size()), _file_manager.page_size());
+    _file_manager.write_page(_root_id, _root_page.data());
+    return;
+  }
+
+  NodePage page;
+  node.encode(page.data(_file_manager.page_size()), _file_manager.page_size());
+  _file_manager.write_page(node.header().node_id, page.data());
+}
+
+void StringDBManager::_set_root(const StringNode& root) {
+  const auto is_new_root = _root_id != InvalidNodeID;
+  _root_id = root.header().node_id;
+  _write_node(root);
+  if (is_new_root) _file_manager.update_root_offset(_root_id);
+}
+
+}  // namespace keva
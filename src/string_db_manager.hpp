@@ -0,0 +1,114 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "bp_node_view.hpp"
+#include "file_manager.hpp"
+#include "string_node.hpp"
+#include "types.hpp"
+#include "write_batch.hpp"
+
+namespace keva {
+
+using StringScanCallback = std::function<void(const std::string&, const FileValue&)>;
+
+using StringBulkLoadEntry = std::pair<std::string, FileValue>;
+using StringBulkLoadEntryGenerator = std::function<StringBulkLoadEntry()>;
+
+// B+-tree with variable-length keys of up to MAX_STRING_KEY_SIZE bytes that are ordered bytewise, like std::string.
+// Nodes are slotted pages (see StringNode) that are split when their keys do not fit anymore instead of after a fixed
+// number of keys. Leaves store full keys, internal nodes only the shortest separators between their children. Both
+// store the prefix that all keys of a node share only once.
+//
+// Values are stored by the FileManager just like for DBManager. The file header has keys_per_node = 0, so a file of
+// this tree is never opened as a tree with fixed-size keys and vice versa. Removes do not merge nodes, and the value log
+// is not supported.
+class StringDBManager : public Noncopyable {
+ public:
+  explicit StringDBManager(uint16_t value_size);
+  StringDBManager(std::string db_file_name, uint16_t value_size, DBOptions options = {});
+
+  FileValue get(std::string_view key) const;
+
+  // Returns the values in the order of keys. Values of keys that do not exist are empty. All values are read at once.
+  std::vector<FileValue> multi_get(const std::vector<std::string>& keys) const;
+
+  // Calls callback for all entries with lower <= key <= upper in ascending key order
+  void scan(std::string_view lower, std::string_view upper, const StringScanCallback& callback,
+            uint32_t value_batch_size = DEFAULT_SCAN_BATCH_SIZE) const;
+
+  // Calls callback for all entries whose key starts with prefix in ascending key order
+  void scan_prefix(std::string_view prefix, const StringScanCallback& callback,
+                   uint32_t value_batch_size = DEFAULT_SCAN_BATCH_SIZE) const;
+
+  void put(std::string_view key, const FileValue& value);
+
+  // update throws if the key does not exist, upsert inserts it
+  void update(std::string_view key, const FileValue& value);
+  void upsert(std::string_view key, const FileValue& value);
+
+  // Removing a key that does not exist has no effect. Leaves can become empty, they stay in the leaf chain.
+  void remove(std::string_view key);
+
+  // Applies all operations of the batch in a single commit. The batch is validated before anything is written.
+  void write(const StringWriteBatch& batch);
+
+  // Builds the tree bottom-up from num_entries entries with strictly increasing keys. Only possible on an empty
+  // database. fill_factor is the share of each page that is used.
+  void bulk_load(uint64_t num_entries, const StringBulkLoadEntryGenerator& next_entry, double fill_factor = 1.0);
+
+  // Writes all entries to a new database file with a bulk load, so the leaves are stored in key order, each followed
+  // by its values
+  void compact(const std::string& dest_file_name, double fill_factor = 1.0) const;
+
+  uint64_t num_entries() const;
+  uint32_t height() const;
+
+  const FileManager& get_file_manager() const;
+
+ protected:
+  // IDs of the internal nodes on the way to a leaf and the position of the child that was taken in each
+  using Path = std::vector<std::pair<NodeID, uint16_t>>;
+
+  void _put(std::string_view key, const FileValue& value);
+
+  // Return false if the key does not exist
+  bool _update(std::string_view key, const FileValue& value);
+  bool _remove(std::string_view key);
+
+  // Returns the page of the node, the root is always in memory
+  const char* _view_node(NodeID node_id, NodePage& buffer) const;
+
+  NodeID _find_leaf(std::string_view key) const;
+  std::optional<FileOffset> _find_value_slot(std::string_view key) const;
+  StringNode _load_leaf(std::string_view key, Path& path) const;
+
+  // Writes the node and splits it (and its parents) if it does not fit into its page. After an insert at the end of
+  // the rightmost leaf, nodes are split right before their last key, so ascending inserts fill all nodes completely.
+  void _write_node_with_splits(StringNode node, Path& path, bool split_at_end);
+  std::pair<std::string, NodeID> _split_node(StringNode& node, bool split_at_end);
+
+  // Writes the leaves and then each level of internal nodes from left to right and returns the root
+  NodeID _build_tree(uint64_t num_entries, const StringBulkLoadEntryGenerator& next_entry, uint32_t max_node_size);
+
+  // The root page is kept in memory and updated with every write of the root
+  void _write_node(const StringNode& node);
+  void _set_root(const StringNode& root);
+
+  // Calls callback for all entries from the first key >= lower on as long as is_in_range returns true for their key
+  void _scan(std::string_view lower, const std::function<bool(std::string_view)>& is_in_range,
+             const StringScanCallback& callback, uint32_t value_batch_size) const;
+
+  FileManager _file_manager;
+  uint16_t _value_size;
+
+  NodeID _root_id = InvalidNodeID;
+  NodePage _root_page{};
+};
+
+}  // namespace keva
@@ -0,0 +1,283 @@
+#include "string_node.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "bp_node_view.hpp"
+#include "key_search.hpp"
+
+namespace {
+
+using namespace keva;
+
+uint16_t common_prefix_size(const std::string_view lhs, const std::string_view rhs) {
+  const auto max_size = std::min(lhs.size(), rhs.size());
+  auto size = size_t{0};
+  while (size < max_size && lhs[size] == rhs[size]) ++size;
+  return static_cast<uint16_t>(size);
+}
+
+// The first bytes of the key, zero-padded, in an order-preserving integer. Keys with different heads compare like them.
+FileKey key_head(const std::string_view key) {
+  auto head = FileKey{0};
+  for (auto i = size_t{0}; i < sizeof(head); ++i) {
+    head = (head << 8) | (i < key.size() ? static_cast<uint8_t>(key[i]) : 0u);
+  }
+  return head;
+}
+
+}  // namespace
+
+namespace keva {
+
+std::string shortest_separator(const std::string_view left, const std::string_view right) {
+  DebugAssert(left < right, "Separator needs a left key that is smaller than the right one");
+
+  // right differs from left in the byte after their common prefix (or left is a prefix of right)
+  return std::string(right.substr(0, common_prefix_size(left, right) + 1));
+}
+
+StringNode::StringNode(BPNodeHeader header, std::vector<std::string> keys, std::vector<NodeID> children)
+    : _header(header), _keys(std::move(keys)), _children(std::move(children)) {
+  _header.num_keys = static_cast<uint16_t>(_keys.size());
+  DebugAssert(_children.size() == _keys.size() + (_header.is_leaf ? 0 : 1), "Passed in wrong number of children");
+}
+
+StringNode StringNode::decode(const char* page) {
+  const StringNodeView view{page};
+  auto header = BPNodeView{page, NodeLayout{0}}.header();
+
+  std::vector<std::string> keys;
+  keys.reserve(view.num_keys());
+  std::vector<NodeID> children;
+  children.reserve(view.num_keys() + 1);
+  if (!view.is_leaf()) children.push_back(view.child(0));
+
+  for (auto position = uint16_t{0}; position < view.num_keys(); ++position) {
+    keys.push_back(view.key(position));
+    children.push_back(view.is_leaf() ? view.value_slot(position) : view.child(position + 1));
+  }
+
+  return StringNode(header, std::move(keys), std::move(children));
+}
+
+void StringNode::encode(char* page, const uint32_t page_size) const {
+  DebugAssert(fits(page_size), "Node does not fit into its page");
+
+  // The free space between the slots and the keys is null
+  std::memset(page, 0, page_size);
+  encode_node_header(_header, page);
+
+  const auto prefix_size = _keys.empty() ? uint16_t{0} : common_prefix_size(_keys.front(), _keys.back());
+  write_to_page(page, PREFIX_SIZE_OFFSET, prefix_size);
+  write_to_page(page, FIRST_CHILD_OFFSET, _header.is_leaf ? InvalidNodeID : _children.front());
+  if (prefix_size > 0) std::memcpy(page + PREFIX_OFFSET, _keys.front().data(), prefix_size);
+
+  const auto first_child = _header.is_leaf ? 0u : 1u;
+  const auto heads_offset = static_cast<uint32_t>(PREFIX_OFFSET + prefix_size);
+  auto slot_offset = static_cast<uint32_t>(heads_offset + _keys.size() * KEY_HEAD_SIZE);
+  auto key_offset = page_size;
+  for (auto position = 0u; position < _keys.size(); ++position) {
+    const auto suffix_size = static_cast<uint16_t>(_keys[position].size() - prefix_size);
+    key_offset -= suffix_size;
+    std::memcpy(page + key_offset, _keys[position].data() + prefix_size, suffix_size);
+
+    write_to_page(page, slot_offset, static_cast<uint16_t>(key_offset));
+    write_to_page(page, slot_offset + sizeof(uint16_t), suffix_size);
+    write_to_page(page, heads_offset + position * KEY_HEAD_SIZE,
+                  key_head(std::string_view{_keys[position]}.substr(prefix_size)));
+    write_to_page(page, slot_offset + SLOT_CHILD_OFFSET, _children[position + first_child]);
+    slot_offset += STRING_SLOT_SIZE;
+  }
+}
+
+uint32_t StringNode::encoded_size() const { return _encoded_size(0, static_cast<uint16_t>(_keys.size())); }
+
+bool StringNode::fits(const uint32_t page_size) const { return encoded_size() <= page_size; }
+
+const BPNodeHeader& StringNode::header() const { return _header; }
+
+const std::vector<std::string>& StringNode::keys() const { return _keys; }
+
+const std::vector<NodeID>& StringNode::children() const { return _children; }
+
+BPNodeHeader& StringNode::mutable_header() { return _header; }
+
+void StringNode::insert(const uint16_t position, std::string key, const NodeID child) {
+  DebugAssert(key.size() <= MAX_STRING_KEY_SIZE, "Key is too long");
+  _keys.insert(_keys.begin() + position, std::move(key));
+  _children.insert(_children.begin() + position + (_header.is_leaf ? 0 : 1), child);
+  ++_header.num_keys;
+}
+
+void StringNode::erase(const uint16_t position) {
+  _keys.erase(_keys.begin() + position);
+  _children.erase(_children.begin() + position + (_header.is_leaf ? 0 : 1));
+  --_header.num_keys;
+}
+
+void StringNode::set_child(const uint16_t position, const NodeID child) { _children[position] = child; }
+
+uint16_t StringNode::split_position(const bool at_end, const uint32_t page_size) const {
+  const auto num_keys = static_cast<uint16_t>(_keys.size());
+
+  // In internal nodes, the key at the split position moves up, so the new node starts behind it
+  const auto right_begin = [&](const uint16_t position) { return _header.is_leaf ? position : position + 1; };
+  const auto min_position = _header.is_leaf ? uint16_t{1} : uint16_t{0};
+  DebugAssert(num_keys > min_position, "Node has too few keys to be split");
+
+  const auto last_position = static_cast<uint16_t>(num_keys - 1);
+  if (at_end && _encoded_size(0, last_position) <= page_size) return last_position;
+
+  // A key that changed the shared prefix of all keys makes the other keys longer, so the halves are only guaranteed to
+  // fit if the new key is on its own. Splitting at the byte midpoint of the keys might therefore not be possible.
+  auto best_position = last_position;
+  auto best_difference = std::numeric_limits<uint32_t>::max();
+  for (auto position = min_position; position < num_keys; ++position) {
+    const auto left_size = _encoded_size(0, position);
+    const auto right_size = _encoded_size(right_begin(position), num_keys);
+    if (left_size > page_size || right_size > page_size) continue;
+
+    const auto difference = left_size > right_size ? left_size - right_size : right_size - left_size;
+    if (difference < best_difference) {
+      best_position = position;
+      best_difference = difference;
+    }
+  }
+
+  Assert(best_difference != std::numeric_limits<uint32_t>::max(), "Node cannot be split into two pages");
+  return best_position;
+}
+
+std::pair<StringNode, std::string> StringNode::split(const uint16_t position) {
+  DebugAssert(position < _keys.size() && (position > 0 || !_header.is_leaf), "Split would leave a leaf without keys");
+
+  BPNodeHeader new_header{};
+  new_header.is_leaf = _header.is_leaf;
+  new_header.parent_id = _header.parent_id;
+
+  std::string separator;
+  std::vector<std::string> new_keys;
+  std::vector<NodeID> new_children;
+  if (_header.is_leaf) {
+    separator = shortest_separator(_keys[position - 1], _keys[position]);
+    new_keys.assign(std::make_move_iterator(_keys.begin() + position), std::make_move_iterator(_keys.end()));
+    new_children.assign(_children.begin() + position, _children.end());
+    _children.resize(position);
+  } else {
+    separator = std::move(_keys[position]);
+    new_keys.assign(std::make_move_iterator(_keys.begin() + position + 1), std::make_move_iterator(_keys.end()));
+    new_children.assign(_children.begin() + position + 1, _children.end());
+    _children.resize(position + 1);
+  }
+  _keys.resize(position);
+  _header.num_keys = position;
+
+  return {StringNode(new_header, std::move(new_keys), std::move(new_children)), std::move(separator)};
+}
+
+uint16_t StringNode::lower_bound(const std::string_view key) const {
+  return static_cast<uint16_t>(std::lower_bound(_keys.begin(), _keys.end(), key) - _keys.begin());
+}
+
+uint16_t StringNode::upper_bound(const std::string_view key) const {
+  return static_cast<uint16_t>(std::upper_bound(_keys.begin(), _keys.end(), key) - _keys.begin());
+}
+
+uint32_t StringNode::_encoded_size(const uint16_t begin, const uint16_t end) const {
+  const auto prefix_size = begin == end ? uint16_t{0} : common_prefix_size(_keys[begin], _keys[end - 1]);
+  auto size = static_cast<uint32_t>(PREFIX_OFFSET + prefix_size + (end - begin) * (KEY_HEAD_SIZE + STRING_SLOT_SIZE));
+  for (auto position = begin; position < end; ++position) {
+    size += static_cast<uint32_t>(_keys[position].size() - prefix_size);
+  }
+  return size;
+}
+
+StringNodeView::StringNodeView(const char* page)
+    : _page(page),
+      _prefix_size(read_from_page<uint16_t>(page, PREFIX_SIZE_OFFSET)),
+      _num_keys(read_from_page<uint16_t>(page, NUM_KEYS_OFFSET)),
+      _heads(page + PREFIX_OFFSET + _prefix_size) {}
+
+bool StringNodeView::is_leaf() const { return read_from_page<uint8_t>(_page, IS_LEAF_OFFSET) != 0; }
+
+uint16_t StringNodeView::num_keys() const { return _num_keys; }
+
+NodeID StringNodeView::next_leaf() const { return read_from_page<NodeID>(_page, NEXT_LEAF_OFFSET); }
+
+std::string_view StringNodeView::prefix() const { return {_page + PREFIX_OFFSET, _prefix_size}; }
+
+std::string_view StringNodeView::key_suffix(const uint16_t position) const {
+  const auto* slot = _slot(position);
+  return {_page + read_from_page<uint16_t>(slot, 0), read_from_page<uint16_t>(slot, sizeof(uint16_t))};
+}
+
+std::string StringNodeView::key(const uint16_t position) const {
+  std::string key;
+  const auto suffix = key_suffix(position);
+  key.reserve(_prefix_size + suffix.size());
+  key.append(prefix()).append(suffix);
+  return key;
+}
+
+NodeID StringNodeView::child(const uint16_t position) const {
+  DebugAssert(!is_leaf(), "Cannot call child on leaf node");
+  if (position == 0) return read_from_page<NodeID>(_page, FIRST_CHILD_OFFSET);
+  return read_from_page<NodeID>(_slot(position - 1), SLOT_CHILD_OFFSET);
+}
+
+FileOffset StringNodeView::value_slot(const uint16_t position) const {
+  DebugAssert(is_leaf(), "Cannot call value_slot on non-leaf node");
+  return read_from_page<FileOffset>(_slot(position), SLOT_CHILD_OFFSET);
+}
+
+uint16_t StringNodeView::lower_bound(const std::string_view key) const { return _search(key, false); }
+
+uint16_t StringNodeView::upper_bound(const std::string_view key) const { return _search(key, true); }
+
+NodeID StringNodeView::find_child(const std::string_view key) const { return child(upper_bound(key)); }
+
+std::optional<FileOffset> StringNodeView::find_value(const std::string_view key) const {
+  const auto position = lower_bound(key);
+  if (position == _num_keys || key.size() != _prefix_size + key_suffix(position).size()) return std::nullopt;
+  if (key.substr(_prefix_size) != key_suffix(position)) return std::nullopt;
+  return value_slot(position);
+}
+
+const char* StringNodeView::_slot(const uint16_t position) const {
+  return _heads + _num_keys * KEY_HEAD_SIZE + position * STRING_SLOT_SIZE;
+}
+
+FileKey StringNodeView::_head(const uint16_t position) const {
+  return read_from_page<FileKey>(_heads, position * KEY_HEAD_SIZE);
+}
+
+uint16_t StringNodeView::_search(const std::string_view key, const bool is_upper_bound) const {
+  // All keys of the node start with the prefix, so a key that does not is smaller or greater than all of them
+  const auto prefix_order = key.substr(0, _prefix_size).compare(prefix());
+  if (prefix_order != 0) return prefix_order < 0 ? 0 : _num_keys;
+  if (_num_keys == 0) return 0;
+
+  const auto suffix = key.substr(_prefix_size);
+  const auto head = key_head(suffix);
+
+  // Heads are mostly unique, so the range of keys with the same head usually has at most one key
+  auto begin = keys_lower_bound(_heads, _num_keys, head);
+  if (begin == _num_keys || _head(begin) != head) return begin;
+  auto end = static_cast<uint16_t>(begin + 1);
+  if (end < _num_keys && _head(end) == head) end = keys_upper_bound(_heads, _num_keys, head);
+
+  while (begin < end) {
+    const auto middle = static_cast<uint16_t>((begin + end) / 2);
+    const auto order = key_suffix(middle).compare(suffix);
+    if (order < 0 || (is_upper_bound && order == 0)) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return begin;
+}
+
+}  // namespace keva
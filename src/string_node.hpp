@@ -0,0 +1,122 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bp_node.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+// Keys of a StringDBManager can have up to this many bytes. Any three keys fit into a node, so a split always finds a
+// position at which both halves fit into their pages.
+static const uint16_t MAX_STRING_KEY_SIZE = 512;
+
+// Byte offsets within the page of a StringNode. The page starts with the same header as a BPNode page, followed by the
+// length of the prefix that all keys of the node share, the leftmost child of internal nodes and the prefix itself.
+static const uint16_t PREFIX_SIZE_OFFSET = BP_NODE_HEADER_SIZE;
+static const uint16_t FIRST_CHILD_OFFSET = PREFIX_SIZE_OFFSET + sizeof(uint16_t);
+static const uint16_t PREFIX_OFFSET = FIRST_CHILD_OFFSET + sizeof(NodeID);
+
+// Behind the prefix, the page holds the heads of all keys and then a slot per key with the offset and the length of the
+// rest of the key and the child right of it (or its value slot in leaves). The rests of the keys are stored from the end
+// of the page downwards. A head holds the first bytes of the rest as a big-endian FileKey, so the heads are ordered like
+// the keys and can be searched with keys_lower_bound. Only keys with the same head as the search key are compared in
+// full.
+static const uint16_t KEY_HEAD_SIZE = sizeof(FileKey);
+static const uint16_t SLOT_CHILD_OFFSET = 2 * sizeof(uint16_t);
+static const uint16_t STRING_SLOT_SIZE = SLOT_CHILD_OFFSET + sizeof(NodeID);
+
+// The shortest key that is greater than left and not greater than right, which must be greater than left. Used as the
+// separator of two nodes, so that internal nodes only store as many bytes of a key as are needed to route lookups.
+std::string shortest_separator(std::string_view left, std::string_view right);
+
+// Node of a tree with variable-length keys (slotted page). Like a BPNode, it is decoded from its page for changes and
+// encoded again as a whole. The keys are full keys, the prefix is only stripped when the node is encoded.
+class StringNode {
+ public:
+  StringNode(BPNodeHeader header, std::vector<std::string> keys, std::vector<NodeID> children);
+
+  static StringNode decode(const char* page);
+  void encode(char* page, uint32_t page_size) const;
+
+  // Number of bytes the encoded node uses. The node fits into its page if this is at most the page size.
+  uint32_t encoded_size() const;
+  bool fits(uint32_t page_size) const;
+
+  const BPNodeHeader& header() const;
+  const std::vector<std::string>& keys() const;
+  const std::vector<NodeID>& children() const;
+
+  BPNodeHeader& mutable_header();
+
+  // Same semantics as the BPNode functions of the same name: In internal nodes, the child is right of the key.
+  void insert(uint16_t position, std::string key, NodeID child);
+  void erase(uint16_t position);
+  void set_child(uint16_t position, NodeID child);
+
+  // Position at which split leaves two nodes that fit into their pages and use about the same number of bytes. With
+  // at_end, only the last key (in internal nodes: the last child) moves to the new node if possible.
+  uint16_t split_position(bool at_end, uint32_t page_size) const;
+
+  // Moves the keys from position on (and their children) to the returned node. In internal nodes, the key at position
+  // moves up to the parent instead, so it is returned as the separator. Leaves return the shortest separator.
+  std::pair<StringNode, std::string> split(uint16_t position);
+
+  uint16_t lower_bound(std::string_view key) const;
+  uint16_t upper_bound(std::string_view key) const;
+
+ protected:
+  // Size of a node with the keys in [begin, end) and their children
+  uint32_t _encoded_size(uint16_t begin, uint16_t end) const;
+
+  BPNodeHeader _header;
+  std::vector<std::string> _keys;
+  std::vector<NodeID> _children;
+};
+
+// Read-only view of a StringNode page. Keys are compared in place, only their prefix is compared once per node.
+class StringNodeView {
+ public:
+  explicit StringNodeView(const char* page);
+
+  bool is_leaf() const;
+  uint16_t num_keys() const;
+  NodeID next_leaf() const;
+
+  std::string_view prefix() const;
+
+  // The part of the key behind the prefix, and the full key
+  std::string_view key_suffix(uint16_t position) const;
+  std::string key(uint16_t position) const;
+
+  // Position 0 is the leftmost child of internal nodes, the children right of the keys follow. Leaves have a value slot
+  // per key instead.
+  NodeID child(uint16_t position) const;
+  FileOffset value_slot(uint16_t position) const;
+
+  uint16_t lower_bound(std::string_view key) const;
+  uint16_t upper_bound(std::string_view key) const;
+
+  NodeID find_child(std::string_view key) const;
+
+  // nullopt if the leaf does not contain the key. Inline values can have a null slot.
+  std::optional<FileOffset> find_value(std::string_view key) const;
+
+ protected:
+  const char* _slot(uint16_t position) const;
+  FileKey _head(uint16_t position) const;
+
+  // Index of the first key that is >= key (or > key if is_upper_bound)
+  uint16_t _search(std::string_view key, bool is_upper_bound) const;
+
+  const char* _page;
+  uint16_t _prefix_size;
+  uint16_t _num_keys;
+  const char* _heads;
+};
+
+}  // namespace keva
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 namespace keva {
 
 using NodeID = uint64_t;
@@ -9,14 +12,121 @@ using FileOffset = NodeID;
 using FileKey = uint64_t;
 using FileValue = std::vector<char>;
 
-// sizeof(DBHeader) returns wrong size (12 bytes) because of padding
-static const uint16_t DB_HEADER_SIZE = 14;
+// sizeof(DBHeader) returns wrong size because of padding. Files of format version 2 and older have no key size, so
+// their header only has 14 bytes, files of version 3 have no page size and 16 bytes, files of version 4 have no flags
+// and 20 bytes.
+static const uint16_t DB_HEADER_SIZE = 22;
 
 static const uint16_t BP_NODE_HEADER_SIZE = 35;
 
-static const uint16_t BP_NODE_SIZE = 2048;
+// The page size of a database is chosen when it is created. The header fills the first page and all nodes start at a
+// multiple of the page size, so a node never straddles a 4 KiB device or OS page. Files of format version 3 and older
+// have LEGACY_PAGE_SIZE pages that directly follow the header.
+static const uint32_t MIN_PAGE_SIZE = 4 * 1024;
+static const uint32_t MAX_PAGE_SIZE = 64 * 1024;
+static const uint32_t DEFAULT_PAGE_SIZE = MIN_PAGE_SIZE;
+static const uint32_t LEGACY_PAGE_SIZE = 2048;
+
+// Number of keys per node and the width in bytes of the keys in a node page, 4 or 8. Keys of databases with 4-byte keys
+// must fit into 32 bits, which leaves room for more keys per node. A plain number of keys converts to a layout with
+// 8-byte keys.
+struct NodeLayout {
+  constexpr NodeLayout(const uint16_t keys_per_node, const uint16_t bytes_per_key = sizeof(FileKey))
+      : max_keys_per_node(keys_per_node), key_size(bytes_per_key) {}
+
+  // As many keys as fit into a page of page_size bytes next to the node header and one more child than keys
+  static constexpr NodeLayout for_key_size(const uint16_t key_size, const uint32_t page_size = DEFAULT_PAGE_SIZE) {
+    return {static_cast<uint16_t>((page_size - BP_NODE_HEADER_SIZE - sizeof(NodeID)) / (key_size + sizeof(NodeID))),
+            key_size};
+  }
+
+  uint16_t max_keys_per_node;
+  uint16_t key_size;
+};
+
+// 35 byte header + 253 * 8 (keys) + 254 * 8 (child pointer) = 4091
+static constexpr uint16_t KEYS_PER_NODE = NodeLayout::for_key_size(sizeof(FileKey)).max_keys_per_node;
+static_assert(KEYS_PER_NODE == 253);
+
+// Buffer pool size that is used if a feature needs the pool but no size is configured
+static const uint64_t DEFAULT_BUFFER_POOL_SIZE = 8 * 1024 * 1024;
+
+// Memory-mapped files are grown in steps of this size to avoid remapping on every new node
+static const uint64_t MMAP_CHUNK_SIZE = 4 * 1024 * 1024;
+
+// Number of values a cursor reads at once when it walks over a leaf
+static const uint32_t DEFAULT_SCAN_BATCH_SIZE = 64;
+
+// Number of node latches of a concurrent tree (see DBOptions::concurrent). 64K latches take 512 KiB.
+static const uint32_t DEFAULT_NUM_NODE_LATCHES = 1 << 16;
+
+// Number of readers that can read a copy-on-write tree at once (see DBOptions::max_readers)
+static const uint32_t DEFAULT_NUM_READER_SLOTS = 128;
+
+// Stream reads and writes the file with pread and pwrite, MemoryMapped maps it into memory
+enum class StorageMode : uint8_t { Stream, MemoryMapped };
+
+// Options that are chosen when opening a database. Except for the page size of a new database, they are not stored in
+// the file.
+struct DBOptions {
+  StorageMode storage_mode = StorageMode::Stream;
+
+  // Size of the node pages of a new database, a power of two in [MIN_PAGE_SIZE, MAX_PAGE_SIZE]. Larger pages hold more
+  // keys per node (see NodeLayout::for_key_size). Existing databases keep the page size they were created with.
+  uint32_t page_size = DEFAULT_PAGE_SIZE;
+
+  // Batched lookups and scans keep up to this many reads of node pages and values in flight at once. The reads go
+  // through io_uring if the kernel supports it and are issued one after another with pread otherwise.
+  uint32_t io_queue_depth = 64;
+
+  // Memory budget in bytes for cached node pages. 0 disables the buffer pool.
+  uint64_t buffer_pool_size = 0;
+
+  // Log all changes to <db_file_name>-wal and sync the log once per commit instead of flushing every node. Node pages
+  // are written back lazily through the buffer pool, which uses DEFAULT_BUFFER_POOL_SIZE if no size is configured.
+  bool enable_wal = false;
+
+  // The log is checkpointed into the database file once it grows beyond this size
+  uint64_t wal_checkpoint_size = 64 * 1024 * 1024;
+
+  // A remove only drops the entry from its leaf. Leaves with fewer than merge_min_fill * (max_keys_per_node + 1)
+  // entries are remembered and merged with or refilled from a neighbour in one pass once merge_batch_size of them are
+  // pending. 0 only merges on DBManager::merge_underfull_nodes. merge_min_fill must be in (0, 0.5].
+  double merge_min_fill = 0.5;
+  uint32_t merge_batch_size = 64;
+
+  // Store values that are not inlined into their leaf in an append-only value log <db_file_name>-vlog instead of the
+  // database file, so that the file only contains nodes. The log is split into segments of up to value_log_segment_size
+  // bytes. Must be the same every time the database is opened.
+  bool enable_value_log = false;
+  uint64_t value_log_segment_size = 64 * 1024 * 1024;
+
+  // After a write, the live values of the segment with the largest share of dead bytes are moved to the head of the log
+  // once the share reaches value_log_gc_ratio. The segment is deleted afterwards. 0 only collects garbage on
+  // DBManager::collect_value_log_garbage.
+  double value_log_gc_ratio = 0.5;
+
+  // Allow get, multi_get, put, update, upsert and remove from many threads at once. Readers take no latches, they
+  // validate the version of each node they read and restart if a writer changed it meanwhile. Writers lock the leaf
+  // they change and, to split a full node on their way down, the node and its parent. All other functions must not run
+  // concurrently with anything else, and underfull leaves are only merged by merge_underfull_nodes. Requires
+  // StorageMode::Stream without write-ahead log, buffer pool and value log, which are not thread-safe.
+  bool concurrent = false;
+
+  // Never overwrite a node or value that is part of the committed tree. Writers copy the path from the root to the
+  // changed leaf to new pages and then replace the root offset, so a crash leaves either the old or the new tree in the
+  // file. Pages of replaced nodes are only reused once no reader is using a tree that contains them. get, multi_get,
+  // scans, cursors and num_entries may run on many threads at once and concurrently with one writer (put, update,
+  // upsert, remove and write, which wait for each other). They take no latches and see the tree of the last commit
+  // before they started. Leaves are not chained, cursors find the next leaf from the root, and underfull leaves are
+  // not merged, only empty ones are dropped. The mode is stored in the file, which cannot be opened with a different
+  // setting. Requires StorageMode::Stream without write-ahead log, buffer pool and value log, and cannot be combined
+  // with concurrent.
+  bool copy_on_write = false;
 
-// 35 byte header + 125 * 8 (keys) + 126 * 8 (child pointer) = 2043
-static const uint16_t KEYS_PER_NODE = 125;
+  // Lookups, scans, cursors and snapshots that can read a copy-on-write tree at once. Each of them takes a slot of the
+  // reader table until it is done (see ReaderTable), further readers wait for a free slot.
+  uint32_t max_readers = DEFAULT_NUM_READER_SLOTS;
+};
 
 }  // namespace keva
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <functional>
+#include <stdexcept>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -30,6 +30,17 @@ class Noncopyable {
 #define DebugAssert(expr, msg)
 #endif
 
+// FNV-1a over the bytes. Unlike std::hash, the result is the same with every compiler and standard library, so it may
+// be stored in files or decide where keys are stored.
+inline uint64_t fnv1a_hash(const char* data, const uint64_t num_bytes) {
+  uint64_t hash = 14695981039346656037ull;
+  for (auto i = 0ull; i < num_bytes; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
 template <typename T>
 std::enable_if_t<!std::is_same_v<T, std::string>, uint16_t> inline get_type_size() {
   return static_cast<uint16_t>(sizeof(T));
@@ -40,16 +51,6 @@ std::enable_if_t<std::is_same_v<T, std::string>, uint16_t> inline get_type_size(
   return 0;
 }
 
-template <typename KeyType>
-inline FileKey convert_to_file_key(const KeyType& key) {
-  return static_cast<uint64_t>(key);
-}
-
-template <>
-inline FileKey convert_to_file_key(const std::string& key) {
-  return std::hash<std::string>{}(key);
-}
-
 template <typename ValueType>
 inline ValueType convert_from_file_value(const FileValue& file_value) {
   ValueType result;
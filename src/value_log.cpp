@@ -0,0 +1,304 @@
+#include "value_log.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+using namespace keva;
+
+// Pointers hold the segment ID in the upper bits and the offset of the record in the segment in the lower ones
+const uint32_t SEGMENT_ID_SHIFT = 48;
+const FileOffset RECORD_OFFSET_MASK = (FileOffset{1} << SEGMENT_ID_SHIFT) - 1;
+
+// key + number of value bytes
+const uint32_t RECORD_HEADER_SIZE = sizeof(FileKey) + sizeof(uint32_t);
+
+const uint64_t MANIFEST_MAGIC = 0x676f6c65756c6176;
+
+// The size of a record is not known before reading it, so this much is read ahead
+const uint64_t PREFETCH_SIZE = 4096;
+
+uint32_t segment_of(const FileOffset pointer) { return static_cast<uint32_t>(pointer >> SEGMENT_ID_SHIFT); }
+
+uint64_t offset_of(const FileOffset pointer) { return pointer & RECORD_OFFSET_MASK; }
+
+// The segment IDs and dead byte counts of the manifest. Empty if there is no manifest.
+std::vector<std::pair<uint32_t, uint64_t>> read_manifest(const std::string& base_name) {
+  std::ifstream manifest{base_name, std::ios::binary};
+  uint64_t magic = 0;
+  uint32_t num_segments = 0;
+  manifest.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  manifest.read(reinterpret_cast<char*>(&num_segments), sizeof(num_segments));
+  if (!manifest.good() || magic != MANIFEST_MAGIC) return {};
+
+  std::vector<std::pair<uint32_t, uint64_t>> segments(num_segments);
+  for (auto& [segment_id, num_dead_bytes] : segments) {
+    manifest.read(reinterpret_cast<char*>(&segment_id), sizeof(segment_id));
+    manifest.read(reinterpret_cast<char*>(&num_dead_bytes), sizeof(num_dead_bytes));
+  }
+  Assert(manifest.good(), "Value log manifest '" + base_name + "' is corrupted.");
+  return segments;
+}
+
+}  // namespace
+
+namespace keva {
+
+ValueLog::ValueLog(std::string base_name, const uint64_t segment_size, const bool is_new_db)
+    : _base_name(std::move(base_name)), _segment_size(segment_size) {
+  Assert(segment_size > RECORD_HEADER_SIZE && segment_size <= RECORD_OFFSET_MASK, "Invalid value log segment size.");
+
+  const auto manifest_segments = read_manifest(_base_name);
+  if (is_new_db) {
+    // The log belongs to a database that does not exist anymore
+    for (const auto& [segment_id, num_dead_bytes] : manifest_segments) {
+      std::remove(_segment_file_name(segment_id).c_str());
+    }
+  } else {
+    Assert(exists(_base_name), "Value log '" + _base_name + "' is missing.");
+
+    // Segments are created after they were added to the manifest, so a crash can leave listed segments that do not exist
+    for (const auto& [segment_id, num_dead_bytes] : manifest_segments) {
+      if (std::ifstream{_segment_file_name(segment_id)}.good()) _open_segment(segment_id, num_dead_bytes, false);
+    }
+  }
+
+  // The end of the last head segment may be torn, so new records go to a new segment unless it is empty
+  if (!_segments.empty() && _segments.rbegin()->second.size == 0) {
+    _head_segment_id = _segments.rbegin()->first;
+    _write_manifest();
+  } else {
+    _start_head_segment();
+  }
+}
+
+ValueLog::~ValueLog() {
+  try {
+    flush();
+    _write_manifest();
+  } catch (const std::exception&) {
+    // Only the dead byte counts since the last manifest write are lost
+  }
+
+  for (const auto& [segment_id, segment] : _segments) close(segment.fd);
+}
+
+bool ValueLog::exists(const std::string& base_name) { return std::ifstream{base_name}.good(); }
+
+FileOffset ValueLog::append(const FileKey key, const char* data, const uint32_t num_bytes) {
+  const auto record_size = RECORD_HEADER_SIZE + static_cast<uint64_t>(num_bytes);
+  if (_segments.at(_head_segment_id).size > 0 && _segments.at(_head_segment_id).size + record_size > _segment_size) {
+    flush();
+    _start_head_segment();
+  }
+
+  auto& head = _segments.at(_head_segment_id);
+  const auto pointer = (static_cast<FileOffset>(_head_segment_id) << SEGMENT_ID_SHIFT) | head.size;
+
+  const auto* key_raw = reinterpret_cast<const char*>(&key);
+  const auto* num_bytes_raw = reinterpret_cast<const char*>(&num_bytes);
+  _head_buffer.insert(_head_buffer.end(), key_raw, key_raw + sizeof(key));
+  _head_buffer.insert(_head_buffer.end(), num_bytes_raw, num_bytes_raw + sizeof(num_bytes));
+  _head_buffer.insert(_head_buffer.end(), data, data + num_bytes);
+  head.size += record_size;
+
+  if (_head_buffer.size() >= WRITE_BUFFER_SIZE) flush();
+  return pointer;
+}
+
+FileValue ValueLog::read(const FileOffset pointer) const {
+  const auto segment_id = segment_of(pointer);
+  const auto offset = offset_of(pointer);
+
+  uint32_t num_bytes;
+  _read_bytes(segment_id, offset + sizeof(FileKey), reinterpret_cast<char*>(&num_bytes), sizeof(num_bytes));
+
+  FileValue value(num_bytes);
+  _read_bytes(segment_id, offset + RECORD_HEADER_SIZE, value.data(), num_bytes);
+  return value;
+}
+
+void ValueLog::free(const FileOffset pointer) {
+  const auto segment_id = segment_of(pointer);
+  uint32_t num_bytes;
+  _read_bytes(segment_id, offset_of(pointer) + sizeof(FileKey), reinterpret_cast<char*>(&num_bytes), sizeof(num_bytes));
+  _segments.at(segment_id).num_dead_bytes += RECORD_HEADER_SIZE + num_bytes;
+}
+
+void ValueLog::prefetch(const std::vector<FileOffset>& pointers) const {
+  for (const auto pointer : pointers) {
+    const auto segment_id = segment_of(pointer);
+    const auto offset = offset_of(pointer);
+    if (segment_id == _head_segment_id && offset >= _head_buffer_offset) continue;
+
+    posix_fadvise(_segments.at(segment_id).fd, static_cast<off_t>(offset), PREFETCH_SIZE, POSIX_FADV_WILLNEED);
+  }
+}
+
+void ValueLog::flush() {
+  if (_head_buffer.empty()) return;
+
+  const auto fd = _segments.at(_head_segment_id).fd;
+  auto bytes_written = 0ull;
+  while (bytes_written < _head_buffer.size()) {
+    const auto result = pwrite(fd, _head_buffer.data() + bytes_written, _head_buffer.size() - bytes_written,
+                               static_cast<off_t>(_head_buffer_offset + bytes_written));
+    Assert(result > 0, "Failed to write value log segment.");
+    bytes_written += result;
+  }
+
+  _head_buffer_offset += _head_buffer.size();
+  _head_buffer.clear();
+  if (std::find(_unsynced_segments.begin(), _unsynced_segments.end(), _head_segment_id) == _unsynced_segments.end()) {
+    _unsynced_segments.push_back(_head_segment_id);
+  }
+}
+
+void ValueLog::sync() {
+  flush();
+  for (const auto segment_id : _unsynced_segments) {
+    Assert(fdatasync(_segments.at(segment_id).fd) == 0, "Failed to sync value log segment.");
+  }
+  _unsynced_segments.clear();
+}
+
+uint32_t ValueLog::find_garbage_segment(const double min_dead_ratio) const {
+  uint32_t garbage_segment = 0;
+  auto max_dead_ratio = 0.0;
+  for (const auto& [segment_id, segment] : _segments) {
+    if (segment_id == _head_segment_id || segment.num_dead_bytes == 0) continue;
+    if (std::find(_dropped_segments.begin(), _dropped_segments.end(), segment_id) != _dropped_segments.end()) continue;
+
+    const auto dead_ratio = static_cast<double>(segment.num_dead_bytes) / static_cast<double>(segment.size);
+    if (dead_ratio >= min_dead_ratio && dead_ratio > max_dead_ratio) {
+      garbage_segment = segment_id;
+      max_dead_ratio = dead_ratio;
+    }
+  }
+  return garbage_segment;
+}
+
+std::vector<ValueLogRecord> ValueLog::read_segment(const uint32_t segment_id) const {
+  Assert(segment_id != _head_segment_id, "Cannot read the head segment of the value log.");
+
+  std::vector<char> data(_segments.at(segment_id).size);
+  _read_bytes(segment_id, 0, data.data(), data.size());
+
+  // A crash can leave a torn record at the end of the segment, which was never referenced
+  std::vector<ValueLogRecord> records;
+  auto position = 0ull;
+  while (position + RECORD_HEADER_SIZE <= data.size()) {
+    FileKey key;
+    uint32_t num_bytes;
+    std::memcpy(&key, data.data() + position, sizeof(key));
+    std::memcpy(&num_bytes, data.data() + position + sizeof(key), sizeof(num_bytes));
+    if (position + RECORD_HEADER_SIZE + num_bytes > data.size()) break;
+
+    const auto value_begin = data.begin() + position + RECORD_HEADER_SIZE;
+    const auto pointer = (static_cast<FileOffset>(segment_id) << SEGMENT_ID_SHIFT) | position;
+    records.push_back({key, pointer, FileValue(value_begin, value_begin + num_bytes)});
+    position += RECORD_HEADER_SIZE + num_bytes;
+  }
+  return records;
+}
+
+void ValueLog::drop_segment(const uint32_t segment_id) {
+  Assert(segment_id != _head_segment_id, "Cannot drop the head segment of the value log.");
+  _dropped_segments.push_back(segment_id);
+}
+
+void ValueLog::release_dropped_segments() {
+  if (_dropped_segments.empty()) return;
+
+  // The relocated records must not get lost together with the segment
+  sync();
+
+  for (const auto segment_id : _dropped_segments) {
+    close(_segments.at(segment_id).fd);
+    std::remove(_segment_file_name(segment_id).c_str());
+    _segments.erase(segment_id);
+    _unsynced_segments.erase(std::remove(_unsynced_segments.begin(), _unsynced_segments.end(), segment_id),
+                             _unsynced_segments.end());
+  }
+  _dropped_segments.clear();
+  _write_manifest();
+}
+
+uint32_t ValueLog::num_segments() const { return static_cast<uint32_t>(_segments.size()); }
+
+uint64_t ValueLog::num_dead_bytes(const uint32_t segment_id) const { return _segments.at(segment_id).num_dead_bytes; }
+
+std::string ValueLog::_segment_file_name(const uint32_t segment_id) const {
+  return _base_name + "-" + std::to_string(segment_id);
+}
+
+void ValueLog::_open_segment(const uint32_t segment_id, const uint64_t num_dead_bytes, const bool create) {
+  const auto file_name = _segment_file_name(segment_id);
+  const auto fd = open(file_name.c_str(), O_RDWR | (create ? O_CREAT | O_TRUNC : 0), 0644);
+  Assert(fd >= 0, "Failed to open value log segment '" + file_name + "'.");
+
+  struct stat file_stat {};
+  Assert(fstat(fd, &file_stat) == 0, "Failed to read size of value log segment.");
+  _segments[segment_id] = Segment{fd, static_cast<uint64_t>(file_stat.st_size), num_dead_bytes};
+}
+
+void ValueLog::_start_head_segment() {
+  const auto segment_id = _segments.empty() ? 1 : _segments.rbegin()->first + 1;
+  Assert(segment_id < (1u << (64 - SEGMENT_ID_SHIFT)), "Value log ran out of segment IDs.");
+
+  // The manifest must list the segment before any record in it can be referenced
+  _open_segment(segment_id, 0, true);
+  _head_segment_id = segment_id;
+  _head_buffer_offset = 0;
+  _write_manifest();
+}
+
+void ValueLog::_read_bytes(const uint32_t segment_id, const uint64_t offset, char* data, const uint64_t num_bytes) const {
+  if (segment_id == _head_segment_id && offset >= _head_buffer_offset) {
+    DebugAssert(offset + num_bytes <= _head_buffer_offset + _head_buffer.size(), "Trying to read beyond the value log");
+    std::memcpy(data, _head_buffer.data() + (offset - _head_buffer_offset), num_bytes);
+    return;
+  }
+
+  const auto fd = _segments.at(segment_id).fd;
+  auto bytes_read = 0ull;
+  while (bytes_read < num_bytes) {
+    const auto result = pread(fd, data + bytes_read, num_bytes - bytes_read, static_cast<off_t>(offset + bytes_read));
+    Assert(result > 0, "Failed to read value log segment.");
+    bytes_read += result;
+  }
+}
+
+void ValueLog::_write_manifest() const {
+  std::vector<char> manifest;
+  const auto append = [&](const auto& value) {
+    const auto* raw = reinterpret_cast<const char*>(&value);
+    manifest.insert(manifest.end(), raw, raw + sizeof(value));
+  };
+
+  append(MANIFEST_MAGIC);
+  append(static_cast<uint32_t>(_segments.size()));
+  for (const auto& [segment_id, segment] : _segments) {
+    append(segment_id);
+    append(segment.num_dead_bytes);
+  }
+
+  // Replace the manifest atomically, so a crash leaves either the old or the new one
+  const auto temp_name = _base_name + "-manifest";
+  const auto fd = open(temp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  Assert(fd >= 0, "Failed to write value log manifest.");
+  const auto is_written = write(fd, manifest.data(), manifest.size()) == static_cast<ssize_t>(manifest.size()) &&
+                          fdatasync(fd) == 0;
+  close(fd);
+  Assert(is_written && std::rename(temp_name.c_str(), _base_name.c_str()) == 0,
+         "Failed to write value log manifest.");
+}
+
+}  // namespace keva
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+struct ValueLogRecord {
+  FileKey key;
+  FileOffset pointer;
+  FileValue value;
+};
+
+// Append-only log of values, split into segment files <base_name>-<segment id>. Leaves only store a pointer to the
+// record of their value, which holds the key, the size and the value. Values are never overwritten: an update appends a
+// new record and the old one becomes dead. Segments with many dead records are garbage collected by appending their
+// live records to the head segment and deleting them.
+//
+// The manifest <base_name> lists the segments and how many of their bytes are dead. The counts are only written when
+// segments are created or deleted and on close, so they can be too low after a crash.
+class ValueLog : public Noncopyable {
+ public:
+  // Records at the end of the head segment are buffered until this many bytes are pending
+  static constexpr uint32_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+  // Removes the files of an old log with the same name if is_new_db
+  ValueLog(std::string base_name, uint64_t segment_size, bool is_new_db);
+  ~ValueLog();
+
+  static bool exists(const std::string& base_name);
+
+  // Returns the pointer to the new record. The pointer is never InvalidNodeID.
+  FileOffset append(FileKey key, const char* data, uint32_t num_bytes);
+  FileValue read(FileOffset pointer) const;
+
+  // Counts the record as dead. The record is still readable, as the committed tree may reference it.
+  void free(FileOffset pointer);
+
+  // Tells the OS that the records will be read soon
+  void prefetch(const std::vector<FileOffset>& pointers) const;
+
+  // Writes the buffered records to the head segment. sync additionally makes all appended records durable.
+  void flush();
+  void sync();
+
+  // Returns the sealed segment with the largest share of dead bytes if the share is at least min_dead_ratio and the
+  // segment has dead bytes at all, 0 otherwise. The head segment is never collected.
+  uint32_t find_garbage_segment(double min_dead_ratio) const;
+
+  // All records of a sealed segment in log order, including dead ones
+  std::vector<ValueLogRecord> read_segment(uint32_t segment_id) const;
+
+  // The segment is only deleted by release_dropped_segments, after the relocation of its live records is committed
+  void drop_segment(uint32_t segment_id);
+  void release_dropped_segments();
+
+  uint32_t num_segments() const;
+  uint64_t num_dead_bytes(uint32_t segment_id) const;
+
+ protected:
+  struct Segment {
+    int fd;
+    uint64_t size;
+    uint64_t num_dead_bytes;
+  };
+
+  std::string _segment_file_name(uint32_t segment_id) const;
+  void _open_segment(uint32_t segment_id, uint64_t num_dead_bytes, bool create);
+  void _start_head_segment();
+  void _read_bytes(uint32_t segment_id, uint64_t offset, char* data, uint64_t num_bytes) const;
+  void _write_manifest() const;
+
+  const std::string _base_name;
+  const uint64_t _segment_size;
+
+  std::map<uint32_t, Segment> _segments;
+  uint32_t _head_segment_id = 0;
+
+  // Records of the head segment from _head_buffer_offset on that are not written yet
+  std::vector<char> _head_buffer;
+  uint64_t _head_buffer_offset = 0;
+
+  std::vector<uint32_t> _unsynced_segments;
+  std::vector<uint32_t> _dropped_segments;
+};
+
+}  // namespace keva
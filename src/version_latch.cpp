@@ -0,0 +1,59 @@
+#include "version_latch.hpp"
+
+#include <algorithm>
+
+namespace keva {
+
+std::optional<uint64_t> VersionLatch::read_version() const {
+  const auto version = _version.load(std::memory_order_acquire);
+  if (version & 1) return std::nullopt;
+  return version;
+}
+
+bool VersionLatch::validate(const uint64_t version) const {
+  // The reads of the node must not be reordered behind the check
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return _version.load(std::memory_order_relaxed) == version;
+}
+
+bool VersionLatch::try_upgrade(uint64_t version) {
+  return _version.compare_exchange_strong(version, version + 1, std::memory_order_acquire);
+}
+
+void VersionLatch::unlock() { _version.fetch_add(1, std::memory_order_release); }
+
+NodeLatches::NodeLatches(const uint32_t num_latches)
+    : _latches(std::make_unique<VersionLatch[]>(num_latches)), _mask(num_latches - 1) {
+  Assert(num_latches > 0 && (num_latches & (num_latches - 1)) == 0, "Number of latches must be a power of two.");
+}
+
+VersionLatch& NodeLatches::operator[](const NodeID node_id) const {
+  // Node IDs are multiples of the page size, so their low bits are all the same
+  const auto hash = (node_id * 0x9e3779b97f4a7c15) >> 32;
+  return _latches[hash & _mask];
+}
+
+LatchSet::~LatchSet() {
+  for (const auto& [latch, version] : _latches) latch->unlock();
+}
+
+bool LatchSet::try_upgrade(VersionLatch& latch, const uint64_t version) {
+  const auto held_latch = std::find_if(_latches.begin(), _latches.end(),
+                                       [&](const auto& entry) { return entry.first == &latch; });
+  if (held_latch != _latches.end()) return held_latch->second == version;
+
+  if (!latch.try_upgrade(version)) return false;
+  _latches.emplace_back(&latch, version);
+  return true;
+}
+
+bool LatchSet::try_lock(VersionLatch& latch) {
+  const auto is_held =
+      std::any_of(_latches.begin(), _latches.end(), [&](const auto& entry) { return entry.first == &latch; });
+  if (is_held) return true;
+
+  const auto version = latch.read_version();
+  return version && try_upgrade(latch, *version);
+}
+
+}  // namespace keva
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+// Latch for optimistic lock coupling (Leis et al., "The ART of Practical Synchronization"). Readers never acquire it:
+// they remember its version before reading a node and check that it is unchanged afterwards, otherwise they start
+// over. A writer locks the latch, which makes the version odd, and unlocks it with the next even version.
+class VersionLatch : public Noncopyable {
+ public:
+  // nullopt while a writer holds the latch
+  std::optional<uint64_t> read_version() const;
+
+  // True if nobody locked the latch since version was read
+  bool validate(uint64_t version) const;
+
+  // Locks the latch if it still has version. Never waits, so writers cannot deadlock when they take several latches.
+  bool try_upgrade(uint64_t version);
+
+  void unlock();
+
+ protected:
+  std::atomic<uint64_t> _version{0};
+};
+
+// Latches of all nodes of a tree. Nodes share a latch if their IDs hash to the same slot, which only makes them
+// conflict more often.
+class NodeLatches : public Noncopyable {
+ public:
+  explicit NodeLatches(uint32_t num_latches = DEFAULT_NUM_NODE_LATCHES);
+
+  VersionLatch& operator[](NodeID node_id) const;
+
+ protected:
+  std::unique_ptr<VersionLatch[]> _latches;
+  const uint32_t _mask;
+};
+
+// Latches held by a writer. Taking a latch twice (e.g., for two nodes that share it) only checks the version. All
+// latches are unlocked when the set is destroyed.
+class LatchSet : public Noncopyable {
+ public:
+  ~LatchSet();
+
+  bool try_upgrade(VersionLatch& latch, uint64_t version);
+  bool try_lock(VersionLatch& latch);
+
+ protected:
+  // Each latch with its version before it was locked
+  std::vector<std::pair<VersionLatch*, uint64_t>> _latches;
+};
+
+}  // namespace keva
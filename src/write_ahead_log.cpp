@@ -0,0 +1,177 @@
+#include "write_ahead_log.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace {
+
+using namespace keva;
+
+enum class LogRecordType : uint8_t { Write = 1, Commit = 2 };
+
+// type + file offset + number of bytes
+const uint32_t WRITE_RECORD_HEADER_SIZE = 13;
+// type + transaction size + checksum
+const uint32_t COMMIT_RECORD_SIZE = 17;
+
+// FNV-1a, good enough to detect torn writes at the end of the log
+uint64_t checksum(const char* data, const uint64_t num_bytes) { return fnv1a_hash(data, num_bytes); }
+
+template <typename T>
+void append_to_log(std::vector<char>& log, const T& value) {
+  const auto* bytes = reinterpret_cast<const char*>(&value);
+  log.insert(log.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T read_from_log(const std::vector<char>& log, const uint64_t position) {
+  T value;
+  std::memcpy(&value, log.data() + position, sizeof(T));
+  return value;
+}
+
+}  // namespace
+
+namespace keva {
+
+WriteAheadLog::WriteAheadLog(std::string log_file_name) : _log_file_name(std::move(log_file_name)) {
+  _fd = open(_log_file_name.c_str(), O_RDWR | O_CREAT, 0644);
+  Assert(_fd >= 0, "Failed to open write-ahead log '" + _log_file_name + "'.");
+
+  struct stat file_stat {};
+  Assert(fstat(_fd, &file_stat) == 0, "Failed to read size of write-ahead log.");
+  _log_size = static_cast<uint64_t>(file_stat.st_size);
+}
+
+WriteAheadLog::~WriteAheadLog() { close(_fd); }
+
+void WriteAheadLog::append_write(std::vector<char>& txn_log, const FileOffset offset, const char* data,
+                                 const uint32_t num_bytes) {
+  append_to_log(txn_log, LogRecordType::Write);
+  append_to_log(txn_log, offset);
+  append_to_log(txn_log, num_bytes);
+  txn_log.insert(txn_log.end(), data, data + num_bytes);
+}
+
+void WriteAheadLog::commit(const std::vector<char>& txn_log) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  Assert(!_has_failed, "Write-ahead log failed to write an earlier commit.");
+
+  _pending_log.insert(_pending_log.end(), txn_log.begin(), txn_log.end());
+  append_to_log(_pending_log, LogRecordType::Commit);
+  append_to_log(_pending_log, static_cast<uint64_t>(txn_log.size()));
+  append_to_log(_pending_log, checksum(txn_log.data(), txn_log.size()));
+  const auto commit_id = ++_num_appended_commits;
+
+  while (_num_synced_commits < commit_id) {
+    Assert(!_has_failed, "Failed to write write-ahead log.");
+    if (_is_syncing) {
+      // Another committer is the leader of the current group. Our records are part of the next group.
+      _synced.wait(lock);
+      continue;
+    }
+
+    // Become the leader and sync everything that was appended so far
+    _is_syncing = true;
+    std::vector<char> group_log;
+    group_log.swap(_pending_log);
+    const auto group_commit_id = _num_appended_commits;
+    const auto log_offset = _log_size;
+
+    lock.unlock();
+    const auto is_written = _write_to_log(group_log, log_offset);
+    const auto is_synced = is_written && fdatasync(_fd) == 0;
+    lock.lock();
+
+    // The group is only durable if the sync succeeded. Otherwise its commits and all waiting ones fail, and the next
+    // group would not start behind it.
+    _is_syncing = false;
+    _num_syncs++;
+    if (is_synced) {
+      _num_synced_commits = group_commit_id;
+      _log_size += group_log.size();
+    } else {
+      _has_failed = true;
+    }
+    _synced.notify_all();
+  }
+}
+
+uint64_t WriteAheadLog::recover(const RecordApplier& apply_record) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  std::vector<char> log(_log_size);
+  auto bytes_read = 0ull;
+  while (bytes_read < log.size()) {
+    const auto result = pread(_fd, log.data() + bytes_read, log.size() - bytes_read, bytes_read);
+    Assert(result > 0, "Failed to read write-ahead log.");
+    bytes_read += result;
+  }
+
+  uint64_t num_transactions = 0;
+  uint64_t txn_begin = 0;
+  uint64_t position = 0;
+
+  while (position < log.size()) {
+    const auto record_type = read_from_log<LogRecordType>(log, position);
+
+    if (record_type == LogRecordType::Write) {
+      if (position + WRITE_RECORD_HEADER_SIZE > log.size()) break;
+      const auto num_bytes = read_from_log<uint32_t>(log, position + 9);
+      position += WRITE_RECORD_HEADER_SIZE + num_bytes;
+      continue;
+    }
+
+    if (record_type != LogRecordType::Commit || position + COMMIT_RECORD_SIZE > log.size()) break;
+
+    const auto txn_size = read_from_log<uint64_t>(log, position + 1);
+    const auto txn_checksum = read_from_log<uint64_t>(log, position + 9);
+    if (txn_size != position - txn_begin || txn_checksum != checksum(log.data() + txn_begin, txn_size)) break;
+
+    // Transaction is complete, replay all of its writes
+    for (auto record_pos = txn_begin; record_pos < position;) {
+      const auto offset = read_from_log<FileOffset>(log, record_pos + 1);
+      const auto num_bytes = read_from_log<uint32_t>(log, record_pos + 9);
+      apply_record(offset, log.data() + record_pos + WRITE_RECORD_HEADER_SIZE, num_bytes);
+      record_pos += WRITE_RECORD_HEADER_SIZE + num_bytes;
+    }
+
+    num_transactions++;
+    position += COMMIT_RECORD_SIZE;
+    txn_begin = position;
+  }
+
+  return num_transactions;
+}
+
+void WriteAheadLog::truncate() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Assert(!_is_syncing && _pending_log.empty(), "Cannot truncate write-ahead log during a commit.");
+  Assert(ftruncate(_fd, 0) == 0 && fdatasync(_fd) == 0, "Failed to truncate write-ahead log.");
+  _log_size = 0;
+}
+
+uint64_t WriteAheadLog::size() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _log_size;
+}
+
+uint64_t WriteAheadLog::num_syncs() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _num_syncs;
+}
+
+bool WriteAheadLog::_write_to_log(const std::vector<char>& data, const uint64_t offset) {
+  auto bytes_written = 0ull;
+  while (bytes_written < data.size()) {
+    const auto result = pwrite(_fd, data.data() + bytes_written, data.size() - bytes_written, offset + bytes_written);
+    if (result <= 0) return false;
+    bytes_written += result;
+  }
+  return true;
+}
+
+}  // namespace keva
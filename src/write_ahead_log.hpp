@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+#include "utils.hpp"
+
+namespace keva {
+
+// Redo log of physical writes to the database file. A transaction is collected in a local buffer with append_write
+// and handed to commit as a whole, so records of concurrent transactions never interleave in the log.
+class WriteAheadLog : public Noncopyable {
+ public:
+  using RecordApplier = std::function<void(FileOffset, const char*, uint32_t)>;
+
+  explicit WriteAheadLog(std::string log_file_name);
+  ~WriteAheadLog();
+
+  static void append_write(std::vector<char>& txn_log, FileOffset offset, const char* data, uint32_t num_bytes);
+
+  // Appends the transaction to the log and returns once it is durable. Commits that arrive while another commit is
+  // syncing are written together with a single fdatasync. Throws if the write or sync of its group fails. A failed sync
+  // may have dropped written data, so all later commits throw as well.
+  void commit(const std::vector<char>& txn_log);
+
+  // Calls apply_record for all writes of committed transactions in log order. A torn or corrupted tail is ignored.
+  // Returns the number of replayed transactions.
+  uint64_t recover(const RecordApplier& apply_record) const;
+
+  // Drop all records. Only call this once all logged writes are durable in the database file.
+  void truncate();
+
+  uint64_t size() const;
+  uint64_t num_syncs() const;
+
+ protected:
+  bool _write_to_log(const std::vector<char>& data, uint64_t offset);
+
+  const std::string _log_file_name;
+  int _fd = -1;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _synced;
+  std::vector<char> _pending_log;
+  bool _is_syncing = false;
+  bool _has_failed = false;
+  uint64_t _num_appended_commits = 0;
+  uint64_t _num_synced_commits = 0;
+  uint64_t _num_syncs = 0;
+  uint64_t _log_size = 0;
+};
+
+}  // namespace keva
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+namespace keva {
+
+enum class WriteType : uint8_t { Put, Remove };
+
+template <typename Key>
+struct BasicWriteOperation {
+  WriteType type;
+  Key key;
+  FileValue value;
+};
+
+// Collects puts and removes that DBManager::write applies atomically. Operations on the same key are applied in the
+// order in which they were added, e.g., a remove followed by a put replaces the value of an existing key.
+template <typename Key>
+class BasicWriteBatch {
+ public:
+  void put(Key key, FileValue value) { _operations.push_back({WriteType::Put, std::move(key), std::move(value)}); }
+  void remove(Key key) { _operations.push_back({WriteType::Remove, std::move(key), {}}); }
+  void clear() { _operations.clear(); }
+
+  uint64_t size() const { return _operations.size(); }
+  bool empty() const { return _operations.empty(); }
+  const std::vector<BasicWriteOperation<Key>>& operations() const { return _operations; }
+
+ protected:
+  std::vector<BasicWriteOperation<Key>> _operations;
+};
+
+using WriteOperation = BasicWriteOperation<FileKey>;
+using WriteBatch = BasicWriteBatch<FileKey>;
+
+// Batch for StringDBManager::write
+using StringWriteBatch = BasicWriteBatch<std::string>;
+
+}  // namespace keva
@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <random>
+
+#include "async_reader.hpp"
+#include "test_utils.hpp"
+
+namespace keva {
+
+// Submits at most one read per call and fails the submit with failing_submit (1-based) with error
+class FlakyAsyncReader : public AsyncReader {
+ public:
+  FlakyAsyncReader(const int fd, const uint32_t queue_depth, const uint32_t failing_submit, const int error)
+      : AsyncReader(fd, queue_depth), _failing_submit(failing_submit), _error(error) {}
+
+ protected:
+  int _enter(const uint32_t to_submit, const uint32_t min_complete, const uint32_t flags) override {
+    if (to_submit > 0 && ++_num_submits == _failing_submit) {
+      errno = _error;
+      return -1;
+    }
+    return AsyncReader::_enter(std::min(to_submit, 1u), min_complete, flags);
+  }
+
+  const uint32_t _failing_submit;
+  const int _error;
+  uint32_t _num_submits = 0;
+};
+
+class AsyncReaderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    _file_name = get_random_temp_file_name();
+    _content.resize(1024 * 1024);
+    std::mt19937 random_engine{17};
+    for (auto& byte : _content) byte = static_cast<char>(random_engine());
+    std::ofstream{_file_name, std::ios::binary}.write(_content.data(), _content.size());
+    _fd = open(_file_name.c_str(), O_RDONLY);
+  }
+
+  void TearDown() override {
+    close(_fd);
+    std::remove(_file_name.data());
+  }
+
+  // Reads many ranges of different sizes, more than fit into the queue at once
+  void _expect_ranges_are_read(AsyncReader& reader) const {
+    std::mt19937 random_engine{3};
+    std::vector<std::vector<char>> buffers(500);
+    std::vector<ReadRequest> requests;
+    for (auto& buffer : buffers) {
+      buffer.resize(1 + random_engine() % 9'000);
+      const auto offset = random_engine() % (_content.size() - buffer.size());
+      requests.push_back({offset, static_cast<uint32_t>(buffer.size()), buffer.data()});
+    }
+    reader.read(requests);
+
+    for (const auto& request : requests) {
+      ASSERT_TRUE(std::equal(request.data, request.data + request.num_bytes, _content.begin() + request.offset));
+    }
+  }
+
+  std::string _file_name;
+  std::vector<char> _content;
+  int _fd = -1;
+};
+
+TEST_F(AsyncReaderTest, ReadsRanges) {
+  // Falls back to pread if io_uring is not available
+  AsyncReader reader{_fd, 16};
+  _expect_ranges_are_read(reader);
+  _expect_ranges_are_read(reader);
+}
+
+TEST_F(AsyncReaderTest, Pread) {
+  AsyncReader reader{_fd, 16, false};
+  EXPECT_FALSE(reader.uses_io_uring());
+  _expect_ranges_are_read(reader);
+  EXPECT_THROW((AsyncReader{_fd, 0}), std::logic_error);
+}
+
+TEST_F(AsyncReaderTest, ReadBeyondEndOfFile) {
+  AsyncReader reader{_fd, 4};
+  std::vector<char> buffer(100);
+  EXPECT_THROW(reader.read({{_content.size() - 10, 100, buffer.data()}, {0, 10, buffer.data()}}), std::logic_error);
+
+  // The reader can still be used afterwards
+  _expect_ranges_are_read(reader);
+}
+
+TEST_F(AsyncReaderTest, ShortAndInterruptedSubmits) {
+  FlakyAsyncReader reader{_fd, 16, 3, EINTR};
+  const auto uses_io_uring = reader.uses_io_uring();
+  _expect_ranges_are_read(reader);
+  EXPECT_EQ(reader.uses_io_uring(), uses_io_uring);
+}
+
+TEST_F(AsyncReaderTest, FailedSubmitFallsBackToPread) {
+  // The first two reads are in flight when the third submit fails
+  FlakyAsyncReader reader{_fd, 16, 3, EIO};
+  _expect_ranges_are_read(reader);
+  EXPECT_FALSE(reader.uses_io_uring());
+  _expect_ranges_are_read(reader);
+}
+
+}  // namespace keva
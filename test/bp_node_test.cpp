@@ -566,4 +566,40 @@ TEST_F(BPNodeTest, SplitInternalNodeOddNumberKeysLeft) {
   EXPECT_EQ(node.children(), expected_old_values);
 }
 
+TEST_F(BPNodeTest, SplitInternalNodeWithoutInsert) {
+  const BPNodeHeader header{196, false, 144, InvalidNodeID, InvalidNodeID, 5};
+  BPNode node{header, {1, 3, 5, 7, 9}, {12, 24, 36, 48, 60, 72}};
+
+  const auto [new_node, median_key] = node.split_internal();
+  EXPECT_EQ(median_key, 5u);
+
+  EXPECT_EQ(new_node.header().num_keys, 2u);
+  EXPECT_EQ(new_node.header().parent_id, header.parent_id);
+  EXPECT_EQ(new_node.keys(), (std::vector<FileKey>{7, 9}));
+  EXPECT_EQ(new_node.children(), (std::vector<NodeID>{48, 60, 72}));
+
+  EXPECT_EQ(node.header().num_keys, 2u);
+  EXPECT_EQ(node.keys(), (std::vector<FileKey>{1, 3}));
+  EXPECT_EQ(node.children(), (std::vector<NodeID>{12, 24, 36}));
+}
+
+TEST_F(BPNodeTest, EraseChildOfInternalNode) {
+  const BPNodeHeader header{196, false, 144, InvalidNodeID, InvalidNodeID, 3};
+  BPNode node{header, {1, 3, 5}, {12, 24, 36, 48}};
+
+  // Inner children take the key on their left with them, the first child the key on its right
+  node.erase_child(2);
+  EXPECT_EQ(node.keys(), (std::vector<FileKey>{1, 5}));
+  EXPECT_EQ(node.children(), (std::vector<NodeID>{12, 24, 48}));
+
+  node.erase_child(0);
+  EXPECT_EQ(node.keys(), (std::vector<FileKey>{5}));
+  EXPECT_EQ(node.children(), (std::vector<NodeID>{24, 48}));
+
+  node.erase_child(1);
+  node.erase_child(0);
+  EXPECT_EQ(node.header().num_keys, 0u);
+  EXPECT_TRUE(node.children().empty());
+}
+
 }  // namespace keva
@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+
+#include "bp_node_view.hpp"
+#include "file_manager.hpp"
+#include "test_utils.hpp"
+
+namespace keva {
+
+class BPNodeViewTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    _node_offset = _file_manager.get_next_node_position();
+    const BPNodeHeader header{_node_offset, false, 12, InvalidNodeID, InvalidNodeID, 4};
+    _file_manager.write_node(BPNode{header, {1, 3, 5, 7}, {12, 24, 36, 48, 60}});
+
+    _leaf_offset = _file_manager.get_next_node_position();
+    const BPNodeHeader leaf_header{_leaf_offset, true, _node_offset, 1000, 2000, 4};
+    _file_manager.write_node(BPNode{leaf_header, {1, 3, 5, 7}, {12, 24, 36, 48}});
+  }
+
+  FileManager _file_manager{8, 5};
+  NodePage _buffer{};
+  FileOffset _node_offset = InvalidNodeID;
+  FileOffset _leaf_offset = InvalidNodeID;
+};
+
+TEST_F(BPNodeViewTest, ReadHeaderKeysAndChildren) {
+  const auto view = _file_manager.view_node(_leaf_offset, _buffer);
+  const auto header = view.header();
+
+  EXPECT_EQ(header.node_id, _leaf_offset);
+  EXPECT_TRUE(header.is_leaf);
+  EXPECT_EQ(header.parent_id, _node_offset);
+  EXPECT_EQ(header.next_leaf, 1000u);
+  EXPECT_EQ(header.previous_leaf, 2000u);
+  EXPECT_EQ(header.num_keys, 4);
+
+  const auto keys = view.keys();
+  ASSERT_EQ(keys.size(), 4);
+  EXPECT_EQ(keys.front(), 1u);
+  EXPECT_EQ(keys[2], 5u);
+  EXPECT_EQ(keys.back(), 7u);
+
+  const auto children = view.children();
+  ASSERT_EQ(children.size(), 4);
+  EXPECT_EQ(children[1], 24u);
+}
+
+TEST_F(BPNodeViewTest, SearchLikeBPNode) {
+  const auto node = _file_manager.load_node(_node_offset);
+  const auto node_view = _file_manager.view_node(_node_offset, _buffer);
+  ASSERT_EQ(node_view.children().size(), 5);
+
+  for (FileKey key = 0; key < 10; ++key) {
+    EXPECT_EQ(node_view.find_child(key), node.find_child(key));
+    EXPECT_EQ(node_view.find_child_insert_position(key), node.find_child_insert_position(key));
+  }
+
+  const auto leaf = _file_manager.load_node(_leaf_offset);
+  const auto leaf_view = _file_manager.view_node(_leaf_offset, _buffer);
+  for (FileKey key = 0; key < 10; ++key) {
+    EXPECT_EQ(leaf_view.find_value(key), leaf.find_value(key));
+    EXPECT_EQ(leaf_view.find_value_insert_position(key), leaf.find_value_insert_position(key));
+  }
+}
+
+TEST_F(BPNodeViewTest, ViewCachedPage) {
+  DBOptions options;
+  options.buffer_pool_size = 4 * DEFAULT_PAGE_SIZE;
+  const auto file_name = get_random_temp_file_name();
+  {
+    FileManager file_manager{file_name, 8, 5, options};
+    const auto offset = file_manager.get_next_node_position();
+    file_manager.write_node(BPNode{{offset, true, InvalidNodeID, InvalidNodeID, InvalidNodeID, 2}, {4, 8}, {16, 32}});
+
+    // The view points into the pool frame, so the buffer is not touched
+    NodePage buffer{};
+    const auto view = file_manager.view_node(offset, buffer);
+    EXPECT_EQ(view.find_value(8), 32u);
+    EXPECT_EQ(buffer.data()[0], 0);
+  }
+  std::remove(file_name.data());
+}
+
+TEST_F(BPNodeViewTest, NodePageOnlyGrowsForLargePages) {
+  // Buffers on the stack only hold a default page
+  EXPECT_LT(sizeof(NodePage), 2 * DEFAULT_PAGE_SIZE);
+
+  NodePage page;
+  auto* inline_page = page.data(DEFAULT_PAGE_SIZE);
+  EXPECT_EQ(page.data(LEGACY_PAGE_SIZE), inline_page);
+
+  auto* large_page = page.data(MAX_PAGE_SIZE);
+  EXPECT_NE(large_page, inline_page);
+  large_page[MAX_PAGE_SIZE - 1] = 1;
+  EXPECT_EQ(page.data(DEFAULT_PAGE_SIZE), large_page);
+  EXPECT_EQ(page.data()[MAX_PAGE_SIZE - 1], 1);
+}
+
+}  // namespace keva
@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+
+#include <map>
+
+#include "buffer_pool.hpp"
+
+namespace keva {
+
+class BufferPoolTest : public ::testing::Test {
+ protected:
+  BufferPool _create_pool(const uint32_t num_frames) {
+    auto page_reader = [&](const FileOffset offset, char* page) {
+      _num_reads++;
+      std::fill(page, page + DEFAULT_PAGE_SIZE, _file[offset]);
+    };
+    auto page_writer = [&](const FileOffset offset, const char* page) {
+      _num_writes++;
+      _file[offset] = page[0];
+    };
+    return BufferPool(num_frames * DEFAULT_PAGE_SIZE, DEFAULT_PAGE_SIZE, page_reader, page_writer);
+  }
+
+  // Each "page" is filled with a single char
+  std::map<FileOffset, char> _file = {{100, 'a'}, {200, 'b'}, {300, 'c'}, {400, 'd'}};
+  uint32_t _num_reads = 0;
+  uint32_t _num_writes = 0;
+};
+
+TEST_F(BufferPoolTest, SimpleCreate) {
+  auto pool = _create_pool(4);
+  EXPECT_EQ(pool.num_frames(), 4u);
+  EXPECT_THROW(BufferPool(DEFAULT_PAGE_SIZE - 1, DEFAULT_PAGE_SIZE, nullptr, nullptr), std::logic_error);
+}
+
+TEST_F(BufferPoolTest, ReadPageOnlyOnce) {
+  auto pool = _create_pool(4);
+
+  EXPECT_EQ(pool.read_page(100)[0], 'a');
+  EXPECT_EQ(pool.read_page(100)[0], 'a');
+  EXPECT_EQ(pool.read_page(200)[0], 'b');
+
+  EXPECT_EQ(_num_reads, 2u);
+  EXPECT_EQ(pool.stats().hits, 1u);
+  EXPECT_EQ(pool.stats().misses, 2u);
+  EXPECT_EQ(pool.stats().evictions, 0u);
+}
+
+TEST_F(BufferPoolTest, WritePageIsDeferred) {
+  auto pool = _create_pool(4);
+
+  pool.write_page(100, true)[0] = 'x';
+  pool.write_page(500, false)[0] = 'y';
+  EXPECT_EQ(_num_reads, 1u);
+  EXPECT_EQ(_num_writes, 0u);
+  EXPECT_EQ(pool.read_page(100)[0], 'x');
+
+  pool.flush();
+  EXPECT_EQ(_num_writes, 2u);
+  EXPECT_EQ(_file[100], 'x');
+  EXPECT_EQ(_file[500], 'y');
+
+  // Clean pages are not written again
+  pool.flush();
+  EXPECT_EQ(_num_writes, 2u);
+}
+
+TEST_F(BufferPoolTest, ClockEviction) {
+  auto pool = _create_pool(2);
+
+  pool.read_page(100);
+  pool.read_page(200);
+
+  // Both pages are referenced, so the clock clears both and evicts the first one
+  pool.read_page(300);
+  EXPECT_EQ(pool.stats().evictions, 1u);
+
+  // 200 was not referenced since the last sweep, so it is evicted and 300 stays
+  pool.read_page(400);
+  EXPECT_EQ(pool.stats().evictions, 2u);
+
+  const auto misses = pool.stats().misses;
+  pool.read_page(300);
+  EXPECT_EQ(pool.stats().misses, misses);
+  pool.read_page(200);
+  EXPECT_EQ(pool.stats().misses, misses + 1);
+}
+
+TEST_F(BufferPoolTest, EvictDirtyPage) {
+  auto pool = _create_pool(1);
+
+  pool.write_page(100, true)[0] = 'x';
+  EXPECT_EQ(_num_writes, 0u);
+
+  pool.read_page(200);
+  EXPECT_EQ(_num_writes, 1u);
+  EXPECT_EQ(_file[100], 'x');
+  EXPECT_EQ(pool.stats().write_backs, 1u);
+}
+
+}  // namespace keva
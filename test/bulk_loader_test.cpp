@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "bulk_loader.hpp"
+#include "test_utils.hpp"
+
+namespace keva {
+
+class BulkLoaderTest : public ::testing::Test {
+ protected:
+  BulkLoadEntryGenerator _generate_entries(const uint64_t key_step) {
+    return [this, key_step]() {
+      const auto key = _next_key;
+      _next_key += key_step;
+      return BulkLoadEntry{key, convert_to_file_value(key * 10)};
+    };
+  }
+
+  FileKey _next_key = 0;
+};
+
+TEST_F(BulkLoaderTest, SingleLeaf) {
+  FileManager file_manager{8, 5};
+  BulkLoader bulk_loader{file_manager, 5, 1.0};
+
+  const auto root_id = bulk_loader.load(4, _generate_entries(1));
+  const auto root = file_manager.load_node(root_id);
+
+  EXPECT_TRUE(nodes_equal(root, TestBPNode::new_leaf({0, 1, 2, 3})));
+  EXPECT_EQ(root.header().parent_id, InvalidNodeID);
+  EXPECT_EQ(root.header().next_leaf, InvalidNodeID);
+  EXPECT_EQ(root.header().previous_leaf, InvalidNodeID);
+  EXPECT_EQ(convert_from_file_value<uint64_t>(file_manager.get_value(root.children()[3])), 30u);
+}
+
+TEST_F(BulkLoaderTest, PackedLevels) {
+  FileManager file_manager{8, 3};
+  BulkLoader bulk_loader{file_manager, 3, 1.0};
+
+  // 10 keys in leaves of 3 (distributed as 2/3/2/3), internal nodes of up to 4 children
+  const auto root_id = bulk_loader.load(10, _generate_entries(1));
+  const auto root = file_manager.load_node(root_id);
+
+  const auto leaf_1 = TestBPNode::new_leaf({0, 1});
+  const auto leaf_2 = TestBPNode::new_leaf({2, 3, 4});
+  const auto leaf_3 = TestBPNode::new_leaf({5, 6});
+  const auto leaf_4 = TestBPNode::new_leaf({7, 8, 9});
+  const auto expected_root = TestBPNode::new_node({2, 5, 7}, {leaf_1, leaf_2, leaf_3, leaf_4});
+  EXPECT_TRUE(trees_equal(root, expected_root, file_manager));
+
+  // Leaves are linked, know their parent and hold their 8 byte values inline, so they directly follow each other
+  NodeID previous_leaf = InvalidNodeID;
+  for (auto i = 0u; i < root.children().size(); ++i) {
+    const auto leaf = file_manager.load_node(root.children()[i]);
+    EXPECT_EQ(leaf.header().parent_id, root_id);
+    EXPECT_EQ(leaf.header().previous_leaf, previous_leaf);
+    EXPECT_EQ(convert_from_file_value<uint64_t>(file_manager.get_value(leaf.children().front())),
+              leaf.keys().front() * 10);
+    if (previous_leaf != InvalidNodeID) {
+      EXPECT_EQ(leaf.header().node_id, previous_leaf + DEFAULT_PAGE_SIZE);
+    }
+
+    const auto is_last = i + 1 == root.children().size();
+    EXPECT_EQ(leaf.header().next_leaf, is_last ? InvalidNodeID : root.children()[i + 1]);
+    previous_leaf = leaf.header().node_id;
+  }
+}
+
+TEST_F(BulkLoaderTest, ValuesFollowTheirLeaf) {
+  FileManager file_manager{0, 3};
+  BulkLoader bulk_loader{file_manager, 3, 1.0};
+
+  FileKey next_key = 0;
+  const auto next_entry = [&]() {
+    const auto key = next_key++;
+    return BulkLoadEntry{key, convert_to_file_value(std::to_string(key))};
+  };
+  const auto root = file_manager.load_node(bulk_loader.load(10, next_entry));
+
+  for (const auto leaf_id : root.children()) {
+    const auto leaf = file_manager.load_node(leaf_id);
+    EXPECT_EQ(leaf.children().front(), leaf_id + DEFAULT_PAGE_SIZE);
+    EXPECT_EQ(convert_from_file_value<std::string>(file_manager.get_value(leaf.children().back())),
+              std::to_string(leaf.keys().back()));
+  }
+}
+
+TEST_F(BulkLoaderTest, RejectUnsortedKeys) {
+  FileManager file_manager{8, 5};
+  BulkLoader bulk_loader{file_manager, 5, 1.0};
+
+  std::vector<FileKey> keys = {1, 2, 4, 3};
+  auto key_it = keys.begin();
+  const auto next_entry = [&]() { return BulkLoadEntry{*key_it++, convert_to_file_value(uint64_t{1})}; };
+  EXPECT_THROW(bulk_loader.load(keys.size(), next_entry), std::runtime_error);
+
+  EXPECT_THROW(BulkLoader(file_manager, 5, 0.0), std::logic_error);
+  EXPECT_THROW(BulkLoader(file_manager, 5, 1.5), std::logic_error);
+}
+
+}  // namespace keva
@@ -0,0 +1,153 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+
+#include "cursor.hpp"
+#include "db_manager.hpp"
+#include "test_utils.hpp"
+
+namespace keva {
+
+class CursorTest : public ::testing::Test {
+ protected:
+  // Fills the database with the keys 0, 2, 4, ... with the value key * 10
+  void _fill(DBManager& db_manager, const uint64_t num_entries) {
+    std::vector<FileKey> keys(num_entries);
+    for (auto i = 0u; i < num_entries; ++i) keys[i] = i * 2;
+    std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+
+    for (const auto key : keys) db_manager.put(key, convert_to_file_value(key * 10));
+  }
+};
+
+TEST_F(CursorTest, EmptyDatabase) {
+  DBManager db_manager{8, 5};
+  auto cursor = db_manager.cursor();
+  EXPECT_FALSE(cursor.seek(0));
+  EXPECT_FALSE(cursor.seek_to_first());
+  EXPECT_FALSE(cursor.seek_to_last());
+  EXPECT_FALSE(cursor.is_valid());
+}
+
+TEST_F(CursorTest, SeekAndIterateForward) {
+  DBManager db_manager{8, 5};
+  _fill(db_manager, 500);
+
+  auto cursor = db_manager.cursor(7);
+  ASSERT_TRUE(cursor.seek(101));
+
+  uint64_t expected_key = 102;
+  for (; cursor.is_valid(); cursor.next()) {
+    ASSERT_EQ(cursor.key(), expected_key);
+    ASSERT_EQ(convert_from_file_value<uint64_t>(cursor.value()), expected_key * 10);
+    expected_key += 2;
+  }
+  EXPECT_EQ(expected_key, 1000u);
+
+  ASSERT_TRUE(cursor.seek(0));
+  EXPECT_EQ(cursor.key(), 0u);
+  EXPECT_FALSE(cursor.seek(999));
+}
+
+TEST_F(CursorTest, IterateBackward) {
+  DBManager db_manager{8, 5};
+  _fill(db_manager, 500);
+
+  auto cursor = db_manager.cursor(3);
+  ASSERT_TRUE(cursor.seek_to_last());
+
+  uint64_t expected_key = 998;
+  auto num_entries = 0u;
+  for (; cursor.is_valid(); cursor.prev()) {
+    ASSERT_EQ(cursor.key(), expected_key);
+    ASSERT_EQ(convert_from_file_value<uint64_t>(cursor.value()), expected_key * 10);
+    expected_key -= 2;
+    ++num_entries;
+  }
+  EXPECT_EQ(num_entries, 500u);
+}
+
+TEST_F(CursorTest, ChangeDirection) {
+  DBManager db_manager{8, 5};
+  _fill(db_manager, 100);
+
+  auto cursor = db_manager.cursor(4);
+  ASSERT_TRUE(cursor.seek(50));
+  EXPECT_EQ(convert_from_file_value<uint64_t>(cursor.value()), 500u);
+
+  for (auto i = 0u; i < 10; ++i) ASSERT_TRUE(cursor.next());
+  EXPECT_EQ(cursor.key(), 70u);
+  EXPECT_EQ(convert_from_file_value<uint64_t>(cursor.value()), 700u);
+
+  for (auto i = 0u; i < 20; ++i) ASSERT_TRUE(cursor.prev());
+  EXPECT_EQ(cursor.key(), 30u);
+  EXPECT_EQ(convert_from_file_value<uint64_t>(cursor.value()), 300u);
+
+  ASSERT_TRUE(cursor.seek_to_first());
+  EXPECT_FALSE(cursor.prev());
+}
+
+TEST_F(CursorTest, UpperBound) {
+  DBManager db_manager{8, 5};
+  _fill(db_manager, 100);
+
+  auto cursor = db_manager.cursor(DEFAULT_SCAN_BATCH_SIZE, 51);
+  ASSERT_TRUE(cursor.seek(46));
+  EXPECT_TRUE(cursor.next());
+  EXPECT_TRUE(cursor.next());
+  EXPECT_EQ(cursor.key(), 50u);
+  EXPECT_FALSE(cursor.next());
+
+  ASSERT_TRUE(cursor.seek_to_last());
+  EXPECT_EQ(cursor.key(), 50u);
+  EXPECT_FALSE(cursor.seek(52));
+}
+
+TEST_F(CursorTest, Scan) {
+  DBManager db_manager{0, 7};
+  for (uint64_t key = 0; key < 1'000; ++key) {
+    db_manager.put(key, convert_to_file_value(std::string(key % 50 + 1, 'a')));
+  }
+
+  std::vector<FileKey> keys;
+  db_manager.scan(100, 299, [&](const FileKey key, const FileValue& value) {
+    keys.push_back(key);
+    EXPECT_EQ(convert_from_file_value<std::string>(value), std::string(key % 50 + 1, 'a'));
+  });
+
+  ASSERT_EQ(keys.size(), 200u);
+  for (auto i = 0u; i < keys.size(); ++i) EXPECT_EQ(keys[i], 100 + i);
+
+  auto num_calls = 0u;
+  db_manager.scan(2'000, 3'000, [&](FileKey, const FileValue&) { ++num_calls; });
+  db_manager.scan(10, 5, [&](FileKey, const FileValue&) { ++num_calls; });
+  EXPECT_EQ(num_calls, 0u);
+}
+
+TEST_F(CursorTest, ScanBulkLoadedValues) {
+  // Bulk loaded values are stored contiguously behind their leaf, so they are read together
+  for (const auto value_size : {0, 8}) {
+    DBManager db_manager{static_cast<uint16_t>(value_size), 15};
+    uint64_t next_key = 0;
+    db_manager.bulk_load(5'000, [&]() {
+      const auto key = next_key++;
+      const auto value = value_size == 0 ? convert_to_file_value(std::to_string(key)) : convert_to_file_value(key);
+      return BulkLoadEntry{key, value};
+    });
+
+    uint64_t expected_key = 0;
+    db_manager.scan(0, 10'000, [&](const FileKey key, const FileValue& value) {
+      ASSERT_EQ(key, expected_key);
+      if (value_size == 0) {
+        ASSERT_EQ(convert_from_file_value<std::string>(value), std::to_string(key));
+      } else {
+        ASSERT_EQ(convert_from_file_value<uint64_t>(value), key);
+      }
+      ++expected_key;
+    });
+    EXPECT_EQ(expected_key, 5'000u);
+  }
+}
+
+}  // namespace keva
@@ -1,5 +1,14 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <thread>
+
 #include "db_manager.hpp"
 #include "test_utils.hpp"
 
@@ -266,7 +275,6 @@ TEST_F(DBManagerTest, Put100Values) {
   }
 }
 
-
 TEST_F(DBManagerTest, Put10kValues) {
   DBManager db_manager{0, 15};
   const auto num_iterations = 10'000;
@@ -303,4 +311,1261 @@ TEST_F(DBManagerTest, Put100kValues) {
   EXPECT_TRUE(tree_is_valid(db_manager));
 }
 
+TEST_F(DBManagerTest, ReopenDatabase) {
+  const auto file_name = get_random_temp_file_name();
+  const auto num_iterations = 1'000u;
+
+  {
+    DBManager db_manager{file_name, 8, 5};
+    for (uint64_t i = 0; i < num_iterations; ++i) {
+      db_manager.put(i, convert_to_file_value(i * i));
+    }
+  }
+
+  DBManager db_manager{file_name, 8, 5};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  for (uint64_t i = 0; i < num_iterations; ++i) {
+    EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(i)), i * i);
+  }
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, MemoryMappedPutAndGet) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.storage_mode = StorageMode::MemoryMapped;
+  const auto num_iterations = 10'000u;
+
+  {
+    DBManager db_manager{file_name, 0, 15, options};
+    for (uint64_t i = 0; i < num_iterations; ++i) {
+      db_manager.put(i, convert_to_file_value(std::to_string(i) + "abc"));
+    }
+    EXPECT_TRUE(tree_is_valid(db_manager));
+  }
+
+  // Reopen mapped and check all values
+  DBManager db_manager{file_name, 0, 15, options};
+  for (uint64_t i = 0; i < num_iterations; ++i) {
+    EXPECT_EQ(convert_from_file_value<std::string>(db_manager.get(i)), std::to_string(i) + "abc");
+  }
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, BufferPoolPutAndGet) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.buffer_pool_size = 16 * DEFAULT_PAGE_SIZE;
+  const auto num_iterations = 10'000u;
+
+  {
+    DBManager db_manager{file_name, 8, 15, options};
+    for (uint64_t i = 0; i < num_iterations; ++i) {
+      db_manager.put(i, convert_to_file_value(i * 2));
+    }
+    EXPECT_TRUE(tree_is_valid(db_manager));
+    EXPECT_GT(db_manager.get_file_manager().buffer_pool()->stats().evictions, 0u);
+  }
+
+  // Dirty pages must have been written back on close
+  DBManager db_manager{file_name, 8, 15};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  for (uint64_t i = 0; i < num_iterations; ++i) {
+    EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(i)), i * 2);
+  }
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, BufferPoolKeepsHotPath) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.buffer_pool_size = 64 * DEFAULT_PAGE_SIZE;
+
+  DBManager db_manager{file_name, 8, 5, options};
+  for (uint64_t i = 0; i < 100; ++i) {
+    db_manager.put(i, convert_to_file_value(i));
+  }
+
+  const auto& stats = db_manager.get_file_manager().buffer_pool()->stats();
+  db_manager.get(42);
+  const auto misses = stats.misses;
+  const auto hits = stats.hits;
+
+  // The whole path of the second lookup is cached
+  db_manager.get(42);
+  EXPECT_EQ(stats.misses, misses);
+  EXPECT_GT(stats.hits, hits);
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, WriteAheadLogPutAndGet) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.enable_wal = true;
+  const auto num_iterations = 2'000u;
+
+  {
+    DBManager db_manager{file_name, 8, 5, options};
+    for (uint64_t i = 0; i < num_iterations; ++i) {
+      db_manager.put(i, convert_to_file_value(i + 1));
+    }
+
+    // One sync for the initial root and one per put
+    EXPECT_EQ(db_manager.get_file_manager().write_ahead_log()->num_syncs(), num_iterations + 1);
+    EXPECT_TRUE(tree_is_valid(db_manager));
+  }
+
+  DBManager db_manager{file_name, 8, 5};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  for (uint64_t i = 0; i < num_iterations; ++i) {
+    EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(i)), i + 1);
+  }
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-wal").data());
+}
+
+TEST_F(DBManagerTest, WriteAheadLogRecovery) {
+  const auto file_name = get_random_temp_file_name();
+  const auto crash_file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.enable_wal = true;
+  options.buffer_pool_size = 1024 * DEFAULT_PAGE_SIZE;  // large enough to keep all pages in memory
+  const auto num_iterations = 1'000u;
+
+  {
+    DBManager db_manager{file_name, 8, 5, options};
+    for (uint64_t i = 0; i < num_iterations; ++i) {
+      db_manager.put(i, convert_to_file_value(i + 1));
+    }
+
+    // Simulate a crash by copying the files while most pages are only in the buffer pool
+    std::ifstream db_file(file_name, std::ios::binary);
+    std::ofstream(crash_file_name, std::ios::binary) << db_file.rdbuf();
+    std::ifstream wal_file(file_name + "-wal", std::ios::binary);
+    std::ofstream(crash_file_name + "-wal", std::ios::binary) << wal_file.rdbuf();
+  }
+
+  DBManager db_manager{crash_file_name, 8, 5, options};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  for (uint64_t i = 0; i < num_iterations; ++i) {
+    EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(i)), i + 1);
+  }
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-wal").data());
+  std::remove(crash_file_name.data());
+  std::remove((crash_file_name + "-wal").data());
+}
+
+TEST_F(DBManagerTest, BulkLoad) {
+  for (const auto fill_factor : {1.0, 0.7, 0.5, 0.1}) {
+    DBManager db_manager{0, 15};
+    const auto num_entries = 10'000u;
+
+    uint64_t next_key = 0;
+    db_manager.bulk_load(num_entries,
+                         [&]() {
+                           const auto key = next_key++;
+                           return BulkLoadEntry{key * 2, convert_to_file_value(std::to_string(key) + "abc")};
+                         },
+                         fill_factor);
+
+    EXPECT_TRUE(tree_is_valid(db_manager)) << "Invalid tree with fill factor " << fill_factor;
+    for (uint64_t key = 0; key < num_entries; ++key) {
+      ASSERT_EQ(convert_from_file_value<std::string>(db_manager.get(key * 2)), std::to_string(key) + "abc");
+      ASSERT_TRUE(db_manager.get(key * 2 + 1).empty());
+    }
+
+    // The tree can be used normally afterwards
+    for (uint64_t key = 0; key < num_entries; ++key) {
+      db_manager.put(key * 2 + 1, convert_to_file_value(std::to_string(key)));
+    }
+    EXPECT_TRUE(tree_is_valid(db_manager));
+    EXPECT_EQ(convert_from_file_value<std::string>(db_manager.get(4001)), "2000");
+  }
+}
+
+TEST_F(DBManagerTest, BulkLoadWithWriteAheadLog) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.enable_wal = true;
+  options.buffer_pool_size = 8 * DEFAULT_PAGE_SIZE;  // much smaller than the loaded tree
+  const auto num_entries = 10'000u;
+
+  {
+    DBManager db_manager{file_name, 8, 15, options};
+    uint64_t next_key = 0;
+    db_manager.bulk_load(num_entries, [&]() {
+      const auto key = next_key++;
+      return BulkLoadEntry{key, convert_to_file_value(key)};
+    });
+  }
+
+  DBManager db_manager{file_name, 8, 15};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  for (uint64_t key = 0; key < num_entries; ++key) {
+    ASSERT_EQ(convert_from_file_value<uint64_t>(db_manager.get(key)), key);
+  }
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-wal").data());
+}
+
+TEST_F(DBManagerTest, BulkLoadIntoNonEmptyDatabase) {
+  DBManager db_manager{8, 5};
+  db_manager.put(1, convert_to_file_value(uint64_t{1}));
+
+  const auto next_entry = []() { return BulkLoadEntry{2, convert_to_file_value(uint64_t{2})}; };
+  EXPECT_THROW(db_manager.bulk_load(1, next_entry), std::logic_error);
+}
+
+TEST_F(DBManagerTest, MultiGet) {
+  DBManager db_manager{0, 5};
+  for (uint64_t key = 0; key < 1'000; key += 2) {
+    db_manager.put(key, convert_to_file_value(std::to_string(key)));
+  }
+
+  // Unsorted keys with duplicates and keys that do not exist
+  std::vector<FileKey> keys;
+  for (uint64_t i = 0; i < 1'500; ++i) keys.push_back((i * 7919) % 1'200);
+
+  const auto values = db_manager.multi_get(keys);
+  ASSERT_EQ(values.size(), keys.size());
+  for (auto i = 0u; i < keys.size(); ++i) {
+    if (keys[i] % 2 == 0 && keys[i] < 1'000) {
+      EXPECT_EQ(convert_from_file_value<std::string>(values[i]), std::to_string(keys[i]));
+    } else {
+      EXPECT_TRUE(values[i].empty()) << "Found value for key " << keys[i];
+    }
+  }
+
+  EXPECT_TRUE(db_manager.multi_get({}).empty());
+}
+
+TEST_F(DBManagerTest, MultiGetFromFile) {
+  for (const auto storage_mode : {StorageMode::Stream, StorageMode::MemoryMapped}) {
+    const auto file_name = get_random_temp_file_name();
+    DBOptions options;
+    options.storage_mode = storage_mode;
+    options.buffer_pool_size = 16 * DEFAULT_PAGE_SIZE;
+
+    DBManager db_manager{file_name, 8, 15, options};
+    for (uint64_t key = 0; key < 5'000; ++key) db_manager.put(key * 3, convert_to_file_value(key));
+
+    std::vector<FileKey> keys;
+    for (uint64_t key = 0; key < 15'000; key += 5) keys.push_back(15'000 - key);
+
+    const auto values = db_manager.multi_get(keys);
+    for (auto i = 0u; i < keys.size(); ++i) {
+      ASSERT_EQ(values[i], db_manager.get(keys[i])) << "Wrong value for key " << keys[i];
+    }
+
+    std::remove(file_name.data());
+  }
+}
+
+// Checks the contents of the tree including the leaf chain in both directions
+void expect_entries(const DBManager& db_manager, const std::map<FileKey, uint64_t>& expected) {
+  std::map<FileKey, uint64_t> entries;
+  db_manager.scan(0, std::numeric_limits<FileKey>::max(), [&](const FileKey key, const FileValue& value) {
+    entries.emplace(key, convert_from_file_value<uint64_t>(value));
+  });
+  EXPECT_EQ(entries, expected);
+
+  auto cursor = db_manager.cursor();
+  auto num_backward = 0u;
+  for (auto is_valid = cursor.seek_to_last(); is_valid; is_valid = cursor.prev()) ++num_backward;
+  EXPECT_EQ(num_backward, expected.size());
+
+  for (const auto& [key, value] : expected) {
+    ASSERT_EQ(convert_from_file_value<uint64_t>(db_manager.get(key)), value) << "Wrong value for key " << key;
+  }
+}
+
+TEST_F(DBManagerTest, WriteBatchInserts) {
+  DBManager db_manager{8, 5};
+  std::map<FileKey, uint64_t> expected;
+
+  std::vector<FileKey> keys(5'000);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{7});
+
+  // The first batch grows the tree by several levels at once, later ones split many nodes
+  for (const auto batch_size : {1'000u, 10u, 1u, 500u, 3'489u}) {
+    WriteBatch batch;
+    for (auto i = 0u; i < batch_size; ++i) {
+      const auto key = keys[expected.size() + i];
+      batch.put(key, convert_to_file_value(key + 1));
+    }
+    for (auto i = 0u; i < batch_size; ++i) expected[keys[expected.size()]] = keys[expected.size()] + 1;
+
+    db_manager.write(batch);
+    ASSERT_TRUE(tree_is_valid(db_manager)) << "Invalid tree after batch of " << batch_size;
+  }
+
+  expect_entries(db_manager, expected);
+
+  // put still works on a tree built by batches
+  db_manager.put(10'000, convert_to_file_value(uint64_t{1}));
+  EXPECT_TRUE(tree_is_valid(db_manager));
+}
+
+TEST_F(DBManagerTest, WriteBatchMixedOperations) {
+  DBManager db_manager{8, 5};
+  std::map<FileKey, uint64_t> expected;
+  for (uint64_t key = 0; key < 200; ++key) {
+    db_manager.put(key, convert_to_file_value(key));
+    expected[key] = key;
+  }
+
+  WriteBatch batch;
+  batch.remove(10);                                 // remove existing
+  batch.remove(1'000);                              // remove missing
+  batch.remove(20);                                 // replace existing
+  batch.put(20, convert_to_file_value(uint64_t{42}));
+  batch.put(500, convert_to_file_value(uint64_t{5}));  // insert and remove again
+  batch.remove(500);
+  batch.put(300, convert_to_file_value(uint64_t{3}));  // insert
+  for (uint64_t key = 100; key < 150; ++key) batch.remove(key);
+
+  db_manager.write(batch);
+
+  expected.erase(10);
+  expected[20] = 42;
+  expected[300] = 3;
+  for (uint64_t key = 100; key < 150; ++key) expected.erase(key);
+  expect_entries(db_manager, expected);
+
+  db_manager.remove(0);
+  db_manager.remove(0);
+  expected.erase(0);
+  expect_entries(db_manager, expected);
+}
+
+TEST_F(DBManagerTest, WriteBatchIsValidatedFirst) {
+  DBManager db_manager{8, 5};
+  db_manager.put(5, convert_to_file_value(uint64_t{5}));
+
+  WriteBatch batch;
+  for (uint64_t key = 0; key < 100; ++key) {
+    if (key != 5) batch.put(key, convert_to_file_value(key));
+  }
+  batch.put(5, convert_to_file_value(uint64_t{6}));
+  EXPECT_THROW(db_manager.write(batch), std::runtime_error);
+
+  expect_entries(db_manager, {{5, 5}});
+}
+
+TEST_F(DBManagerTest, WriteBatchIsOneTransaction) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.enable_wal = true;
+
+  {
+    DBManager db_manager{file_name, 8, 5, options};
+    const auto num_syncs = db_manager.get_file_manager().write_ahead_log()->num_syncs();
+
+    WriteBatch batch;
+    for (uint64_t key = 0; key < 1'000; ++key) batch.put(key, convert_to_file_value(key));
+    db_manager.write(batch);
+
+    EXPECT_EQ(db_manager.get_file_manager().write_ahead_log()->num_syncs(), num_syncs + 1);
+  }
+
+  DBManager db_manager{file_name, 8, 5};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(999)), 999u);
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-wal").data());
+}
+
+TEST_F(DBManagerTest, UpdateAndUpsert) {
+  DBManager db_manager{8, 5};
+  for (uint64_t key = 0; key < 100; ++key) db_manager.put(key, convert_to_file_value(key));
+
+  for (uint64_t key = 0; key < 100; key += 3) db_manager.update(key, convert_to_file_value(key * 2));
+  EXPECT_THROW(db_manager.update(100, convert_to_file_value(uint64_t{1})), std::runtime_error);
+
+  db_manager.upsert(1, convert_to_file_value(uint64_t{11}));
+  db_manager.upsert(100, convert_to_file_value(uint64_t{1'000}));
+
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  for (uint64_t key = 2; key < 100; ++key) {
+    const auto expected = key % 3 == 0 ? key * 2 : key;
+    EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(key)), expected);
+  }
+  EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(1)), 11u);
+  EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(100)), 1'000u);
+
+  // Single leaf root
+  DBManager small_db_manager{8, 5};
+  small_db_manager.upsert(1, convert_to_file_value(uint64_t{1}));
+  small_db_manager.update(1, convert_to_file_value(uint64_t{2}));
+  EXPECT_EQ(convert_from_file_value<uint64_t>(small_db_manager.get(1)), 2u);
+}
+
+TEST_F(DBManagerTest, UpdateVariableSizeValues) {
+  DBManager db_manager{0, 5};
+  for (uint64_t key = 0; key < 100; ++key) db_manager.put(key, convert_to_file_value(std::string(10, 'a')));
+
+  // Shrinking values stay in place, growing ones are moved
+  for (uint64_t key = 0; key < 100; ++key) {
+    const auto value = std::string(key % 2 == 0 ? 5 : 20, 'b');
+    db_manager.update(key, convert_to_file_value(value));
+  }
+
+  // The slot is only as large as the last value
+  db_manager.update(0, convert_to_file_value(std::string(8, 'c')));
+
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  EXPECT_EQ(convert_from_file_value<std::string>(db_manager.get(0)), std::string(8, 'c'));
+  for (uint64_t key = 1; key < 100; ++key) {
+    const auto expected = std::string(key % 2 == 0 ? 5 : 20, 'b');
+    EXPECT_EQ(convert_from_file_value<std::string>(db_manager.get(key)), expected);
+  }
+}
+
+TEST_F(DBManagerTest, UpdateInPlaceDoesNotGrowFile) {
+  const auto file_name = get_random_temp_file_name();
+  const auto file_size = [&]() {
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    return static_cast<uint64_t>(file.tellg());
+  };
+
+  {
+    DBManager db_manager{file_name, 8, 5};
+    for (uint64_t key = 0; key < 1'000; ++key) db_manager.put(key, convert_to_file_value(key));
+  }
+  const auto initial_size = file_size();
+
+  {
+    DBManager db_manager{file_name, 8, 5};
+    for (auto round = 0u; round < 5; ++round) {
+      for (uint64_t key = 0; key < 1'000; ++key) db_manager.update(key, convert_to_file_value(key + round));
+    }
+
+    WriteBatch batch;
+    for (uint64_t key = 0; key < 1'000; ++key) {
+      batch.remove(key);
+      batch.put(key, convert_to_file_value(key * 3));
+    }
+    db_manager.write(batch);
+  }
+
+  EXPECT_EQ(file_size(), initial_size);
+  DBManager db_manager{file_name, 8, 5};
+  for (uint64_t key = 0; key < 1'000; ++key) {
+    ASSERT_EQ(convert_from_file_value<uint64_t>(db_manager.get(key)), key * 3);
+  }
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, UpdateWithWriteAheadLog) {
+  const auto file_name = get_random_temp_file_name();
+  const auto crash_file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.enable_wal = true;
+
+  {
+    DBManager db_manager{file_name, 8, 5, options};
+    for (uint64_t key = 0; key < 100; ++key) db_manager.put(key, convert_to_file_value(key));
+
+    for (uint64_t key = 0; key < 100; ++key) db_manager.update(key, convert_to_file_value(key + 1));
+    EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(42)), 43u);
+
+    // Simulate a crash
+    std::ifstream db_file(file_name, std::ios::binary);
+    std::ofstream(crash_file_name, std::ios::binary) << db_file.rdbuf();
+    std::ifstream wal_file(file_name + "-wal", std::ios::binary);
+    std::ofstream(crash_file_name + "-wal", std::ios::binary) << wal_file.rdbuf();
+  }
+
+  for (const auto& name : {file_name, crash_file_name}) {
+    DBManager db_manager{name, 8, 5, options};
+    for (uint64_t key = 0; key < 100; ++key) {
+      ASSERT_EQ(convert_from_file_value<uint64_t>(db_manager.get(key)), key + 1);
+    }
+  }
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-wal").data());
+  std::remove(crash_file_name.data());
+  std::remove((crash_file_name + "-wal").data());
+}
+
+TEST_F(DBManagerTest, RemoveDefersMerges) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.merge_batch_size = 0;
+  DBManager db_manager{file_name, 8, 5, options};
+
+  std::map<FileKey, uint64_t> expected;
+  for (uint64_t key = 0; key < 1'000; ++key) {
+    db_manager.put(key, convert_to_file_value(key));
+    expected[key] = key;
+  }
+
+  // Removes only rewrite the leaf, so the tree is not valid until the underfull nodes are merged
+  std::mt19937 random_engine{42};
+  std::vector<FileKey> keys(1'000);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), random_engine);
+  for (auto i = 0u; i < 900; ++i) {
+    db_manager.remove(keys[i]);
+    expected.erase(keys[i]);
+  }
+
+  EXPECT_GT(db_manager.num_pending_merges(), 0u);
+  expect_entries(db_manager, expected);
+
+  db_manager.merge_underfull_nodes();
+  EXPECT_EQ(db_manager.num_pending_merges(), 0u);
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  expect_entries(db_manager, expected);
+
+  // The tree shrinks down to a single leaf
+  for (auto i = 900u; i < 1'000; ++i) db_manager.remove(keys[i]);
+  db_manager.merge_underfull_nodes();
+  EXPECT_TRUE(db_manager.get_root().header().is_leaf);
+  EXPECT_EQ(db_manager.get_root().header().num_keys, 0u);
+
+  for (uint64_t key = 0; key < 100; ++key) db_manager.put(key, convert_to_file_value(key + 1));
+  EXPECT_TRUE(tree_is_valid(db_manager));
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, RemoveMergesInBatches) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.merge_batch_size = 4;
+  options.enable_wal = true;
+
+  std::map<FileKey, uint64_t> expected;
+  {
+    DBManager db_manager{file_name, 8, 5, options};
+
+    // Churn: removes of random keys between inserts and batches
+    std::mt19937 random_engine{7};
+    std::uniform_int_distribution<FileKey> key_distribution{0, 2'000};
+    for (auto round = 0u; round < 20; ++round) {
+      WriteBatch batch;
+      for (auto i = 0u; i < 100; ++i) {
+        const auto key = key_distribution(random_engine);
+        if (expected.count(key) == 0) {
+          batch.put(key, convert_to_file_value(key));
+          expected[key] = key;
+        }
+      }
+      db_manager.write(batch);
+
+      for (auto i = 0u; i < 80; ++i) {
+        const auto key = key_distribution(random_engine);
+        if (round % 2 == 0) {
+          db_manager.remove(key);
+        } else {
+          batch.clear();
+          batch.remove(key);
+          db_manager.write(batch);
+        }
+        expected.erase(key);
+      }
+
+      EXPECT_LT(db_manager.num_pending_merges(), options.merge_batch_size);
+    }
+
+    expect_entries(db_manager, expected);
+    db_manager.merge_underfull_nodes();
+    EXPECT_TRUE(tree_is_valid(db_manager));
+  }
+
+  // The root may have changed through the merges
+  DBManager db_manager{file_name, 8, 5, options};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  expect_entries(db_manager, expected);
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-wal").data());
+}
+
+TEST_F(DBManagerTest, RemoveWithLowerMinFill) {
+  DBOptions options;
+  options.merge_min_fill = 0.2;
+  const auto file_name = get_random_temp_file_name();
+  DBManager db_manager{file_name, 8, 9, options};
+
+  std::map<FileKey, uint64_t> expected;
+  for (uint64_t key = 0; key < 1'000; ++key) {
+    db_manager.put(key, convert_to_file_value(key));
+    expected[key] = key;
+  }
+  for (uint64_t key = 0; key < 1'000; ++key) {
+    if (key % 5 != 0) {
+      db_manager.remove(key);
+      expected.erase(key);
+    }
+  }
+  db_manager.merge_underfull_nodes();
+  expect_entries(db_manager, expected);
+
+  options.merge_min_fill = 0.6;
+  EXPECT_THROW(DBManager(file_name, 8, 9, options), std::logic_error);
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, RemovedSpaceIsReused) {
+  const auto file_name = get_random_temp_file_name();
+  const auto file_size = [&]() {
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    return static_cast<uint64_t>(file.tellg());
+  };
+
+  for (const auto enable_wal : {false, true}) {
+    DBOptions options;
+    options.enable_wal = enable_wal;
+    std::map<FileKey, uint64_t> expected;
+    std::mt19937 random_engine{enable_wal ? 1u : 2u};
+    std::uniform_int_distribution<FileKey> key_distribution{0, 5'000};
+
+    // Each round replaces a part of the entries and reopens the database
+    uint64_t first_round_size = 0;
+    for (auto round = 0u; round < 10; ++round) {
+      {
+        DBManager db_manager{file_name, 0, 5, options};
+        for (auto i = 0u; i < 500; ++i) {
+          const auto key = key_distribution(random_engine);
+          if (expected.erase(key) > 0) db_manager.remove(key);
+        }
+        db_manager.merge_underfull_nodes();
+
+        while (expected.size() < 2'000) {
+          const auto key = key_distribution(random_engine);
+          if (expected.count(key) > 0) continue;
+          db_manager.put(key, convert_to_file_value(std::to_string(key)));
+          expected[key] = key;
+        }
+      }
+
+      if (round == 0) first_round_size = file_size();
+    }
+
+    // Freed nodes and values are filled again, but fragmentation can leave some space unused
+    EXPECT_LT(file_size(), first_round_size * 3 / 2);
+
+    DBManager db_manager{file_name, 0, 5, options};
+    EXPECT_TRUE(tree_is_valid(db_manager));
+    for (const auto& [key, value] : expected) {
+      ASSERT_EQ(convert_from_file_value<std::string>(db_manager.get(key)), std::to_string(value));
+    }
+
+    std::remove(file_name.data());
+    std::remove((file_name + "-wal").data());
+  }
+}
+
+TEST_F(DBManagerTest, Compact) {
+  const auto file_name = get_random_temp_file_name();
+  const auto compacted_file_name = get_random_temp_file_name();
+  const auto file_size = [](const std::string& name) {
+    std::ifstream file(name, std::ios::binary | std::ios::ate);
+    return static_cast<uint64_t>(file.tellg());
+  };
+
+  std::map<FileKey, uint64_t> expected;
+  {
+    DBManager db_manager{file_name, 0};
+    std::mt19937 random_engine{3};
+    std::uniform_int_distribution<FileKey> key_distribution{0, 10'000};
+    for (auto i = 0u; i < 3'000; ++i) {
+      const auto key = key_distribution(random_engine);
+      if (expected.count(key) > 0) {
+        db_manager.remove(key);
+        expected.erase(key);
+      } else {
+        db_manager.put(key, convert_to_file_value(std::to_string(key)));
+        expected[key] = key;
+      }
+    }
+
+    EXPECT_EQ(db_manager.num_entries(), expected.size());
+    db_manager.compact(compacted_file_name);
+    EXPECT_THROW(db_manager.compact(compacted_file_name), std::runtime_error);
+  }
+
+  EXPECT_LT(file_size(compacted_file_name), file_size(file_name));
+
+  DBManager db_manager{compacted_file_name, 0};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  EXPECT_EQ(db_manager.num_entries(), expected.size());
+  for (const auto& [key, value] : expected) {
+    ASSERT_EQ(convert_from_file_value<std::string>(db_manager.get(key)), std::to_string(value));
+  }
+
+  // The leaves follow each other in key order, each directly followed by its values and starting on the next page
+  const auto& file_manager = db_manager.get_file_manager();
+  auto leaf_id = db_manager.get_root().children().front();
+  while (!file_manager.load_node_header(leaf_id).is_leaf) leaf_id = file_manager.load_node(leaf_id).children().front();
+
+  auto expected_position = leaf_id;
+  EXPECT_EQ(db_manager.get_root().header().node_id, DEFAULT_PAGE_SIZE);
+  while (leaf_id != InvalidNodeID) {
+    const auto leaf = file_manager.load_node(leaf_id);
+    ASSERT_EQ(leaf_id, file_manager.page_aligned(expected_position));
+    expected_position = leaf_id + DEFAULT_PAGE_SIZE;
+    for (const auto value_position : leaf.children()) {
+      ASSERT_EQ(value_position, expected_position);
+      expected_position += file_manager.get_value(value_position).size() + sizeof(uint32_t);
+    }
+    leaf_id = leaf.header().next_leaf;
+  }
+  EXPECT_EQ(expected_position, file_size(compacted_file_name));
+
+  std::remove(file_name.data());
+  std::remove(compacted_file_name.data());
+}
+
+TEST_F(DBManagerTest, InlineValues) {
+  const auto file_name = get_random_temp_file_name();
+  const auto file_size = [&]() {
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    return static_cast<uint64_t>(file.tellg());
+  };
+
+  {
+    DBManager db_manager{file_name, 8, 5};
+    for (uint64_t key = 0; key < 1'000; key += 2) db_manager.put(key, convert_to_file_value(key % 7));
+    db_manager.update(10, convert_to_file_value(uint64_t{12345}));
+  }
+
+  // Only the header and nodes are stored
+  EXPECT_EQ(file_size() % DEFAULT_PAGE_SIZE, 0u);
+
+  DBManager db_manager{file_name, 8, 5};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+
+  // A null slot is a valid value, missing keys are recognized by their key
+  EXPECT_EQ(db_manager.get(0), convert_to_file_value(uint64_t{0}));
+  EXPECT_TRUE(db_manager.get(1).empty());
+  EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(10)), 12345u);
+
+  const auto values = db_manager.multi_get({7, 14, 3, 998, 1'000});
+  EXPECT_TRUE(values[0].empty());
+  EXPECT_EQ(values[1], convert_to_file_value(uint64_t{0}));
+  EXPECT_TRUE(values[2].empty());
+  EXPECT_EQ(convert_from_file_value<uint64_t>(values[3]), 998u % 7);
+  EXPECT_TRUE(values[4].empty());
+
+  WriteBatch batch;
+  batch.put(14, convert_to_file_value(uint64_t{1}));
+  EXPECT_THROW(db_manager.write(batch), std::runtime_error);
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, VersionOneFilesKeepValuesOutOfLine) {
+  const auto file_name = get_random_temp_file_name();
+  { DBManager db_manager{file_name, 8, 5}; }
+
+  // Files of the first format version have no inline values. The header is read as a 14-byte header with
+  // LEGACY_PAGE_SIZE pages, which still hold the nodes with five keys.
+  {
+    std::fstream file(file_name, std::ios::binary | std::ios::in | std::ios::out);
+    const uint16_t version = 1;
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  }
+
+  {
+    DBManager db_manager{file_name, 8, 5};
+    for (uint64_t key = 0; key < 100; ++key) db_manager.put(key, convert_to_file_value(key * 2));
+  }
+
+  std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+  EXPECT_NE(static_cast<uint64_t>(file.tellg()) % LEGACY_PAGE_SIZE, 0u);
+
+  DBManager db_manager{file_name, 8, 5};
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  for (uint64_t key = 0; key < 100; ++key) {
+    ASSERT_EQ(convert_from_file_value<uint64_t>(db_manager.get(key)), key * 2);
+  }
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, FourByteKeys) {
+  static_assert(NodeLayout::for_key_size(sizeof(uint32_t)).max_keys_per_node == 337);
+  const auto file_name = get_random_temp_file_name();
+  const auto node_layout = NodeLayout::for_key_size(sizeof(uint32_t));
+
+  std::vector<uint64_t> keys(20'000);
+  std::iota(keys.begin(), keys.end(), std::numeric_limits<uint32_t>::max() - keys.size() + 1);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{5});
+
+  {
+    DBManager db_manager{file_name, 8, node_layout};
+    for (const auto key : keys) db_manager.put(key, convert_to_file_value(key));
+    EXPECT_THROW(db_manager.put(uint64_t{1} << 32, convert_to_file_value(uint64_t{1})), std::runtime_error);
+    EXPECT_TRUE(db_manager.get(uint64_t{1} << 32).empty());
+  }
+
+  {
+    DBManager db_manager{file_name, 8, node_layout};
+    EXPECT_TRUE(tree_is_valid(db_manager));
+    for (const auto key : keys) ASSERT_EQ(convert_from_file_value<uint64_t>(db_manager.get(key)), key);
+
+    std::vector<FileKey> scanned_keys;
+    db_manager.scan(0, std::numeric_limits<FileKey>::max(),
+                    [&](const FileKey key, const FileValue&) { scanned_keys.push_back(key); });
+    std::sort(keys.begin(), keys.end());
+    EXPECT_EQ(scanned_keys, keys);
+  }
+
+  // The key size is part of the file format
+  EXPECT_THROW((DBManager{file_name, 8, NodeLayout{node_layout.max_keys_per_node, sizeof(FileKey)}}),
+               std::logic_error);
+
+  DBManager bulk_loaded_db{8, node_layout};
+  uint64_t next_key = 0;
+  bulk_loaded_db.bulk_load(1'000, [&]() {
+    next_key += uint64_t{1} << 22;
+    return BulkLoadEntry{next_key, convert_to_file_value(next_key)};
+  });
+  EXPECT_EQ(convert_from_file_value<uint64_t>(bulk_loaded_db.get(uint64_t{1} << 29)), uint64_t{1} << 29);
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, ValueLog) {
+  const auto file_name = get_random_temp_file_name();
+  const auto value_of = [](const uint64_t key, const uint32_t round) {
+    return std::to_string(key) + std::string(key % 20, 'v') + std::to_string(round);
+  };
+
+  DBOptions options;
+  options.enable_value_log = true;
+  options.value_log_segment_size = 4096;
+  options.value_log_gc_ratio = 0;
+
+  {
+    DBManager db_manager{file_name, 0, 5, options};
+    for (uint64_t key = 0; key < 1'000; ++key) db_manager.put(key, convert_to_file_value(value_of(key, 0)));
+    for (uint64_t key = 0; key < 1'000; key += 2) db_manager.update(key, convert_to_file_value(value_of(key, 1)));
+  }
+
+  // The database file only contains nodes
+  std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+  EXPECT_EQ(static_cast<uint64_t>(file.tellg()) % DEFAULT_PAGE_SIZE, 0u);
+
+  DBManager db_manager{file_name, 0, 5, options};
+  for (uint64_t key = 1; key < 1'000; key += 4) db_manager.remove(key);
+  db_manager.merge_underfull_nodes();
+
+  const auto num_segments = db_manager.get_file_manager().value_log()->num_segments();
+  auto num_collected_segments = 0u;
+  while (db_manager.collect_value_log_garbage()) num_collected_segments++;
+  EXPECT_GT(num_collected_segments, 0u);
+  EXPECT_LT(db_manager.get_file_manager().value_log()->num_segments(), num_segments);
+
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  for (uint64_t key = 0; key < 1'000; ++key) {
+    const auto value = db_manager.get(key);
+    if (key % 4 == 1) {
+      EXPECT_TRUE(value.empty());
+    } else {
+      EXPECT_EQ(convert_from_file_value<std::string>(value), value_of(key, key % 2 == 0 ? 1 : 0));
+    }
+  }
+  EXPECT_EQ(convert_from_file_value<std::string>(db_manager.multi_get({3, 4})[1]), value_of(4, 1));
+
+  // The value log must not be ignored
+  EXPECT_THROW(DBManager(file_name, 0, 5), std::logic_error);
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-vlog").data());
+  for (auto segment_id = 1u; segment_id <= 1'000; ++segment_id) {
+    std::remove((file_name + "-vlog-" + std::to_string(segment_id)).data());
+  }
+}
+
+TEST_F(DBManagerTest, ValueLogGarbageIsCollectedAfterWrites) {
+  const auto file_name = get_random_temp_file_name();
+  const auto compacted_file_name = get_random_temp_file_name();
+
+  DBOptions options;
+  options.enable_wal = true;
+  options.enable_value_log = true;
+  options.value_log_segment_size = 16 * 1024;
+
+  {
+    DBManager db_manager{file_name, 0, 15, options};
+    for (auto round = 0u; round < 20; ++round) {
+      WriteBatch batch;
+      for (uint64_t key = 0; key < 500; ++key) {
+        batch.remove(key);
+        batch.put(key, convert_to_file_value(std::string(50, 'a' + round)));
+      }
+      db_manager.write(batch);
+    }
+
+    // Without garbage collection, the log would hold 20 times the live values
+    const auto* value_log = db_manager.get_file_manager().value_log();
+    EXPECT_LT(value_log->num_segments(), 10u);
+
+    db_manager.compact(compacted_file_name);
+  }
+
+  for (const auto& name : {file_name, compacted_file_name}) {
+    DBManager db_manager{name, 0, 15, options};
+    EXPECT_EQ(db_manager.num_entries(), 500u);
+    for (uint64_t key = 0; key < 500; ++key) {
+      ASSERT_EQ(convert_from_file_value<std::string>(db_manager.get(key)), std::string(50, 'a' + 19));
+    }
+  }
+
+  for (const auto& name : {file_name, compacted_file_name}) {
+    std::remove(name.data());
+    std::remove((name + "-wal").data());
+    std::remove((name + "-vlog").data());
+    for (auto segment_id = 1u; segment_id <= 1'000; ++segment_id) {
+      std::remove((name + "-vlog-" + std::to_string(segment_id)).data());
+    }
+  }
+}
+
+TEST_F(DBManagerTest, ConcurrentPutsAndGets) {
+  const auto file_name = get_random_temp_file_name();
+  const auto value_of = [](const uint64_t key) { return std::to_string(key) + std::string(key % 50, 'v'); };
+
+  DBOptions options;
+  options.concurrent = true;
+  DBManager db_manager{file_name, 0, 5, options};
+  for (uint64_t key = 0; key < 1'000; ++key) db_manager.put(key * 2, convert_to_file_value(value_of(key * 2)));
+
+  // Writers fill the gaps between the existing keys, so the nodes that readers go through are split all the time
+  const auto num_writers = 4u;
+  const auto num_readers = 4u;
+  std::atomic<uint32_t> num_wrong_values{0};
+  std::vector<std::thread> threads;
+  for (auto writer = 0u; writer < num_writers; ++writer) {
+    threads.emplace_back([&, writer] {
+      for (uint64_t key = writer * 2 + 1; key < 2'000; key += num_writers * 2) {
+        db_manager.put(key, convert_to_file_value(value_of(key)));
+      }
+    });
+  }
+  for (auto reader = 0u; reader < num_readers; ++reader) {
+    threads.emplace_back([&, reader] {
+      for (auto round = 0u; round < 3; ++round) {
+        for (uint64_t key = reader; key < 2'000; key += num_readers) {
+          const auto value = db_manager.get(key);
+          const auto is_new_key = key % 2 == 1;
+          if (is_new_key && value.empty()) continue;
+          if (convert_from_file_value<std::string>(value) != value_of(key)) ++num_wrong_values;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(num_wrong_values, 0u);
+  EXPECT_THROW(db_manager.put(7, convert_to_file_value(value_of(7))), std::runtime_error);
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  EXPECT_EQ(db_manager.num_entries(), 2'000u);
+
+  // The leaf chain is intact
+  uint64_t expected_key = 0;
+  db_manager.scan(0, 2'000, [&](const FileKey key, const FileValue& value) {
+    EXPECT_EQ(key, expected_key++);
+    EXPECT_EQ(convert_from_file_value<std::string>(value), value_of(key));
+  });
+  EXPECT_EQ(expected_key, 2'000u);
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, ConcurrentUpdatesAndRemoves) {
+  const auto file_name = get_random_temp_file_name();
+  const auto value_of = [](const uint64_t key, const uint32_t round) {
+    return std::to_string(key) + std::string((key + round) % 50, 'v') + std::to_string(round);
+  };
+
+  DBOptions options;
+  options.concurrent = true;
+  DBManager db_manager{file_name, 0, 5, options};
+  for (uint64_t key = 0; key < 2'000; ++key) db_manager.put(key, convert_to_file_value(value_of(key, 0)));
+
+  // Even keys are updated in place or moved, depending on whether their new value fits, odd keys are removed
+  std::atomic<uint32_t> num_wrong_values{0};
+  std::vector<std::thread> threads;
+  for (auto writer = 0u; writer < 2; ++writer) {
+    threads.emplace_back([&, writer] {
+      for (uint64_t key = writer * 2; key < 2'000; key += 4) {
+        db_manager.update(key, convert_to_file_value(value_of(key, 1)));
+        db_manager.upsert(key, convert_to_file_value(value_of(key, 2)));
+      }
+    });
+  }
+  threads.emplace_back([&] {
+    for (uint64_t key = 1; key < 2'000; key += 2) db_manager.remove(key);
+  });
+  for (auto reader = 0u; reader < 4; ++reader) {
+    threads.emplace_back([&, reader] {
+      for (uint64_t key = reader; key < 2'000; key += 4) {
+        const auto value = convert_from_file_value<std::string>(db_manager.get(key));
+        const auto is_removed = key % 2 == 1 && value.empty();
+        if (!is_removed && value != value_of(key, 0) && value != value_of(key, 1) && value != value_of(key, 2)) {
+          ++num_wrong_values;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(num_wrong_values, 0u);
+  EXPECT_GT(db_manager.num_pending_merges(), 0u);
+  db_manager.merge_underfull_nodes();
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  EXPECT_EQ(db_manager.num_entries(), 1'000u);
+  for (uint64_t key = 0; key < 2'000; ++key) {
+    const auto value = db_manager.get(key);
+    if (key % 2 == 1) {
+      EXPECT_TRUE(value.empty());
+    } else {
+      EXPECT_EQ(convert_from_file_value<std::string>(value), value_of(key, 2));
+    }
+  }
+  EXPECT_THROW(db_manager.update(1, convert_to_file_value(value_of(1, 3))), std::runtime_error);
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, ConcurrentTreesRejectSharedState) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.concurrent = true;
+  options.enable_wal = true;
+  EXPECT_THROW(DBManager(file_name, 0, 5, options), std::logic_error);
+
+  options.enable_wal = false;
+  options.storage_mode = StorageMode::MemoryMapped;
+  EXPECT_THROW(DBManager(file_name, 0, 5, options), std::logic_error);
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-wal").data());
+}
+
+TEST_F(DBManagerTest, CopyOnWriteCursorKeepsItsTree) {
+  const auto file_name = get_random_temp_file_name();
+  const auto value_of = [](const uint64_t key, const uint32_t round) {
+    return std::to_string(key) + std::string((key + round) % 30, 'v') + std::to_string(round);
+  };
+
+  DBOptions options;
+  options.copy_on_write = true;
+  {
+    DBManager db_manager{file_name, 0, 5, options};
+    for (uint64_t key = 0; key < 500; ++key) db_manager.put(key, convert_to_file_value(value_of(key, 0)));
+    EXPECT_TRUE(tree_is_valid(db_manager));
+
+    // Neither the nodes nor the values of the pinned tree are overwritten or reused
+    auto old_tree = db_manager.cursor();
+    for (uint64_t key = 0; key < 500; ++key) {
+      db_manager.update(key, convert_to_file_value(value_of(key, 1)));
+      if (key % 2 == 1) db_manager.remove(key);
+    }
+    for (uint64_t key = 500; key < 1'000; ++key) db_manager.put(key, convert_to_file_value(value_of(key, 1)));
+    EXPECT_EQ(db_manager.get_file_manager().free_space_map().num_free_pages(), 0u);
+
+    uint64_t expected_key = 0;
+    for (auto is_valid = old_tree.seek_to_first(); is_valid; is_valid = old_tree.next()) {
+      EXPECT_EQ(old_tree.key(), expected_key);
+      EXPECT_EQ(convert_from_file_value<std::string>(old_tree.value()), value_of(expected_key, 0));
+      ++expected_key;
+    }
+    EXPECT_EQ(expected_key, 500u);
+    EXPECT_TRUE(old_tree.seek_to_last());
+    EXPECT_EQ(old_tree.key(), 499u);
+    EXPECT_TRUE(old_tree.prev());
+    EXPECT_EQ(old_tree.key(), 498u);
+
+    // New readers see the current tree, whose leaves are not chained
+    auto new_tree = db_manager.cursor();
+    expected_key = 0;
+    for (auto is_valid = new_tree.seek_to_first(); is_valid; is_valid = new_tree.next()) {
+      EXPECT_EQ(new_tree.key(), expected_key);
+      EXPECT_EQ(convert_from_file_value<std::string>(new_tree.value()), value_of(expected_key, 1));
+      expected_key += expected_key < 500 ? 2 : 1;
+    }
+    EXPECT_EQ(expected_key, 1'000u);
+    EXPECT_TRUE(new_tree.seek(998));
+    EXPECT_TRUE(new_tree.prev());
+    EXPECT_EQ(new_tree.key(), 997u);
+    EXPECT_EQ(db_manager.num_entries(), 750u);
+  }
+
+  // The space of the old trees is reused once no cursor reads them
+  DBManager db_manager{file_name, 0, 5, options};
+  EXPECT_GT(db_manager.get_file_manager().free_space_map().num_free_pages(), 0u);
+  EXPECT_EQ(db_manager.num_entries(), 750u);
+  EXPECT_EQ(convert_from_file_value<std::string>(db_manager.get(998)), value_of(998, 1));
+  EXPECT_EQ(convert_from_file_value<std::string>(db_manager.get(997)), value_of(997, 1));
+  EXPECT_TRUE(db_manager.get(1).empty());
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, CopyOnWriteDropsEmptyNodes) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.copy_on_write = true;
+  DBManager db_manager{file_name, 8, 5, options};
+
+  WriteBatch batch;
+  for (uint64_t key = 0; key < 300; ++key) batch.put(key, convert_to_file_value(key));
+  db_manager.write(batch);
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  EXPECT_FALSE(db_manager.get_root().header().is_leaf);
+
+  // Removing a range empties whole subtrees, which are dropped. The root shrinks back to a leaf.
+  for (uint64_t key = 0; key < 250; ++key) db_manager.remove(key);
+  EXPECT_EQ(db_manager.num_entries(), 50u);
+  uint64_t expected_key = 250;
+  db_manager.scan(0, 300, [&](const FileKey key, const FileValue& value) {
+    EXPECT_EQ(key, expected_key++);
+    EXPECT_EQ(convert_from_file_value<uint64_t>(value), key);
+  });
+  EXPECT_EQ(expected_key, 300u);
+
+  for (uint64_t key = 250; key < 300; ++key) db_manager.remove(key);
+  EXPECT_TRUE(db_manager.get_root().header().is_leaf);
+  EXPECT_EQ(db_manager.num_entries(), 0u);
+  EXPECT_FALSE(db_manager.cursor().seek_to_first());
+
+  db_manager.put(7, convert_to_file_value(uint64_t{7}));
+  EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(7)), 7u);
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, CopyOnWriteReadersSeeWholeCommits) {
+  const auto file_name = get_random_temp_file_name();
+  const auto num_keys = 300u;
+  const auto value_of = [](const uint64_t key, const uint32_t round) {
+    return std::to_string(round) + std::string((key + round) % 20, 'v');
+  };
+  const auto round_of = [](const FileValue& value) { return std::stoul(convert_from_file_value<std::string>(value)); };
+
+  DBOptions options;
+  options.copy_on_write = true;
+  DBManager db_manager{file_name, 0, 5, options};
+  for (uint64_t key = 0; key < num_keys; ++key) db_manager.put(key, convert_to_file_value(value_of(key, 0)));
+
+  // Each batch replaces all values with the values of the next round, readers must never see two rounds at once
+  const auto num_rounds = 30u;
+  std::atomic<bool> is_done{false};
+  std::atomic<uint32_t> num_torn_reads{0};
+  std::vector<std::thread> threads;
+  threads.emplace_back([&] {
+    for (auto round = 1u; round <= num_rounds; ++round) {
+      WriteBatch batch;
+      for (uint64_t key = 0; key < num_keys; ++key) {
+        batch.remove(key);
+        batch.put(key, convert_to_file_value(value_of(key, round)));
+      }
+      db_manager.write(batch);
+    }
+    is_done = true;
+  });
+  for (auto reader = 0u; reader < 3; ++reader) {
+    threads.emplace_back([&, reader] {
+      std::vector<FileKey> keys(num_keys);
+      std::iota(keys.begin(), keys.end(), 0);
+      while (!is_done) {
+        std::set<uint64_t> rounds;
+        if (reader == 0) {
+          db_manager.scan(0, num_keys, [&](const FileKey, const FileValue& value) { rounds.insert(round_of(value)); });
+        } else {
+          for (const auto& value : db_manager.multi_get(keys)) rounds.insert(round_of(value));
+        }
+        if (rounds.size() != 1) ++num_torn_reads;
+
+        const auto key = *rounds.begin() % num_keys;
+        const auto value = db_manager.get(key);
+        if (convert_from_file_value<std::string>(value) != value_of(key, round_of(value))) ++num_torn_reads;
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(num_torn_reads, 0u);
+  EXPECT_TRUE(tree_is_valid(db_manager));
+  EXPECT_EQ(db_manager.num_entries(), num_keys);
+  for (uint64_t key = 0; key < num_keys; ++key) {
+    EXPECT_EQ(convert_from_file_value<std::string>(db_manager.get(key)), value_of(key, num_rounds));
+  }
+
+  std::remove(file_name.data());
+}
+
+TEST_F(DBManagerTest, CopyOnWriteIsStoredInTheFile) {
+  const auto file_name = get_random_temp_file_name();
+  const auto compacted_file_name = get_random_temp_file_name();
+  const auto num_keys = 5000u;
+  DBOptions options;
+  options.copy_on_write = true;
+  {
+    DBManager db_manager{file_name, 0, 5, options};
+    for (uint64_t key = 0; key < num_keys; ++key) db_manager.put(key, convert_to_file_value(std::to_string(key)));
+  }
+
+  // The leaves of the tree are not chained, other modes would scan only a part of it
+  EXPECT_THROW(DBManager(file_name, 0, 5), std::logic_error);
+  EXPECT_EQ(FileManager::read_db_header(file_name).flags, COPY_ON_WRITE_FLAG);
+
+  {
+    DBManager db_manager{file_name, 0, 5, options};
+    EXPECT_EQ(db_manager.num_entries(), num_keys);
+    db_manager.compact(compacted_file_name);
+  }
+
+  // The copy is opened with the same options as its source
+  DBManager compacted_db{compacted_file_name, 0, 5, options};
+  auto num_scanned = 0u;
+  compacted_db.scan(0, num_keys, [&](const FileKey key, const FileValue& value) {
+    EXPECT_EQ(key, num_scanned++);
+    EXPECT_EQ(convert_from_file_value<std::string>(value), std::to_string(key));
+  });
+  EXPECT_EQ(num_scanned, num_keys);
+
+  const auto plain_file_name = get_random_temp_file_name();
+  { DBManager plain_db{plain_file_name, 0, 5}; }
+  EXPECT_THROW(DBManager(plain_file_name, 0, 5, options), std::logic_error);
+
+  std::remove(file_name.data());
+  std::remove(compacted_file_name.data());
+  std::remove(plain_file_name.data());
+}
+
+TEST_F(DBManagerTest, CopyOnWriteRejectsSharedState) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.copy_on_write = true;
+  options.enable_wal = true;
+  EXPECT_THROW(DBManager(file_name, 0, 5, options), std::logic_error);
+
+  options.enable_wal = false;
+  options.concurrent = true;
+  EXPECT_THROW(DBManager(file_name, 0, 5, options), std::logic_error);
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-wal").data());
+}
+
 }  // namespace keva
@@ -1,5 +1,10 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+
 #include "file_manager.hpp"
 #include "test_utils.hpp"
 
@@ -21,7 +26,8 @@ TEST_F(FileManagerTest, InitDB) {
   EXPECT_GE(db_header.version, 0u);
   EXPECT_EQ(db_header.value_size, 4u);
   EXPECT_EQ(db_header.keys_per_node, 5u);
-  EXPECT_EQ(db_header.root_offset, 14u);
+  EXPECT_EQ(db_header.root_offset, DEFAULT_PAGE_SIZE);
+  EXPECT_EQ(db_header.key_size, sizeof(FileKey));
 }
 
 TEST_F(FileManagerTest, InitAndLoadDB) {
@@ -33,6 +39,7 @@ TEST_F(FileManagerTest, InitAndLoadDB) {
   EXPECT_EQ(db_header.value_size, loaded_header.value_size);
   EXPECT_EQ(db_header.keys_per_node, loaded_header.keys_per_node);
   EXPECT_EQ(db_header.root_offset, loaded_header.root_offset);
+  EXPECT_EQ(db_header.key_size, loaded_header.key_size);
 }
 
 TEST_F(FileManagerTest, UpdateRootOffset) {
@@ -54,7 +61,7 @@ TEST_F(FileManagerTest, UpdateRootOffset) {
 
 TEST_F(FileManagerTest, WriteAndLoadNodeHeader) {
   BPNodeHeader header{};
-  header.node_id = 14;
+  header.node_id = DEFAULT_PAGE_SIZE;
   header.is_leaf = true;
   header.parent_id = 0;
   header.next_leaf = 2233;
@@ -74,7 +81,7 @@ TEST_F(FileManagerTest, WriteAndLoadNodeHeader) {
 
 TEST_F(FileManagerTest, WriteAndLoadLeafNode) {
   BPNodeHeader header{};
-  header.node_id = 14;
+  header.node_id = DEFAULT_PAGE_SIZE;
   header.is_leaf = true;
   header.parent_id = 0;
   header.next_leaf = 2233;
@@ -102,7 +109,7 @@ TEST_F(FileManagerTest, WriteAndLoadLeafNode) {
 
 TEST_F(FileManagerTest, WriteAndLoadInternalNode) {
   BPNodeHeader header{};
-  header.node_id = 14;
+  header.node_id = DEFAULT_PAGE_SIZE;
   header.is_leaf = false;
   header.parent_id = 0;
   header.next_leaf = 2233;
@@ -205,10 +212,10 @@ TEST_F(FileManagerTest, GetNextNodePosition) {
   EXPECT_NE(node_pos, InvalidNodeID);
 
   const auto next_node_pos = _file_manager.get_next_node_position();
-  EXPECT_EQ(next_node_pos, node_pos + BP_NODE_SIZE);
+  EXPECT_EQ(next_node_pos, node_pos + DEFAULT_PAGE_SIZE);
 
   const auto second_next_node_pos = _file_manager.get_next_node_position();
-  EXPECT_EQ(second_next_node_pos, next_node_pos + BP_NODE_SIZE);
+  EXPECT_EQ(second_next_node_pos, next_node_pos + DEFAULT_PAGE_SIZE);
 }
 
 TEST_F(FileManagerTest, GetNextValuePosition) {
@@ -229,4 +236,284 @@ TEST_F(FileManagerTest, GetNextValuePosition) {
   EXPECT_EQ(third_next_node_pos, second_next_node_pos + third_value.size());
 }
 
+TEST_F(FileManagerTest, MemoryMappedWriteAndLoadNode) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.storage_mode = StorageMode::MemoryMapped;
+
+  BPNodeHeader header{};
+  header.is_leaf = false;
+  header.parent_id = 0;
+  header.next_leaf = 2233;
+  header.previous_leaf = 1122;
+  header.num_keys = 5;
+
+  const std::vector<FileKey> keys = {1, 3, 5, 7, 9};
+  const std::vector<NodeID> children = {12, 24, 36, 48, 60, 72};
+
+  {
+    FileManager file_manager{file_name, 4, 5, options};
+    header.node_id = file_manager.get_next_node_position();
+    file_manager.write_node(BPNode{header, keys, children});
+
+    const auto loaded_node = file_manager.load_node(header.node_id);
+    EXPECT_EQ(loaded_node.header().next_leaf, header.next_leaf);
+    EXPECT_EQ(loaded_node.header().previous_leaf, header.previous_leaf);
+    EXPECT_EQ(loaded_node.keys(), keys);
+    EXPECT_EQ(loaded_node.children(), children);
+  }
+
+  // Reopen with the stream backend to check that the file is identical
+  FileManager file_manager{file_name, 4, 5};
+  EXPECT_FALSE(file_manager.is_new_db());
+  const auto loaded_node = file_manager.load_node(header.node_id);
+  EXPECT_EQ(loaded_node.header().num_keys, header.num_keys);
+  EXPECT_EQ(loaded_node.keys(), keys);
+  EXPECT_EQ(loaded_node.children(), children);
+  EXPECT_EQ(file_manager.get_next_node_position(), header.node_id + DEFAULT_PAGE_SIZE);
+
+  std::remove(file_name.data());
+}
+
+TEST_F(FileManagerTest, MemoryMappedWriteAndGetValues) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.storage_mode = StorageMode::MemoryMapped;
+
+  FileManager file_manager{file_name, 0, 5, options};
+
+  // Enough values to grow the mapping more than once
+  const auto num_values = 2 * MMAP_CHUNK_SIZE / 1024;
+  const std::string value(1020, 'x');
+  std::vector<FileOffset> value_positions;
+  for (auto i = 0u; i < num_values; ++i) {
+    value_positions.push_back(file_manager.insert_value(convert_to_file_value(value + std::to_string(i % 10))));
+  }
+
+  for (auto i = 0u; i < num_values; ++i) {
+    const auto loaded_value = file_manager.get_value(value_positions[i]);
+    EXPECT_EQ(convert_from_file_value<std::string>(loaded_value), value + std::to_string(i % 10));
+  }
+
+  std::remove(file_name.data());
+}
+
+TEST_F(FileManagerTest, BatchedReads) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.io_queue_depth = 4;
+  FileManager file_manager{file_name, 0, 5, options};
+
+  // Values of different sizes, some of them far apart, so they are read in several runs
+  std::vector<FileOffset> value_positions;
+  std::vector<FileOffset> node_positions;
+  for (auto i = 0u; i < 100; ++i) {
+    const auto value = std::string(1 + i * 37 % 3'000, static_cast<char>('a' + i % 26));
+    value_positions.push_back(file_manager.insert_value(convert_to_file_value(value)));
+    if (i % 10 == 0) {
+      node_positions.push_back(file_manager.get_next_node_position());
+      file_manager.write_node(BPNode{{node_positions.back(), true, i, 0, 0, 0}, {}, {}});
+    }
+  }
+
+  auto positions = value_positions;
+  positions.push_back(InvalidNodeID);
+  positions.push_back(value_positions[7]);
+  std::reverse(positions.begin(), positions.end());
+  const auto values = file_manager.get_values(positions);
+  ASSERT_EQ(values.size(), positions.size());
+  EXPECT_TRUE(values[1].empty());
+  for (auto i = 0u; i < positions.size(); ++i) {
+    if (positions[i] != InvalidNodeID) {
+      EXPECT_EQ(values[i], file_manager.get_value(positions[i]));
+    }
+  }
+
+  std::vector<char> buffer;
+  const auto nodes = file_manager.view_nodes(node_positions, buffer);
+  ASSERT_EQ(nodes.size(), node_positions.size());
+  for (auto i = 0u; i < nodes.size(); ++i) {
+    EXPECT_EQ(nodes[i].header().node_id, node_positions[i]);
+    EXPECT_EQ(nodes[i].header().parent_id, i * 10);
+  }
+
+  std::remove(file_name.data());
+}
+
+TEST_F(FileManagerTest, ConcurrentReads) {
+  const auto file_name = get_random_temp_file_name();
+  FileManager file_manager{file_name, 0, 5};
+
+  std::vector<FileOffset> value_positions;
+  std::vector<FileOffset> node_positions;
+  for (auto i = 0u; i < 200; ++i) {
+    const auto value = std::string(1 + i * 37 % 1'000, static_cast<char>('a' + i % 26));
+    value_positions.push_back(file_manager.insert_value(convert_to_file_value(value)));
+    if (i % 10 == 0) {
+      node_positions.push_back(file_manager.get_next_node_position());
+      file_manager.write_node(BPNode{{node_positions.back(), true, i, 0, 0, 0}, {}, {}});
+    }
+  }
+
+  // Without a buffer pool, reads share no state, so each thread has to see exactly what was written
+  std::atomic<uint32_t> num_mismatches{0};
+  std::vector<std::thread> threads;
+  for (auto thread_id = 0u; thread_id < 8; ++thread_id) {
+    threads.emplace_back([&, thread_id] {
+      for (auto round = 0u; round < 20; ++round) {
+        for (auto i = thread_id; i < value_positions.size(); i += 8) {
+          const auto value = convert_from_file_value<std::string>(file_manager.get_value(value_positions[i]));
+          if (value != std::string(1 + i * 37 % 1'000, static_cast<char>('a' + i % 26))) ++num_mismatches;
+        }
+
+        const auto values = file_manager.get_values(value_positions);
+        for (auto i = 0u; i < values.size(); ++i) {
+          if (values[i] != file_manager.get_value(value_positions[i])) ++num_mismatches;
+        }
+
+        for (auto i = 0u; i < node_positions.size(); ++i) {
+          if (file_manager.load_node(node_positions[i]).header().parent_id != i * 10) ++num_mismatches;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(num_mismatches, 0u);
+  std::remove(file_name.data());
+}
+
+TEST_F(FileManagerTest, FreedSpaceIsReused) {
+  FileManager file_manager{0, 5};
+  const auto node_position = file_manager.get_next_node_position();
+  const auto value_position = file_manager.insert_value(convert_to_file_value(std::string(100, 'a')));
+
+  file_manager.free_node(node_position);
+  file_manager.free_value(value_position);
+
+  // The space is only free after the commit. The next node starts on a new page, the space in front of it is left to
+  // values.
+  const auto next_node_position = file_manager.get_next_node_position();
+  EXPECT_NE(next_node_position, node_position);
+  EXPECT_EQ(next_node_position % DEFAULT_PAGE_SIZE, 0u);
+  const auto page_rest = next_node_position - value_position - sizeof(uint32_t) - 100;
+  file_manager.commit();
+  EXPECT_EQ(file_manager.get_next_node_position(), node_position);
+
+  // A smaller value leaves the rest of the slot free
+  EXPECT_EQ(file_manager.insert_value(convert_to_file_value(std::string(50, 'b'))), value_position);
+  EXPECT_EQ(file_manager.free_space_map().num_free_value_bytes(), page_rest + 50u);
+
+  // An update that moves the value frees its old slot. The value moves to the rest of the page.
+  const auto moved_position =
+      file_manager.update_value(value_position, convert_to_file_value(std::string(200, 'c')));
+  EXPECT_EQ(moved_position, next_node_position - page_rest);
+  file_manager.commit();
+  EXPECT_EQ(file_manager.free_space_map().num_free_value_bytes(),
+            page_rest - sizeof(uint32_t) - 200u + 50u + sizeof(uint32_t) + 50u);
+}
+
+TEST_F(FileManagerTest, PageSize) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.page_size = 16 * 1024;
+  const auto node_layout = NodeLayout::for_key_size(sizeof(FileKey), options.page_size);
+
+  FileOffset node_position;
+  {
+    FileManager file_manager{file_name, 0, node_layout, options};
+    EXPECT_EQ(file_manager.page_size(), options.page_size);
+    EXPECT_EQ(file_manager.db_header().root_offset, options.page_size);
+
+    // Nodes start on page boundaries, also behind values
+    node_position = file_manager.get_next_node_position();
+    file_manager.write_node(BPNode{{node_position, true, 0, 0, 0, 0}, {}, {}});
+    const auto value_position = file_manager.insert_value(convert_to_file_value(std::string(100, 'a')));
+    EXPECT_EQ(value_position, node_position + options.page_size);
+    EXPECT_EQ(file_manager.get_next_node_position(), node_position + 2 * options.page_size);
+  }
+
+  // The page size of the file is kept, whatever page size is passed when it is opened again
+  EXPECT_EQ(FileManager::read_db_header(file_name).page_size, options.page_size);
+  {
+    FileManager file_manager{file_name, 0, node_layout};
+    EXPECT_EQ(file_manager.page_size(), options.page_size);
+    EXPECT_TRUE(file_manager.load_node(node_position).header().is_leaf);
+  }
+  std::remove(file_name.data());
+
+  // Nodes for larger pages do not fit into the default pages
+  EXPECT_THROW((FileManager{0, node_layout}), std::logic_error);
+
+  options.page_size = 3'000;
+  EXPECT_THROW((FileManager{file_name, 0, 5, options}), std::logic_error);
+  options.page_size = 2 * MAX_PAGE_SIZE;
+  EXPECT_THROW((FileManager{file_name, 0, 5, options}), std::logic_error);
+  std::remove(file_name.data());
+}
+
+TEST_F(FileManagerTest, FreeSpaceMapIsStored) {
+  const auto file_name = get_random_temp_file_name();
+  const auto file_size = [&]() {
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    return static_cast<uint64_t>(file.tellg());
+  };
+
+  for (const auto storage_mode : {StorageMode::Stream, StorageMode::MemoryMapped}) {
+    DBOptions options;
+    options.storage_mode = storage_mode;
+
+    std::vector<FileOffset> node_positions;
+    FileOffset data_end;
+    {
+      FileManager file_manager{file_name, 8, 5, options};
+      for (auto i = 0u; i < 10; ++i) node_positions.push_back(file_manager.get_next_node_position());
+      for (const auto position : node_positions) file_manager.write_node(BPNode{{position, true, 0, 0, 0, 0}, {}, {}});
+      data_end = node_positions.back() + DEFAULT_PAGE_SIZE;
+
+      for (auto i = 0u; i < 5; ++i) file_manager.free_node(node_positions[i]);
+      file_manager.commit();
+    }
+
+    // The map is stored behind the data
+    EXPECT_GT(file_size(), data_end);
+
+    {
+      FileManager file_manager{file_name, 8, 5, options};
+      EXPECT_EQ(file_manager.free_space_map().num_free_pages(), 5u);
+      for (auto i = 0u; i < 5; ++i) {
+        const auto position = file_manager.get_next_node_position();
+        EXPECT_LT(position, node_positions[5]);
+      }
+
+      // The map is overwritten by new data
+      EXPECT_EQ(file_manager.get_next_node_position(), data_end);
+    }
+
+    // Nothing is free, so the file ends with the data
+    EXPECT_EQ(file_size(), data_end + DEFAULT_PAGE_SIZE);
+    FileManager file_manager{file_name, 8, 5, options};
+    EXPECT_TRUE(file_manager.free_space_map().empty());
+
+    std::remove(file_name.data());
+  }
+}
+
+TEST_F(FileManagerTest, InlineValues) {
+  FileManager file_manager{4, 5};
+  EXPECT_TRUE(file_manager.has_inline_values());
+  EXPECT_FALSE(FileManager(0, 5).has_inline_values());
+  EXPECT_FALSE(FileManager(16, 5).has_inline_values());
+
+  // Values are converted to child slots without being written to the file
+  const auto next_position = file_manager.get_next_value_position(convert_to_file_value(uint32_t{0}));
+  const auto slot = file_manager.insert_value(convert_to_file_value(uint32_t{0xabcd}));
+  EXPECT_EQ(slot, 0xabcdu);
+  EXPECT_EQ(file_manager.update_value(slot, convert_to_file_value(uint32_t{0})), 0u);
+  EXPECT_EQ(convert_from_file_value<uint32_t>(file_manager.get_value(0)), 0u);
+  EXPECT_EQ(file_manager.get_values({slot, 7}),
+            (std::vector<FileValue>{convert_to_file_value(uint32_t{0xabcd}), convert_to_file_value(uint32_t{7})}));
+  EXPECT_EQ(file_manager.get_next_value_position(convert_to_file_value(uint32_t{0})), next_position + sizeof(uint32_t));
+}
+
 }  // namespace keva
@@ -0,0 +1,87 @@
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "free_space_map.hpp"
+
+namespace keva {
+
+class FreeSpaceMapTest : public ::testing::Test {
+ protected:
+  FreeSpaceMap _free_space_map{5};
+};
+
+TEST_F(FreeSpaceMapTest, FreedSpaceIsOnlyReusedAfterRelease) {
+  _free_space_map.free_page(4096);
+  _free_space_map.free_value_slot(100, 16);
+  EXPECT_TRUE(_free_space_map.empty());
+  EXPECT_EQ(_free_space_map.allocate_page(), InvalidNodeID);
+  EXPECT_EQ(_free_space_map.allocate_value_slot(16), InvalidNodeID);
+
+  _free_space_map.release_freed_space();
+  EXPECT_EQ(_free_space_map.num_free_pages(), 1u);
+  EXPECT_EQ(_free_space_map.num_free_value_bytes(), 16u);
+  EXPECT_EQ(_free_space_map.allocate_page(), 4096u);
+  EXPECT_EQ(_free_space_map.allocate_page(), InvalidNodeID);
+  EXPECT_EQ(_free_space_map.allocate_value_slot(16), 100u);
+  EXPECT_TRUE(_free_space_map.empty());
+}
+
+TEST_F(FreeSpaceMapTest, ValueSlotsAreSplit) {
+  _free_space_map.free_value_slot(1'000, 100);
+  _free_space_map.release_freed_space();
+
+  // The rest of the slot stays free unless it is too small for a value
+  EXPECT_EQ(_free_space_map.allocate_value_slot(60), 1'000u);
+  EXPECT_EQ(_free_space_map.num_free_value_bytes(), 40u);
+  EXPECT_EQ(_free_space_map.allocate_value_slot(36), 1'060u);
+  EXPECT_TRUE(_free_space_map.empty());
+
+  // Slots that are too small for any value are not kept
+  _free_space_map.free_value_slot(2'000, 4);
+  _free_space_map.release_freed_space();
+  EXPECT_TRUE(_free_space_map.empty());
+}
+
+TEST_F(FreeSpaceMapTest, ValueSlotsBySizeClass) {
+  _free_space_map.free_value_slot(1'000, 20);
+  _free_space_map.free_value_slot(2'000, 30);
+  _free_space_map.free_value_slot(3'000, 1'000);
+  _free_space_map.release_freed_space();
+
+  // 20 and 30 are in the same class, only 30 bytes fit
+  EXPECT_EQ(_free_space_map.allocate_value_slot(25), 2'000u);
+  EXPECT_EQ(_free_space_map.allocate_value_slot(20), 1'000u);
+
+  // Nothing of this size class left, so the large slot is split
+  EXPECT_EQ(_free_space_map.allocate_value_slot(12), 3'000u);
+  EXPECT_EQ(_free_space_map.allocate_value_slot(2'000), InvalidNodeID);
+  EXPECT_EQ(_free_space_map.num_free_value_bytes(), 988u + 5u);
+}
+
+TEST_F(FreeSpaceMapTest, Serialize) {
+  for (auto i = 1u; i <= 10; ++i) {
+    _free_space_map.free_page(i * DEFAULT_PAGE_SIZE);
+    _free_space_map.free_value_slot(100'000 + i * 100, i * 10);
+  }
+  _free_space_map.release_freed_space();
+
+  // Space that is not released yet is not stored
+  _free_space_map.free_page(100 * DEFAULT_PAGE_SIZE);
+
+  std::vector<char> buffer;
+  _free_space_map.serialize(buffer);
+
+  FreeSpaceMap loaded_map{5};
+  ASSERT_TRUE(loaded_map.deserialize(buffer.data(), buffer.size()));
+  EXPECT_EQ(loaded_map.num_free_pages(), 10u);
+  EXPECT_EQ(loaded_map.num_free_value_bytes(), _free_space_map.num_free_value_bytes());
+  EXPECT_EQ(loaded_map.allocate_value_slot(100), 101'000u);
+
+  FreeSpaceMap broken_map{5};
+  EXPECT_FALSE(broken_map.deserialize(buffer.data(), buffer.size() - 1));
+  EXPECT_FALSE(broken_map.deserialize(buffer.data() + 8, buffer.size() - 8));
+  EXPECT_TRUE(broken_map.empty());
+}
+
+}  // namespace keva
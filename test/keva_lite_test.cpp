@@ -1,5 +1,8 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "keva_lite.hpp"
 #include "test_utils.hpp"
 
@@ -70,4 +73,240 @@ TEST_F(KevaLiteTest, SimpleCreate) {
 //  }
 //}
 
+TEST_F(KevaLiteTest, BulkLoadUnsorted) {
+  KevaLite<uint64_t, std::string> kv;
+
+  std::vector<std::pair<uint64_t, std::string>> entries;
+  for (uint64_t key = 0; key < 1'000; ++key) {
+    entries.emplace_back((key * 7919) % 1'000, std::to_string(key));
+  }
+
+  kv.bulk_load(entries.begin(), entries.end(), 0.8);
+
+  for (const auto& entry : entries) {
+    EXPECT_EQ(kv.get(entry.first), entry.second);
+  }
+}
+
+TEST_F(KevaLiteTest, BulkLoadDuplicateKeys) {
+  KevaLite<uint64_t, uint64_t> kv;
+  const std::vector<std::pair<uint64_t, uint64_t>> entries = {{1, 1}, {2, 2}, {2, 3}};
+  EXPECT_THROW(kv.bulk_load(entries.begin(), entries.end()), std::runtime_error);
+}
+
+TEST_F(KevaLiteTest, Scan) {
+  KevaLite<uint32_t, std::string> kv;
+  for (uint32_t key = 0; key < 100; ++key) kv.put(key, std::to_string(key));
+
+  std::vector<std::pair<uint32_t, std::string>> entries;
+  kv.scan(10, 19, [&](const uint32_t key, const std::string& value) { entries.emplace_back(key, value); });
+
+  ASSERT_EQ(entries.size(), 10u);
+  for (uint32_t i = 0; i < entries.size(); ++i) {
+    EXPECT_EQ(entries[i].first, 10 + i);
+    EXPECT_EQ(entries[i].second, std::to_string(10 + i));
+  }
+}
+
+TEST_F(KevaLiteTest, SignedAndCompositeKeysAreOrdered) {
+  KevaLite<int32_t, int32_t> signed_kv;
+  std::vector<std::pair<int32_t, int32_t>> signed_entries;
+  for (int32_t key = 50; key >= -50; --key) signed_entries.emplace_back(key, key * 2);
+  signed_kv.bulk_load(signed_entries.begin(), signed_entries.end());
+
+  std::vector<int32_t> scanned_keys;
+  signed_kv.scan(-3, 2, [&](const int32_t key, const int32_t value) {
+    EXPECT_EQ(value, key * 2);
+    scanned_keys.push_back(key);
+  });
+  EXPECT_EQ(scanned_keys, std::vector<int32_t>({-3, -2, -1, 0, 1, 2}));
+
+  KevaLite<double, uint64_t> double_kv;
+  for (const auto key : {2.5, -0.25, 1e9, -7.0}) double_kv.put(key, 1);
+  std::vector<double> scanned_doubles;
+  double_kv.scan(-10.0, 10.0, [&](const double key, uint64_t) { scanned_doubles.push_back(key); });
+  EXPECT_EQ(scanned_doubles, std::vector<double>({-7.0, -0.25, 2.5}));
+
+  // (tenant, timestamp) keys: a scan over one tenant returns its entries in time order
+  using TenantTime = std::pair<uint32_t, int32_t>;
+  KevaLite<TenantTime, uint64_t> composite_kv;
+  for (uint32_t tenant = 0; tenant < 3; ++tenant) {
+    for (int32_t timestamp = 10; timestamp >= -10; --timestamp) composite_kv.put({tenant, timestamp}, tenant);
+  }
+
+  std::vector<TenantTime> scanned_composites;
+  composite_kv.scan({1, std::numeric_limits<int32_t>::min()}, {1, std::numeric_limits<int32_t>::max()},
+                    [&](const TenantTime& key, uint64_t) { scanned_composites.push_back(key); });
+  ASSERT_EQ(scanned_composites.size(), 21u);
+  EXPECT_EQ(scanned_composites.front(), TenantTime(1, -10));
+  EXPECT_TRUE(std::is_sorted(scanned_composites.begin(), scanned_composites.end()));
+  EXPECT_THROW(composite_kv.get({3, 0}), std::runtime_error);
+}
+
+TEST_F(KevaLiteTest, StringKeysAreOrdered) {
+  KevaLite<std::string, uint64_t> kv;
+  const std::vector<std::string> keys = {"pear", "apple", "banana", "apricot", "cherry", "app"};
+  for (auto i = 0u; i < keys.size(); ++i) kv.put(keys[i], i);
+
+  std::vector<std::string> scanned_keys;
+  kv.scan("apple", "banana", [&](const std::string& key, const uint64_t) { scanned_keys.push_back(key); });
+  EXPECT_EQ(scanned_keys, std::vector<std::string>({"apple", "apricot", "banana"}));
+
+  scanned_keys.clear();
+  kv.scan_prefix("ap", [&](const std::string& key, const uint64_t value) {
+    EXPECT_EQ(keys[value], key);
+    scanned_keys.push_back(key);
+  });
+  EXPECT_EQ(scanned_keys, std::vector<std::string>({"app", "apple", "apricot"}));
+
+  KevaLite<std::string, std::string> bulk_kv;
+  std::vector<std::pair<std::string, std::string>> entries = {{"b", "2"}, {"c", "3"}, {"a", "1"}};
+  bulk_kv.bulk_load(entries.begin(), entries.end());
+  EXPECT_EQ(bulk_kv.get("a"), "1");
+  EXPECT_THROW(bulk_kv.get("d"), std::runtime_error);
+
+  KevaLite<std::string, std::string>::WriteBatch batch;
+  batch.put("d", "4");
+  batch.remove("a");
+  bulk_kv.write(batch);
+  EXPECT_EQ(bulk_kv.get("d"), "4");
+  EXPECT_THROW(bulk_kv.get("a"), std::runtime_error);
+}
+
+TEST_F(KevaLiteTest, MultiGet) {
+  KevaLite<std::string, uint64_t> kv;
+  kv.put("a", 1);
+  kv.put("b", 2);
+  kv.put("c", 3);
+
+  const auto values = kv.multi_get({"c", "x", "a", "c"});
+  ASSERT_EQ(values.size(), 4u);
+  EXPECT_EQ(values[0], 3u);
+  EXPECT_FALSE(values[1].has_value());
+  EXPECT_EQ(values[2], 1u);
+  EXPECT_EQ(values[3], 3u);
+}
+
+TEST_F(KevaLiteTest, WriteBatch) {
+  KevaLite<uint64_t, std::string> kv;
+  kv.put(1, "one");
+
+  KevaLite<uint64_t, std::string>::WriteBatch batch;
+  batch.put(2, "two");
+  batch.put(3, "three");
+  batch.remove(1);
+  EXPECT_EQ(batch.size(), 3u);
+  kv.write(batch);
+
+  EXPECT_THROW(kv.get(1), std::runtime_error);
+  EXPECT_EQ(kv.get(2), "two");
+  EXPECT_EQ(kv.get(3), "three");
+
+  kv.remove(3);
+  EXPECT_THROW(kv.get(3), std::runtime_error);
+}
+
+TEST_F(KevaLiteTest, UpdateAndUpsert) {
+  KevaLite<uint64_t, std::string> kv;
+  kv.put(1, "one");
+
+  kv.update(1, "uno");
+  EXPECT_EQ(kv.get(1), "uno");
+  EXPECT_THROW(kv.update(2, "two"), std::runtime_error);
+
+  kv.upsert(2, "two");
+  kv.upsert(1, "eins");
+  EXPECT_EQ(kv.get(1), "eins");
+  EXPECT_EQ(kv.get(2), "two");
+}
+
+TEST_F(KevaLiteTest, RemoveAndMerge) {
+  KevaLite<uint64_t, uint64_t> kv;
+  for (uint64_t key = 0; key < 10'000; ++key) kv.put(key, key);
+  for (uint64_t key = 0; key < 10'000; ++key) {
+    if (key % 10 != 0) kv.remove(key);
+  }
+  kv.merge_underfull_nodes();
+
+  for (uint64_t key = 0; key < 10'000; ++key) {
+    if (key % 10 == 0) {
+      EXPECT_EQ(kv.get(key), key);
+    } else {
+      EXPECT_THROW(kv.get(key), std::runtime_error);
+    }
+  }
+}
+
+TEST_F(KevaLiteTest, PageSize) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.page_size = MAX_PAGE_SIZE;
+  {
+    KevaLite<uint32_t, std::string> kv{file_name, options};
+    for (uint32_t key = 0; key < 20'000; ++key) kv.put(key * 3, std::to_string(key));
+  }
+
+  // The number of keys per node follows the page size of the file
+  KevaLite<uint32_t, std::string> kv{file_name};
+  for (uint32_t key = 0; key < 20'000; key += 7) EXPECT_EQ(kv.get(key * 3), std::to_string(key));
+  kv.put(1, "new");
+  EXPECT_EQ(kv.get(1), "new");
+
+  remove(file_name.data());
+}
+
+TEST_F(KevaLiteTest, Compact) {
+  const auto file_name = get_random_temp_file_name();
+  const auto compacted_file_name = get_random_temp_file_name();
+  {
+    KevaLite<uint64_t, std::string> kv{file_name};
+    for (uint64_t key = 0; key < 1'000; ++key) kv.put((key * 7) % 1'000, std::to_string(key));
+    for (uint64_t key = 0; key < 1'000; key += 2) kv.remove(key);
+    kv.compact(compacted_file_name);
+  }
+
+  {
+    KevaLite<uint64_t, std::string> kv{compacted_file_name};
+    for (uint64_t key = 0; key < 1'000; ++key) {
+      if ((key * 7) % 2 == 0) {
+        EXPECT_THROW(kv.get((key * 7) % 1'000), std::runtime_error);
+      } else {
+        EXPECT_EQ(kv.get((key * 7) % 1'000), std::to_string(key));
+      }
+    }
+  }
+
+  remove(file_name.data());
+  remove(compacted_file_name.data());
+}
+
+TEST_F(KevaLiteTest, Snapshot) {
+  const auto file_name = get_random_temp_file_name();
+  DBOptions options;
+  options.copy_on_write = true;
+  KevaLite<int32_t, std::string> kv{file_name, options};
+  for (int32_t key = -100; key < 100; ++key) kv.put(key, std::to_string(key));
+
+  const auto snapshot = kv.snapshot();
+  for (int32_t key = -100; key < 100; key += 2) kv.update(key, "new");
+  kv.remove(-99);
+  kv.put(100, "100");
+
+  EXPECT_EQ(snapshot.get(-100), "-100");
+  EXPECT_EQ(kv.get(-100), "new");
+  EXPECT_THROW(snapshot.get(100), std::runtime_error);
+  EXPECT_EQ(snapshot.multi_get({-99, 0, 100}),
+            (std::vector<std::optional<std::string>>{"-99", "0", std::nullopt}));
+
+  std::vector<int32_t> keys;
+  snapshot.scan(-100, 100, [&](const int32_t key, const std::string& value) {
+    EXPECT_EQ(value, std::to_string(key));
+    keys.push_back(key);
+  });
+  EXPECT_EQ(keys.size(), 200u);
+  EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+  remove(file_name.data());
+}
+
 }  // namespace keva
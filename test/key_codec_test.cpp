@@ -0,0 +1,67 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "key_codec.hpp"
+
+namespace keva {
+
+class KeyCodecTest : public ::testing::Test {
+ protected:
+  // The keys must be sorted. Checks that their file keys are sorted as well and that they are decoded again.
+  template <typename T>
+  static void _expect_order_preserved(const std::vector<T>& keys) {
+    for (auto i = size_t{0}; i < keys.size(); ++i) {
+      EXPECT_EQ(convert_from_file_key<T>(convert_to_file_key(keys[i])), keys[i]);
+      if (i > 0) {
+        EXPECT_LT(convert_to_file_key(keys[i - 1]), convert_to_file_key(keys[i]));
+      }
+    }
+  }
+};
+
+TEST_F(KeyCodecTest, UnsignedIntegers) {
+  EXPECT_EQ(convert_to_file_key(uint64_t{42}), 42u);
+  _expect_order_preserved<uint64_t>({0, 1, 1000, std::numeric_limits<uint64_t>::max()});
+  _expect_order_preserved<uint8_t>({0, 127, 128, 255});
+}
+
+TEST_F(KeyCodecTest, SignedIntegers) {
+  _expect_order_preserved<int32_t>({std::numeric_limits<int32_t>::min(), -1000, -1, 0, 1, 1000,
+                                    std::numeric_limits<int32_t>::max()});
+  _expect_order_preserved<int64_t>({std::numeric_limits<int64_t>::min(), -1, 0, std::numeric_limits<int64_t>::max()});
+  _expect_order_preserved<int8_t>({-128, -1, 0, 127});
+
+  // Only the bits of the type are used
+  EXPECT_EQ(convert_to_file_key(int32_t{-1}), 0x7FFF'FFFFu);
+}
+
+TEST_F(KeyCodecTest, FloatingPoint) {
+  using Limits = std::numeric_limits<double>;
+  _expect_order_preserved<double>({-Limits::infinity(), Limits::lowest(), -1.5, -Limits::min(), -Limits::denorm_min(),
+                                   0.0, Limits::denorm_min(), 1.0, 1.5, Limits::max(), Limits::infinity()});
+  _expect_order_preserved<float>({-2.5f, -1.0f, 0.0f, 0.5f, 3.0f});
+
+  // -0.0 is ordered right before 0.0
+  EXPECT_EQ(convert_to_file_key(-0.0) + 1, convert_to_file_key(0.0));
+}
+
+TEST_F(KeyCodecTest, Composites) {
+  using TenantTime = std::pair<uint32_t, int32_t>;
+  _expect_order_preserved<TenantTime>({{0, -5}, {0, 0}, {0, 7}, {1, std::numeric_limits<int32_t>::min()}, {1, -1},
+                                       {std::numeric_limits<uint32_t>::max(), 0}});
+
+  using Triple = std::tuple<int16_t, uint8_t, float>;
+  _expect_order_preserved<Triple>({{-3, 255, 1.0f}, {-3, 255, 2.0f}, {0, 0, -1.0f}, {0, 1, -1.0f}, {2, 0, 0.0f}});
+
+  EXPECT_EQ(convert_to_file_key(TenantTime{1, 2}), (uint64_t{1} << 32) | 0x8000'0002u);
+
+  // A single element may use all bits
+  _expect_order_preserved<std::tuple<int64_t>>({{-1}, {0}, {1}});
+}
+
+}  // namespace keva
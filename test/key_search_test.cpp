@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "key_search.hpp"
+
+namespace keva {
+
+class KeySearchTest : public ::testing::Test {};
+
+TEST_F(KeySearchTest, MatchesStandardSearch) {
+  std::mt19937_64 random_engine{17};
+
+  // Cover all tail lengths of the SIMD blocks and keys that need an unsigned comparison
+  for (uint16_t num_keys = 0; num_keys <= 130; ++num_keys) {
+    std::vector<FileKey> keys(num_keys);
+    for (auto& key : keys) key = random_engine() % 500 + (random_engine() % 2 == 0 ? 0 : (1ull << 63));
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<FileKey> search_keys = {0, 1, std::numeric_limits<FileKey>::max(), 1ull << 63};
+    for (const auto key : keys) {
+      search_keys.push_back(key);
+      search_keys.push_back(key - 1);
+      search_keys.push_back(key + 1);
+    }
+
+    for (const auto kernel : {KeySearchKernel::Scalar, KeySearchKernel::AVX2, KeySearchKernel::AVX512}) {
+      if (!key_search_kernel_is_supported(kernel)) continue;
+
+      for (const auto search_key : search_keys) {
+        const auto lower = std::lower_bound(keys.begin(), keys.end(), search_key) - keys.begin();
+        const auto upper = std::upper_bound(keys.begin(), keys.end(), search_key) - keys.begin();
+        ASSERT_EQ(keys_lower_bound(keys.data(), num_keys, search_key, kernel), lower);
+        ASSERT_EQ(keys_upper_bound(keys.data(), num_keys, search_key, kernel), upper);
+      }
+    }
+  }
+}
+
+TEST_F(KeySearchTest, MatchesStandardSearchFor32BitKeys) {
+  std::mt19937 random_engine{17};
+
+  for (uint16_t num_keys = 0; num_keys <= 200; ++num_keys) {
+    std::vector<uint32_t> keys(num_keys);
+    for (auto& key : keys) key = random_engine() % 500 + (random_engine() % 2 == 0 ? 0 : (1u << 31));
+    std::sort(keys.begin(), keys.end());
+
+    // Search keys that do not fit into 32 bits are greater than all keys
+    std::vector<FileKey> search_keys = {0, std::numeric_limits<uint32_t>::max(), 1ull << 32, 1u << 31};
+    for (const FileKey key : keys) {
+      search_keys.push_back(key);
+      search_keys.push_back(key - 1);
+      search_keys.push_back(key + 1);
+    }
+
+    for (const auto kernel : {KeySearchKernel::Scalar, KeySearchKernel::AVX2, KeySearchKernel::AVX512}) {
+      if (!key_search_kernel_is_supported(kernel)) continue;
+
+      for (const auto search_key : search_keys) {
+        const auto lower = std::lower_bound(keys.begin(), keys.end(), search_key) - keys.begin();
+        const auto upper = std::upper_bound(keys.begin(), keys.end(), search_key) - keys.begin();
+        ASSERT_EQ(keys32_lower_bound(keys.data(), num_keys, search_key, kernel), lower);
+        ASSERT_EQ(keys32_upper_bound(keys.data(), num_keys, search_key, kernel), upper);
+      }
+    }
+  }
+}
+
+TEST_F(KeySearchTest, UnsupportedKernelThrows) {
+  const std::vector<FileKey> keys = {2, 4, 6};
+  for (const auto kernel : {KeySearchKernel::AVX2, KeySearchKernel::AVX512}) {
+    if (key_search_kernel_is_supported(kernel)) continue;
+    EXPECT_THROW(keys_lower_bound(keys.data(), 3, 4, kernel), std::logic_error);
+  }
+}
+
+TEST_F(KeySearchTest, ActiveKernelIsSupported) {
+  EXPECT_TRUE(key_search_kernel_is_supported(active_key_search_kernel()));
+
+  const std::vector<FileKey> keys = {2, 4, 6};
+  EXPECT_EQ(keys_lower_bound(keys.data(), 3, 4), 1);
+  EXPECT_EQ(keys_upper_bound(keys.data(), 3, 4), 2);
+}
+
+}  // namespace keva
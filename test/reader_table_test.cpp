@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <thread>
+
+#include "reader_table.hpp"
+
+namespace keva {
+
+class ReaderTableTest : public ::testing::Test {};
+
+TEST_F(ReaderTableTest, PinsKeepOldVersions) {
+  ReaderTable reader_table{4096, 4};
+  EXPECT_EQ(reader_table.oldest_pinned_version(), std::numeric_limits<uint64_t>::max());
+
+  std::optional<ReaderPin> old_pin = reader_table.pin();
+  EXPECT_EQ(old_pin->root_id(), 4096u);
+  EXPECT_EQ(reader_table.publish(8192), 1u);
+  EXPECT_EQ(reader_table.oldest_pinned_version(), 0u);
+
+  // Moved pins stay pinned until the last owner is gone
+  const auto new_pin = reader_table.pin();
+  EXPECT_EQ(new_pin.root_id(), 8192u);
+  const auto moved_pin = std::move(*old_pin);
+  old_pin.reset();
+  EXPECT_EQ(reader_table.oldest_pinned_version(), 0u);
+  EXPECT_EQ(moved_pin.root_id(), 4096u);
+}
+
+TEST_F(ReaderTableTest, UnpinnedVersionsAreReleased) {
+  ReaderTable reader_table{4096, 4};
+  reader_table.publish(8192);
+  {
+    const auto pin = reader_table.pin();
+    EXPECT_EQ(reader_table.publish(12288), 2u);
+    EXPECT_EQ(reader_table.oldest_pinned_version(), 1u);
+  }
+  EXPECT_EQ(reader_table.oldest_pinned_version(), std::numeric_limits<uint64_t>::max());
+}
+
+TEST_F(ReaderTableTest, ReadersWaitForAFreeSlot) {
+  ReaderTable reader_table{4096, 2};
+  std::optional<ReaderPin> first_pin = reader_table.pin();
+  const auto second_pin = reader_table.pin();
+
+  std::atomic<bool> is_pinned{false};
+  std::thread reader([&] {
+    const auto pin = reader_table.pin();
+    is_pinned = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(is_pinned);
+
+  first_pin.reset();
+  reader.join();
+  EXPECT_TRUE(is_pinned);
+}
+
+}  // namespace keva
@@ -0,0 +1,161 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "sharded_keva_lite.hpp"
+#include "test_utils.hpp"
+
+namespace keva {
+
+class ShardedKevaLiteTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    for (auto shard_id = 0u; shard_id <= NUM_SHARDS; ++shard_id) {
+      std::remove(ShardedKevaLite<int32_t, std::string>::shard_file_name(_file_name, shard_id).data());
+    }
+  }
+
+  static constexpr uint32_t NUM_SHARDS = 4;
+
+  const std::string _file_name = get_random_temp_file_name();
+};
+
+TEST_F(ShardedKevaLiteTest, SpreadsKeysAcrossShards) {
+  ShardedKevaLite<int32_t, std::string> kv{_file_name, NUM_SHARDS};
+  EXPECT_EQ(kv.num_shards(), NUM_SHARDS);
+  for (int32_t key = -500; key < 500; ++key) kv.put(key, std::to_string(key));
+
+  for (int32_t key = -500; key < 500; ++key) EXPECT_EQ(kv.get(key), std::to_string(key));
+  EXPECT_THROW(kv.get(500), std::runtime_error);
+
+  // Each shard got a fair share of the keys and grew beyond an empty database
+  std::vector<uint64_t> file_sizes;
+  for (auto shard_id = 0u; shard_id < NUM_SHARDS; ++shard_id) {
+    const auto shard_file_name = ShardedKevaLite<int32_t, std::string>::shard_file_name(_file_name, shard_id);
+    std::ifstream shard_file{shard_file_name, std::ios::binary | std::ios::ate};
+    ASSERT_TRUE(shard_file.good());
+    file_sizes.push_back(static_cast<uint64_t>(shard_file.tellg()));
+  }
+  const auto [min_size, max_size] = std::minmax_element(file_sizes.begin(), file_sizes.end());
+  EXPECT_LE(*max_size, 2 * *min_size);
+}
+
+TEST_F(ShardedKevaLiteTest, WritesAndReadsBatches) {
+  ShardedKevaLite<int32_t, std::string> kv{_file_name, NUM_SHARDS};
+  ShardedKevaLite<int32_t, std::string>::WriteBatch batch;
+  for (int32_t key = 0; key < 100; ++key) batch.put(key, std::to_string(key));
+  batch.remove(7);
+  EXPECT_EQ(batch.size(), 101u);
+  kv.write(batch);
+
+  std::vector<int32_t> keys{99, 7, 0, 100, 42, 42};
+  const auto values = kv.multi_get(keys);
+  EXPECT_EQ(values, (std::vector<std::optional<std::string>>{"99", std::nullopt, "0", std::nullopt, "42", "42"}));
+
+  kv.update(42, "new");
+  kv.upsert(100, "100");
+  kv.remove(99);
+  EXPECT_THROW(kv.update(7, "missing"), std::runtime_error);
+  EXPECT_EQ(kv.multi_get({42, 100, 99}), (std::vector<std::optional<std::string>>{"new", "100", std::nullopt}));
+}
+
+TEST_F(ShardedKevaLiteTest, ScanMergesShardsInKeyOrder) {
+  ShardedKevaLite<int32_t, std::string> kv{_file_name, NUM_SHARDS};
+  std::vector<std::pair<int32_t, std::string>> entries;
+  for (int32_t key = 300; key > -300; key -= 3) entries.emplace_back(key, std::to_string(key));
+  kv.bulk_load(entries.begin(), entries.end());
+
+  std::vector<int32_t> keys;
+  kv.scan(-100, 100, [&](const int32_t key, const std::string& value) {
+    EXPECT_EQ(value, std::to_string(key));
+    keys.push_back(key);
+  });
+
+  std::vector<int32_t> expected_keys;
+  for (int32_t key = -99; key <= 100; key += 3) expected_keys.push_back(key);
+  EXPECT_EQ(keys, expected_keys);
+}
+
+TEST_F(ShardedKevaLiteTest, ManyThreadsWriteAtOnce) {
+  ShardedKevaLite<int32_t, std::string> kv{_file_name, NUM_SHARDS};
+  const auto num_threads = 4;
+  const auto num_keys_per_thread = 250;
+
+  std::vector<std::thread> writers;
+  for (auto thread_id = 0; thread_id < num_threads; ++thread_id) {
+    writers.emplace_back([&, thread_id]() {
+      for (auto i = 0; i < num_keys_per_thread; ++i) {
+        const auto key = i * num_threads + thread_id;
+        kv.put(key, std::to_string(key));
+      }
+    });
+  }
+  for (auto& writer : writers) writer.join();
+
+  auto num_entries = 0;
+  kv.scan(0, num_threads * num_keys_per_thread, [&](const int32_t key, const std::string& value) {
+    EXPECT_EQ(key, num_entries++);
+    EXPECT_EQ(value, std::to_string(key));
+  });
+  EXPECT_EQ(num_entries, num_threads * num_keys_per_thread);
+}
+
+TEST_F(ShardedKevaLiteTest, ReadsCopyOnWriteShardsOnCallingThread) {
+  DBOptions options;
+  options.copy_on_write = true;
+  ShardedKevaLite<int32_t, std::string> kv{_file_name, NUM_SHARDS, options};
+  for (int32_t key = 0; key < 200; ++key) kv.put(key, "old");
+
+  std::thread writer([&]() {
+    for (int32_t key = 0; key < 200; ++key) kv.update(key, "new");
+  });
+  for (int32_t key = 0; key < 200; ++key) {
+    const auto value = kv.get(key);
+    EXPECT_TRUE(value == "old" || value == "new");
+  }
+  writer.join();
+
+  for (int32_t key = 0; key < 200; ++key) EXPECT_EQ(kv.get(key), "new");
+}
+
+TEST_F(ShardedKevaLiteTest, ReopenKeepsKeysAndNumberOfShards) {
+  {
+    ShardedKevaLite<int32_t, std::string> kv{_file_name, NUM_SHARDS};
+    for (int32_t key = 0; key < 100; ++key) kv.put(key, std::to_string(key));
+  }
+
+  EXPECT_THROW((ShardedKevaLite<int32_t, std::string>{_file_name, NUM_SHARDS - 1}), std::runtime_error);
+  EXPECT_THROW((ShardedKevaLite<int32_t, std::string>{_file_name, NUM_SHARDS + 1}), std::runtime_error);
+  EXPECT_THROW((ShardedKevaLite<int32_t, std::string>{_file_name, 0}), std::logic_error);
+
+  ShardedKevaLite<int32_t, std::string> kv{_file_name, NUM_SHARDS};
+  for (int32_t key = 0; key < 100; ++key) EXPECT_EQ(kv.get(key), std::to_string(key));
+}
+
+TEST_F(ShardedKevaLiteTest, StringKeys) {
+  ShardedKevaLite<std::string, uint64_t> kv{_file_name, NUM_SHARDS};
+  for (auto i = 0u; i < 100; ++i) kv.put("key" + std::to_string(i), i);
+
+  EXPECT_EQ(kv.get("key42"), 42u);
+  std::vector<std::string> keys;
+  kv.scan("key1", "key2", [&](const std::string& key, uint64_t) { keys.push_back(key); });
+  EXPECT_EQ(keys.size(), 12u);
+  EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
+TEST_F(ShardedKevaLiteTest, StringKeysAlwaysGoToTheSameShard) {
+  // Existing files would be read wrongly if another build or standard library put keys into other shards
+  using StringKevaLite = ShardedKevaLite<std::string, uint64_t>;
+  EXPECT_EQ(StringKevaLite::shard_of("apple", 4), 3u);
+  EXPECT_EQ(StringKevaLite::shard_of("banana", 4), 0u);
+  EXPECT_EQ(StringKevaLite::shard_of("key42", 4), 2u);
+  EXPECT_EQ(StringKevaLite::shard_of("", 4), 1u);
+  EXPECT_EQ(StringKevaLite::shard_of("cherry", 7), 4u);
+}
+
+}  // namespace keva
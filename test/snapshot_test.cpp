@@ -0,0 +1,141 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db_manager.hpp"
+#include "test_utils.hpp"
+
+namespace keva {
+
+class SnapshotTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    _file_name = get_random_temp_file_name();
+    DBOptions options;
+    options.copy_on_write = true;
+    _db_manager.emplace(_file_name, 0, 5, options);
+    for (uint64_t key = 0; key < 200; ++key) _db_manager->put(key, convert_to_file_value(value_of(key, 0)));
+  }
+
+  void TearDown() override {
+    _db_manager.reset();
+    std::remove(_file_name.data());
+  }
+
+  static std::string value_of(const uint64_t key, const uint32_t round) {
+    return std::to_string(key) + std::string((key + round) % 20, 'v') + std::to_string(round);
+  }
+
+  // Replaces all values and removes every third key
+  void _change_all_keys(const uint32_t round) {
+    WriteBatch batch;
+    for (uint64_t key = 0; key < 200; ++key) {
+      batch.remove(key);
+      if (key % 3 != 0) batch.put(key, convert_to_file_value(value_of(key, round)));
+    }
+    _db_manager->write(batch);
+  }
+
+  std::string _file_name;
+  std::optional<DBManager> _db_manager;
+};
+
+TEST_F(SnapshotTest, ReadsTheTreeOfItsTime) {
+  const auto snapshot = _db_manager->snapshot();
+  _change_all_keys(1);
+  _db_manager->put(500, convert_to_file_value(value_of(500, 1)));
+
+  for (uint64_t key = 0; key < 200; ++key) {
+    EXPECT_EQ(convert_from_file_value<std::string>(snapshot.get(key)), value_of(key, 0));
+  }
+  EXPECT_TRUE(snapshot.get(500).empty());
+  EXPECT_TRUE(_db_manager->get(3).empty());
+
+  const auto values = snapshot.multi_get({3, 4, 500});
+  EXPECT_EQ(convert_from_file_value<std::string>(values[0]), value_of(3, 0));
+  EXPECT_EQ(convert_from_file_value<std::string>(values[1]), value_of(4, 0));
+  EXPECT_TRUE(values[2].empty());
+
+  uint64_t expected_key = 10;
+  snapshot.scan(10, 1'000, [&](const FileKey key, const FileValue& value) {
+    EXPECT_EQ(key, expected_key);
+    EXPECT_EQ(convert_from_file_value<std::string>(value), value_of(key, 0));
+    ++expected_key;
+  }, 3);
+  EXPECT_EQ(expected_key, 200u);
+
+  auto cursor = snapshot.cursor();
+  ASSERT_TRUE(cursor.seek_to_last());
+  EXPECT_EQ(cursor.key(), 199u);
+}
+
+TEST_F(SnapshotTest, PagesAreKeptUntilTheLastCopyIsGone) {
+  std::optional<Snapshot> snapshot = _db_manager->snapshot();
+  auto copy = std::make_optional(*snapshot);
+  auto cursor = std::make_optional(snapshot->cursor());
+  snapshot.reset();
+
+  // The copy and the cursor still read the first tree, so nothing that the writes replace is reused
+  const auto& free_space_map = _db_manager->get_file_manager().free_space_map();
+  _change_all_keys(1);
+  _change_all_keys(2);
+  EXPECT_EQ(free_space_map.num_free_pages(), 0u);
+  EXPECT_EQ(convert_from_file_value<std::string>(copy->get(3)), value_of(3, 0));
+
+  copy.reset();
+  _change_all_keys(3);
+  EXPECT_EQ(free_space_map.num_free_pages(), 0u);
+  ASSERT_TRUE(cursor->seek(3));
+  EXPECT_EQ(convert_from_file_value<std::string>(cursor->value()), value_of(3, 0));
+
+  cursor.reset();
+  _change_all_keys(4);
+  EXPECT_GT(free_space_map.num_free_pages(), 0u);
+}
+
+TEST_F(SnapshotTest, ManySnapshotsDoNotGrowTheFile) {
+  // Each snapshot is released before the next write, so the writes keep reusing the same pages
+  for (auto round = 1u; round <= 5; ++round) _change_all_keys(round);
+  const auto num_bytes = std::ifstream(_file_name, std::ios::binary | std::ios::ate).tellg();
+
+  for (auto round = 6u; round <= 100; ++round) {
+    const auto snapshot = _db_manager->snapshot();
+    EXPECT_EQ(convert_from_file_value<std::string>(snapshot.get(4)), value_of(4, round - 1));
+    _change_all_keys(round);
+  }
+  EXPECT_LE(std::ifstream(_file_name, std::ios::binary | std::ios::ate).tellg(), num_bytes * 2);
+}
+
+TEST_F(SnapshotTest, ReadersTakeSnapshotsWhileWritesGoOn) {
+  std::atomic<bool> is_done{false};
+  std::atomic<uint32_t> num_torn_reads{0};
+  std::vector<std::thread> readers;
+  for (auto reader = 0u; reader < 3; ++reader) {
+    readers.emplace_back([&] {
+      while (!is_done) {
+        // Both keys are changed by the same batch, so a snapshot sees them in the same round
+        const auto snapshot = _db_manager->snapshot();
+        const auto first_value = convert_from_file_value<std::string>(snapshot.get(1));
+        const auto last_value = convert_from_file_value<std::string>(snapshot.get(199));
+        if (first_value.back() != last_value.back()) ++num_torn_reads;
+      }
+    });
+  }
+
+  for (auto round = 1u; round <= 9; ++round) _change_all_keys(round);
+  is_done = true;
+  for (auto& reader : readers) reader.join();
+  EXPECT_EQ(num_torn_reads, 0u);
+}
+
+TEST_F(SnapshotTest, RequiresCopyOnWrite) {
+  DBManager db_manager{0, 5};
+  EXPECT_THROW(db_manager.snapshot(), std::logic_error);
+}
+
+}  // namespace keva
@@ -0,0 +1,256 @@
+#include "gtest/gtest.h"
+
+#include <map>
+#include <random>
+
+#include "db_manager.hpp"
+#include "string_db_manager.hpp"
+#include "test_utils.hpp"
+
+namespace keva {
+
+class StringDBManagerTest : public ::testing::Test {
+ protected:
+  static FileValue _value(const std::string& value) { return convert_to_file_value(value); }
+
+  static std::string _string(const FileValue& value) { return std::string(value.begin(), value.end()); }
+
+  // Keys of different lengths with long shared prefixes, in random order
+  static std::vector<std::string> _random_keys(const uint32_t num_keys, const uint32_t seed = 1) {
+    std::mt19937 random_engine{seed};
+    std::vector<std::string> keys;
+    for (auto i = 0u; i < num_keys; ++i) {
+      const auto tenant = std::to_string(random_engine() % 10);
+      keys.push_back("tenant-" + tenant + "/" + std::string(random_engine() % 40, 'x') + std::to_string(i));
+    }
+    std::shuffle(keys.begin(), keys.end(), random_engine);
+    return keys;
+  }
+
+  static std::vector<std::pair<std::string, std::string>> _scan_all(const StringDBManager& db_manager) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    db_manager.scan("", std::string(MAX_STRING_KEY_SIZE, '\xff'),
+                    [&](const std::string& key, const FileValue& value) { entries.emplace_back(key, _string(value)); });
+    return entries;
+  }
+};
+
+TEST_F(StringDBManagerTest, PutAndGet) {
+  StringDBManager db_manager{0};
+  const auto keys = _random_keys(10'000);
+  for (const auto& key : keys) db_manager.put(key, _value("value of " + key));
+
+  EXPECT_GT(db_manager.height(), 2u);
+  EXPECT_EQ(db_manager.num_entries(), keys.size());
+  for (const auto& key : keys) EXPECT_EQ(_string(db_manager.get(key)), "value of " + key);
+
+  EXPECT_TRUE(db_manager.get("tenant-1").empty());
+  EXPECT_TRUE(db_manager.get("").empty());
+  EXPECT_THROW(db_manager.put(keys.front(), _value("again")), std::runtime_error);
+}
+
+TEST_F(StringDBManagerTest, ScansAreOrdered) {
+  StringDBManager db_manager{8};
+  std::map<std::string, uint64_t> expected;
+  for (const auto& key : _random_keys(5'000)) {
+    expected[key] = expected.size();
+    db_manager.put(key, convert_to_file_value(expected[key]));
+  }
+
+  std::vector<std::string> scanned_keys;
+  db_manager.scan("tenant-3", "tenant-5", [&](const std::string& key, const FileValue& value) {
+    EXPECT_EQ(convert_from_file_value<uint64_t>(value), expected.at(key));
+    scanned_keys.push_back(key);
+  });
+
+  std::vector<std::string> expected_keys;
+  for (auto it = expected.lower_bound("tenant-3"); it != expected.upper_bound("tenant-5"); ++it) {
+    expected_keys.push_back(it->first);
+  }
+  EXPECT_EQ(scanned_keys, expected_keys);
+
+  // The bounds are inclusive
+  scanned_keys.clear();
+  const auto& some_key = std::next(expected.begin(), 100)->first;
+  db_manager.scan(some_key, some_key, [&](const std::string& key, const FileValue&) { scanned_keys.push_back(key); });
+  EXPECT_EQ(scanned_keys, std::vector<std::string>({some_key}));
+
+  scanned_keys.clear();
+  db_manager.scan_prefix("tenant-7/xxx", [&](const std::string& key, const FileValue&) { scanned_keys.push_back(key); });
+  expected_keys.clear();
+  for (const auto& [key, value] : expected) {
+    if (key.rfind("tenant-7/xxx", 0) == 0) expected_keys.push_back(key);
+  }
+  EXPECT_FALSE(expected_keys.empty());
+  EXPECT_EQ(scanned_keys, expected_keys);
+}
+
+TEST_F(StringDBManagerTest, LongKeys) {
+  StringDBManager db_manager{8};
+  std::vector<std::string> keys;
+  for (auto i = 0u; i < 200; ++i) keys.push_back(std::string(MAX_STRING_KEY_SIZE - 3, 'a' + i % 3) + std::to_string(i));
+  for (auto i = 0u; i < keys.size(); ++i) db_manager.put(keys[i], convert_to_file_value(uint64_t{i}));
+
+  // A key that shares no prefix with its neighbours makes the others longer in their node
+  db_manager.put("b", convert_to_file_value(uint64_t{1000}));
+
+  for (auto i = 0u; i < keys.size(); ++i) EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(keys[i])), i);
+  EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get("b")), 1000u);
+  EXPECT_EQ(_scan_all(db_manager).size(), keys.size() + 1);
+
+  EXPECT_THROW(db_manager.put(std::string(MAX_STRING_KEY_SIZE + 1, 'a'), convert_to_file_value(uint64_t{1})),
+               std::runtime_error);
+  EXPECT_TRUE(db_manager.get(std::string(MAX_STRING_KEY_SIZE + 1, 'a')).empty());
+}
+
+TEST_F(StringDBManagerTest, UpdateUpsertAndRemove) {
+  StringDBManager db_manager{0};
+  const auto keys = _random_keys(2'000);
+  for (const auto& key : keys) db_manager.put(key, _value("a"));
+
+  db_manager.update(keys[0], _value("a much longer value that does not fit into the old one"));
+  EXPECT_EQ(_string(db_manager.get(keys[0])), "a much longer value that does not fit into the old one");
+  EXPECT_THROW(db_manager.update("missing", _value("b")), std::runtime_error);
+
+  db_manager.upsert("missing", _value("b"));
+  db_manager.upsert(keys[1], _value("c"));
+  EXPECT_EQ(_string(db_manager.get("missing")), "b");
+  EXPECT_EQ(_string(db_manager.get(keys[1])), "c");
+
+  for (auto i = 0u; i < keys.size(); i += 2) db_manager.remove(keys[i]);
+  db_manager.remove("never inserted");
+  for (auto i = 0u; i < keys.size(); ++i) EXPECT_EQ(db_manager.get(keys[i]).empty(), i % 2 == 0);
+  EXPECT_EQ(db_manager.num_entries(), keys.size() / 2 + 1);
+}
+
+TEST_F(StringDBManagerTest, WriteBatch) {
+  StringDBManager db_manager{0};
+  db_manager.put("a", _value("1"));
+  db_manager.put("b", _value("2"));
+
+  StringWriteBatch batch;
+  batch.put("c", _value("3"));
+  batch.remove("a");
+  batch.remove("b");
+  batch.put("b", _value("two"));
+  db_manager.write(batch);
+
+  EXPECT_TRUE(db_manager.get("a").empty());
+  EXPECT_EQ(_string(db_manager.get("b")), "two");
+  EXPECT_EQ(_string(db_manager.get("c")), "3");
+
+  // Nothing is written if the batch is invalid
+  StringWriteBatch invalid_batch;
+  invalid_batch.put("d", _value("4"));
+  invalid_batch.put("c", _value("3"));
+  EXPECT_THROW(db_manager.write(invalid_batch), std::runtime_error);
+  EXPECT_TRUE(db_manager.get("d").empty());
+}
+
+TEST_F(StringDBManagerTest, Reopen) {
+  const auto file_name = get_random_temp_file_name();
+  const auto keys = _random_keys(3'000);
+
+  DBOptions options;
+  options.enable_wal = true;
+  {
+    StringDBManager db_manager{file_name, 0, options};
+    for (const auto& key : keys) db_manager.put(key, _value(key));
+  }
+
+  {
+    StringDBManager db_manager{file_name, 0, options};
+    for (const auto& key : keys) EXPECT_EQ(_string(db_manager.get(key)), key);
+    EXPECT_EQ(_scan_all(db_manager).size(), keys.size());
+  }
+
+  // Trees with fixed-size keys cannot read the file
+  EXPECT_THROW((DBManager{file_name, 0}), std::logic_error);
+
+  DBOptions value_log_options;
+  value_log_options.enable_value_log = true;
+  EXPECT_THROW((StringDBManager{get_random_temp_file_name(), 0, value_log_options}), std::logic_error);
+
+  std::remove(file_name.data());
+  std::remove((file_name + "-wal").data());
+}
+
+TEST_F(StringDBManagerTest, BulkLoadAndCompact) {
+  const auto file_name = get_random_temp_file_name();
+  const auto compacted_file_name = get_random_temp_file_name();
+
+  std::map<std::string, std::string> entries;
+  for (const auto& key : _random_keys(5'000)) entries[key] = "value of " + key;
+
+  {
+    StringDBManager db_manager{file_name, 0};
+    auto entry_it = entries.cbegin();
+    db_manager.bulk_load(entries.size(), [&]() {
+      const auto& [key, value] = *entry_it++;
+      return StringBulkLoadEntry{key, _value(value)};
+    });
+    EXPECT_EQ(db_manager.num_entries(), entries.size());
+    for (const auto& [key, value] : entries) EXPECT_EQ(_string(db_manager.get(key)), value);
+
+    // Loaded trees can be changed like any other
+    db_manager.put("tenant-0", _value("new"));
+    for (auto it = entries.begin(); it != entries.end(); std::advance(it, 2)) db_manager.remove(it->first);
+    db_manager.compact(compacted_file_name, 0.9);
+  }
+
+  {
+    StringDBManager db_manager{compacted_file_name, 0};
+    EXPECT_EQ(db_manager.num_entries(), entries.size() / 2 + 1);
+    EXPECT_EQ(_string(db_manager.get("tenant-0")), "new");
+
+    auto index = 0u;
+    for (const auto& [key, value] : entries) {
+      if (index++ % 2 == 0) {
+        EXPECT_TRUE(db_manager.get(key).empty());
+      } else {
+        EXPECT_EQ(_string(db_manager.get(key)), value);
+      }
+    }
+  }
+
+  StringDBManager empty_db_manager{0};
+  const std::vector<std::pair<std::string, FileValue>> unsorted = {{"b", _value("1")}, {"a", _value("2")}};
+  auto entry_it = unsorted.cbegin();
+  EXPECT_THROW(empty_db_manager.bulk_load(unsorted.size(), [&]() { return *entry_it++; }), std::runtime_error);
+
+  std::remove(file_name.data());
+  std::remove(compacted_file_name.data());
+}
+
+TEST_F(StringDBManagerTest, RandomOperations) {
+  DBOptions options;
+  options.buffer_pool_size = 64 * DEFAULT_PAGE_SIZE;
+  const auto file_name = get_random_temp_file_name();
+  StringDBManager db_manager{file_name, 8, options};
+
+  std::mt19937 random_engine{7};
+  std::map<std::string, uint64_t> expected;
+  for (auto i = 0u; i < 20'000; ++i) {
+    const auto key = std::to_string(random_engine() % 3'000) + std::string(random_engine() % 3, '#');
+    if (random_engine() % 3 == 0) {
+      db_manager.remove(key);
+      expected.erase(key);
+    } else {
+      db_manager.upsert(key, convert_to_file_value(uint64_t{i}));
+      expected[key] = i;
+    }
+  }
+
+  const auto entries = _scan_all(db_manager);
+  ASSERT_EQ(entries.size(), expected.size());
+  auto expected_it = expected.cbegin();
+  for (const auto& [key, value] : entries) {
+    EXPECT_EQ(key, expected_it->first);
+    EXPECT_EQ(convert_from_file_value<uint64_t>(db_manager.get(key)), expected_it->second);
+    ++expected_it;
+  }
+
+  std::remove(file_name.data());
+}
+
+}  // namespace keva
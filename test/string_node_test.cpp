@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+
+#include "bp_node_view.hpp"
+#include "string_node.hpp"
+
+namespace keva {
+
+class StringNodeTest : public ::testing::Test {
+ protected:
+  static StringNode _leaf(std::vector<std::string> keys) {
+    std::vector<NodeID> children(keys.size());
+    for (auto i = 0u; i < children.size(); ++i) children[i] = 100 + i;
+    BPNodeHeader header{};
+    header.node_id = 14;
+    header.is_leaf = true;
+    header.next_leaf = 1000;
+    return StringNode{header, std::move(keys), std::move(children)};
+  }
+
+  NodePage _page{};
+};
+
+TEST_F(StringNodeTest, ShortestSeparator) {
+  EXPECT_EQ(shortest_separator("apple", "banana"), "b");
+  EXPECT_EQ(shortest_separator("apple", "apricot"), "apr");
+  EXPECT_EQ(shortest_separator("app", "apple"), "appl");
+  EXPECT_EQ(shortest_separator("", "a"), "a");
+}
+
+TEST_F(StringNodeTest, EncodeAndDecode) {
+  const auto leaf = _leaf({"user:1", "user:10", "user:2", "user:3"});
+  leaf.encode(_page.data(), LEGACY_PAGE_SIZE);
+
+  // The shared prefix is only stored once
+  const StringNodeView view{_page.data()};
+  EXPECT_TRUE(view.is_leaf());
+  EXPECT_EQ(view.num_keys(), 4);
+  EXPECT_EQ(view.next_leaf(), 1000u);
+  EXPECT_EQ(view.prefix(), "user:");
+  EXPECT_EQ(view.key_suffix(1), "10");
+  EXPECT_EQ(view.key(1), "user:10");
+  EXPECT_EQ(view.value_slot(2), 102u);
+  EXPECT_EQ(leaf.encoded_size(), PREFIX_OFFSET + 5u + 4u * (KEY_HEAD_SIZE + STRING_SLOT_SIZE) + 5u);
+
+  const auto decoded = StringNode::decode(_page.data());
+  EXPECT_EQ(decoded.header().node_id, 14u);
+  EXPECT_EQ(decoded.keys(), leaf.keys());
+  EXPECT_EQ(decoded.children(), leaf.children());
+}
+
+TEST_F(StringNodeTest, Search) {
+  _leaf({"user:1", "user:10", "user:2", "user:3"}).encode(_page.data(), LEGACY_PAGE_SIZE);
+  const StringNodeView view{_page.data()};
+
+  EXPECT_EQ(view.lower_bound("user:10"), 1);
+  EXPECT_EQ(view.upper_bound("user:10"), 2);
+  EXPECT_EQ(view.lower_bound("user:15"), 2);
+  EXPECT_EQ(view.lower_bound("user:"), 0);
+
+  // Keys without the prefix are smaller or greater than all keys
+  EXPECT_EQ(view.lower_bound("us"), 0);
+  EXPECT_EQ(view.lower_bound("abc"), 0);
+  EXPECT_EQ(view.lower_bound("zzz"), 4);
+
+  EXPECT_EQ(view.find_value("user:2"), 102u);
+  EXPECT_FALSE(view.find_value("user:20").has_value());
+  EXPECT_FALSE(view.find_value("user").has_value());
+}
+
+TEST_F(StringNodeTest, InternalNode) {
+  BPNodeHeader header{};
+  header.node_id = 14;
+  StringNode node{header, {"b", "d"}, {1, 2, 3}};
+  node.insert(1, "c", 4);
+  EXPECT_EQ(node.children(), std::vector<NodeID>({1, 2, 4, 3}));
+
+  node.encode(_page.data(), LEGACY_PAGE_SIZE);
+  const StringNodeView view{_page.data()};
+  EXPECT_EQ(view.find_child("a"), 1u);
+  EXPECT_EQ(view.find_child("b"), 2u);
+  EXPECT_EQ(view.find_child("cat"), 4u);
+  EXPECT_EQ(view.find_child("z"), 3u);
+
+  // The middle key moves up
+  auto [sibling, separator] = node.split(1);
+  EXPECT_EQ(separator, "c");
+  EXPECT_EQ(node.keys(), std::vector<std::string>({"b"}));
+  EXPECT_EQ(node.children(), std::vector<NodeID>({1, 2}));
+  EXPECT_EQ(sibling.keys(), std::vector<std::string>({"d"}));
+  EXPECT_EQ(sibling.children(), std::vector<NodeID>({4, 3}));
+}
+
+TEST_F(StringNodeTest, SplitLeaf) {
+  std::vector<std::string> keys;
+  for (auto i = 0; i < 26; ++i) keys.push_back(std::to_string(100 + i) + std::string(57, 'a'));
+  auto leaf = _leaf(keys);
+  EXPECT_FALSE(leaf.fits(LEGACY_PAGE_SIZE));
+
+  // Both halves fit and use about the same space. After appends, the left half stays full.
+  const auto position = leaf.split_position(false, LEGACY_PAGE_SIZE);
+  EXPECT_EQ(position, 13);
+  EXPECT_EQ(leaf.split_position(true, LEGACY_PAGE_SIZE), 25);
+
+  auto [sibling, separator] = leaf.split(position);
+  EXPECT_TRUE(leaf.fits(LEGACY_PAGE_SIZE));
+  EXPECT_TRUE(sibling.fits(LEGACY_PAGE_SIZE));
+  EXPECT_EQ(separator, "113");
+  EXPECT_EQ(sibling.keys().front(), keys[13]);
+  EXPECT_EQ(sibling.children().front(), 113u);
+}
+
+TEST_F(StringNodeTest, SplitAfterPrefixChange) {
+  // All keys share a long prefix, except for the last one. The other keys only fit into a page with their prefix.
+  std::vector<std::string> keys;
+  for (auto i = 0; i < 60; ++i) keys.push_back(std::string(400, 'a') + std::to_string(100 + i));
+  keys.push_back("b");
+  auto leaf = _leaf(keys);
+  EXPECT_FALSE(leaf.fits(LEGACY_PAGE_SIZE));
+
+  auto [sibling, separator] = leaf.split(leaf.split_position(false, LEGACY_PAGE_SIZE));
+  EXPECT_TRUE(leaf.fits(LEGACY_PAGE_SIZE));
+  EXPECT_TRUE(sibling.fits(LEGACY_PAGE_SIZE));
+  EXPECT_EQ(sibling.keys().back(), "b");
+}
+
+}  // namespace keva
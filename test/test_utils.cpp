@@ -1,7 +1,11 @@
 #include "test_utils.hpp"
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
 #include <string>
 
 #include "types.hpp"
@@ -36,14 +40,16 @@ namespace keva {
 
 std::string get_random_temp_file_name() {
   const auto length = 15;
+  // Seeded per process, so that leftovers of an aborted test run do not collide with new files
+  static std::mt19937 random_engine{std::random_device{}()};
   auto rand_char = []() -> char
   {
     const std::string chars = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
     const size_t max_index = chars.length() - 1;
-    return chars[rand() % max_index];
+    return chars[random_engine() % max_index];
   };
   std::string str = "/tmp/";
-  std::generate_n(str.end(), length, rand_char);
+  std::generate_n(std::back_inserter(str), length, rand_char);
   return str;
 }
 
@@ -234,7 +240,7 @@ bool subtree_is_valid(const BPNode& node, const FileKey lower, const FileKey upp
   const auto& keys = node.keys();
   const auto& children = node.children();
   const auto num_children = node.children().size();
-  const auto min_num_children = static_cast<const uint16_t>((file_manager.max_keys_per_node() + 1) / 2);
+  const auto min_num_children = static_cast<uint16_t>((file_manager.max_keys_per_node() + 1) / 2);
 
   if (node.header().num_keys != keys.size()) return false;
   if (num_children < min_num_children) return false;
@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "test_utils.hpp"
+#include "value_log.hpp"
+
+namespace keva {
+
+class ValueLogTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    std::remove(_base_name.data());
+    for (auto segment_id = 1u; segment_id <= 32; ++segment_id) {
+      std::remove((_base_name + "-" + std::to_string(segment_id)).data());
+    }
+  }
+
+  FileOffset _append(ValueLog& value_log, const FileKey key, const std::string& value) {
+    return value_log.append(key, value.data(), static_cast<uint32_t>(value.size()));
+  }
+
+  std::string _read(const ValueLog& value_log, const FileOffset pointer) {
+    const auto value = value_log.read(pointer);
+    return std::string(value.begin(), value.end());
+  }
+
+  const std::string _base_name = get_random_temp_file_name();
+};
+
+TEST_F(ValueLogTest, AppendAndRead) {
+  ValueLog value_log{_base_name, 1024 * 1024, true};
+  EXPECT_TRUE(ValueLog::exists(_base_name));
+
+  const auto first = _append(value_log, 1, "foo");
+  const auto second = _append(value_log, 2, std::string(1000, 'x'));
+  EXPECT_NE(first, InvalidNodeID);
+
+  // Buffered and written records are read the same way
+  EXPECT_EQ(_read(value_log, first), "foo");
+  value_log.flush();
+  EXPECT_EQ(_read(value_log, first), "foo");
+  EXPECT_EQ(_read(value_log, second), std::string(1000, 'x'));
+}
+
+TEST_F(ValueLogTest, SegmentsAreRotated) {
+  ValueLog value_log{_base_name, 100, true};
+
+  // Records have a 12 byte header, so three of them fit into a segment
+  std::vector<FileOffset> pointers;
+  for (auto key = 0u; key < 10; ++key) pointers.push_back(_append(value_log, key, std::string(20, 'a' + key)));
+  EXPECT_EQ(value_log.num_segments(), 4u);
+
+  for (auto key = 0u; key < 10; ++key) EXPECT_EQ(_read(value_log, pointers[key]), std::string(20, 'a' + key));
+
+  value_log.flush();
+  const auto records = value_log.read_segment(2);
+  ASSERT_EQ(records.size(), 3u);
+  EXPECT_EQ(records[0].key, 3u);
+  EXPECT_EQ(records[0].pointer, pointers[3]);
+  EXPECT_EQ(records[2].value, FileValue(20, 'f'));
+
+  // A single record may be larger than a segment
+  const auto large = _append(value_log, 10, std::string(500, 'z'));
+  EXPECT_EQ(_read(value_log, large), std::string(500, 'z'));
+}
+
+TEST_F(ValueLogTest, GarbageSegments) {
+  ValueLog value_log{_base_name, 100, true};
+
+  std::vector<FileOffset> pointers;
+  for (auto key = 0u; key < 9; ++key) pointers.push_back(_append(value_log, key, std::string(20, 'a')));
+  ASSERT_EQ(value_log.num_segments(), 3u);
+
+  value_log.free(pointers[0]);
+  value_log.free(pointers[3]);
+  value_log.free(pointers[4]);
+  EXPECT_EQ(value_log.num_dead_bytes(2), 64u);
+  EXPECT_EQ(value_log.find_garbage_segment(0.0), 2u);
+  EXPECT_EQ(value_log.find_garbage_segment(0.9), 0u);
+
+  // The head segment is never collected
+  value_log.free(pointers[6]);
+  value_log.free(pointers[7]);
+  value_log.free(pointers[8]);
+  EXPECT_EQ(value_log.find_garbage_segment(0.0), 2u);
+
+  // Dropped segments stay readable until they are released
+  value_log.drop_segment(2);
+  EXPECT_EQ(value_log.find_garbage_segment(0.0), 1u);
+  EXPECT_EQ(_read(value_log, pointers[3]), std::string(20, 'a'));
+
+  value_log.release_dropped_segments();
+  EXPECT_EQ(value_log.num_segments(), 2u);
+  EXPECT_FALSE(std::ifstream(_base_name + "-2").good());
+}
+
+TEST_F(ValueLogTest, Reopen) {
+  FileOffset pointer;
+  {
+    ValueLog value_log{_base_name, 1000, true};
+    pointer = _append(value_log, 1, std::string(50, 'a'));
+    value_log.free(_append(value_log, 2, std::string(30, 'b')));
+  }
+
+  {
+    // New records go to a new segment, as the end of the old head might be torn
+    ValueLog value_log{_base_name, 1000, false};
+    EXPECT_EQ(value_log.num_segments(), 2u);
+    EXPECT_EQ(_read(value_log, pointer), std::string(50, 'a'));
+    EXPECT_EQ(value_log.num_dead_bytes(1), 42u);
+    EXPECT_EQ(value_log.find_garbage_segment(0.0), 1u);
+  }
+
+  // A new database removes the old segments
+  ValueLog value_log{_base_name, 100, true};
+  EXPECT_EQ(value_log.num_segments(), 1u);
+  EXPECT_FALSE(std::ifstream(_base_name + "-2").good());
+}
+
+TEST_F(ValueLogTest, TornRecordIsIgnored) {
+  {
+    ValueLog value_log{_base_name, 1000, true};
+    _append(value_log, 1, "foo");
+    _append(value_log, 2, "bar");
+  }
+
+  // Cut off the last byte of the second record
+  std::string segment;
+  {
+    std::ifstream segment_file(_base_name + "-1", std::ios::binary);
+    segment.assign(std::istreambuf_iterator<char>(segment_file), std::istreambuf_iterator<char>());
+  }
+  std::ofstream(_base_name + "-1", std::ios::binary | std::ios::trunc) << segment.substr(0, segment.size() - 1);
+
+  ValueLog value_log{_base_name, 1000, false};
+  const auto records = value_log.read_segment(1);
+  ASSERT_EQ(records.size(), 1u);
+  EXPECT_EQ(records[0].key, 1u);
+}
+
+}  // namespace keva
@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+
+#include "version_latch.hpp"
+
+namespace keva {
+
+class VersionLatchTest : public ::testing::Test {
+ protected:
+  VersionLatch _latch;
+};
+
+TEST_F(VersionLatchTest, WritersChangeTheVersion) {
+  const auto version = _latch.read_version();
+  ASSERT_TRUE(version);
+  EXPECT_TRUE(_latch.validate(*version));
+
+  ASSERT_TRUE(_latch.try_upgrade(*version));
+  EXPECT_FALSE(_latch.read_version());
+  EXPECT_FALSE(_latch.validate(*version));
+  EXPECT_FALSE(_latch.try_upgrade(*version));
+
+  _latch.unlock();
+  const auto new_version = _latch.read_version();
+  ASSERT_TRUE(new_version);
+  EXPECT_NE(*new_version, *version);
+  EXPECT_FALSE(_latch.validate(*version));
+
+  // A writer that read the old version has to start over
+  EXPECT_FALSE(_latch.try_upgrade(*version));
+}
+
+TEST_F(VersionLatchTest, LatchSetTakesSharedLatchesOnce) {
+  const auto version = *_latch.read_version();
+  {
+    LatchSet latches;
+    EXPECT_TRUE(latches.try_upgrade(_latch, version));
+    EXPECT_TRUE(latches.try_upgrade(_latch, version));
+    EXPECT_TRUE(latches.try_lock(_latch));
+    EXPECT_FALSE(latches.try_upgrade(_latch, version + 2));
+    EXPECT_FALSE(_latch.read_version());
+  }
+
+  // Unlocked once when the set is destroyed
+  const auto new_version = _latch.read_version();
+  ASSERT_TRUE(new_version);
+  EXPECT_EQ(*new_version, version + 2);
+
+  LatchSet latches;
+  ASSERT_TRUE(latches.try_lock(_latch));
+  LatchSet other_latches;
+  EXPECT_FALSE(other_latches.try_lock(_latch));
+}
+
+TEST_F(VersionLatchTest, NodeLatches) {
+  const NodeLatches node_latches{16};
+  EXPECT_EQ(&node_latches[4096], &node_latches[4096]);
+
+  // Page-aligned node IDs are spread over all latches
+  auto num_distinct = 0u;
+  for (auto page = 1u; page <= 16; ++page) {
+    auto is_new = true;
+    for (auto other_page = 1u; other_page < page; ++other_page) {
+      if (&node_latches[page * 4096] == &node_latches[other_page * 4096]) is_new = false;
+    }
+    num_distinct += is_new;
+  }
+  EXPECT_GE(num_distinct, 8u);
+
+  EXPECT_THROW(NodeLatches{12}, std::logic_error);
+}
+
+}  // namespace keva
@@ -0,0 +1,150 @@
+#include "gtest/gtest.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "test_utils.hpp"
+#include "write_ahead_log.hpp"
+
+namespace keva {
+
+class WriteAheadLogTest : public ::testing::Test {
+ protected:
+  void TearDown() override { std::remove(_log_file_name.data()); }
+
+  using LoggedWrite = std::pair<FileOffset, std::string>;
+
+  std::vector<LoggedWrite> _recover(const WriteAheadLog& wal) {
+    std::vector<LoggedWrite> writes;
+    wal.recover([&](const FileOffset offset, const char* data, const uint32_t num_bytes) {
+      writes.emplace_back(offset, std::string(data, num_bytes));
+    });
+    return writes;
+  }
+
+  std::vector<char> _create_txn(const std::vector<LoggedWrite>& writes) {
+    std::vector<char> txn_log;
+    for (const auto& write : writes) {
+      WriteAheadLog::append_write(txn_log, write.first, write.second.data(), write.second.size());
+    }
+    return txn_log;
+  }
+
+  const std::string _log_file_name = get_random_temp_file_name();
+};
+
+// Log whose file can be swapped for a read-only one, so that all further writes fail
+class BreakableWriteAheadLog : public WriteAheadLog {
+ public:
+  using WriteAheadLog::WriteAheadLog;
+
+  void break_file() {
+    close(_fd);
+    _fd = open(_log_file_name.c_str(), O_RDONLY);
+  }
+};
+
+TEST_F(WriteAheadLogTest, CommitAndRecover) {
+  const std::vector<LoggedWrite> first_txn = {{14, "foo"}, {2062, "barbaz"}};
+  const std::vector<LoggedWrite> second_txn = {{6, "12345678"}};
+
+  {
+    WriteAheadLog wal{_log_file_name};
+    wal.commit(_create_txn(first_txn));
+    wal.commit(_create_txn(second_txn));
+    EXPECT_EQ(wal.num_syncs(), 2u);
+    EXPECT_GT(wal.size(), 0u);
+  }
+
+  WriteAheadLog wal{_log_file_name};
+  const std::vector<LoggedWrite> expected = {{14, "foo"}, {2062, "barbaz"}, {6, "12345678"}};
+  EXPECT_EQ(_recover(wal), expected);
+}
+
+TEST_F(WriteAheadLogTest, IgnoreTornTransaction) {
+  uint64_t first_txn_size;
+  {
+    WriteAheadLog wal{_log_file_name};
+    wal.commit(_create_txn({{14, "foo"}}));
+    first_txn_size = wal.size();
+    wal.commit(_create_txn({{100, "bar"}, {200, "baz"}}));
+  }
+
+  // Cut the second transaction in the middle of its commit record
+  ASSERT_EQ(truncate(_log_file_name.data(), static_cast<off_t>(first_txn_size + 40)), 0);
+
+  WriteAheadLog wal{_log_file_name};
+  const std::vector<LoggedWrite> expected = {{14, "foo"}};
+  EXPECT_EQ(_recover(wal), expected);
+}
+
+TEST_F(WriteAheadLogTest, Truncate) {
+  WriteAheadLog wal{_log_file_name};
+  wal.commit(_create_txn({{14, "foo"}}));
+  wal.truncate();
+  EXPECT_EQ(wal.size(), 0u);
+  EXPECT_TRUE(_recover(wal).empty());
+
+  wal.commit(_create_txn({{28, "bar"}}));
+  const std::vector<LoggedWrite> expected = {{28, "bar"}};
+  EXPECT_EQ(_recover(wal), expected);
+}
+
+TEST_F(WriteAheadLogTest, ConcurrentCommits) {
+  const auto num_threads = 8u;
+  const auto num_commits = 50u;
+
+  WriteAheadLog wal{_log_file_name};
+  std::vector<std::thread> threads;
+  for (auto thread_id = 0u; thread_id < num_threads; ++thread_id) {
+    threads.emplace_back([&, thread_id]() {
+      for (auto i = 0u; i < num_commits; ++i) {
+        wal.commit(_create_txn({{thread_id, std::to_string(i)}, {thread_id, std::to_string(i)}}));
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  // Group commit never needs more syncs than commits
+  EXPECT_LE(wal.num_syncs(), num_threads * num_commits);
+
+  // Records of a transaction are never interleaved with other transactions
+  const auto writes = _recover(wal);
+  ASSERT_EQ(writes.size(), 2 * num_threads * num_commits);
+  for (auto i = 0u; i < writes.size(); i += 2) {
+    EXPECT_EQ(writes[i], writes[i + 1]);
+  }
+}
+
+TEST_F(WriteAheadLogTest, FailedWritesAreNotDurable) {
+  const std::vector<LoggedWrite> committed_txn = {{14, "foo"}};
+  BreakableWriteAheadLog wal{_log_file_name};
+  wal.commit(_create_txn(committed_txn));
+  const auto log_size = wal.size();
+
+  // Every committer throws, whether it led its group or waited for another one
+  wal.break_file();
+  const auto num_threads = 4u;
+  std::atomic<uint32_t> num_failed_commits{0};
+  std::vector<std::thread> threads;
+  for (auto thread_id = 0u; thread_id < num_threads; ++thread_id) {
+    threads.emplace_back([&, thread_id]() {
+      try {
+        wal.commit(_create_txn({{thread_id, "lost"}}));
+      } catch (const std::logic_error&) {
+        ++num_failed_commits;
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(num_failed_commits, num_threads);
+  EXPECT_EQ(wal.size(), log_size);
+  EXPECT_THROW(wal.commit(_create_txn(committed_txn)), std::logic_error);
+  EXPECT_EQ(_recover(wal), committed_txn);
+}
+
+}  // namespace keva